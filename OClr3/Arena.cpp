@@ -0,0 +1,578 @@
+﻿#include "Arena.h"
+#include "Platform.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define ARENA_CLASSES      10            // ARENA_MIN_BLOCK << 9 == ARENA_CHUNK_BYTES
+#define ARENA_CHUNKS       (ARENA_BYTES / ARENA_CHUNK_BYTES)
+#define ARENA_STALL_SPINS  4096          // ожиданий INIT между проверками хозяина
+
+// Состояние записи каталога — старшие два бита ключа. Средние 30 бит:
+// в LIVE и DYING — поколение доски, в INIT — pid хозяина записи
+// (создателя или освобождающего).
+enum { BOARD_NONE = 0, BOARD_LIVE = 1, BOARD_DYING = 2, BOARD_INIT = 3 };
+
+static inline uint64_t MakeKey(uint32_t id, uint32_t tag, uint32_t state) {
+    return (uint64_t)id | (uint64_t)(tag & 0x3FFFFFFF) << 32 | (uint64_t)state << 62;
+}
+static inline uint32_t KeyId(uint64_t k)    { return (uint32_t)k; }
+static inline uint32_t KeyTag(uint64_t k)   { return (uint32_t)(k >> 32) & 0x3FFFFFFF; }
+static inline uint32_t KeyState(uint64_t k) { return (uint32_t)(k >> 62); }
+
+// Запись каталога. Блоки — смещения в единицах ARENA_MIN_BLOCK; пишет их
+// хозяин в состоянии INIT сразу после выделения, читают все после LIVE.
+// У записи в NONE все блоки нулевые.
+struct ArenaBoard {
+    std::atomic<uint64_t> key;         // 0 — запись ни за кем не закреплена
+    std::atomic<uint32_t> table;       // таблица подключений, в единицах ARENA_TABLE_BYTES
+    uint32_t dataBlock;
+    uint32_t cellsBlock;
+    uint32_t generation;               // сколько раз доску под этим номером заводили
+    uint8_t  dataClass;
+    uint8_t  cellsClass;
+};
+
+// Подключения доски — это pid в её таблице: сколько занятых ячеек,
+// столько подключений, и умерший процесс виден по своей ячейке. Таблицы
+// нарезаются из своих кусков и обратно в общие блоки не уходят, поэтому
+// опоздавший процесс, прочитавший номер таблицы уже удалённой доски,
+// пишет в чужую таблицу, а не в чужие клетки; owner говорит, чья она.
+struct ArenaTable {
+    std::atomic<uint64_t> owner;       // запись каталога + 1 | поколение << 32; 0 — свободна
+    uint32_t              next;        // в стеке свободных таблиц
+    uint32_t              reserved;
+    std::atomic<uint32_t> pid[ARENA_ATTACH_SLOTS];
+};
+static_assert(sizeof(ArenaTable) == ARENA_TABLE_BYTES, "table size");
+
+struct ArenaHeader {
+    std::atomic<uint64_t> carved;                  // нарезано байт от начала кусков
+    std::atomic<uint64_t> inUse;
+    std::atomic<uint64_t> freeHead[ARENA_CLASSES]; // блок | метка << 32
+    std::atomic<uint64_t> freeChunks;              // первый блок куска | метка << 32
+    std::atomic<uint64_t> freeTables;              // таблица | метка << 32
+    std::atomic<uint32_t> chunksFree;
+    std::atomic<uint32_t> tableChunks;
+    std::atomic<uint32_t> chunkLive[ARENA_CHUNKS]; // выданных блоков куска
+    std::atomic<uint32_t> boards;
+    std::atomic<uint32_t> directory;
+    std::atomic<uint32_t> probe;                   // самое дальнее место записи от начала её пробы
+    ArenaBoard dir[ARENA_DIR_SLOTS];
+    // далее, с границы ARENA_MIN_BLOCK: куски по ARENA_CHUNK_BYTES
+};
+
+struct Arena {
+    uint8_t*     base;
+    ArenaHeader* hh;
+    uint64_t     chunksStart;
+    uint64_t     chunksBytes;
+#ifdef _WIN32
+    HANDLE       hMap;
+#endif
+};
+
+// ——————————————————————————————— Блоки ——————————————————————————————————————
+
+static inline uint32_t* BlockNext(Arena* a, uint32_t blk) {
+    return (uint32_t*)(a->base + (uint64_t)blk * ARENA_MIN_BLOCK);
+}
+
+static inline uint32_t ChunkOf(Arena* a, uint32_t blk) {
+    return (uint32_t)(((uint64_t)blk * ARENA_MIN_BLOCK - a->chunksStart) / ARENA_CHUNK_BYTES);
+}
+
+static int ClassFor(size_t bytes) {
+    int cls = 0;
+    for (size_t sz = ARENA_MIN_BLOCK; sz < bytes; sz *= 2) cls++;
+    return cls < ARENA_CLASSES ? cls : -1;
+}
+
+static inline uint64_t ClassBytes(int cls) {
+    return (uint64_t)ARENA_MIN_BLOCK << cls;
+}
+
+// Цепочка first..last (уже связанная через next) на вершину стека head
+static void PushChain(Arena* a, std::atomic<uint64_t>& head, uint32_t first, uint32_t last) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    do {
+        *BlockNext(a, last) = (uint32_t)h;
+    } while (!head.compare_exchange_weak(h, first | ((h >> 32) + 1) << 32, std::memory_order_release));
+}
+
+// Метка в старшей половине головы отсекает ABA: блок, снятый и
+// возвращённый другим процессом между чтением next и CAS, голову меняет
+static uint32_t Pop(Arena* a, std::atomic<uint64_t>& head) {
+    uint64_t h = head.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t blk = (uint32_t)h;
+        if (!blk) return 0;
+        uint32_t next = *BlockNext(a, blk);
+        if (head.compare_exchange_weak(h, next | ((h >> 32) + 1) << 32, std::memory_order_acquire))
+            return blk;
+    }
+}
+
+// Кусок из общего списка, иначе новый от границы нарезки. Возвращает
+// его первый блок, 0 — сегмент кончился.
+static uint32_t TakeChunk(Arena* a) {
+    uint32_t first = Pop(a, a->hh->freeChunks);
+    if (first) {
+        a->hh->chunksFree.fetch_sub(1, std::memory_order_relaxed);
+        return first;
+    }
+    uint64_t off = a->hh->carved.fetch_add(ARENA_CHUNK_BYTES, std::memory_order_relaxed);
+    if (off + ARENA_CHUNK_BYTES > a->chunksBytes) return 0;
+    return (uint32_t)((a->chunksStart + off) / ARENA_MIN_BLOCK);
+}
+
+// Вернуть в общий список куски размера cls, все блоки которых свободны.
+// Стек снимается целиком одним CAS: пока он у нас, никто не выдаст из
+// него блок, и «все блоки куска на руках при нуле выданных» — надёжный
+// признак. Остальное возвращается одной цепочкой. Два одновременных
+// прохода делят стек между собой и кусок могут не собрать — его соберёт
+// следующий проход того же размера. Процесс, умерший посреди прохода,
+// уносит снятые блоки: их куски так и останутся нарезанными.
+static void Sweep(Arena* a, int cls) {
+    std::atomic<uint64_t>& head = a->hh->freeHead[cls];
+    uint64_t h = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(h, ((h >> 32) + 1) << 32, std::memory_order_acquire)) {}
+    if (!(uint32_t)h) return;
+
+    uint16_t have[ARENA_CHUNKS] = {};
+    for (uint32_t b = (uint32_t)h; b; b = *BlockNext(a, b)) have[ChunkOf(a, b)]++;
+    uint32_t perChunk = (uint32_t)(ARENA_CHUNK_BYTES / ClassBytes(cls));
+    bool gone[ARENA_CHUNKS];
+    for (uint32_t c = 0; c < ARENA_CHUNKS; c++)
+        gone[c] = have[c] == perChunk && a->hh->chunkLive[c].load(std::memory_order_acquire) == 0;
+
+    uint32_t first = 0, last = 0;
+    for (uint32_t b = (uint32_t)h; b; ) {
+        uint32_t next = *BlockNext(a, b);
+        if (!gone[ChunkOf(a, b)]) {
+            if (last) *BlockNext(a, last) = b;
+            else first = b;
+            last = b;
+        }
+        b = next;
+    }
+    if (first) PushChain(a, head, first, last);
+    for (uint32_t c = 0; c < ARENA_CHUNKS; c++) {
+        if (!gone[c]) continue;
+        uint32_t blk = (uint32_t)((a->chunksStart + (uint64_t)c * ARENA_CHUNK_BYTES) / ARENA_MIN_BLOCK);
+        PushChain(a, a->hh->freeChunks, blk, blk);
+        a->hh->chunksFree.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Сначала стек размера, потом кусок из общего списка или новый. Если
+// сегмент кончился, все размеры отдают свободные куски, и попытка
+// повторяется.
+static uint32_t Alloc(Arena* a, int cls) {
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t blk = Pop(a, a->hh->freeHead[cls]);
+        if (blk) {
+            a->hh->chunkLive[ChunkOf(a, blk)].fetch_add(1, std::memory_order_acq_rel);
+        }
+        else if ((blk = TakeChunk(a)) != 0) {
+            // кусок целиком под этот размер: первый блок наш, остальные в стек
+            a->hh->chunkLive[ChunkOf(a, blk)].store(1, std::memory_order_release);
+            uint32_t step = 1u << cls, end = blk + ARENA_CHUNK_BYTES / ARENA_MIN_BLOCK;
+            if (blk + step < end) {
+                for (uint32_t b = blk + step; b + step < end; b += step) *BlockNext(a, b) = b + step;
+                PushChain(a, a->hh->freeHead[cls], blk + step, end - step);
+            }
+        }
+        if (blk) {
+            a->hh->inUse.fetch_add(ClassBytes(cls), std::memory_order_relaxed);
+            return blk;
+        }
+        if (pass == 0)
+            for (int c = 0; c < ARENA_CLASSES; c++) Sweep(a, c);
+    }
+    return 0;
+}
+
+// Блок — в стек, и только потом минус выданный: пока счётчик куска не
+// ноль, проход его не заберёт, даже если блок уже снят вместе со стеком
+static void Free(Arena* a, int cls, uint32_t blk) {
+    a->hh->inUse.fetch_sub(ClassBytes(cls), std::memory_order_relaxed);
+    PushChain(a, a->hh->freeHead[cls], blk, blk);
+    if (a->hh->chunkLive[ChunkOf(a, blk)].fetch_sub(1, std::memory_order_acq_rel) == 1)
+        Sweep(a, cls);
+}
+
+// ——————————————————————————————— Таблицы подключений ——————————————————————————————————————
+
+static inline ArenaTable* TableAt(Arena* a, uint32_t t) {
+    return (ArenaTable*)(a->base + (uint64_t)t * ARENA_TABLE_BYTES);
+}
+
+static uint32_t PopTable(Arena* a) {
+    std::atomic<uint64_t>& head = a->hh->freeTables;
+    uint64_t h = head.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t t = (uint32_t)h;
+        if (!t) return 0;
+        uint32_t next = TableAt(a, t)->next;
+        if (head.compare_exchange_weak(h, next | ((h >> 32) + 1) << 32, std::memory_order_acquire))
+            return t;
+    }
+}
+
+static void PushTables(Arena* a, uint32_t first, uint32_t last) {
+    std::atomic<uint64_t>& head = a->hh->freeTables;
+    uint64_t h = head.load(std::memory_order_relaxed);
+    do {
+        TableAt(a, last)->next = (uint32_t)h;
+    } while (!head.compare_exchange_weak(h, first | ((h >> 32) + 1) << 32, std::memory_order_release));
+}
+
+// Пустая таблица для записи slot поколения gen
+static uint32_t AllocTable(Arena* a, int slot, uint32_t gen) {
+    uint32_t t = PopTable(a);
+    for (int pass = 0; !t && pass < 2; pass++) {
+        uint32_t blk = TakeChunk(a);
+        if (!blk) {
+            for (int c = 0; c < ARENA_CLASSES; c++) Sweep(a, c);
+            continue;
+        }
+        a->hh->tableChunks.fetch_add(1, std::memory_order_relaxed);
+        const uint32_t per = ARENA_CHUNK_BYTES / ARENA_TABLE_BYTES;
+        t = (uint32_t)((uint64_t)blk * ARENA_MIN_BLOCK / ARENA_TABLE_BYTES);
+        for (uint32_t i = 1; i < per; i++) {
+            TableAt(a, t + i)->owner.store(0, std::memory_order_relaxed);
+            TableAt(a, t + i)->next = t + i + 1;
+        }
+        PushTables(a, t + 1, t + per - 1);
+    }
+    if (!t) return 0;
+    ArenaTable* tb = TableAt(a, t);
+    for (uint32_t i = 0; i < ARENA_ATTACH_SLOTS; i++) tb->pid[i].store(0, std::memory_order_relaxed);
+    tb->owner.store((uint64_t)(slot + 1) | (uint64_t)gen << 32, std::memory_order_release);
+    a->hh->inUse.fetch_add(ARENA_TABLE_BYTES, std::memory_order_relaxed);
+    return t;
+}
+
+static void FreeTable(Arena* a, uint32_t t) {
+    a->hh->inUse.fetch_sub(ARENA_TABLE_BYTES, std::memory_order_relaxed);
+    TableAt(a, t)->owner.store(0, std::memory_order_release);
+    PushTables(a, t, t);
+}
+
+// Занять ячейку таблицы; -1 — таблица полна
+static int AddPid(Arena* a, uint32_t t, uint32_t pid) {
+    ArenaTable* tb = TableAt(a, t);
+    for (uint32_t i = 0; i < ARENA_ATTACH_SLOTS; i++) {
+        uint32_t v = 0;
+        if (tb->pid[i].load(std::memory_order_relaxed) == 0 && tb->pid[i].compare_exchange_strong(v, pid))
+            return (int)i;
+    }
+    return -1;
+}
+
+// ——————————————————————————————— Каталог ——————————————————————————————————————
+
+// Запись доски id: любая, кроме NONE; -1 — такой доски нет. Удалённая
+// доска оставляет запись в NONE, и её потом занимает любой номер, так что
+// ключ 0 попадается всё реже; пробу ограничивает probe — дальше от начала
+// пробы не стоит ни одна запись.
+static int FindSlot(Arena* a, uint32_t id) {
+    uint32_t h = id * 2654435761u, reach = a->hh->probe.load();
+    for (uint32_t i = 0; i <= reach && i < ARENA_DIR_SLOTS; i++) {
+        uint32_t slot = (h + i) % ARENA_DIR_SLOTS;
+        uint64_t k = a->hh->dir[slot].key.load();
+        if (k == 0) return -1;
+        if (KeyId(k) == id && KeyState(k) != BOARD_NONE) return (int)slot;
+    }
+    return -1;
+}
+
+// Закрепить за id первую свободную по ходу пробы запись — удалённую или
+// ни разу не занятую — сразу в INIT со своим pid; probe растёт до CAS,
+// чтобы ищущий после него запись не проскочил. Двое, заводящие один
+// номер, могут занять разные записи, поэтому затем цепочка проверяется
+// ещё раз, и при чужой записи того же номера своя отдаётся обратно. Оба
+// сначала пишут свой ключ и только потом читают чужие (всё seq_cst), так
+// что хотя бы один увидит другого: двух досок с одним номером не будет.
+// Возвращает запись, -1 — каталог полон, -2 — номер завёл кто-то ещё.
+static int ClaimSlot(Arena* a, uint32_t id, uint64_t own) {
+    uint32_t h = id * 2654435761u;
+    int slot = -1;
+    for (uint32_t i = 0; i < ARENA_DIR_SLOTS && slot < 0; i++) {
+        ArenaBoard& b = a->hh->dir[(h + i) % ARENA_DIR_SLOTS];
+        uint64_t k = b.key.load();
+        if (k != 0 && KeyState(k) != BOARD_NONE) continue;
+        uint32_t reach = a->hh->probe.load();
+        while (reach < i && !a->hh->probe.compare_exchange_weak(reach, i)) {}
+        if (!b.key.compare_exchange_strong(k, own)) continue;
+        if (k == 0) a->hh->directory.fetch_add(1, std::memory_order_relaxed);
+        slot = (int)((h + i) % ARENA_DIR_SLOTS);
+    }
+    if (slot < 0) return -1;
+    uint32_t reach = a->hh->probe.load();
+    for (uint32_t i = 0; i <= reach && i < ARENA_DIR_SLOTS; i++) {
+        uint32_t other = (h + i) % ARENA_DIR_SLOTS;
+        uint64_t k = a->hh->dir[other].key.load();
+        if (k == 0) break;
+        if ((int)other == slot || KeyId(k) != id || KeyState(k) == BOARD_NONE) continue;
+        a->hh->dir[slot].key.store(MakeKey(id, 0, BOARD_NONE));
+        return -2;
+    }
+    return slot;
+}
+
+// Забрать запись с ключом k под себя (INIT со своим pid) и вернуть память
+// доски. Блоки обнуляются до перевода в NONE, так что умерший посреди
+// освобождения оставляет запись в INIT с тем, что ещё не отдано, а
+// следующий хозяин её доберёт. false — ключ изменился, k перечитан.
+static bool Release(Arena* a, ArenaBoard& b, uint64_t& k) {
+    if (!b.key.compare_exchange_weak(k, MakeKey(KeyId(k), SelfPid(), BOARD_INIT), std::memory_order_acq_rel))
+        return false;
+    if (KeyState(k) != BOARD_INIT) a->hh->boards.fetch_sub(1, std::memory_order_relaxed);
+    uint32_t t = b.table.load(std::memory_order_relaxed);
+    uint32_t db = b.dataBlock, cb = b.cellsBlock;
+    int dc = b.dataClass, cc = b.cellsClass;
+    b.table.store(0, std::memory_order_relaxed);
+    b.dataBlock = b.cellsBlock = 0;
+    b.key.store(MakeKey(KeyId(k), 0, BOARD_NONE), std::memory_order_release);
+    if (t) FreeTable(a, t);
+    if (db) Free(a, dc, db);
+    if (cb) Free(a, cc, cb);
+    return true;
+}
+
+// Запись в INIT, хозяин которой умер: создатель не дошёл до ArenaPublish
+// или освобождающий — до конца. Pid в ключе урезан до 30 бит: больших
+// идентификаторов процессов ни Linux, ни Windows на деле не выдают.
+static void RecoverDead(Arena* a, ArenaBoard& b, uint64_t k) {
+    if (!ProcessAlive(KeyTag(k))) Release(a, b, k);
+}
+
+// Удалённую доску (k — её ключ в DYING) освобождает тот, кто застал её
+// таблицу пустой. Ячейки умерших процессов по пути снимаются: их
+// подключения больше никто не отпустит. Ячейка занимается до проверки
+// ключа, а ключ переводится в DYING до обхода таблицы, поэтому
+// подключающийся либо увидит DYING и уйдёт, либо его ячейку увидит обход.
+static bool TryRelease(Arena* a, ArenaBoard& b, uint64_t k) {
+    uint32_t t = b.table.load(std::memory_order_acquire);
+    if (t) {
+        ArenaTable* tb = TableAt(a, t);
+        for (uint32_t i = 0; i < ARENA_ATTACH_SLOTS; i++) {
+            uint32_t pid = tb->pid[i].load();
+            if (!pid) continue;
+            if (ProcessAlive(pid) || !tb->pid[i].compare_exchange_strong(pid, 0)) return false;
+        }
+    }
+    uint64_t cur = k;
+    while (!Release(a, b, cur))
+        if (cur != k) return false;
+    return true;
+}
+
+// Ячейка таблицы t только что освобождена: если таблица принадлежит
+// удалённой доске, возможно, это было последнее подключение
+static void AfterClear(Arena* a, uint32_t t) {
+    uint64_t own = TableAt(a, t)->owner.load();
+    if (!own) return;
+    ArenaBoard& b = a->hh->dir[(uint32_t)own - 1];
+    uint64_t k = b.key.load();
+    if (KeyState(k) == BOARD_DYING && KeyTag(k) == (uint32_t)(own >> 32)) TryRelease(a, b, k);
+}
+
+// Разметить запись slot, закреплённую за собой ключом own: поколение,
+// таблица подключений, блоки. -1 — памяти не хватило, запись отдана.
+static int CreateBoard(Arena* a, int slot, uint64_t own, size_t dataBytes, size_t cellsBytes, int dc, int cc) {
+    ArenaBoard& b = a->hh->dir[slot];
+    uint32_t gen = (b.generation + 1) & 0x3FFFFFFF;
+    b.generation = gen;
+    b.dataClass = (uint8_t)dc;
+    b.cellsClass = (uint8_t)cc;
+    b.table.store(AllocTable(a, slot, gen), std::memory_order_relaxed);
+    if (b.table.load(std::memory_order_relaxed)) b.dataBlock = Alloc(a, dc);
+    if (b.dataBlock) b.cellsBlock = Alloc(a, cc);
+    if (!b.cellsBlock) {
+        while (!Release(a, b, own)) {}
+        return -1;
+    }
+    memset(a->base + (uint64_t)b.dataBlock * ARENA_MIN_BLOCK, 0, dataBytes);
+    memset(a->base + (uint64_t)b.cellsBlock * ARENA_MIN_BLOCK, 0, cellsBytes);
+    AddPid(a, b.table.load(std::memory_order_relaxed), KeyTag(own));
+    return slot;
+}
+
+int ArenaAttach(Arena* a, uint32_t id, size_t dataBytes, size_t cellsBytes, bool create, bool* created) {
+    *created = false;
+    if (!id) return -1;
+    uint32_t self = SelfPid();
+
+    for (uint32_t spins = 1; ; spins++) {
+        int slot = FindSlot(a, id);
+        if (slot < 0) {
+            if (!create) return -1;
+            int dc = ClassFor(dataBytes), cc = ClassFor(cellsBytes);
+            if (dc < 0 || cc < 0) return -1;
+            uint64_t own = MakeKey(id, self, BOARD_INIT);
+            slot = ClaimSlot(a, id, own);
+            if (slot == -1) return -1;
+            if (slot == -2) {
+                ThreadYield();
+                continue;
+            }
+            slot = CreateBoard(a, slot, own, dataBytes, cellsBytes, dc, cc);
+            *created = slot >= 0;
+            return slot;
+        }
+        ArenaBoard& b = a->hh->dir[slot];
+        uint64_t k = b.key.load(std::memory_order_acquire);
+        if (KeyId(k) != id) continue;           // запись успели освободить и отдать другому номеру
+        switch (KeyState(k)) {
+        case BOARD_LIVE: {
+            // ячейку — в таблицу, потом убедиться, что доска та же и жива
+            uint32_t t = b.table.load(std::memory_order_acquire);
+            if (!t) break;
+            int i = AddPid(a, t, self);
+            if (i < 0) return -1;
+            if (b.key.load() == k) return slot;
+            TableAt(a, t)->pid[i].store(0);
+            AfterClear(a, t);
+            break;
+        }
+        case BOARD_INIT:
+            // хозяин ещё размечает или освобождает доску; жив ли он —
+            // раз в ARENA_STALL_SPINS
+            if (spins % ARENA_STALL_SPINS == 0) RecoverDead(a, b, k);
+            ThreadYield();
+            break;
+        case BOARD_DYING:
+            // удалённую, но брошенную умершими доску освобождаем и заводим заново
+            if (!create || !TryRelease(a, b, k)) return -1;
+            break;
+        case BOARD_NONE:
+            // освобождена между поиском и чтением — искать заново
+            break;
+        }
+    }
+}
+
+void ArenaPublish(Arena* a, int board) {
+    ArenaBoard& b = a->hh->dir[board];
+    a->hh->boards.fetch_add(1, std::memory_order_relaxed);
+    b.key.store(MakeKey(KeyId(b.key.load(std::memory_order_relaxed)), b.generation, BOARD_LIVE));
+}
+
+void* ArenaBoardData(Arena* a, int board) {
+    return a->base + (uint64_t)a->hh->dir[board].dataBlock * ARENA_MIN_BLOCK;
+}
+
+void* ArenaBoardCells(Arena* a, int board) {
+    return a->base + (uint64_t)a->hh->dir[board].cellsBlock * ARENA_MIN_BLOCK;
+}
+
+void ArenaDetach(Arena* a, int board) {
+    uint32_t t = a->hh->dir[board].table.load(std::memory_order_acquire);
+    if (!t) return;
+    ArenaTable* tb = TableAt(a, t);
+    uint32_t self = SelfPid();
+    for (uint32_t i = 0; i < ARENA_ATTACH_SLOTS; i++) {
+        uint32_t v = self;
+        if (tb->pid[i].compare_exchange_strong(v, 0)) {
+            AfterClear(a, t);
+            return;
+        }
+    }
+}
+
+bool ArenaDestroy(Arena* a, uint32_t id) {
+    for (uint32_t spins = 1; ; spins++) {
+        int slot = FindSlot(a, id);
+        if (slot < 0) return false;
+        ArenaBoard& b = a->hh->dir[slot];
+        uint64_t k = b.key.load(std::memory_order_acquire);
+        if (KeyId(k) != id) continue;
+        switch (KeyState(k)) {
+        case BOARD_NONE:
+            break;
+        case BOARD_INIT:
+            if (spins % ARENA_STALL_SPINS == 0) RecoverDead(a, b, k);
+            ThreadYield();
+            break;
+        case BOARD_LIVE:
+            b.key.compare_exchange_weak(k, MakeKey(id, KeyTag(k), BOARD_DYING));
+            break;
+        case BOARD_DYING:
+            // повторный вызов снимает подключения умерших, что остались с прошлого
+            TryRelease(a, b, k);
+            return true;
+        }
+    }
+}
+
+ArenaStats ArenaGetStats(Arena* a) {
+    ArenaStats s;
+    s.boards = a->hh->boards.load(std::memory_order_relaxed);
+    s.directory = a->hh->directory.load(std::memory_order_relaxed);
+    s.probe = a->hh->probe.load(std::memory_order_relaxed) + 1;
+    s.bytesInUse = a->hh->inUse.load(std::memory_order_relaxed);
+    uint64_t carved = a->hh->carved.load(std::memory_order_relaxed);
+    s.bytesCarved = carved < a->chunksBytes ? carved : a->chunksBytes;   // неудачные попытки нарезки тоже в carved
+    s.bytesTotal = a->chunksBytes;
+    s.bytesFreeChunks = (uint64_t)a->hh->chunksFree.load(std::memory_order_relaxed) * ARENA_CHUNK_BYTES;
+    s.bytesTables = (uint64_t)a->hh->tableChunks.load(std::memory_order_relaxed) * ARENA_CHUNK_BYTES;
+    return s;
+}
+
+// ——————————————————————————————— Сегмент ——————————————————————————————————————
+
+// Новый сегмент приходит обнулённым, а нули — это и есть пустая арена:
+// размечать нечего, создатель от подключившегося не отличается.
+Arena* ArenaOpen(const char* name) {
+    void* p = nullptr;
+    Arena* a = new Arena();
+#ifdef _WIN32
+    a->hMap = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, ARENA_BYTES, name);
+    if (a->hMap) {
+        p = MapViewOfFile(a->hMap, FILE_MAP_ALL_ACCESS, 0, 0, ARENA_BYTES);
+        if (!p) CloseHandle(a->hMap);
+    }
+#else
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd >= 0) {
+        // ftruncate только растит: второй вызов с тем же размером безвреден
+        struct stat st;
+        if (fstat(fd, &st) == 0 && ((size_t)st.st_size >= ARENA_BYTES || ftruncate(fd, ARENA_BYTES) == 0)) {
+            p = mmap(nullptr, ARENA_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) p = nullptr;
+        }
+        close(fd);
+    }
+#endif
+    if (!p) {
+        delete a;
+        return nullptr;
+    }
+    a->base = (uint8_t*)p;
+    a->hh = (ArenaHeader*)p;
+    a->chunksStart = (sizeof(ArenaHeader) + ARENA_MIN_BLOCK - 1) / ARENA_MIN_BLOCK * ARENA_MIN_BLOCK;
+    a->chunksBytes = (ARENA_BYTES - a->chunksStart) / ARENA_CHUNK_BYTES * ARENA_CHUNK_BYTES;
+    return a;
+}
+
+void ArenaClose(Arena* a) {
+    if (!a) return;
+#ifdef _WIN32
+    UnmapViewOfFile(a->base);
+    CloseHandle(a->hMap);
+#else
+    munmap(a->base, ARENA_BYTES);
+#endif
+    delete a;
+}
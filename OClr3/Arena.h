@@ -0,0 +1,80 @@
+﻿#pragma once
+
+// Много независимых полей в одном разделяемом сегменте.
+//
+// Сегмент — заголовок, каталог досок и куски по ARENA_CHUNK_BYTES.
+// Память выдаётся блоками размером в степень двойки от ARENA_MIN_BLOCK до
+// ARENA_CHUNK_BYTES; у каждого размера свой стек свободных блоков (CAS по
+// голове с меткой против ABA), кусок под размер берётся при нехватке.
+// Освобождённый блок возвращается в стек своего размера; когда у куска не
+// остаётся выданных блоков, он целиком уходит в общий список кусков и
+// достаётся потом любому размеру — сегмент не дробится и не застревает
+// нарезанным под размер, которого больше никто не просит.
+//
+// Каталог — открытая адресация по номеру доски, всё состояние записи —
+// одно 64-битное слово (номер, метка, состояние), меняется CAS-ом.
+// Удалённая доска оставляет запись свободной, и её занимает любой новый
+// номер. Новая запись встаёт на первое свободное место пробы, и поиск
+// идёт не дальше самого дальнего такого места за жизнь сегмента: оно
+// зависит от того, сколько досок жило одновременно, а не от того, сколько
+// номеров перебывало в каталоге.
+//
+// За умершими процессами убирают живые. Запись, которую создатель не
+// успел опубликовать (или освобождающий — освободить), хранит его pid, и
+// ждущий её проверяет, жив ли хозяин. Подключение к доске — ячейка с pid
+// в её таблице подключений, а не счётчик: ячейку умершего видно, и
+// удаление доски её снимает, вместо того чтобы ждать вечно.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#define ARENA_NAME "Local\\GridArena"
+#else
+#define ARENA_NAME "/GridArena"
+#endif
+
+#define ARENA_BYTES        (128u << 20)
+#define ARENA_CHUNK_BYTES  (2u << 20)    // и самый большой блок
+#define ARENA_MIN_BLOCK    4096u
+#define ARENA_DIR_SLOTS    65536         // досок одновременно, с удаляемыми
+#define ARENA_MAX_GRID     2048          // клетки и версии блоков влезают в ARENA_CHUNK_BYTES
+#define ARENA_TABLE_BYTES  1024u
+#define ARENA_ATTACH_SLOTS ((ARENA_TABLE_BYTES - 16) / 4)   // подключений к одной доске
+
+struct Arena;
+
+struct ArenaStats {
+    uint32_t boards;                   // живых досок
+    uint32_t directory;                // записей каталога, занятых хоть раз
+    uint32_t probe;                    // самая длинная проба каталога, записей
+    uint64_t bytesInUse;               // выдано блоками
+    uint64_t bytesCarved;              // нарезано кусков
+    uint64_t bytesFreeChunks;          // из них целиком свободны, в общем списке
+    uint64_t bytesTables;              // из них под таблицы подключений, не возвращаются
+    uint64_t bytesTotal;               // под куски всего
+};
+
+// Открывает или создаёт арену name. nullptr — не вышло.
+Arena*     ArenaOpen(const char* name);
+void       ArenaClose(Arena* a);
+ArenaStats ArenaGetStats(Arena* a);
+
+// Подключиться к доске id (id != 0). Если её нет и create — заводится:
+// created = true, под неё выделены обнулённые dataBytes и cellsBytes,
+// и остальные ждут ArenaPublish. Удалённая доска, которую держат только
+// умершие процессы, при create тоже заводится заново. Возвращает номер
+// записи, -1 — не вышло
+// (в том числе если к доске уже ARENA_ATTACH_SLOTS подключений).
+int        ArenaAttach(Arena* a, uint32_t id, size_t dataBytes, size_t cellsBytes, bool create, bool* created);
+void       ArenaPublish(Arena* a, int board);
+void*      ArenaBoardData(Arena* a, int board);
+void*      ArenaBoardCells(Arena* a, int board);
+// Доска живёт и без подключений, пока её не удалят; последний
+// отключившийся от удалённой доски освобождает её память
+void       ArenaDetach(Arena* a, int board);
+// Удалить доску id: сразу, если к ней никто не подключён (подключения
+// умерших процессов не в счёт), иначе — после последнего ArenaDetach.
+// Повторный вызов для уже удалённой доски снова снимает подключения
+// умерших. false — такой доски нет.
+bool       ArenaDestroy(Arena* a, uint32_t id);
@@ -0,0 +1,353 @@
+﻿#include "Color.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COLOR_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define TARGET_AVX2
+#define TARGET_SSE2
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define COLOR_MAGIC 0x524C4F43u        // "COLR"
+
+// HSV→RGB
+COLORREF HSVtoRGB(float H, float S, float V) {
+    float r, g, b;
+    int i = (int)(H / 60) % 6;
+    float f = (H / 60) - i, p = V * (1 - S), q = V * (1 - f * S), t = V * (1 - (1 - f) * S);
+    switch (i) {
+    case 0: r = V, g = t, b = p; break;
+    case 1: r = q, g = V, b = p; break;
+    case 2: r = p, g = V, b = t; break;
+    case 3: r = p, g = q, b = V; break;
+    case 4: r = t, g = p, b = V; break;
+    default:r = V, g = p, b = q; break;
+    }
+    return RGB((int)(r * 255), (int)(g * 255), (int)(b * 255));
+}
+
+// ——————————————————————————————— Ядра перевода ——————————————————————————————————————
+//
+// Векторные ядра повторяют HSVtoRGB операция в операцию и в том же
+// порядке: деление на 60 (не умножение на 1/60), усечение к нулю, без
+// FMA, поэтому float-результаты совпадают бит в бит. Остаток от деления
+// на 6 при H/60 в [0, 12) — одно условное вычитание; всё остальное
+// (отрицательные, большие, NaN) пачка из 4/8 отдаёт скалярному ядру.
+
+static inline uint32_t PixelOfRGB(COLORREF c) {
+    return ((uint32_t)GetRValue(c) << 16) | ((uint32_t)GetGValue(c) << 8) | GetBValue(c);
+}
+
+static void HSVtoPixelsScalar(const float* h, const float* s, const float* v, uint32_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = PixelOfRGB(HSVtoRGB(h[i], s[i], v[i]));
+}
+
+#ifdef COLOR_X86
+// a там, где mask, иначе b
+TARGET_SSE2 static inline __m128 Select4(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+TARGET_SSE2 static void HSVtoPixelsSSE2(const float* h, const float* s, const float* v, uint32_t* out, size_t n) {
+    const __m128 k60 = _mm_set1_ps(60.0f), one = _mm_set1_ps(1.0f), k255 = _mm_set1_ps(255.0f);
+    const __m128 zero = _mm_setzero_ps(), twelve = _mm_set1_ps(12.0f);
+    const __m128i six = _mm_set1_epi32(6), low = _mm_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 H = _mm_loadu_ps(h + i), S = _mm_loadu_ps(s + i), V = _mm_loadu_ps(v + i);
+        __m128 h60 = _mm_div_ps(H, k60);
+        __m128 inRange = _mm_and_ps(_mm_cmpge_ps(h60, zero), _mm_cmplt_ps(h60, twelve));
+        if (_mm_movemask_ps(inRange) != 0xF) {
+            HSVtoPixelsScalar(h + i, s + i, v + i, out + i, 4);
+            continue;
+        }
+        __m128i sec = _mm_cvttps_epi32(h60);
+        sec = _mm_sub_epi32(sec, _mm_and_si128(_mm_cmpgt_epi32(sec, _mm_set1_epi32(5)), six));
+        __m128 f = _mm_sub_ps(h60, _mm_cvtepi32_ps(sec));
+        __m128 p = _mm_mul_ps(V, _mm_sub_ps(one, S));
+        __m128 q = _mm_mul_ps(V, _mm_sub_ps(one, _mm_mul_ps(f, S)));
+        __m128 t = _mm_mul_ps(V, _mm_sub_ps(one, _mm_mul_ps(_mm_sub_ps(one, f), S)));
+
+        __m128 m0 = _mm_castsi128_ps(_mm_cmpeq_epi32(sec, _mm_setzero_si128()));
+        __m128 m1 = _mm_castsi128_ps(_mm_cmpeq_epi32(sec, _mm_set1_epi32(1)));
+        __m128 m2 = _mm_castsi128_ps(_mm_cmpeq_epi32(sec, _mm_set1_epi32(2)));
+        __m128 m3 = _mm_castsi128_ps(_mm_cmpeq_epi32(sec, _mm_set1_epi32(3)));
+        __m128 m4 = _mm_castsi128_ps(_mm_cmpeq_epi32(sec, _mm_set1_epi32(4)));
+        // r: V в 0 и 5, q в 1, p в 2-3, t в 4
+        __m128 r = Select4(m1, q, Select4(_mm_or_ps(m2, m3), p, Select4(m4, t, V)));
+        // g: t в 0, V в 1-2, q в 3, p в 4-5
+        __m128 g = Select4(m0, t, Select4(_mm_or_ps(m1, m2), V, Select4(m3, q, p)));
+        // b: p в 0-1, t в 2, V в 3-4, q в 5
+        __m128 b = Select4(_mm_or_ps(m0, m1), p, Select4(m2, t, Select4(_mm_or_ps(m3, m4), V, q)));
+
+        // (int)(x * 255), затем байт, как (BYTE) в RGB()
+        __m128i ri = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(r, k255)), low);
+        __m128i gi = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(g, k255)), low);
+        __m128i bi = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(b, k255)), low);
+        __m128i px = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(ri, 16), _mm_slli_epi32(gi, 8)), bi);
+        _mm_storeu_si128((__m128i*)(out + i), px);
+    }
+    HSVtoPixelsScalar(h + i, s + i, v + i, out + i, n - i);
+}
+
+TARGET_AVX2 static inline __m256 Select8(__m256 mask, __m256 a, __m256 b) {
+    return _mm256_blendv_ps(b, a, mask);
+}
+
+TARGET_AVX2 static void HSVtoPixelsAVX2(const float* h, const float* s, const float* v, uint32_t* out, size_t n) {
+    const __m256 k60 = _mm256_set1_ps(60.0f), one = _mm256_set1_ps(1.0f), k255 = _mm256_set1_ps(255.0f);
+    const __m256 zero = _mm256_setzero_ps(), twelve = _mm256_set1_ps(12.0f);
+    const __m256i six = _mm256_set1_epi32(6), low = _mm256_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 H = _mm256_loadu_ps(h + i), S = _mm256_loadu_ps(s + i), V = _mm256_loadu_ps(v + i);
+        __m256 h60 = _mm256_div_ps(H, k60);
+        __m256 inRange = _mm256_and_ps(_mm256_cmp_ps(h60, zero, _CMP_GE_OQ), _mm256_cmp_ps(h60, twelve, _CMP_LT_OQ));
+        if (_mm256_movemask_ps(inRange) != 0xFF) {
+            // скалярный код собран без VEX: без zeroupper каждый переход стоит сотни тактов
+            _mm256_zeroupper();
+            HSVtoPixelsScalar(h + i, s + i, v + i, out + i, 8);
+            continue;
+        }
+        __m256i sec = _mm256_cvttps_epi32(h60);
+        sec = _mm256_sub_epi32(sec, _mm256_and_si256(_mm256_cmpgt_epi32(sec, _mm256_set1_epi32(5)), six));
+        __m256 f = _mm256_sub_ps(h60, _mm256_cvtepi32_ps(sec));
+        __m256 p = _mm256_mul_ps(V, _mm256_sub_ps(one, S));
+        __m256 q = _mm256_mul_ps(V, _mm256_sub_ps(one, _mm256_mul_ps(f, S)));
+        __m256 t = _mm256_mul_ps(V, _mm256_sub_ps(one, _mm256_mul_ps(_mm256_sub_ps(one, f), S)));
+
+        __m256 m0 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(sec, _mm256_setzero_si256()));
+        __m256 m1 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(sec, _mm256_set1_epi32(1)));
+        __m256 m2 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(sec, _mm256_set1_epi32(2)));
+        __m256 m3 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(sec, _mm256_set1_epi32(3)));
+        __m256 m4 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(sec, _mm256_set1_epi32(4)));
+        __m256 r = Select8(m1, q, Select8(_mm256_or_ps(m2, m3), p, Select8(m4, t, V)));
+        __m256 g = Select8(m0, t, Select8(_mm256_or_ps(m1, m2), V, Select8(m3, q, p)));
+        __m256 b = Select8(_mm256_or_ps(m0, m1), p, Select8(m2, t, Select8(_mm256_or_ps(m3, m4), V, q)));
+
+        __m256i ri = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(r, k255)), low);
+        __m256i gi = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(g, k255)), low);
+        __m256i bi = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(b, k255)), low);
+        __m256i px = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(ri, 16), _mm256_slli_epi32(gi, 8)), bi);
+        _mm256_storeu_si256((__m256i*)(out + i), px);
+    }
+    _mm256_zeroupper();
+    HSVtoPixelsScalar(h + i, s + i, v + i, out + i, n - i);
+}
+#endif
+
+typedef void (*HSVtoPixelsFn)(const float*, const float*, const float*, uint32_t*, size_t);
+static HSVtoPixelsFn hsvToPixels = nullptr;
+
+RenderKernel ColorSetKernel(RenderKernel k) {
+#ifdef COLOR_X86
+    if (k == KERNEL_AUTO) k = RenderCpuHasAVX2() ? KERNEL_AVX2 : KERNEL_SSE2;
+    if (k == KERNEL_AVX2 && !RenderCpuHasAVX2()) k = KERNEL_SSE2;
+    switch (k) {
+    case KERNEL_AVX2: hsvToPixels = HSVtoPixelsAVX2; break;
+    case KERNEL_SSE2: hsvToPixels = HSVtoPixelsSSE2; break;
+    default:          hsvToPixels = HSVtoPixelsScalar; k = KERNEL_SCALAR; break;
+    }
+#else
+    k = KERNEL_SCALAR;
+    hsvToPixels = HSVtoPixelsScalar;
+#endif
+    return k;
+}
+
+void HSVtoPixels(const float* h, const float* s, const float* v, uint32_t* out, size_t n) {
+    if (!hsvToPixels) ColorSetKernel(KERNEL_AUTO);
+    hsvToPixels(h, s, v, out, n);
+}
+
+// ——————————————————————————————— Слой ——————————————————————————————————————
+
+// Кадр n лежит в буфере n & 1. Писатель заполняет кадр version + 1 —
+// буфер, который сейчас не опубликован, — и публикует его, подняв version.
+// Буфер опубликованного кадра v писатель снова тронет только в кадре v + 2;
+// читатель, переведя буфер, проверяет по writing, что этот кадр ещё не начат.
+struct ColorHeader {
+    uint32_t              magic;
+    int                   gridSize;
+    uint32_t              cells;
+    uint32_t              planeFloats;   // шаг между плоскостями, кратен 16 (64 байта)
+    std::atomic<uint32_t> version;       // номер последнего опубликованного кадра
+    std::atomic<uint32_t> writing;       // кадр, который заполняет писатель; == version — никакой
+    uint32_t              pad[10];
+    // далее два буфера: float hue[planeFloats], saturation[planeFloats], value[planeFloats]
+};
+
+struct ColorLayer {
+    ColorHeader* ch;
+    size_t       bytes;
+    uint32_t     generation;
+#ifdef _WIN32
+    HANDLE       hMap;
+#endif
+};
+
+// Плоскость k (0 — H, 1 — S, 2 — V) буфера buf
+static inline float* Plane(const ColorLayer* l, uint32_t buf, int k) {
+    return (float*)(l->ch + 1) + ((size_t)(buf & 1) * 3 + (size_t)k) * l->ch->planeFloats;
+}
+
+static void LayerName(char* out, size_t n, const SharedMapping* m, uint32_t gen) {
+    snprintf(out, n, "%s.color.%u", m->name, gen);
+}
+
+static ColorLayer* MapLayer(const char* sn, size_t bytes, bool create) {
+    void* p = nullptr;
+    ColorLayer* l = new ColorLayer();
+#ifdef _WIN32
+    l->hMap = create
+        ? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32), (DWORD)bytes, sn)
+        : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, sn);
+    if (l->hMap) {
+        // размер открываемого узнаём из заголовка — мапим целиком
+        p = MapViewOfFile(l->hMap, FILE_MAP_ALL_ACCESS, 0, 0, create ? bytes : 0);
+        if (!p) CloseHandle(l->hMap);
+    }
+#else
+    if (create) shm_unlink(sn);        // хвост от прошлого запуска
+    int fd = shm_open(sn, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    if (fd >= 0) {
+        struct stat st;
+        bool sized = create ? ftruncate(fd, (off_t)bytes) == 0
+                            : fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ColorHeader);
+        if (!create) bytes = (size_t)st.st_size;
+        if (sized) {
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) p = nullptr;
+        }
+        close(fd);
+    }
+#endif
+    if (!p) {
+        delete l;
+        return nullptr;
+    }
+    l->ch = (ColorHeader*)p;
+    l->bytes = bytes;
+    return l;
+}
+
+ColorLayer* ColorLayerCreate(SharedMapping* m) {
+    int sz = SharedGridSize(m);
+    uint64_t cells = (uint64_t)sz * sz;
+    if (sz < 1 || cells > COLOR_MAX_CELLS) return nullptr;
+    uint32_t planeFloats = (uint32_t)((cells + 15) & ~15ull);
+    size_t bytes = sizeof(ColorHeader) + (size_t)planeFloats * 6 * sizeof(float);
+
+    SharedData* d = m->data;
+    uint32_t gen = d->colorGeneration.load(std::memory_order_acquire) + 1;
+    char sn[96];
+    LayerName(sn, sizeof(sn), m, gen);
+    ColorLayer* l = MapLayer(sn, bytes, true);
+    if (!l) return nullptr;
+    l->generation = gen;
+    l->ch->gridSize = sz;
+    l->ch->cells = (uint32_t)cells;
+    l->ch->planeFloats = planeFloats;
+    l->ch->magic = COLOR_MAGIC;
+    // пока писатель не нарисовал первый кадр — белые клетки (S = 0, V = 1)
+    for (uint32_t b = 0; b < 2; b++)
+        for (uint32_t i = 0; i < planeFloats; i++) Plane(l, b, 1)[i] = 0, Plane(l, b, 2)[i] = 1;
+    d->colorGeneration.store(gen, std::memory_order_release);
+#ifndef _WIN32
+    // старое поколение больше никто не откроет; замапленное у читателей живёт
+    if (gen > 1) {
+        LayerName(sn, sizeof(sn), m, gen - 1);
+        shm_unlink(sn);
+    }
+#endif
+    return l;
+}
+
+ColorLayer* ColorLayerOpen(SharedMapping* m) {
+    uint32_t gen = m->data->colorGeneration.load(std::memory_order_acquire);
+    if (!gen) return nullptr;
+    char sn[96];
+    LayerName(sn, sizeof(sn), m, gen);
+    ColorLayer* l = MapLayer(sn, 0, false);
+    if (!l) return nullptr;
+    l->generation = gen;
+    size_t need = sizeof(ColorHeader) + (size_t)l->ch->planeFloats * 6 * sizeof(float);
+    if (l->ch->magic != COLOR_MAGIC
+#ifndef _WIN32
+        || l->bytes < need
+#endif
+        ) {
+        ColorLayerClose(l);
+        return nullptr;
+    }
+    l->bytes = need;
+    return l;
+}
+
+void ColorLayerClose(ColorLayer* l) {
+    if (!l) return;
+#ifdef _WIN32
+    UnmapViewOfFile(l->ch);
+    CloseHandle(l->hMap);
+#else
+    munmap(l->ch, l->bytes);
+#endif
+    delete l;
+}
+
+bool ColorLayerCurrent(const ColorLayer* l, const SharedMapping* m) {
+    return l && l->generation == m->data->colorGeneration.load(std::memory_order_acquire);
+}
+
+int ColorLayerGridSize(const ColorLayer* l) {
+    return l ? l->ch->gridSize : 0;
+}
+
+uint32_t ColorLayerVersion(const ColorLayer* l) {
+    return l ? l->ch->version.load(std::memory_order_acquire) : 0;
+}
+
+// Как BeginWrite у поля: номер кадра виден раньше, чем первая запись в буфер
+uint32_t ColorLayerBegin(ColorLayer* l) {
+    uint32_t next = l->ch->version.load(std::memory_order_relaxed) + 1;
+    l->ch->writing.store(next, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return next;
+}
+
+float* ColorLayerHue(ColorLayer* l) { return Plane(l, l->ch->writing.load(std::memory_order_relaxed), 0); }
+float* ColorLayerSaturation(ColorLayer* l) { return Plane(l, l->ch->writing.load(std::memory_order_relaxed), 1); }
+float* ColorLayerValue(ColorLayer* l) { return Plane(l, l->ch->writing.load(std::memory_order_relaxed), 2); }
+
+uint32_t ColorLayerPublish(ColorLayer* l) {
+    uint32_t v = l->ch->writing.load(std::memory_order_relaxed);
+    l->ch->version.store(v, std::memory_order_release);
+    return v;
+}
+
+// Писатель обогнал на целый кадр и начал переписывать переводимый буфер —
+// переводим заново свежий. Кадр пишется за доли кадра, так что это редкость.
+uint32_t ColorLayerConvert(const ColorLayer* l, uint32_t* out) {
+    for (;;) {
+        uint32_t v = l->ch->version.load(std::memory_order_acquire);
+        HSVtoPixels(Plane(l, v, 0), Plane(l, v, 1), Plane(l, v, 2), out, l->ch->cells);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (l->ch->writing.load(std::memory_order_relaxed) - v < 2) return v;
+    }
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+// Цвет клеток: у каждой клетки свой HSV, пачкой переводится в пиксели.
+//
+// Слой цветов — отдельный сегмент name.color.<gen> рядом с SharedData:
+// три плоскости float (H в градусах, S и V в 0..1) по клетке поля, в двух
+// буферах. Пишет его один экземпляр (-heatmap) целым кадром в буфер, который
+// сейчас не опубликован, и поднимает version; остальные видят новую версию
+// и переводят весь слой в пиксели сами. Читатель не ждёт писателя и не
+// видит полукадров: после перевода он проверяет, что писатель не начал
+// переписывать его буфер, иначе переводит заново.
+//
+// Номер действующего слоя — SharedData::colorGeneration. Сменился размер
+// поля — писатель создаёт слой следующего поколения, читатели замечают
+// смену номера и переоткрывают.
+
+#include "SharedGrid.h"
+#include "Render.h"
+
+#include <stddef.h>
+
+#define COLOR_MAX_CELLS  (4u << 20)    // 2048 x 2048; у полей крупнее слоя нет
+
+// Тот самый HSV -> COLORREF, которым колёсико красит сетку
+COLORREF HSVtoRGB(float H, float S, float V);
+
+// Пачка: out[i] — пиксель DIB (0x00RRGGBB, как в Framebuffer) цвета
+// HSVtoRGB(h[i], s[i], v[i]), бит в бит. Ядра те же, что у заливки
+// (RenderKernel); оттенки вне [0, 720) векторные ядра отдают скалярному.
+void         HSVtoPixels(const float* h, const float* s, const float* v, uint32_t* out, size_t n);
+RenderKernel ColorSetKernel(RenderKernel k);
+
+struct ColorLayer;
+
+// Писатель: слой следующего поколения под текущий размер поля m.
+// nullptr — не вышло или поле крупнее COLOR_MAX_CELLS.
+ColorLayer* ColorLayerCreate(SharedMapping* m);
+// Читатель: действующий слой поля m; nullptr — его нет
+ColorLayer* ColorLayerOpen(SharedMapping* m);
+void        ColorLayerClose(ColorLayer* l);
+// Слой всё ещё действующий (его поколение в SharedData не сменилось)
+bool        ColorLayerCurrent(const ColorLayer* l, const SharedMapping* m);
+
+int         ColorLayerGridSize(const ColorLayer* l);
+uint32_t    ColorLayerVersion(const ColorLayer* l);
+
+// Писатель: ColorLayerBegin начинает кадр (номер — будущая версия),
+// плоскости — его буфер, заполняется целиком; ColorLayerPublish публикует
+uint32_t    ColorLayerBegin(ColorLayer* l);
+float*      ColorLayerHue(ColorLayer* l);
+float*      ColorLayerSaturation(ColorLayer* l);
+float*      ColorLayerValue(ColorLayer* l);
+uint32_t    ColorLayerPublish(ColorLayer* l);
+
+// Весь опубликованный кадр в пиксели (out — по элементу на клетку).
+// Возвращает версию, которую перевели: пиксели — ровно этого кадра.
+uint32_t    ColorLayerConvert(const ColorLayer* l, uint32_t* out);
@@ -0,0 +1,652 @@
+﻿#include "Config.h"
+#include "Platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define sscanf_s sscanf
+#endif
+
+// Конфиг
+Config currentConfig = {
+    DEFAULT_GRID_SIZE,
+    DEFAULT_WIN_WIDTH,
+    DEFAULT_WIN_HEIGHT,
+    RGB(0, 0, 255),
+    RGB(255, 0, 0)
+};
+
+ConfigMethod configMethod = METHOD_MAPPING;
+
+const char* configFileName = "config.txt";
+const char* configBinFileName = "config.bin";
+
+ConfigIOStats configIOStats = {};
+
+// ——————————————————————————— Переносимые файловые вызовы ———————————————————————————————
+
+struct FileView {
+    void*  data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE f, m;
+#else
+    int    fd;
+#endif
+};
+
+// Временный файл рядом с целевым — rename в пределах каталога атомарен
+static void TempName(char* out, size_t n, const char* path) {
+    snprintf(out, n, "%s.%u.tmp", path, SelfPid());
+}
+
+static bool ReplaceWith(const char* tmp, const char* path) {
+    configIOStats.renames++;
+#ifdef _WIN32
+    if (MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) return true;
+    DeleteFileA(tmp);
+    return false;
+#else
+    if (rename(tmp, path) == 0) return true;
+    unlink(tmp);
+    return false;
+#endif
+}
+
+static bool MapForRead(const char* path, FileView* v) {
+    memset(v, 0, sizeof(*v));
+    configIOStats.opens++;
+#ifdef _WIN32
+    v->f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (v->f == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER sz; GetFileSizeEx(v->f, &sz);
+    v->size = (size_t)sz.QuadPart;
+    configIOStats.maps++;
+    v->m = v->size ? CreateFileMapping(v->f, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    v->data = v->m ? MapViewOfFile(v->m, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!v->data) {
+        if (v->m) CloseHandle(v->m);
+        CloseHandle(v->f);
+        return false;
+    }
+#else
+    v->fd = open(path, O_RDONLY);
+    if (v->fd < 0) return false;
+    struct stat st;
+    if (fstat(v->fd, &st) != 0 || st.st_size == 0) { close(v->fd); return false; }
+    v->size = (size_t)st.st_size;
+    configIOStats.maps++;
+    v->data = mmap(nullptr, v->size, PROT_READ, MAP_SHARED, v->fd, 0);
+    if (v->data == MAP_FAILED) { close(v->fd); v->data = nullptr; return false; }
+#endif
+    return true;
+}
+
+// Создаёт файл длины len и отображает его на запись
+static bool MapForWrite(const char* path, size_t len, FileView* v) {
+    memset(v, 0, sizeof(*v));
+    configIOStats.opens++;
+#ifdef _WIN32
+    v->f = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (v->f == INVALID_HANDLE_VALUE) return false;
+    // расширяем файл и мапим для записи
+    LARGE_INTEGER size; size.QuadPart = (LONGLONG)len;
+    SetFilePointerEx(v->f, size, nullptr, FILE_BEGIN);
+    SetEndOfFile(v->f);
+    configIOStats.maps++;
+    v->m = CreateFileMapping(v->f, nullptr, PAGE_READWRITE, 0, (DWORD)len, nullptr);
+    v->data = v->m ? MapViewOfFile(v->m, FILE_MAP_WRITE, 0, 0, len) : nullptr;
+    if (!v->data) {
+        if (v->m) CloseHandle(v->m);
+        CloseHandle(v->f);
+        return false;
+    }
+#else
+    v->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (v->fd < 0) return false;
+    if (ftruncate(v->fd, (off_t)len) != 0) { close(v->fd); return false; }
+    configIOStats.maps++;
+    v->data = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, v->fd, 0);
+    if (v->data == MAP_FAILED) { close(v->fd); v->data = nullptr; return false; }
+#endif
+    v->size = len;
+    return true;
+}
+
+static void FlushView(FileView* v) {
+    configIOStats.flushes++;
+#ifdef _WIN32
+    FlushViewOfFile(v->data, v->size);
+#else
+    msync(v->data, v->size, MS_SYNC);
+#endif
+}
+
+static void Unmap(FileView* v) {
+#ifdef _WIN32
+    UnmapViewOfFile(v->data);
+    CloseHandle(v->m);
+    CloseHandle(v->f);
+#else
+    munmap(v->data, v->size);
+    close(v->fd);
+#endif
+    v->data = nullptr;
+}
+
+// Файл одним чтением в буфер вызывающего (не больше cap байт)
+static bool ReadInto(const char* path, char* buf, size_t cap, size_t* len) {
+    configIOStats.opens++;
+#ifdef _WIN32
+    HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+    DWORD rd = 0;
+    configIOStats.reads++;
+    BOOL ok = ReadFile(f, buf, (DWORD)cap, &rd, nullptr);
+    CloseHandle(f);
+    if (!ok) return false;
+#else
+    int f = open(path, O_RDONLY);
+    if (f < 0) return false;
+    configIOStats.reads++;
+    ssize_t rd = read(f, buf, cap);
+    close(f);
+    if (rd < 0) return false;
+#endif
+    *len = (size_t)rd;
+    return true;
+}
+
+// Новый файл одной записью
+static bool WriteWhole(const char* path, const void* data, size_t len) {
+    configIOStats.opens++;
+    configIOStats.writes++;
+#ifdef _WIN32
+    HANDLE f = CreateFileA(path, GENERIC_WRITE, 0, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    WriteFile(f, data, (DWORD)len, &written, nullptr);
+    CloseHandle(f);
+    return written == len;
+#else
+    int f = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f < 0) return false;
+    ssize_t n = write(f, data, len);
+    close(f);
+    return n == (ssize_t)len;
+#endif
+}
+
+// ——————————————————————————————— Разбор текста ——————————————————————————————————————
+
+// Один проход по буферу, без выделений и без sscanf. Строки вида "Key=value",
+// ключи в любом порядке, незнакомые ключи, пустые строки и \r пропускаются.
+// Строка применяется к cfg только если значение разобралось целиком.
+
+static bool ParseInt(const char*& p, const char* end, int* out) {
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+    if (p >= end || *p < '0' || *p > '9') return false;
+    int64_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+        if (v > INT32_MAX) return false;
+    }
+    *out = (int)(neg ? -v : v);
+    return true;
+}
+
+static bool ParseColor(const char*& p, const char* end, COLORREF* out) {
+    int c[3];
+    for (int i = 0; i < 3; i++) {
+        if (i && (p >= end || *p++ != ';')) return false;
+        if (!ParseInt(p, end, &c[i]) || c[i] < 0 || c[i] > 255) return false;
+    }
+    *out = RGB(c[0], c[1], c[2]);
+    return true;
+}
+
+enum ConfigKey { KEY_UNKNOWN, KEY_GRID, KEY_WIDTH, KEY_HEIGHT, KEY_BACKGROUND, KEY_GRIDCOLOR };
+
+static ConfigKey MatchKey(const char* k, size_t n) {
+#define KEY_IS(s) (n == sizeof(s) - 1 && !memcmp(k, s, n))
+    switch (n) {
+    case 8:  if (KEY_IS("GridSize")) return KEY_GRID; break;
+    case 9:  if (KEY_IS("GridColor")) return KEY_GRIDCOLOR; break;
+    case 11: if (KEY_IS("WindowWidth")) return KEY_WIDTH; break;
+    case 12: if (KEY_IS("WindowHeight")) return KEY_HEIGHT; break;
+    case 15: if (KEY_IS("BackgroundColor")) return KEY_BACKGROUND; break;
+    }
+#undef KEY_IS
+    return KEY_UNKNOWN;
+}
+
+bool ConfigParse(const char* text, size_t len, Config* cfg) {
+    const char* p = text;
+    const char* end = text + len;
+    bool any = false;
+    while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        const char* le = eol;
+        if (le > p && le[-1] == '\r') le--;
+
+        const char* eq = (const char*)memchr(p, '=', le - p);
+        if (eq) {
+            const char* v = eq + 1;
+            int n = 0; COLORREF c = 0;
+            switch (MatchKey(p, eq - p)) {
+            case KEY_GRID:       if (ParseInt(v, le, &n) && v == le) { cfg->gridSize = n; any = true; } break;
+            case KEY_WIDTH:      if (ParseInt(v, le, &n) && v == le) { cfg->clientWidth = n; any = true; } break;
+            case KEY_HEIGHT:     if (ParseInt(v, le, &n) && v == le) { cfg->clientHeight = n; any = true; } break;
+            case KEY_BACKGROUND: if (ParseColor(v, le, &c) && v == le) { cfg->backgroundColor = c; any = true; } break;
+            case KEY_GRIDCOLOR:  if (ParseColor(v, le, &c) && v == le) { cfg->gridColor = c; any = true; } break;
+            case KEY_UNKNOWN:    break;
+            }
+        }
+        p = eol + 1;
+    }
+    return any;
+}
+
+// Текстовое представление конфига — одно на все сохранялки
+static int FormatConfig(char* buf, size_t n) {
+    return snprintf(buf, n,
+        "GridSize=%d\nWindowWidth=%d\nWindowHeight=%d\n"
+        "BackgroundColor=%d;%d;%d\nGridColor=%d;%d;%d\n",
+        currentConfig.gridSize,
+        currentConfig.clientWidth,
+        currentConfig.clientHeight,
+        GetRValue(currentConfig.backgroundColor),
+        GetGValue(currentConfig.backgroundColor),
+        GetBValue(currentConfig.backgroundColor),
+        GetRValue(currentConfig.gridColor),
+        GetGValue(currentConfig.gridColor),
+        GetBValue(currentConfig.gridColor)
+    );
+}
+
+// ————————————————————————————— Работа с конфигом (5 способов) ——————————————————————————————————
+
+void LoadConfig() {
+    switch (configMethod) {
+    case METHOD_MAPPING:   LoadConfigMapping(); break;
+    case METHOD_FILEVARS:  LoadConfigFileVars(); break;
+    case METHOD_FSTREAM:   LoadConfigFStream(); break;
+    case METHOD_WINAPI:    LoadConfigWinAPI(); break;
+    case METHOD_BINARY:    LoadConfigBinary(); break;
+    }
+}
+void SaveConfig() {
+    switch (configMethod) {
+    case METHOD_MAPPING:   SaveConfigMapping(); break;
+    case METHOD_FILEVARS:  SaveConfigFileVars(); break;
+    case METHOD_FSTREAM:   SaveConfigFStream(); break;
+    case METHOD_WINAPI:    SaveConfigWinAPI(); break;
+    case METHOD_BINARY:    SaveConfigBinary(); break;
+    }
+}
+
+// — Memory Mapping: разбираем прямо отображение файла
+static bool ReadConfigMapping(Config* cfg) {
+    FileView v;
+    if (!MapForRead(configFileName, &v)) return false;
+    bool ok = ConfigParse((const char*)v.data, v.size, cfg);
+    Unmap(&v);
+    return ok;
+}
+void LoadConfigMapping() { ReadConfigMapping(&currentConfig); }
+void SaveConfigMapping() {
+    char buf[512];
+    int len = FormatConfig(buf, sizeof(buf));
+    char tmp[260]; TempName(tmp, sizeof(tmp), configFileName);
+    FileView v;
+    if (!MapForWrite(tmp, (size_t)len, &v)) return;
+    memcpy(v.data, buf, len);
+    FlushView(&v);
+    Unmap(&v);
+    ReplaceWith(tmp, configFileName);
+}
+
+// — FILEVARS
+static bool ReadConfigFileVars(Config* cfg) {
+    configIOStats.opens++;
+    FILE* fp = fopen(configFileName, "r");
+    if (!fp) return false;
+    char buf[CONFIG_TEXT_MAX];
+    configIOStats.reads++;
+    size_t rd = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    return ConfigParse(buf, rd, cfg);
+}
+void LoadConfigFileVars() { ReadConfigFileVars(&currentConfig); }
+void SaveConfigFileVars() {
+    char tmp[260]; TempName(tmp, sizeof(tmp), configFileName);
+    configIOStats.opens++;
+    FILE* fp = fopen(tmp, "w");
+    if (!fp) return;
+    char buf[512];
+    int len = FormatConfig(buf, sizeof(buf));
+    configIOStats.writes++;
+    bool ok = fwrite(buf, 1, len, fp) == (size_t)len;
+    ok = (fclose(fp) == 0) && ok;
+    if (ok) ReplaceWith(tmp, configFileName);
+    else remove(tmp);
+}
+
+// — FSTREAM
+static bool ReadConfigFStream(Config* cfg) {
+    configIOStats.opens++;
+    std::ifstream f(configFileName, std::ios::binary);
+    if (!f) return false;
+    char buf[CONFIG_TEXT_MAX];
+    configIOStats.reads++;
+    f.read(buf, sizeof(buf));
+    return ConfigParse(buf, (size_t)f.gcount(), cfg);
+}
+void LoadConfigFStream() { ReadConfigFStream(&currentConfig); }
+void SaveConfigFStream() {
+    char tmp[260]; TempName(tmp, sizeof(tmp), configFileName);
+    configIOStats.opens++;
+    {
+        std::ofstream f(tmp);
+        configIOStats.writes++;
+        f << "GridSize=" << currentConfig.gridSize << "\n"
+            << "WindowWidth=" << currentConfig.clientWidth << "\n"
+            << "WindowHeight=" << currentConfig.clientHeight << "\n"
+            << "BackgroundColor="
+            << (int)GetRValue(currentConfig.backgroundColor) << ";"
+            << (int)GetGValue(currentConfig.backgroundColor) << ";"
+            << (int)GetBValue(currentConfig.backgroundColor) << "\n"
+            << "GridColor="
+            << (int)GetRValue(currentConfig.gridColor) << ";"
+            << (int)GetGValue(currentConfig.gridColor) << ";"
+            << (int)GetBValue(currentConfig.gridColor) << "\n";
+        f.close();
+        if (!f) { remove(tmp); return; }
+    }
+    ReplaceWith(tmp, configFileName);
+}
+
+// — WinAPI
+static bool ReadConfigWinAPI(Config* cfg) {
+    char buf[CONFIG_TEXT_MAX];
+    size_t len;
+    if (!ReadInto(configFileName, buf, sizeof(buf), &len)) return false;
+    return ConfigParse(buf, len, cfg);
+}
+void LoadConfigWinAPI() { ReadConfigWinAPI(&currentConfig); }
+void SaveConfigWinAPI() {
+    char buf[512];
+    int len = FormatConfig(buf, sizeof(buf));
+    char tmp[260]; TempName(tmp, sizeof(tmp), configFileName);
+    if (WriteWhole(tmp, buf, (size_t)len)) ReplaceWith(tmp, configFileName);
+}
+
+// — BINARY: запись фиксированной раскладки, читается прямо из отображения файла.
+// checksum (CRC32) считается по байтам после заголовка, size — по всей записи:
+// новые версии дописывают поля в конец, старые поля остаются на месте.
+#define CONFIG_BIN_MAGIC    0x47464347u     // "GCFG"
+#define CONFIG_BIN_VERSION  1
+
+struct ConfigRecord {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t checksum;
+    uint32_t reserved;
+    int32_t  gridSize;
+    int32_t  clientWidth;
+    int32_t  clientHeight;
+    uint32_t backgroundColor;
+    uint32_t gridColor;
+};
+#define CONFIG_BIN_HEADER  16
+
+static uint32_t Crc32(const uint8_t* p, size_t n) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; i++) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// Проверка записи на месте, без копирования и разбора
+static bool ConfigRecordValid(const ConfigRecord* r, size_t fileSize) {
+    return fileSize >= sizeof(ConfigRecord)
+        && r->magic == CONFIG_BIN_MAGIC
+        && r->version >= CONFIG_BIN_VERSION
+        && r->size >= sizeof(ConfigRecord) && r->size <= fileSize
+        && r->checksum == Crc32((const uint8_t*)r + CONFIG_BIN_HEADER, r->size - CONFIG_BIN_HEADER);
+}
+
+static bool ReadConfigBinary(Config* cfg) {
+    FileView v;
+    if (!MapForRead(configBinFileName, &v)) return false;
+    const ConfigRecord* r = (const ConfigRecord*)v.data;
+    bool ok = ConfigRecordValid(r, v.size);
+    if (ok) {
+        cfg->gridSize = r->gridSize;
+        cfg->clientWidth = r->clientWidth;
+        cfg->clientHeight = r->clientHeight;
+        cfg->backgroundColor = r->backgroundColor;
+        cfg->gridColor = r->gridColor;
+    }
+    Unmap(&v);
+    return ok;
+}
+void LoadConfigBinary() {
+    // Первый запуск (или битый файл): берём текстовый конфиг и сразу переводим его в бинарный
+    if (!ReadConfigBinary(&currentConfig)) {
+        LoadConfigMapping();
+        SaveConfigBinary();
+    }
+}
+void SaveConfigBinary() {
+    ConfigRecord r = {};
+    r.magic = CONFIG_BIN_MAGIC;
+    r.version = CONFIG_BIN_VERSION;
+    r.size = sizeof(ConfigRecord);
+    r.gridSize = currentConfig.gridSize;
+    r.clientWidth = currentConfig.clientWidth;
+    r.clientHeight = currentConfig.clientHeight;
+    r.backgroundColor = currentConfig.backgroundColor;
+    r.gridColor = currentConfig.gridColor;
+    r.checksum = Crc32((const uint8_t*)&r + CONFIG_BIN_HEADER, sizeof(r) - CONFIG_BIN_HEADER);
+
+    char tmp[260]; TempName(tmp, sizeof(tmp), configBinFileName);
+    if (WriteWhole(tmp, &r, sizeof(r))) ReplaceWith(tmp, configBinFileName);
+}
+
+bool ConfigRead(ConfigMethod method, Config* cfg) {
+    switch (method) {
+    case METHOD_MAPPING:   return ReadConfigMapping(cfg);
+    case METHOD_FILEVARS:  return ReadConfigFileVars(cfg);
+    case METHOD_FSTREAM:   return ReadConfigFStream(cfg);
+    case METHOD_WINAPI:    return ReadConfigWinAPI(cfg);
+    case METHOD_BINARY:    return ReadConfigBinary(cfg);
+    }
+    return false;
+}
+
+// ——————————————————————————————— Горячая перезагрузка ———————————————————————————————————
+
+// Поток ждёт изменений в текущем каталоге (сохранения идут через rename,
+// поэтому ловим и запись, и переименование), перечитывает файл выбранным
+// способом и, если конфиг правда изменился, кладёт его в latest и зовёт fn.
+// Окно забирает latest через ConfigWatchTake — копия под мьютексом,
+// файловый ввод-вывод в поток сообщений не попадает.
+struct ConfigWatcher {
+    ConfigMethod    method;
+    ConfigChangedFn fn;
+    void*           ctx;
+    const char*     file;
+    Config          last;       // только поток наблюдателя
+    std::mutex      lock;
+    Config          latest;     // под lock
+    bool            fresh;      // под lock
+    std::thread     thread;
+#ifdef _WIN32
+    HANDLE          hStop;
+    HANDLE          hDir;       // каталог "." для ReadDirectoryChangesW
+    OVERLAPPED      ov;         // ov.hEvent — пришли изменения
+    DWORD           buf[1024];  // FILE_NOTIFY_INFORMATION, выровнено по DWORD
+#else
+    int             fdNotify;
+    int             stopPipe[2];
+#endif
+};
+
+static bool ConfigEqual(const Config& a, const Config& b) {
+    return a.gridSize == b.gridSize
+        && a.clientWidth == b.clientWidth
+        && a.clientHeight == b.clientHeight
+        && a.backgroundColor == b.backgroundColor
+        && a.gridColor == b.gridColor;
+}
+
+static void WatchReload(ConfigWatcher* w) {
+    Config c = w->last;
+    if (!ConfigRead(w->method, &c) || ConfigEqual(c, w->last)) return;
+    w->last = c;
+    {
+        std::lock_guard<std::mutex> g(w->lock);
+        w->latest = c;
+        w->fresh = true;
+    }
+    w->fn(w->ctx);
+}
+
+#ifdef _WIN32
+// Имя из уведомления (UTF-16, без нуля) — наш ли это файл
+static bool IsWatchedName(const ConfigWatcher* w, const WCHAR* name, DWORD bytes) {
+    size_t n = bytes / sizeof(WCHAR);
+    if (n != strlen(w->file)) return false;
+    for (size_t i = 0; i < n; i++) {
+        WCHAR a = name[i], b = (WCHAR)(unsigned char)w->file[i];
+        if (a >= L'A' && a <= L'Z') a += L'a' - L'A';
+        if (b >= L'A' && b <= L'Z') b += L'a' - L'A';
+        if (a != b) return false;
+    }
+    return true;
+}
+
+static bool WatchArm(ConfigWatcher* w) {
+    return ReadDirectoryChangesW(w->hDir, w->buf, sizeof(w->buf), FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &w->ov, nullptr) != 0;
+}
+
+// В каталоге каждый кадр пишутся data.bin, журнал и снимки поля,
+// поэтому перечитываем конфиг только по событиям с его именем
+static void WatchLoop(ConfigWatcher* w) {
+    HANDLE h[2] = { w->hStop, w->ov.hEvent };
+    while (WatchArm(w) && WaitForMultipleObjects(2, h, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        DWORD got = 0;
+        if (!GetOverlappedResult(w->hDir, &w->ov, &got, FALSE)) break;
+        // got == 0 — буфер переполнился и имена потеряны: перечитаем на всякий случай
+        bool ours = got == 0;
+        for (const BYTE* p = (const BYTE*)w->buf; got && !ours; ) {
+            const FILE_NOTIFY_INFORMATION* e = (const FILE_NOTIFY_INFORMATION*)p;
+            ours = IsWatchedName(w, e->FileName, e->FileNameLength);
+            if (!e->NextEntryOffset) break;
+            p += e->NextEntryOffset;
+        }
+        if (ours) WatchReload(w);
+    }
+    CancelIo(w->hDir);
+}
+#else
+static void WatchLoop(ConfigWatcher* w) {
+    alignas(struct inotify_event) char buf[4096];
+    pollfd fds[2] = { { w->fdNotify, POLLIN, 0 }, { w->stopPipe[0], POLLIN, 0 } };
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents) break;
+        bool ours = false;
+        ssize_t n;
+        while ((n = read(w->fdNotify, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + n; ) {
+                const inotify_event* e = (const inotify_event*)p;
+                if (e->len && !strcmp(e->name, w->file)) ours = true;
+                p += sizeof(inotify_event) + e->len;
+            }
+        }
+        if (ours) WatchReload(w);
+    }
+}
+#endif
+
+ConfigWatcher* ConfigWatchStart(ConfigMethod method, const Config* initial, ConfigChangedFn fn, void* ctx) {
+    ConfigWatcher* w = new ConfigWatcher();
+    w->method = method;
+    w->fn = fn;
+    w->ctx = ctx;
+    w->file = (method == METHOD_BINARY) ? configBinFileName : configFileName;
+    // Сравниваем с тем, что лежит в файле, а не с initial: ключи командной
+    // строки (-grid) не должны выглядеть как правка конфига
+    w->last = *initial;
+    ConfigRead(method, &w->last);
+    w->fresh = false;
+#ifdef _WIN32
+    w->hDir = CreateFileA(".", FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (w->hDir == INVALID_HANDLE_VALUE) { delete w; return nullptr; }
+    w->ov.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    w->hStop = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+#else
+    w->fdNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fdNotify < 0) { delete w; return nullptr; }
+    if (inotify_add_watch(w->fdNotify, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0 || pipe(w->stopPipe) != 0) {
+        close(w->fdNotify);
+        delete w;
+        return nullptr;
+    }
+#endif
+    w->thread = std::thread(WatchLoop, w);
+    return w;
+}
+
+bool ConfigWatchTake(ConfigWatcher* w, Config* out) {
+    std::lock_guard<std::mutex> g(w->lock);
+    if (!w->fresh) return false;
+    *out = w->latest;
+    w->fresh = false;
+    return true;
+}
+
+void ConfigWatchStop(ConfigWatcher* w) {
+    if (!w) return;
+#ifdef _WIN32
+    SetEvent(w->hStop);
+    w->thread.join();
+    CloseHandle(w->hDir);
+    CloseHandle(w->ov.hEvent);
+    CloseHandle(w->hStop);
+#else
+    char b = 0;
+    if (write(w->stopPipe[1], &b, 1) < 0) {}
+    w->thread.join();
+    close(w->stopPipe[0]);
+    close(w->stopPipe[1]);
+    close(w->fdNotify);
+#endif
+    delete w;
+}
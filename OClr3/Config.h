@@ -0,0 +1,74 @@
+﻿#pragma once
+
+// Конфиг окна и пять способов его хранить (-m1..-m5).
+// Файловые вызовы идут через переносимые обёртки: под Windows — WinAPI,
+// под POSIX — open/read/write/mmap, поэтому всё это работает и без окна.
+//
+// Save* пишут во временный файл рядом и атомарно подменяют им config.*:
+// экземпляры, одновременно сохраняющиеся в WM_DESTROY, больше не оставляют
+// обрезанный или перемешанный файл — выигрывает последний целиком.
+
+#include "Platform.h"
+
+#include <stddef.h>
+
+#define DEFAULT_GRID_SIZE      3
+#define DEFAULT_WIN_WIDTH      320
+#define DEFAULT_WIN_HEIGHT     240
+
+// Текстовый конфиг длиннее не читается (хвост отбрасывается)
+#define CONFIG_TEXT_MAX        4096
+
+struct Config {
+    int gridSize;
+    int clientWidth;
+    int clientHeight;
+    COLORREF backgroundColor;
+    COLORREF gridColor;
+};
+
+extern Config currentConfig;
+
+// Механизмы чтения/записи конфига
+enum ConfigMethod { METHOD_MAPPING, METHOD_FILEVARS, METHOD_FSTREAM, METHOD_WINAPI, METHOD_BINARY };
+extern ConfigMethod configMethod;
+
+extern const char* configFileName;
+extern const char* configBinFileName;
+
+void    LoadConfig(), SaveConfig();
+void    LoadConfigMapping(), SaveConfigMapping();
+void    LoadConfigFileVars(), SaveConfigFileVars();
+void    LoadConfigFStream(), SaveConfigFStream();
+void    LoadConfigWinAPI(), SaveConfigWinAPI();
+void    LoadConfigBinary(), SaveConfigBinary();
+
+// Разбор "Key=value" строк за один проход: порядок ключей любой, незнакомые
+// ключи пропускаются, найденные значения пишутся поверх cfg.
+// false — не нашлось ни одного известного ключа.
+bool    ConfigParse(const char* text, size_t len, Config* cfg);
+
+// Прочитать конфиг способом method поверх cfg, не трогая currentConfig
+bool    ConfigRead(ConfigMethod method, Config* cfg);
+
+// Слежение за файлом конфига. fn зовётся из потока наблюдателя, когда
+// файл изменился и прочитанный конфиг отличается от прошлого; сам конфиг
+// забирается из своего потока через ConfigWatchTake. Прошлым считается
+// содержимое файла на момент старта (initial — только если файла нет).
+struct ConfigWatcher;
+typedef void (*ConfigChangedFn)(void* ctx);
+
+ConfigWatcher* ConfigWatchStart(ConfigMethod method, const Config* initial, ConfigChangedFn fn, void* ctx);
+bool    ConfigWatchTake(ConfigWatcher* w, Config* out);
+void    ConfigWatchStop(ConfigWatcher* w);
+
+// Сколько файловых вызовов сделали загрузчики/сохранялки с начала работы
+struct ConfigIOStats {
+    uint64_t opens;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t maps;
+    uint64_t flushes;
+    uint64_t renames;
+};
+extern ConfigIOStats configIOStats;
@@ -0,0 +1,76 @@
+﻿// Точка входа без окна для машин без дисплея (Linux CI): те же ключи,
+// что у OClr3 -replay / -load (Loadgen.h). Под Windows этот режим
+// выбирается в ParseCommandLine, и файл собирается пустым.
+
+#ifndef _WIN32
+
+#include "Loadgen.h"
+#include "Config.h"
+#include "UpdateScheduler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+int main(int argc, char** argv) {
+    LoadgenOptions o;
+    LoadgenDefaults(&o);
+    char journalFile[64] = "data.bin";
+    bool gridFromCmdLine = false;
+    uint32_t destroyId = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcasecmp(argv[i], "-m1")) configMethod = METHOD_MAPPING;
+        if (!strcasecmp(argv[i], "-m2")) configMethod = METHOD_FILEVARS;
+        if (!strcasecmp(argv[i], "-m3")) configMethod = METHOD_FSTREAM;
+        if (!strcasecmp(argv[i], "-m4")) configMethod = METHOD_WINAPI;
+        if (!strcasecmp(argv[i], "-m5")) configMethod = METHOD_BINARY;
+        if (!strcasecmp(argv[i], "-grid") && i + 1 < argc) {
+            currentConfig.gridSize = atoi(argv[++i]);
+            gridFromCmdLine = true;
+        }
+        if (!strcasecmp(argv[i], "-board") && i + 1 < argc)
+            o.boardId = (uint32_t)atoi(argv[++i]);
+        if (!strcasecmp(argv[i], "-destroy") && i + 1 < argc)
+            destroyId = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        if (!strcasecmp(argv[i], "-k") && i + 1 < argc)
+            o.winLength = atoi(argv[++i]);
+        if (!strcasecmp(argv[i], "-frame") && i + 1 < argc)
+            o.frameMs = (uint32_t)atoi(argv[++i]);
+        if (!strcasecmp(argv[i], "-replay") && i + 1 < argc) {
+            o.mode = LOADGEN_REPLAY;
+            o.script = argv[++i];
+        }
+        if (!strcasecmp(argv[i], "-load")) o.mode = LOADGEN_RANDOM;
+        if (!strcasecmp(argv[i], "-rate") && i + 1 < argc)
+            o.rate = (uint32_t)atoi(argv[++i]);
+        if (!strcasecmp(argv[i], "-ops") && i + 1 < argc)
+            o.ops = strtoull(argv[++i], nullptr, 10);
+        if (!strcasecmp(argv[i], "-duration") && i + 1 < argc)
+            o.durationMs = (uint32_t)atoi(argv[++i]);
+        if (!strcasecmp(argv[i], "-repeat") && i + 1 < argc)
+            o.repeat = (uint32_t)atoi(argv[++i]);
+        if (!strcasecmp(argv[i], "-seed") && i + 1 < argc)
+            o.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        if (!strcasecmp(argv[i], "-colors") && i + 1 < argc)
+            o.colorPermille = (uint32_t)atoi(argv[++i]);
+    }
+    if (destroyId) return LoadgenDestroyBoard(destroyId, stdout) ? 0 : 1;
+
+    // размер поля — из конфига, как у окна, если не задан -grid
+    if (!gridFromCmdLine) LoadConfig();
+    if (currentConfig.gridSize < 1 || currentConfig.gridSize > GRID_MAX_SIZE)
+        currentConfig.gridSize = DEFAULT_GRID_SIZE;
+    o.gridSize = currentConfig.gridSize;
+    o.resize = gridFromCmdLine;
+    if (o.boardId) snprintf(journalFile, sizeof(journalFile), "data.%u.bin", o.boardId);
+    o.journalFile = journalFile;
+
+    LoadgenReport r;
+    if (!LoadgenRun(&o, &r, stderr)) return 1;
+    LoadgenPrintReport(stdout, &o, &r);
+    return 0;
+}
+
+#endif
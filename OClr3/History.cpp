@@ -0,0 +1,355 @@
+﻿#include "History.h"
+#include "Platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define HISTORY_MAGIC 0x54534948u      // "HIST"
+
+// Лист — слова клеток, внутренний узел — номера детей. Свободный узел
+// хранит в child[0] следующий свободный.
+union HistoryNode {
+    uint64_t words[HISTORY_LEAF_WORDS];
+    uint32_t child[HISTORY_FANOUT];
+};
+
+struct HistoryHeader {
+    uint32_t magic;
+    uint32_t valid;                    // 0 — история выключена до следующего Rebase
+    uint32_t words;                    // слов клеток в поле
+    uint32_t levels;
+    uint32_t freeHead;                 // список освобождённых узлов
+    uint32_t fresh;                    // дальше узлы ещё не выдавались
+    uint32_t used;
+    uint32_t pad;
+    uint64_t first, cur, last;         // номера версий: хранимые и текущая
+    HistoryVersion versions[HISTORY_MAX_VERSIONS];   // по номеру % HISTORY_MAX_VERSIONS
+    uint32_t refs[HISTORY_NODES];
+    // далее: HistoryNode nodes[HISTORY_NODES]; узел 0 не выдаётся
+};
+
+struct History {
+    HistoryHeader* hh;
+    HistoryNode*   nodes;
+    size_t         bytes;
+    uint64_t       seeks;
+    uint32_t       seekUsLast;
+    uint32_t       seekUsMax;
+#ifdef _WIN32
+    HANDLE         hMap;
+#endif
+};
+
+static size_t SegmentBytes() {
+    return sizeof(HistoryHeader) + (size_t)HISTORY_NODES * sizeof(HistoryNode);
+}
+
+// ——————————————————————————————— Узлы ——————————————————————————————————————
+
+static uint32_t Alloc(History* h) {
+    HistoryHeader* hh = h->hh;
+    uint32_t n;
+    if (hh->freeHead) {
+        n = hh->freeHead;
+        hh->freeHead = h->nodes[n].child[0];
+    }
+    else if (hh->fresh < HISTORY_NODES) {
+        n = hh->fresh++;
+    }
+    else {
+        return 0;
+    }
+    hh->refs[n] = 1;
+    hh->used++;
+    return n;
+}
+
+static void FreeNode(History* h, uint32_t n) {
+    h->nodes[n].child[0] = h->hh->freeHead;
+    h->hh->freeHead = n;
+    h->hh->used--;
+}
+
+static void Release(History* h, uint32_t n, uint32_t level) {
+    if (!n || --h->hh->refs[n]) return;
+    if (level > 0)
+        for (int i = 0; i < HISTORY_FANOUT; i++)
+            Release(h, h->nodes[n].child[i], level - 1);
+    FreeNode(h, n);
+}
+
+// Копия пути до слова w; память под levels + 1 узлов должна быть свободна
+static uint32_t SetWord(History* h, uint32_t node, uint32_t level, uint32_t w, uint64_t value) {
+    uint32_t n = Alloc(h);
+    HistoryNode* dst = &h->nodes[n];
+    uint64_t any = 0;
+    if (level == 0) {
+        if (node) memcpy(dst->words, h->nodes[node].words, sizeof(dst->words));
+        else memset(dst->words, 0, sizeof(dst->words));
+        dst->words[w % HISTORY_LEAF_WORDS] = value;
+        for (int i = 0; i < HISTORY_LEAF_WORDS; i++) any |= dst->words[i];
+    }
+    else {
+        uint32_t slot = (w >> (6 * level)) % HISTORY_FANOUT;
+        uint32_t old = 0;
+        if (node) {
+            memcpy(dst->child, h->nodes[node].child, sizeof(dst->child));
+            old = dst->child[slot];
+            for (int i = 0; i < HISTORY_FANOUT; i++)
+                if (i != (int)slot && dst->child[i]) h->hh->refs[dst->child[i]]++;
+        }
+        else {
+            memset(dst->child, 0, sizeof(dst->child));
+        }
+        dst->child[slot] = SetWord(h, old, level - 1, w, value);
+        for (int i = 0; i < HISTORY_FANOUT; i++) any |= dst->child[i];
+    }
+    if (!any) {
+        FreeNode(h, n);
+        return 0;
+    }
+    return n;
+}
+
+static uint64_t GetWord(const History* h, uint32_t node, uint32_t level, uint32_t w) {
+    for (; node && level > 0; level--)
+        node = h->nodes[node].child[(w >> (6 * level)) % HISTORY_FANOUT];
+    return node ? h->nodes[node].words[w % HISTORY_LEAF_WORDS] : 0;
+}
+
+// Дерево из слов поля; пустые поддеревья — 0. oom — кончились узлы.
+static uint32_t Build(History* h, const uint64_t* words, uint32_t count, uint32_t level, uint32_t base, bool* oom) {
+    if (*oom || base >= count) return 0;
+    if (level == 0) {
+        uint32_t n1 = count - base < HISTORY_LEAF_WORDS ? count - base : HISTORY_LEAF_WORDS;
+        uint64_t any = 0;
+        for (uint32_t i = 0; i < n1; i++) any |= words[base + i];
+        if (!any) return 0;
+        uint32_t n = Alloc(h);
+        if (!n) { *oom = true; return 0; }
+        memset(h->nodes[n].words, 0, sizeof(h->nodes[n].words));
+        memcpy(h->nodes[n].words, words + base, (size_t)n1 * sizeof(uint64_t));
+        return n;
+    }
+    uint32_t child[HISTORY_FANOUT];
+    uint32_t any = 0;
+    uint32_t span = 1u << (6 * level);
+    for (int i = 0; i < HISTORY_FANOUT; i++) {
+        uint64_t b = base + (uint64_t)i * span;
+        child[i] = b < count ? Build(h, words, count, level - 1, (uint32_t)b, oom) : 0;
+        any |= child[i];
+    }
+    if (!any) return 0;
+    uint32_t n = Alloc(h);
+    if (!n) {
+        *oom = true;
+        for (int i = 0; i < HISTORY_FANOUT; i++) Release(h, child[i], level - 1);
+        return 0;
+    }
+    memcpy(h->nodes[n].child, child, sizeof(child));
+    return n;
+}
+
+// Вызывает fn для слов, которыми дерево b отличается от a
+static void Diff(History* h, uint32_t a, uint32_t b, uint32_t level, uint32_t base, HistoryWordFn fn, void* ctx) {
+    if (a == b) return;
+    const HistoryNode* na = a ? &h->nodes[a] : nullptr;
+    const HistoryNode* nb = b ? &h->nodes[b] : nullptr;
+    if (level == 0) {
+        for (uint32_t i = 0; i < HISTORY_LEAF_WORDS && base + i < h->hh->words; i++) {
+            uint64_t wa = na ? na->words[i] : 0;
+            uint64_t wb = nb ? nb->words[i] : 0;
+            if (wa != wb) fn(ctx, base + i, wb);
+        }
+        return;
+    }
+    uint32_t span = 1u << (6 * level);
+    for (int i = 0; i < HISTORY_FANOUT; i++) {
+        uint64_t cb = base + (uint64_t)i * span;
+        if (cb >= h->hh->words) break;
+        Diff(h, na ? na->child[i] : 0, nb ? nb->child[i] : 0, level - 1, (uint32_t)cb, fn, ctx);
+    }
+}
+
+// ——————————————————————————————— Версии ——————————————————————————————————————
+
+static HistoryVersion& At(History* h, uint64_t n) {
+    return h->hh->versions[n % HISTORY_MAX_VERSIONS];
+}
+
+static void DropOldest(History* h) {
+    HistoryHeader* hh = h->hh;
+    Release(h, At(h, hh->first).root, hh->levels);
+    hh->first++;
+}
+
+// Отменённые версии после текущей больше не достижимы
+static void DropRedo(History* h) {
+    HistoryHeader* hh = h->hh;
+    for (; hh->last > hh->cur; hh->last--)
+        Release(h, At(h, hh->last).root, hh->levels);
+}
+
+static void Push(History* h, const HistoryVersion& v) {
+    HistoryHeader* hh = h->hh;
+    if (hh->cur + 1 - hh->first >= HISTORY_MAX_VERSIONS) DropOldest(h);
+    hh->last = ++hh->cur;
+    At(h, hh->cur) = v;
+}
+
+// Места под путь: при нехватке отдаём самые старые версии
+static bool Reserve(History* h) {
+    HistoryHeader* hh = h->hh;
+    uint32_t need = hh->levels + 1;
+    while (HISTORY_NODES - 1 - hh->used < need && hh->first < hh->cur) DropOldest(h);
+    return HISTORY_NODES - 1 - hh->used >= need;
+}
+
+void HistoryRebase(History* h, const uint64_t* words, uint32_t count, int winner, int winCell, int winDir) {
+    if (!h) return;
+    HistoryHeader* hh = h->hh;
+    hh->freeHead = 0;
+    hh->fresh = 1;
+    hh->used = 0;
+    hh->words = count;
+    hh->levels = 0;
+    for (uint64_t cap = HISTORY_LEAF_WORDS; cap < count; cap *= HISTORY_FANOUT) hh->levels++;
+    hh->first = hh->cur = hh->last = 0;
+
+    bool oom = false;
+    HistoryVersion v = { words ? Build(h, words, count, hh->levels, 0, &oom) : 0, winner, winCell, winDir };
+    // поле не влезло в узлы целиком — без истории до следующей партии
+    hh->valid = !oom;
+    At(h, 0) = v;
+}
+
+void HistoryRecord(History* h, uint32_t word, uint64_t value, int winner, int winCell, int winDir) {
+    if (!h || !h->hh->valid) return;
+    HistoryHeader* hh = h->hh;
+    DropRedo(h);
+    uint32_t root = At(h, hh->cur).root;
+    if (GetWord(h, root, hh->levels, word) == value) return;   // ничего не поменялось
+    if (!Reserve(h)) {
+        hh->valid = 0;
+        return;
+    }
+    HistoryVersion v = { SetWord(h, root, hh->levels, word, value), winner, winCell, winDir };
+    Push(h, v);
+}
+
+void HistoryRecordClear(History* h) {
+    if (!h) return;
+    HistoryHeader* hh = h->hh;
+    if (!hh->valid) {
+        HistoryRebase(h, nullptr, hh->words, 0, 0, 0);
+        return;
+    }
+    DropRedo(h);
+    if (!At(h, hh->cur).root) return;
+    HistoryVersion v = { 0, 0, 0, 0 };
+    Push(h, v);
+}
+
+bool HistorySeek(History* h, int steps, HistoryWordFn fn, void* ctx, HistoryVersion* to) {
+    if (!h || !h->hh->valid) return false;
+    HistoryHeader* hh = h->hh;
+    int64_t target = (int64_t)hh->cur + steps;
+    if (target < (int64_t)hh->first) target = (int64_t)hh->first;
+    if (target > (int64_t)hh->last) target = (int64_t)hh->last;
+    if ((uint64_t)target == hh->cur) return false;
+
+    auto t0 = std::chrono::steady_clock::now();
+    Diff(h, At(h, hh->cur).root, At(h, (uint64_t)target).root, hh->levels, 0, fn, ctx);
+    hh->cur = (uint64_t)target;
+    *to = At(h, hh->cur);
+    uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    h->seeks++;
+    h->seekUsLast = us;
+    if (us > h->seekUsMax) h->seekUsMax = us;
+    return true;
+}
+
+HistoryInfo HistoryGetInfo(const History* h) {
+    HistoryInfo info = {};
+    if (!h) return info;
+    const HistoryHeader* hh = h->hh;
+    if (hh->valid) {
+        info.undo = (uint32_t)(hh->cur - hh->first);
+        info.redo = (uint32_t)(hh->last - hh->cur);
+    }
+    info.nodes = hh->used;
+    info.levels = hh->levels;
+    info.seeks = h->seeks;
+    info.seekUsLast = h->seekUsLast;
+    info.seekUsMax = h->seekUsMax;
+    return info;
+}
+
+// ——————————————————————————————— Сегмент ——————————————————————————————————————
+
+History* HistoryOpen(const char* name, bool create) {
+    char hn[96];
+    snprintf(hn, sizeof(hn), "%s.hist", name);
+    size_t bytes = SegmentBytes();
+    void* p = nullptr;
+    History* h = new History();
+
+#ifdef _WIN32
+    h->hMap = create
+        ? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+            (DWORD)((uint64_t)bytes >> 32), (DWORD)bytes, hn)
+        : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, hn);
+    if (h->hMap) {
+        p = MapViewOfFile(h->hMap, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+        if (!p) CloseHandle(h->hMap);
+    }
+#else
+    if (create) shm_unlink(hn);        // хвост от прошлого запуска
+    int fd = shm_open(hn, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    if (fd >= 0) {
+        struct stat st;
+        bool sized = create ? ftruncate(fd, (off_t)bytes) == 0
+                            : fstat(fd, &st) == 0 && (size_t)st.st_size >= bytes;
+        if (sized) {
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) p = nullptr;
+        }
+        close(fd);
+    }
+#endif
+    if (!p) {
+        delete h;
+        return nullptr;
+    }
+    h->hh = (HistoryHeader*)p;
+    h->nodes = (HistoryNode*)(h->hh + 1);
+    h->bytes = bytes;
+    // создатель сам заполнит заголовок первым Rebase (SharedAttachHistory)
+    if (create) h->hh->magic = HISTORY_MAGIC;
+    else if (h->hh->magic != HISTORY_MAGIC) {
+        HistoryClose(h);
+        return nullptr;
+    }
+    return h;
+}
+
+void HistoryClose(History* h) {
+    if (!h) return;
+#ifdef _WIN32
+    UnmapViewOfFile(h->hh);
+    CloseHandle(h->hMap);
+#else
+    munmap(h->hh, h->bytes);
+#endif
+    delete h;
+}
@@ -0,0 +1,66 @@
+﻿#pragma once
+
+// История поля для отмены и повтора ходов, общая для всех экземпляров.
+//
+// Каждая версия — корень персистентного дерева над словами клеток:
+// листья по HISTORY_LEAF_WORDS слов, внутренние узлы по HISTORY_FANOUT
+// детей. Ход копирует только путь от корня до своего листа, остальное
+// дерево версии делят между собой, поэтому версия стоит levels + 1 узлов
+// независимо от размера поля. Пустое поддерево — узел 0, так что новая
+// партия — это версия с корнем 0.
+//
+// Переход к любой версии обходит два дерева параллельно и спускается
+// только туда, где узлы различаются: работа пропорциональна разнице.
+//
+// Узлы, счётчики ссылок и список версий лежат в отдельном сегменте
+// name.hist. Меняется он только из SharedGrid.cpp под записью поля,
+// поэтому своей блокировки у него нет (как у журнала).
+
+#include <stdint.h>
+
+#define HISTORY_LEAF_WORDS    64                 // 512 байт клеток в листе
+#define HISTORY_FANOUT        64
+#define HISTORY_NODES         32768              // 16 МБ узлов на всё
+#define HISTORY_MAX_VERSIONS  8192
+
+struct History;
+
+// Что восстановить вместе с клетками
+struct HistoryVersion {
+    uint32_t root;
+    int      winner;
+    int      winCell;
+    int      winDir;
+};
+
+struct HistoryInfo {
+    uint32_t undo;                     // шагов назад
+    uint32_t redo;                     // шагов вперёд
+    uint32_t nodes;                    // занято узлов
+    uint32_t levels;                   // внутренних уровней над листьями
+    uint64_t seeks;                    // переходов этим процессом
+    uint32_t seekUsLast;               // время перехода, мкс
+    uint32_t seekUsMax;
+};
+
+// Сегмент name.hist; create — создать заново (первый экземпляр).
+// nullptr — истории не будет, ходы не отменяются.
+History* HistoryOpen(const char* name, bool create);
+void     HistoryClose(History* h);
+// Счётчики для вывода; читаются без блокировки, значения примерные
+HistoryInfo HistoryGetInfo(const History* h);
+
+// ——— Для SharedGrid.cpp: вызываются только под записью поля ———
+
+// Забыть всё и начать с одной версии — текущего поля (words слов)
+void     HistoryRebase(History* h, const uint64_t* words, uint32_t count, int winner, int winCell, int winDir);
+// Новая версия: в слове word теперь value. Отменённые версии впереди отбрасываются.
+void     HistoryRecord(History* h, uint32_t word, uint64_t value, int winner, int winCell, int winDir);
+// Новая версия с пустым полем (новая партия)
+void     HistoryRecordClear(History* h);
+
+// Перейти на steps версий (< 0 — назад), насколько хватает истории. Для
+// каждого слова, которое отличается, вызывается fn с новым значением.
+// false — идти некуда.
+typedef void (*HistoryWordFn)(void* ctx, uint32_t word, uint64_t value);
+bool     HistorySeek(History* h, int steps, HistoryWordFn fn, void* ctx, HistoryVersion* to);
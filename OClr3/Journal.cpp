@@ -0,0 +1,479 @@
+﻿#include "Journal.h"
+#include "SharedGrid.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define JOURNAL_MAGIC         0x4C4E4A47u     // "GJNL"
+#define JOURNAL_VERSION       2
+#define JOURNAL_HEADER_BYTES  4096u
+#define JOURNAL_REGIONS       4
+#define JOURNAL_REGION_BYTES  (16u << 20)
+#define JOURNAL_FILE_BYTES    ((size_t)JOURNAL_HEADER_BYTES + JOURNAL_REGIONS * (size_t)JOURNAL_REGION_BYTES)
+#define JOURNAL_PAGE          4096u
+
+typedef std::chrono::steady_clock Clock;
+
+// Состояние одним словом: его меняют и запись поля (под seqlock), и
+// JournalCommit без блокировки — только через CAS.
+//   epoch   — номер контрольной точки; начатый до неё JournalCommit уже
+//             ничего не опубликует;
+//   active  — живая область, с неё начинается восстановление;
+//   pending — область новой контрольной точки + 1, ещё не сброшенная (0 — нет);
+//             записи идут в неё, живой её делает следующий JournalCommit;
+//   flushed — до какого байта сброшена живая область.
+static inline uint64_t StatePack(uint32_t epoch, uint32_t active, uint32_t pending, uint32_t flushed) {
+    return (uint64_t)(epoch & 0x07FFFFFFu) << 37 | (uint64_t)active << 35 | (uint64_t)pending << 32 | flushed;
+}
+static inline uint32_t StateEpoch(uint64_t s)   { return (uint32_t)(s >> 37); }
+static inline uint32_t StateActive(uint64_t s)  { return (uint32_t)(s >> 35) & 3; }
+static inline uint32_t StatePending(uint64_t s) { return (uint32_t)(s >> 32) & 7; }
+static inline uint32_t StateFlushed(uint64_t s) { return (uint32_t)s; }
+// Область, куда сейчас добавляются записи
+static inline uint32_t StateTail(uint64_t s)    { return StatePending(s) ? StatePending(s) - 1 : StateActive(s); }
+
+struct JournalHeader {
+    uint32_t              magic;
+    uint32_t              version;
+    uint32_t              regionBytes;
+    uint32_t              regions;
+    uint32_t              nextSeq;     // номер следующей записи; только под записью поля
+    uint32_t              reserved;
+    std::atomic<uint64_t> state;       // StatePack
+    std::atomic<uint64_t> durable;     // epoch << 32 | область, чей заголовок уже сброшен
+    std::atomic<uint32_t> used[JOURNAL_REGIONS];  // занято байт; пишется под записью поля
+};
+
+struct JournalRecord {
+    uint32_t seq;
+    uint16_t op;
+    uint16_t check;                    // FNV-1a полей, свёрнутый до 16 бит
+    uint32_t a;
+    uint32_t b;
+};
+
+struct Journal {
+    uint8_t*       base;
+    JournalHeader* header;
+    std::atomic<bool> disabled;        // снимок поля не помещается в область
+    JournalStats   stats;
+#ifdef _WIN32
+    HANDLE         hFile;
+    HANDLE         hMap;
+#else
+    int            fd;
+#endif
+};
+
+static uint32_t Fnv1a(uint32_t h, const void* data, size_t n) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint16_t RecordCheck(const JournalRecord* r) {
+    uint32_t h = 2166136261u;
+    h = Fnv1a(h, &r->seq, sizeof(r->seq));
+    h = Fnv1a(h, &r->op, sizeof(r->op));
+    h = Fnv1a(h, &r->a, sizeof(r->a));
+    h = Fnv1a(h, &r->b, sizeof(r->b));
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+static uint8_t* Region(Journal* j, uint32_t i) {
+    return j->base + JOURNAL_HEADER_BYTES + (size_t)i * JOURNAL_REGION_BYTES;
+}
+
+static size_t SnapshotBytes(int gridSize) {
+    // слова клеток, выровненные до записи
+    size_t bytes = (size_t)GridWordsFor(gridSize) * sizeof(uint64_t);
+    return (bytes + sizeof(JournalRecord) - 1) / sizeof(JournalRecord) * sizeof(JournalRecord);
+}
+
+static void FlushRange(Journal* j, const uint8_t* from, size_t len) {
+    if (!len) return;
+    j->stats.flushes++;
+    // msync хочет начало страницы
+    uintptr_t start = (uintptr_t)from & ~(uintptr_t)(JOURNAL_PAGE - 1);
+    len += (uintptr_t)from - start;
+#ifdef _WIN32
+    // FlushViewOfFile только отдаёт страницы системе; до диска их
+    // доводит FlushFileBuffers — иначе журнал переживёт падение процесса,
+    // но не выключение питания
+    FlushViewOfFile((const void*)start, len);
+    FlushFileBuffers(j->hFile);
+#else
+    msync((void*)start, len, MS_SYNC);
+#endif
+}
+
+// Запись в область без сдвига used — его двигает вызывающий
+static void PutRecord(uint8_t* at, uint32_t seq, int op, uint32_t a, uint32_t b) {
+    JournalRecord* r = (JournalRecord*)at;
+    r->seq = seq;
+    r->op = (uint16_t)op;
+    r->a = a;
+    r->b = b;
+    // контроль пишется последним: оборванная запись его не сойдётся
+    r->check = RecordCheck(r);
+}
+
+// ——————————————————————————————— Запись ——————————————————————————————————————
+
+void JournalAppend(Journal* j, SharedMapping* m, int op, uint32_t a, uint32_t b) {
+    if (!j || j->disabled) return;
+    JournalHeader* h = j->header;
+    // смена pending на active (JournalCommit) область записей не меняет
+    uint32_t tail = StateTail(h->state.load(std::memory_order_acquire));
+    uint32_t used = h->used[tail].load(std::memory_order_relaxed);
+    if (used + sizeof(JournalRecord) > h->regionBytes) {
+        // область кончилась: снимок уже включает эту запись
+        JournalCheckpoint(j, m);
+        return;
+    }
+    PutRecord(Region(j, tail) + used, h->nextSeq++, op, a, b);
+    h->used[tail].store(used + (uint32_t)sizeof(JournalRecord), std::memory_order_release);
+    j->stats.appended++;
+}
+
+// Эпоха a новее b (по модулю 2^27)
+static bool EpochAfter(uint32_t a, uint32_t b) {
+    uint32_t d = (a - b) & 0x07FFFFFFu;
+    return d && d < 0x04000000u;
+}
+
+// Снимок пишется в область, которую не трогает никто: не живую, не
+// прежнюю pending (её, может быть, прямо сейчас делает живой JournalCommit)
+// и не ту, что может оказаться живой в заголовке на диске (durable) — с
+// четырьмя областями такая есть всегда. На диск здесь ничего не
+// сбрасывается: это сделает следующий JournalCommit уже без записи поля,
+// а до него при сбое восстановится прежняя живая область. Состояние
+// меняется одним CAS в самом конце, так что JournalCommit видит либо
+// старую контрольную точку, либо новую целиком.
+void JournalCheckpoint(Journal* j, SharedMapping* m) {
+    if (!j || j->disabled) return;
+    JournalHeader* h = j->header;
+    SharedCells* c = m->cells;
+    SharedData* d = m->data;
+    size_t snap = SnapshotBytes(c->gridSize);
+    size_t need = sizeof(JournalRecord) + snap + 2 * sizeof(JournalRecord);
+    if (need > h->regionBytes) {
+        // такое поле журнал не держит; пишем дальше только в память
+        j->disabled = true;
+        return;
+    }
+
+    Clock::time_point t0 = Clock::now();
+    uint64_t s = h->state.load(std::memory_order_acquire);
+    uint32_t active = StateActive(s), pending = StatePending(s);
+    uint32_t onDisk = (uint32_t)h->durable.load(std::memory_order_acquire) & 3;
+    uint32_t next = 0;
+    while (next == active || next + 1 == pending || next == onDisk) next++;
+
+    uint8_t* r = Region(j, next);
+    size_t words = (size_t)c->words * sizeof(uint64_t);
+    memcpy(r + sizeof(JournalRecord), SharedCellWords(c), words);
+    memset(r + sizeof(JournalRecord) + words, 0, snap - words);
+    uint32_t sum = Fnv1a(2166136261u, r + sizeof(JournalRecord), snap);
+
+    uint32_t seq = h->nextSeq;
+    size_t used = 0;
+    PutRecord(r, seq++, JR_SNAPSHOT, (uint32_t)c->gridSize, sum);
+    used += sizeof(JournalRecord) + snap;
+    PutRecord(r + used, seq++, JR_COLORS, d->backgroundColor, d->gridColor);
+    used += sizeof(JournalRecord);
+    PutRecord(r + used, seq++, JR_WINLENGTH, (uint32_t)d->winLength, 0);
+    used += sizeof(JournalRecord);
+    // хвост прошлого использования области отрезаем пустой записью
+    if (used + sizeof(JournalRecord) <= h->regionBytes)
+        memset(r + used, 0, sizeof(JournalRecord));
+
+    h->nextSeq = seq;
+    h->used[next].store((uint32_t)used, std::memory_order_release);
+    // живой за это время могла стать прежняя pending — её мы не трогали
+    while (!h->state.compare_exchange_weak(s, StatePack(StateEpoch(s) + 1, StateActive(s), next + 1, 0),
+        std::memory_order_acq_rel)) {}
+    j->stats.checkpoints++;
+    uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+    j->stats.checkpointUsLast = us;
+    if (us > j->stats.checkpointUsMax) j->stats.checkpointUsMax = us;
+}
+
+// Сбрасывает заголовок, где живая область active, и отмечает это в durable
+// (CAS-max по эпохе: опоздавший сброс старой смены не откатит новую)
+static void HeaderDurable(Journal* j, uint32_t epoch, uint32_t active) {
+    JournalHeader* h = j->header;
+    FlushRange(j, j->base, sizeof(JournalHeader));
+    uint64_t d = h->durable.load(std::memory_order_acquire);
+    uint64_t now = (uint64_t)epoch << 32 | active;
+    while (!EpochAfter((uint32_t)(d >> 32), epoch)
+        && !h->durable.compare_exchange_weak(d, now, std::memory_order_acq_rel)) {}
+}
+
+// Без блокировки. Живая область сбрасывается от flushed до used, потом
+// flushed сдвигается CAS-ом в той же эпохе: контрольная точка между
+// чтением и публикацией меняет эпоху, и CAS не пройдёт.
+// Если есть pending — сбрасывается вся новая область, она становится
+// живой, и только после этого на диск идёт заголовок (а durable — на неё).
+// Восстановление идёт по номерам записей, поэтому заголовок без смены
+// живой области сбрасывать не нужно.
+void JournalCommit(Journal* j) {
+    if (!j || j->disabled) return;
+    JournalHeader* h = j->header;
+    uint64_t s = h->state.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t used = h->used[StateTail(s)].load(std::memory_order_acquire);
+        uint32_t epoch = StateEpoch(s), pending = StatePending(s);
+        if (pending) {
+            uint32_t next = pending - 1;
+            // прошлая смена ещё не на диске (её JournalCommit сбрасывает
+            // заголовок): доводим её сами — на диске может быть только
+            // durable или живая область, остальные контрольная точка занимает
+            if (((uint32_t)h->durable.load(std::memory_order_acquire) & 3) != StateActive(s))
+                HeaderDurable(j, epoch, StateActive(s));
+            FlushRange(j, Region(j, next), used);
+            if (!h->state.compare_exchange_strong(s, StatePack(epoch, next, 0, used), std::memory_order_acq_rel))
+                continue;
+            HeaderDurable(j, epoch, next);
+            return;
+        }
+        uint32_t flushed = StateFlushed(s);
+        if (flushed >= used) return;
+        FlushRange(j, Region(j, StateActive(s)) + flushed, used - flushed);
+        // CAS-max: другой JournalCommit мог сдвинуть дальше
+        while (StateEpoch(s) == epoch && !StatePending(s) && StateFlushed(s) < used
+            && !h->state.compare_exchange_weak(s, StatePack(epoch, StateActive(s), 0, used),
+                std::memory_order_acq_rel)) {}
+        if (StateEpoch(s) == epoch) return;
+        // контрольная точка посередине: её область ещё не сброшена
+    }
+}
+
+// ——————————————————————————————— Фоновый сброс ——————————————————————————————————
+
+struct JournalFlusher {
+    Journal*                journal;
+    std::thread             thread;
+    std::mutex              lock;
+    std::condition_variable wake;
+    uint64_t                kicked;            // под lock
+    bool                    stop;              // под lock
+    std::atomic<uint64_t>   done;
+};
+
+// Будильники, пришедшие во время сброса, копятся в kicked: следующий
+// проход сбросит всё разом, сколько бы кадров ни прошло
+static void FlusherMain(JournalFlusher* f) {
+    std::unique_lock<std::mutex> g(f->lock);
+    for (;;) {
+        f->wake.wait(g, [f] { return f->kicked != f->done.load(std::memory_order_relaxed) || f->stop; });
+        uint64_t upTo = f->kicked;
+        bool stop = f->stop;
+        g.unlock();
+        JournalCommit(f->journal);
+        f->done.store(upTo, std::memory_order_release);
+        g.lock();
+        if (stop) break;
+    }
+}
+
+JournalFlusher* JournalFlusherStart(Journal* j) {
+    if (!j) return nullptr;
+    JournalFlusher* f = new JournalFlusher();
+    f->journal = j;
+    f->kicked = 0;
+    f->stop = false;
+    f->done.store(0, std::memory_order_relaxed);
+    f->thread = std::thread(FlusherMain, f);
+    return f;
+}
+
+uint64_t JournalFlusherKick(JournalFlusher* f) {
+    if (!f) return 0;
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> g(f->lock);
+        ticket = ++f->kicked;
+    }
+    f->wake.notify_one();
+    return ticket;
+}
+
+uint64_t JournalFlusherDone(JournalFlusher* f) {
+    return f ? f->done.load(std::memory_order_acquire) : 0;
+}
+
+void JournalFlusherStop(JournalFlusher* f) {
+    if (!f) return;
+    {
+        std::lock_guard<std::mutex> g(f->lock);
+        f->stop = true;
+    }
+    f->wake.notify_one();
+    f->thread.join();
+    delete f;
+}
+
+// ——————————————————————————————— Восстановление ——————————————————————————————————
+
+static bool RecordValid(const JournalRecord* r, uint32_t seq) {
+    return r->seq == seq && r->op >= JR_CELL && r->op <= JR_WINNER && r->check == RecordCheck(r);
+}
+
+bool JournalReplay(Journal* j, SharedMapping* m) {
+    if (!j || j->disabled) return false;
+    JournalHeader* h = j->header;
+    uint64_t st = h->state.load(std::memory_order_acquire);
+    // pending не сброшена: при сбое её как будто и не было
+    uint8_t* r = Region(j, StateActive(st));
+    const JournalRecord* first = (const JournalRecord*)r;
+    if (first->op != JR_SNAPSHOT || first->check != RecordCheck(first)) return false;
+
+    int gridSize = (int)first->a;
+    if (gridSize < 1 || gridSize > GRID_MAX_SIZE) return false;
+    size_t snap = SnapshotBytes(gridSize);
+    if (sizeof(JournalRecord) + snap > h->regionBytes) return false;
+    if (Fnv1a(2166136261u, r + sizeof(JournalRecord), snap) != first->b) return false;
+    SharedLoadCells(m, gridSize, (const uint64_t*)(r + sizeof(JournalRecord)));
+
+    // дальше — записи подряд по номерам; первая несошедшаяся — конец журнала
+    uint32_t seq = first->seq + 1;
+    size_t off = sizeof(JournalRecord) + snap;
+    for (; off + sizeof(JournalRecord) <= h->regionBytes; off += sizeof(JournalRecord), seq++) {
+        const JournalRecord* e = (const JournalRecord*)(r + off);
+        if (!RecordValid(e, seq) || e->op == JR_SNAPSHOT) break;
+        switch (e->op) {
+        case JR_CELL:       SharedWriteCell(m, (int)e->a, (int)e->b); break;
+        case JR_BACKGROUND: SharedWriteBackground(m, e->a); break;
+        case JR_GRIDCOLOR:  SharedWriteGridColor(m, e->a); break;
+        case JR_COLORS:     SharedWriteColors(m, e->a, e->b); break;
+        case JR_RESET:      SharedReset(m, e->a, e->b); break;
+        case JR_RESIZE:     SharedResize(m, (int)e->a); break;
+        case JR_NEWGAME:    SharedNewGame(m); break;
+        case JR_WINLENGTH:  SharedSetWinLength(m, (int)e->a); break;
+        case JR_TRAVEL:     SharedRestoreCell(m, (int)e->a, (int)e->b); break;
+        case JR_WINNER:     SharedRestoreWinner(m, (int)e->a, (int)(e->b & 0x0FFFFFFF), (int)(e->b >> 28)); break;
+        }
+        j->stats.replayed++;
+    }
+    // оборванный хвост (процесс умер посреди записи) отбрасываем
+    uint32_t epoch = StateEpoch(st) + 1;
+    h->used[StateActive(st)].store((uint32_t)off);
+    h->nextSeq = seq;
+    h->state.store(StatePack(epoch, StateActive(st), 0, (uint32_t)off));
+    h->durable.store((uint64_t)(epoch & 0x07FFFFFFu) << 32 | StateActive(st));
+    return true;
+}
+
+const JournalStats* JournalGetStats(const Journal* j) {
+    return &j->stats;
+}
+
+// ——————————————————————————————— Файл ——————————————————————————————————————
+
+// flushed не проверяется: восстановление всё равно идёт по записям
+static bool HeaderValid(const JournalHeader* h) {
+    if (h->magic != JOURNAL_MAGIC || h->version != JOURNAL_VERSION
+        || h->regionBytes != JOURNAL_REGION_BYTES || h->regions != JOURNAL_REGIONS) return false;
+    for (uint32_t i = 0; i < JOURNAL_REGIONS; i++)
+        if (h->used[i].load() > h->regionBytes) return false;
+    return StatePending(h->state.load()) <= JOURNAL_REGIONS;
+}
+
+static void HeaderInit(Journal* j) {
+    JournalHeader* h = j->header;
+    memset((void*)h, 0, sizeof(*h));
+    // пустые области: первый снимок запишет SharedAttachJournal
+    for (uint32_t i = 0; i < JOURNAL_REGIONS; i++)
+        memset(Region(j, i), 0, sizeof(JournalRecord));
+    h->version = JOURNAL_VERSION;
+    h->regionBytes = JOURNAL_REGION_BYTES;
+    h->regions = JOURNAL_REGIONS;
+    h->nextSeq = 1;
+    h->magic = JOURNAL_MAGIC;
+    FlushRange(j, j->base, JOURNAL_HEADER_BYTES);
+}
+
+#ifdef _WIN32
+
+Journal* JournalOpen(const char* path, bool create) {
+    HANDLE f = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return nullptr;
+    LARGE_INTEGER sz; GetFileSizeEx(f, &sz);
+    if ((size_t)sz.QuadPart < JOURNAL_FILE_BYTES && !create) { CloseHandle(f); return nullptr; }
+    // размер задаёт сама проекция: файл растёт до JOURNAL_FILE_BYTES
+    HANDLE m = CreateFileMapping(f, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)JOURNAL_FILE_BYTES >> 32), (DWORD)JOURNAL_FILE_BYTES, nullptr);
+    void* p = m ? MapViewOfFile(m, FILE_MAP_ALL_ACCESS, 0, 0, JOURNAL_FILE_BYTES) : nullptr;
+    if (!p) {
+        if (m) CloseHandle(m);
+        CloseHandle(f);
+        return nullptr;
+    }
+    Journal* j = new Journal();
+    j->base = (uint8_t*)p;
+    j->header = (JournalHeader*)p;
+    j->hFile = f;
+    j->hMap = m;
+    if (!HeaderValid(j->header)) {
+        if (!create) { JournalClose(j); return nullptr; }
+        HeaderInit(j);
+    }
+    return j;
+}
+
+void JournalClose(Journal* j) {
+    if (!j) return;
+    UnmapViewOfFile(j->base);
+    CloseHandle(j->hMap);
+    CloseHandle(j->hFile);
+    delete j;
+}
+
+#else
+
+Journal* JournalOpen(const char* path, bool create) {
+    int fd = open(path, O_RDWR | (create ? O_CREAT : 0), 0644);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return nullptr; }
+    if ((size_t)st.st_size < JOURNAL_FILE_BYTES) {
+        if (!create || ftruncate(fd, (off_t)JOURNAL_FILE_BYTES) != 0) { close(fd); return nullptr; }
+    }
+    void* p = mmap(nullptr, JOURNAL_FILE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) { close(fd); return nullptr; }
+    Journal* j = new Journal();
+    j->base = (uint8_t*)p;
+    j->header = (JournalHeader*)p;
+    j->fd = fd;
+    if (!HeaderValid(j->header)) {
+        if (!create) { JournalClose(j); return nullptr; }
+        HeaderInit(j);
+    }
+    return j;
+}
+
+void JournalClose(Journal* j) {
+    if (!j) return;
+    munmap(j->base, JOURNAL_FILE_BYTES);
+    close(j->fd);
+    delete j;
+}
+
+#endif
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+// Журнал изменений поля в data.bin — чтобы поле пережило выход всех процессов.
+//
+// Файл отображается в память всеми экземплярами. Записи добавляются внутри
+// той же seqlock-записи, что меняет поле (SharedGrid.cpp), поэтому процессы
+// пишут в журнал строго по очереди и без отдельной блокировки.
+//
+// Раскладка: заголовок + четыре области. Живая область начинается со снимка
+// поля, за ним идут записи с номерами подряд. Когда область кончается,
+// снимок текущего поля пишется в свободную область (не живую, не ещё не
+// сброшенную прежнюю и не ту, что может быть живой в заголовке на диске) —
+// только в память, под записью поля. Записи дальше идут туда же, а на диск её сбрасывает и делает живой
+// следующий JournalCommit, уже без записи поля.
+//
+// На диск записи сбрасывает JournalCommit, а не каждая запись: пачка ходов
+// за кадр стоит одного сброса (group commit). Что уже сброшено, хранится в
+// одном слове с номером контрольной точки и меняется только CAS-ом, так что
+// JournalCommit без блокировки не спорит с контрольной точкой. Окно сам
+// JournalCommit не зовёт: раз в кадр оно будит JournalFlusher, и ждёт
+// диска его поток. Если диск медленнее кадров, сброс покрывает несколько.
+//
+// На Windows сброс — FlushViewOfFile и FlushFileBuffers: сброшенное
+// переживает и выключение питания, а не только падение процесса.
+
+#include <stdint.h>
+
+struct SharedMapping;
+struct Journal;
+struct JournalFlusher;
+
+enum JournalOp {
+    JR_CELL = 1,                       // a — клетка, b — значение
+    JR_BACKGROUND,                     // a — цвет
+    JR_GRIDCOLOR,                      // a — цвет
+    JR_COLORS,                         // a — фон, b — сетка
+    JR_RESET,                          // a — фон, b — сетка
+    JR_RESIZE,                         // a — размер
+    JR_NEWGAME,
+    JR_WINLENGTH,                      // a — K
+    JR_SNAPSHOT,                       // a — размер, b — контроль; дальше слова клеток
+    JR_TRAVEL,                         // a — клетка, b — значение (отмена/повтор, без правил)
+    JR_WINNER,                         // a — победитель, b — клетка | направление << 28
+};
+
+struct JournalStats {
+    uint64_t appended;
+    uint64_t checkpoints;
+    uint64_t flushes;
+    uint64_t replayed;
+    uint32_t checkpointUsLast;         // снимок поля в область — под записью, в потоке пишущего
+    uint32_t checkpointUsMax;
+};
+
+// create — разрешено создать или переразметить файл (первый экземпляр).
+// nullptr — журнала не будет, поле живёт только в памяти.
+Journal* JournalOpen(const char* path, bool create);
+void     JournalClose(Journal* j);
+
+// Восстанавливает поле m из журнала. Вызывать до SharedAttachJournal,
+// чтобы повтор не попадал в журнал заново. false — восстанавливать нечего.
+bool     JournalReplay(Journal* j, SharedMapping* m);
+
+// Сбросить на диск всё, что добавлено после прошлого сброса
+void     JournalCommit(Journal* j);
+
+// Поток, который зовёт JournalCommit по JournalFlusherKick. Kick не ждёт
+// диска и возвращает номер: когда JournalFlusherDone дорос до него, всё
+// добавленное до Kick сброшено. Stop делает последний сброс и ждёт поток;
+// журнал закрывается после него. nullptr (нет журнала) — все вызовы пустые.
+JournalFlusher* JournalFlusherStart(Journal* j);
+uint64_t        JournalFlusherKick(JournalFlusher* f);
+uint64_t        JournalFlusherDone(JournalFlusher* f);
+void            JournalFlusherStop(JournalFlusher* f);
+
+const JournalStats* JournalGetStats(const Journal* j);
+
+// ——— Для SharedGrid.cpp: вызываются только под записью поля ———
+void     JournalAppend(Journal* j, SharedMapping* m, int op, uint32_t a, uint32_t b);
+void     JournalCheckpoint(Journal* j, SharedMapping* m);
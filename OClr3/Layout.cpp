@@ -0,0 +1,285 @@
+﻿#include "Layout.h"
+#include "Platform.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define LAYOUT_MAGIC  0x54554F4Cu      // "LOUT"
+#define LAYOUT_WORDS  (LAYOUT_TILES / 64)
+
+enum { LAYOUT_NEW = 0, LAYOUT_INIT, LAYOUT_READY };
+
+struct LayoutHeader {
+    std::atomic<uint32_t> state;       // геометрию пишет тот, кто перевёл NEW -> INIT
+    uint32_t              magic;
+    LayoutRect            work;
+    int                   tileW, tileH;
+    int                   cols, rows;  // плиток на экране
+    uint32_t              perLayer;
+    uint32_t              total;       // perLayer * число слоёв
+    std::atomic<uint64_t> used[LAYOUT_WORDS];
+    std::atomic<uint32_t> owner[LAYOUT_TILES];   // pid; 0 — плитка только что взята
+};
+
+struct Layout {
+    LayoutHeader* lh;
+    uint64_t      claims;
+    uint64_t      retries;
+    uint64_t      reclaimed;
+#ifdef _WIN32
+    HANDLE        hMap;
+#endif
+};
+
+static inline int LowestBit(uint64_t x) {
+    int n = 0;
+    while (!(x & 1)) { x >>= 1; n++; }
+    return n;
+}
+
+// ——————————————————————————————— Сегмент ——————————————————————————————————————
+
+static void InitGeometry(LayoutHeader* lh, const LayoutRect* work, int ww, int wh) {
+    lh->work = *work;
+    if (lh->work.width < 1) lh->work.width = 1;
+    if (lh->work.height < 1) lh->work.height = 1;
+    lh->tileW = (ww > 0 ? ww : 1) + LAYOUT_GAP;
+    lh->tileH = (wh > 0 ? wh : 1) + LAYOUT_GAP;
+    // у последнего столбца и строки зазор не нужен
+    lh->cols = (lh->work.width + LAYOUT_GAP) / lh->tileW;
+    lh->rows = (lh->work.height + LAYOUT_GAP) / lh->tileH;
+    if (lh->cols < 1) lh->cols = 1;
+    if (lh->rows < 1) lh->rows = 1;
+    uint32_t per = (uint32_t)lh->cols * (uint32_t)lh->rows;
+    if (per > LAYOUT_TILES) {
+        per = LAYOUT_TILES;
+        lh->rows = LAYOUT_TILES / lh->cols;
+        per = (uint32_t)lh->cols * (uint32_t)lh->rows;
+    }
+    lh->perLayer = per;
+    lh->total = LAYOUT_TILES / per * per;
+    lh->magic = LAYOUT_MAGIC;
+}
+
+Layout* LayoutOpen(const char* name, const LayoutRect* work, int windowWidth, int windowHeight) {
+    size_t bytes = sizeof(LayoutHeader);
+    void* p = nullptr;
+    Layout* l = new Layout();
+
+    // Сегмент общий для всех экземпляров и досок: кто первый, тот создаёт
+#ifdef _WIN32
+    l->hMap = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)bytes, name);
+    if (l->hMap) {
+        p = MapViewOfFile(l->hMap, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+        if (!p) CloseHandle(l->hMap);
+    }
+#else
+    // после выхода всех сегмент остаётся: плитки мёртвых отберут при нехватке
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd >= 0) {
+        struct stat st;
+        bool sized = fstat(fd, &st) == 0
+            && ((size_t)st.st_size >= bytes || ftruncate(fd, (off_t)bytes) == 0);
+        if (sized) {
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) p = nullptr;
+        }
+        close(fd);
+    }
+#endif
+    if (!p) {
+        delete l;
+        return nullptr;
+    }
+    l->lh = (LayoutHeader*)p;
+
+    uint32_t st = LAYOUT_NEW;
+    if (l->lh->state.compare_exchange_strong(st, LAYOUT_INIT, std::memory_order_acquire)) {
+        InitGeometry(l->lh, work, windowWidth, windowHeight);
+        l->lh->state.store(LAYOUT_READY, std::memory_order_release);
+    }
+    else {
+        // геометрию пишет другой экземпляр — это микросекунды; не дождались — без раскладки
+        for (int i = 0; i < 1000 && st != LAYOUT_READY; i++) {
+            SleepMs(1);
+            st = l->lh->state.load(std::memory_order_acquire);
+        }
+    }
+    if (l->lh->state.load(std::memory_order_acquire) != LAYOUT_READY || l->lh->magic != LAYOUT_MAGIC) {
+        LayoutClose(l);
+        return nullptr;
+    }
+    return l;
+}
+
+void LayoutClose(Layout* l) {
+    if (!l) return;
+#ifdef _WIN32
+    UnmapViewOfFile(l->lh);
+    CloseHandle(l->hMap);
+#else
+    munmap(l->lh, sizeof(LayoutHeader));
+#endif
+    delete l;
+}
+
+// ——————————————————————————————— Плитки ——————————————————————————————————————
+
+static inline uint64_t TileBit(int t) {
+    return 1ull << (t % 64);
+}
+
+static inline bool TileFree(LayoutHeader* lh, int t) {
+    return !(lh->used[t / 64].load(std::memory_order_relaxed) & TileBit(t));
+}
+
+static inline int TileAt(LayoutHeader* lh, int anchor, int dx, int dy) {
+    return anchor + dy * lh->cols + dx;
+}
+
+static void ReleaseTiles(LayoutHeader* lh, int anchor, int tx, int ty) {
+    for (int dy = 0; dy < ty; dy++) {
+        for (int dx = 0; dx < tx; dx++) {
+            int t = TileAt(lh, anchor, dx, dy);
+            lh->owner[t].store(0, std::memory_order_relaxed);
+            lh->used[t / 64].fetch_and(~TileBit(t), std::memory_order_release);
+        }
+    }
+}
+
+// Прямоугольник tx x ty от плитки anchor целиком или ничего.
+// Каждая плитка берётся fetch_or-ом: бит уже стоял — кто-то успел раньше,
+// взятое откатывается.
+static bool TakeTiles(Layout* l, int anchor, int tx, int ty, uint32_t self) {
+    LayoutHeader* lh = l->lh;
+    for (int dy = 0; dy < ty; dy++) {
+        for (int dx = 0; dx < tx; dx++) {
+            int t = TileAt(lh, anchor, dx, dy);
+            uint64_t bit = TileBit(t);
+            if (lh->used[t / 64].fetch_or(bit, std::memory_order_acquire) & bit) {
+                l->retries++;
+                // откат взятого до этой плитки
+                for (int k = 0; k < dy * tx + dx; k++) {
+                    int u = TileAt(lh, anchor, k % tx, k / tx);
+                    lh->owner[u].store(0, std::memory_order_relaxed);
+                    lh->used[u / 64].fetch_and(~TileBit(u), std::memory_order_release);
+                }
+                return false;
+            }
+            lh->owner[t].store(self, std::memory_order_release);
+        }
+    }
+    return true;
+}
+
+// Плитки процессов, которых больше нет. Занятая плитка с pid 0 — её как
+// раз сейчас берут, не трогаем.
+static uint32_t Sweep(Layout* l) {
+    LayoutHeader* lh = l->lh;
+    uint32_t freed = 0, lastDead = 0;
+    for (int w = 0; w < LAYOUT_WORDS; w++) {
+        uint64_t bits = lh->used[w].load(std::memory_order_acquire);
+        while (bits) {
+            int t = w * 64 + LowestBit(bits);
+            bits &= bits - 1;
+            uint32_t pid = lh->owner[t].load(std::memory_order_acquire);
+            // у окна крупнее плитки pid один на все его плитки
+            if (!pid || (pid != lastDead && ProcessAlive(pid))) continue;
+            lastDead = pid;
+            if (!lh->owner[t].compare_exchange_strong(pid, 0, std::memory_order_acq_rel)) continue;
+            lh->used[w].fetch_and(~TileBit(t), std::memory_order_release);
+            freed++;
+        }
+    }
+    l->reclaimed += freed;
+    return freed;
+}
+
+// Первая свободная плитка, от которой влезает tx x ty, — по словам
+// карты, а не по окнам: при сотнях экземпляров это несколько слов
+static int FindAndTake(Layout* l, int tx, int ty, uint32_t self) {
+    LayoutHeader* lh = l->lh;
+    for (int w = 0; w < LAYOUT_WORDS; w++) {
+        uint64_t freeBits = ~lh->used[w].load(std::memory_order_acquire);
+        while (freeBits) {
+            int t = w * 64 + LowestBit(freeBits);
+            freeBits &= freeBits - 1;
+            if ((uint32_t)t >= lh->total) return -1;
+            int cell = (int)((uint32_t)t % lh->perLayer);
+            int col = cell % lh->cols, row = cell / lh->cols;
+            if (col + tx > lh->cols || row + ty > lh->rows) continue;
+            bool fits = true;
+            for (int k = 1; k < tx * ty && fits; k++) fits = TileFree(lh, TileAt(lh, t, k % tx, k / tx));
+            if (fits && TakeTiles(l, t, tx, ty, self)) return t;
+        }
+    }
+    return -1;
+}
+
+LayoutPlace LayoutClaim(Layout* l, int width, int height) {
+    LayoutPlace p = { -1, 0, 0, { 0, 0, width, height } };
+    if (!l) return p;
+    LayoutHeader* lh = l->lh;
+    int tx = (width + LAYOUT_GAP + lh->tileW - 1) / lh->tileW;
+    int ty = (height + LAYOUT_GAP + lh->tileH - 1) / lh->tileH;
+    if (tx < 1) tx = 1;
+    if (ty < 1) ty = 1;
+    if (tx > lh->cols) tx = lh->cols;
+    if (ty > lh->rows) ty = lh->rows;
+
+    uint32_t self = SelfPid();
+    int t = FindAndTake(l, tx, ty, self);
+    if (t < 0 && Sweep(l)) t = FindAndTake(l, tx, ty, self);
+    if (t < 0) return p;
+    l->claims++;
+
+    int layer = (int)((uint32_t)t / lh->perLayer), cell = (int)((uint32_t)t % lh->perLayer);
+    const LayoutRect& wa = lh->work;
+    // Слой сдвигается целиком и только в пределах того, что сетка плиток
+    // оставила свободным у края: прижимать к краю отдельные окна нельзя —
+    // прижатые налезают на соседей того же слоя
+    int slackX = wa.width - (lh->cols * lh->tileW - LAYOUT_GAP);
+    int slackY = wa.height - (lh->rows * lh->tileH - LAYOUT_GAP);
+    int offX = slackX > 0 ? layer * LAYOUT_CASCADE % (slackX + 1) : 0;
+    int offY = slackY > 0 ? layer * LAYOUT_CASCADE % (slackY + 1) : 0;
+    int x = wa.x + cell % lh->cols * lh->tileW + offX;
+    int y = wa.y + cell / lh->cols * lh->tileH + offY;
+    // окно шире рабочей области — единственное, что ещё может вылезти
+    if (x + width > wa.x + wa.width) x = wa.x + wa.width - width;
+    if (y + height > wa.y + wa.height) y = wa.y + wa.height - height;
+    if (x < wa.x) x = wa.x;
+    if (y < wa.y) y = wa.y;
+    p.tile = t;
+    p.tilesX = tx;
+    p.tilesY = ty;
+    p.rect.x = x;
+    p.rect.y = y;
+    return p;
+}
+
+void LayoutRelease(Layout* l, const LayoutPlace* p) {
+    if (!l || !p || p->tile < 0) return;
+    ReleaseTiles(l->lh, p->tile, p->tilesX, p->tilesY);
+}
+
+LayoutStats LayoutGetStats(Layout* l) {
+    LayoutStats s = {};
+    if (!l) return s;
+    for (int w = 0; w < LAYOUT_WORDS; w++) {
+        uint64_t x = l->lh->used[w].load(std::memory_order_relaxed);
+        for (; x; x &= x - 1) s.used++;
+    }
+    s.perLayer = l->lh->perLayer;
+    s.claims = l->claims;
+    s.retries = l->retries;
+    s.reclaimed = l->reclaimed;
+    return s;
+}
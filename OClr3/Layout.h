@@ -0,0 +1,60 @@
+﻿#pragma once
+
+// Где поставить окно нового экземпляра, не перебирая чужие окна.
+//
+// Рабочая область экрана делится на плитки размером с окно первого
+// экземпляра (плюс зазор); плитки идут строками слева направо, сверху
+// вниз. Когда экран заполнен, следующий слой плиток сдвинут на
+// LAYOUT_CASCADE пикселей — окна ложатся стопкой, но не уходят за край:
+// слой сдвигается целиком в пределах остатка рабочей области за сеткой.
+//
+// Занятость плиток — битовая карта в разделяемом сегменте: экземпляр
+// ищет свободный бит в нескольких словах и берёт его CAS-ом, окно крупнее
+// плитки забирает прямоугольник плиток целиком или откатывается. Кто
+// владеет плиткой — pid рядом; плитки умерших процессов отбираются,
+// когда свободных не осталось. Стоимость размещения не зависит от того,
+// сколько окон уже открыто.
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#define LAYOUT_NAME "Local\\GridLayout"
+#else
+#define LAYOUT_NAME "/GridLayout"
+#endif
+
+#define LAYOUT_TILES    4096           // плиток на все слои, кратно 64
+#define LAYOUT_GAP      10             // между соседними окнами
+#define LAYOUT_CASCADE  24             // сдвиг очередного слоя
+
+struct Layout;
+
+struct LayoutRect {
+    int x, y, width, height;
+};
+
+// Место, занятое экземпляром: первая плитка и размер в плитках
+struct LayoutPlace {
+    int        tile;                   // -1 — места не нашлось
+    int        tilesX, tilesY;
+    LayoutRect rect;                   // левый верхний угол окна; размер — как просили
+};
+
+struct LayoutStats {
+    uint32_t used;                     // занятых плиток
+    uint32_t perLayer;                 // плиток на экране
+    uint64_t claims;                   // размещений этим процессом
+    uint64_t retries;                  // проигранных CAS
+    uint64_t reclaimed;                // плиток умерших процессов
+};
+
+// Открывает или создаёт общий сегмент name. Геометрию плиток задаёт тот,
+// кто создал сегмент: рабочая область work и размер его окна.
+Layout*     LayoutOpen(const char* name, const LayoutRect* work, int windowWidth, int windowHeight);
+void        LayoutClose(Layout* l);
+
+// Занять место под окно width x height. tile = -1 — все слои заняты живыми.
+LayoutPlace LayoutClaim(Layout* l, int width, int height);
+void        LayoutRelease(Layout* l, const LayoutPlace* p);
+
+LayoutStats LayoutGetStats(Layout* l);
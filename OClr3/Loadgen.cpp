@@ -0,0 +1,424 @@
+﻿#include "Loadgen.h"
+#include "Arena.h"
+#include "History.h"
+#include "Journal.h"
+#include "Metrics.h"
+#include "MoveQueue.h"
+#include "Notify.h"
+#include "UpdateScheduler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+enum LoadgenOp { OP_MOVE, OP_MOVE_RC, OP_BACKGROUND, OP_GRIDCOLOR, OP_NEWGAME, OP_WINLENGTH, OP_TRAVEL, OP_SLEEP };
+
+// Команда сценария; у хода a — клетка (или строка), b — столбец, c — игрок
+struct LoadgenCommand {
+    int op;
+    int a, b, c;
+};
+
+// xorshift64*: у каждого процесса свой поток чисел
+static inline uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static inline int Popcount64(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((x * 0x0101010101010101ull) >> 56);
+}
+
+void LoadgenDefaults(LoadgenOptions* o) {
+    memset(o, 0, sizeof(*o));
+    o->mode = LOADGEN_RANDOM;
+    o->repeat = 1;
+    o->colorPermille = 20;
+    o->gridSize = 3;
+    o->frameMs = DEFAULT_FRAME_INTERVAL;
+}
+
+// ——————————————————————————————— Сценарий ——————————————————————————————————————
+
+static int ParsePlayer(const char* w) {
+    if (!strcmp(w, "o") || !strcmp(w, "O")) return CELL_O;
+    if (!strcmp(w, "x") || !strcmp(w, "X")) return CELL_X;
+    return CELL_EMPTY;
+}
+
+// Одна строка сценария. false — строка непонятна.
+static bool ParseLine(char* line, std::vector<LoadgenCommand>* out) {
+    char* hash = strchr(line, '#');
+    if (hash) *hash = 0;
+    char word[16] = "";
+    int n[3] = { 0, 0, 0 }, got = 0, len = 0;
+    if (sscanf(line, "%15s%n", word, &len) != 1) return true;   // пустая
+    got = sscanf(line + len, "%d %d %d", &n[0], &n[1], &n[2]);
+    if (got < 0) got = 0;
+
+    LoadgenCommand c = { -1, n[0], n[1], n[2] };
+    if (int p = ParsePlayer(word)) {
+        if (got < 1 || n[0] < 0 || (got >= 2 && n[1] < 0)) return false;
+        c.op = got >= 2 ? OP_MOVE_RC : OP_MOVE;
+        c.c = p;
+    }
+    else if (!strcmp(word, "bg") || !strcmp(word, "grid")) {
+        if (got != 3) return false;
+        c.op = word[0] == 'b' ? OP_BACKGROUND : OP_GRIDCOLOR;
+        c.a = (int)RGB(n[0], n[1], n[2]);
+    }
+    else if (!strcmp(word, "new")) c.op = OP_NEWGAME;
+    else if (!strcmp(word, "k")) {
+        if (got != 1 || n[0] < 0) return false;
+        c.op = OP_WINLENGTH;
+    }
+    else if (!strcmp(word, "undo") || !strcmp(word, "redo")) {
+        int steps = got >= 1 ? n[0] : 1;
+        if (steps < 1) return false;
+        c.op = OP_TRAVEL;
+        c.a = word[0] == 'u' ? -steps : steps;
+    }
+    else if (!strcmp(word, "sleep")) {
+        if (got != 1 || n[0] < 0) return false;
+        c.op = OP_SLEEP;
+    }
+    else return false;
+    out->push_back(c);
+    return true;
+}
+
+static bool LoadScript(const char* path, std::vector<LoadgenCommand>* out, FILE* err) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(err, "cannot open script %s\n", path);
+        return false;
+    }
+    char line[256];
+    int lineNo = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        lineNo++;
+        if (out->size() >= LOADGEN_SCRIPT_MAX) {
+            fprintf(err, "%s: more than %u commands\n", path, LOADGEN_SCRIPT_MAX);
+            ok = false;
+        }
+        else if (!ParseLine(line, out)) {
+            fprintf(err, "%s:%d: cannot parse: %s", path, lineNo, line);
+            ok = false;
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+// ——————————————————————————————— Прогон ——————————————————————————————————————
+
+struct LoadgenState {
+    SharedMapping* m;
+    Metrics*       metrics;
+    LoadgenReport* r;
+    uint64_t       firstWriteNs;       // первая запись, о которой окна ещё не знают
+    uint64_t       lastFlushNs;
+    uint64_t       frameNs;
+    JournalFlusher* flusher;
+};
+
+static void MarkWritten(LoadgenState* s, uint64_t now) {
+    if (!s->firstWriteNs) s->firstWriteNs = now;
+}
+
+// Будим окна и сбрасываем журнал — как BroadcastUpdate у окна, не чаще кадра
+static void Flush(LoadgenState* s, uint64_t now, bool force) {
+    if (!s->firstWriteNs || (!force && now - s->lastFlushNs < s->frameNs)) return;
+    MetricsPublishWrite(s->metrics, s->firstWriteNs);
+    MetricsCount(s->metrics, METRIC_BROADCASTS);
+    NotifyAll(s->m, -1);
+    JournalFlusherKick(s->flusher);
+    s->firstWriteNs = 0;
+    s->lastFlushNs = now;
+    s->r->notifies++;
+}
+
+static void Move(LoadgenState* s, int cell, int player) {
+    LoadgenReport* r = s->r;
+    uint64_t t0 = MetricsNow();
+    int res = MoveSubmit(s->m, cell, player, nullptr);
+    uint64_t t1 = MetricsNow(), ns = t1 - t0;
+    r->moves++;
+    r->submitNsSum += ns;
+    if (ns > r->submitNsMax) r->submitNsMax = ns;
+    if (res == MOVE_ACCEPTED) {
+        r->accepted++;
+        MetricsRecord(s->metrics, METRIC_INPUT_TO_WRITE, ns);
+        MarkWritten(s, t1);
+    }
+    else if (res >= 0 && res <= MOVE_DROPPED) r->rejected[res]++;
+}
+
+// Выполняет команду; пауза возвращается в *sleepMs, а не спится здесь
+static void Execute(LoadgenState* s, const LoadgenCommand& c, uint32_t* sleepMs) {
+    SharedMapping* m = s->m;
+    LoadgenReport* r = s->r;
+    switch (c.op) {
+    case OP_MOVE:
+        Move(s, c.a, c.c);
+        break;
+    case OP_MOVE_RC: {
+        int sz = SharedGridSize(m);
+        // за краем поля — пусть откажет очередь, как и любой чужой ход
+        Move(s, c.b < sz ? c.a * sz + c.b : sz * sz, c.c);
+        break;
+    }
+    case OP_BACKGROUND:
+        SharedWriteBackground(m, (COLORREF)c.a);
+        r->colors++;
+        MarkWritten(s, MetricsNow());
+        break;
+    case OP_GRIDCOLOR:
+        SharedWriteGridColor(m, (COLORREF)c.a);
+        r->colors++;
+        MarkWritten(s, MetricsNow());
+        break;
+    case OP_NEWGAME:
+        SharedNewGame(m);
+        r->newGames++;
+        MarkWritten(s, MetricsNow());
+        break;
+    case OP_WINLENGTH:
+        SharedSetWinLength(m, c.a);
+        MarkWritten(s, MetricsNow());
+        break;
+    case OP_TRAVEL:
+        if (SharedTimeTravel(m, c.a)) {
+            r->travels++;
+            MarkWritten(s, MetricsNow());
+        }
+        break;
+    case OP_SLEEP:
+        *sleepMs = (uint32_t)c.a;
+        return;
+    }
+    r->ops++;
+}
+
+// Случайная команда: ход того, чья очередь, в случайную клетку; изредка
+// смена цвета. Доигранную или заполненную партию начинает заново.
+static LoadgenCommand RandomCommand(LoadgenState* s, const LoadgenOptions* o, uint64_t* rnd) {
+    LoadgenCommand c = { OP_MOVE, 0, 0, 0 };
+    uint64_t x = NextRandom(rnd);
+    if (x % 1000 < o->colorPermille) {
+        uint32_t rgb = (uint32_t)(x >> 32);
+        c.op = (x >> 16) & 1 ? OP_GRIDCOLOR : OP_BACKGROUND;
+        c.a = (int)RGB(rgb, rgb >> 8, rgb >> 16);
+        return c;
+    }
+    int sz = SharedGridSize(s->m);
+    uint64_t cells = (uint64_t)sz * sz;
+    // поля читаются без seqlock: ошибёмся — очередь откажет, только и всего
+    const SharedData* d = s->m->data;
+    if (d->winner != CELL_EMPTY || d->countO + d->countX >= cells) {
+        c.op = OP_NEWGAME;
+        return c;
+    }
+    c.a = (int)((x >> 16) % cells);
+    c.c = SharedSideToMove(s->m);
+    return c;
+}
+
+static void WaitUntil(uint64_t due) {
+    for (;;) {
+        uint64_t now = MetricsNow();
+        if (now >= due) return;
+        // последние пару миллисекунд — уступая ядро, дальше — спим
+        if (due - now > 2000000) std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - 1000000));
+        else std::this_thread::yield();
+    }
+}
+
+static void Drive(LoadgenState* s, const LoadgenOptions* o, const std::vector<LoadgenCommand>& script) {
+    LoadgenReport* r = s->r;
+    uint64_t rnd = o->seed ? o->seed : ((uint64_t)SelfPid() << 32 ^ MetricsNow());
+    if (!rnd) rnd = 1;
+    uint64_t start = MetricsNow(), paused = 0;
+    uint64_t stopAt = o->durationMs ? start + (uint64_t)o->durationMs * 1000000 : UINT64_MAX;
+    uint64_t limit = o->ops;
+    if (!limit && !o->durationMs && o->mode == LOADGEN_RANDOM) limit = LOADGEN_DEFAULT_OPS;
+    size_t pos = 0;
+    uint32_t pass = 0;
+
+    for (;;) {
+        if (limit && r->ops >= limit) break;
+        uint64_t now = MetricsNow();
+        if (now >= stopAt) break;
+
+        LoadgenCommand c;
+        if (o->mode == LOADGEN_REPLAY) {
+            if (pos == script.size()) {
+                pos = 0;
+                if (++pass == o->repeat || script.empty()) break;
+            }
+            c = script[pos++];
+        }
+        else c = RandomCommand(s, o, &rnd);
+
+        // частота считается без пауз сценария
+        if (o->rate && c.op != OP_SLEEP)
+            WaitUntil(start + paused + r->ops * 1000000000ull / o->rate);
+
+        uint32_t sleepMs = 0;
+        Execute(s, c, &sleepMs);
+        if (sleepMs) {
+            Flush(s, MetricsNow(), true);
+            uint64_t t0 = MetricsNow();
+            std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+            paused += MetricsNow() - t0;
+        }
+        Flush(s, MetricsNow(), false);
+    }
+    Flush(s, MetricsNow(), true);
+
+    uint64_t elapsed = MetricsNow() - start;
+    r->elapsedUs = elapsed / 1000;
+    uint64_t busy = elapsed - paused;
+    r->opsPerSec = busy ? r->ops * 1e9 / (double)busy : 0;
+}
+
+uint64_t LoadgenChecksum(const GridSnapshot* s) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    auto mix = [&h](uint64_t v) {
+        for (int i = 0; i < 8; i++, v >>= 8) {
+            h ^= v & 0xFF;
+            h *= 0x100000001B3ull;
+        }
+    };
+    mix((uint64_t)(uint32_t)s->gridSize);
+    mix(s->backgroundColor);
+    mix(s->gridColor);
+    mix((uint64_t)(uint32_t)s->winLength << 32 | (uint32_t)s->winner);
+    uint32_t words = GridWordsFor(s->gridSize);
+    for (uint32_t w = 0; w < words; w++) mix(s->cells[w]);
+    return h;
+}
+
+bool LoadgenRun(const LoadgenOptions* o, LoadgenReport* r, FILE* err) {
+    memset(r, 0, sizeof(*r));
+    std::vector<LoadgenCommand> script;
+    if (o->mode == LOADGEN_REPLAY && !LoadScript(o->script, &script, err)) return false;
+
+    SharedMapping m = {};
+    Arena* arena = nullptr;
+    bool first = false, opened;
+    if (o->boardId) {
+        int sz = o->gridSize > ARENA_MAX_GRID ? ARENA_MAX_GRID : o->gridSize;
+        arena = ArenaOpen(ARENA_NAME);
+        opened = arena && SharedOpenBoard(&m, arena, o->boardId, sz, &first);
+    }
+    else {
+        opened = SharedOpen(&m, SHARED_MEM_NAME, o->gridSize, &first);
+    }
+    if (!opened) {
+        fprintf(err, "cannot create/open shared memory\n");
+        ArenaClose(arena);
+        return false;
+    }
+
+    // Как у окна: первый поднимает поле из журнала, дальше все пишут в него
+    Journal* journal = o->journalFile ? JournalOpen(o->journalFile, first) : nullptr;
+    if (first) {
+        SharedReset(&m, RGB(0, 0, 255), RGB(255, 0, 0));
+        JournalReplay(journal, &m);
+    }
+    SharedAttachJournal(&m, journal, first);
+    History* history = HistoryOpen(m.name, first);
+    SharedAttachHistory(&m, history, first);
+    Metrics* metrics = MetricsOpen(m.name, first, true);
+    if (o->resize && o->gridSize != SharedGridSize(&m))
+        SharedResize(&m, o->gridSize);
+    if (o->winLength > 0)
+        SharedSetWinLength(&m, o->winLength);
+
+    LoadgenState s = {};
+    s.m = &m;
+    s.metrics = metrics;
+    s.r = r;
+    s.frameNs = (uint64_t)o->frameMs * 1000000;
+    s.flusher = JournalFlusherStart(journal);
+    Drive(&s, o, script);
+    JournalFlusherStop(s.flusher);
+
+    GridSnapshot snap = {};
+    SharedReadSnapshot(&m, &snap);
+    r->version = snap.version;
+    r->gridSize = snap.gridSize;
+    r->winner = snap.winner;
+    uint32_t words = GridWordsFor(snap.gridSize);
+    for (uint32_t w = 0; w < words; w++)
+        r->pieces += Popcount64((snap.cells[w] | snap.cells[w] >> 1) & 0x5555555555555555ull);
+    r->checksum = LoadgenChecksum(&snap);
+    GridSnapshotFree(&snap);
+
+    MetricsClose(metrics);
+    m.history = nullptr;
+    HistoryClose(history);
+    m.journal = nullptr;
+    JournalClose(journal);
+    SharedClose(&m);
+    ArenaClose(arena);
+    return true;
+}
+
+bool LoadgenDestroyBoard(uint32_t id, FILE* out) {
+    Arena* arena = id ? ArenaOpen(ARENA_NAME) : nullptr;
+    bool ok = arena && ArenaDestroy(arena, id);
+    if (ok) {
+        ArenaStats as = ArenaGetStats(arena);
+        fprintf(out, "board %u destroyed; arena: %u boards, %llu bytes in use, %llu of %llu carved are free chunks\n",
+            id, as.boards, (unsigned long long)as.bytesInUse, (unsigned long long)as.bytesFreeChunks,
+            (unsigned long long)as.bytesCarved);
+    }
+    else {
+        fprintf(out, "no board %u\n", id);
+    }
+    ArenaClose(arena);
+#ifndef _WIN32
+    // под Windows сегменты уходят вместе с последним хэндлом
+    char name[96];
+    snprintf(name, sizeof(name), "%s.%u.hist", ARENA_NAME, id);
+    shm_unlink(name);
+    snprintf(name, sizeof(name), "%s.%u.stats", ARENA_NAME, id);
+    shm_unlink(name);
+#endif
+    return ok;
+}
+
+void LoadgenPrintReport(FILE* out, const LoadgenOptions* o, const LoadgenReport* r) {
+    fprintf(out, "%s: %llu ops in %.3f s, %.0f ops/s%s\n",
+        o->mode == LOADGEN_REPLAY ? "replay" : "load",
+        (unsigned long long)r->ops, r->elapsedUs / 1e6, r->opsPerSec, o->rate ? "" : " (unthrottled)");
+    fprintf(out, "moves %llu: accepted %llu, occupied %llu, not your turn %llu, game over %llu, out of range %llu, "
+        "dropped %llu; "
+        "submit avg %.1f us, max %.1f us\n",
+        (unsigned long long)r->moves, (unsigned long long)r->accepted,
+        (unsigned long long)r->rejected[MOVE_OCCUPIED], (unsigned long long)r->rejected[MOVE_NOT_YOUR_TURN],
+        (unsigned long long)r->rejected[MOVE_GAME_OVER], (unsigned long long)r->rejected[MOVE_OUT_OF_RANGE],
+        (unsigned long long)r->rejected[MOVE_DROPPED],
+        r->moves ? r->submitNsSum / 1000.0 / r->moves : 0.0, r->submitNsMax / 1000.0);
+    fprintf(out, "colors %llu, new games %llu, undo/redo %llu, notifies %llu\n",
+        (unsigned long long)r->colors, (unsigned long long)r->newGames,
+        (unsigned long long)r->travels, (unsigned long long)r->notifies);
+    fprintf(out, "board: version %u, size %d, pieces %u, winner %d, checksum %016llx\n",
+        r->version, r->gridSize, r->pieces, r->winner, (unsigned long long)r->checksum);
+    fflush(out);
+}
@@ -0,0 +1,86 @@
+﻿#pragma once
+
+// Экземпляр без окна: подключается к общему полю и либо проигрывает
+// сценарий ходов и цветов, либо сам генерирует случайный поток ходов —
+// с заданной частотой или так быстро, как пускает очередь ходов.
+// В конце печатает достигнутые операции в секунду и контрольную сумму
+// итогового поля. Таких процессов на одно поле можно запускать сколько
+// угодно, в том числе на Linux без дисплея (Headless.cpp).
+//
+// Пишет теми же путями, что и окно: ходы — через MoveSubmit, цвета и
+// новая партия — прямыми записями; журнал и история подключаются так же.
+// Окна будятся через Notify не чаще кадра, журнал сбрасывается тогда же.
+//
+// Сценарий — текст, по команде в строке, # — комментарий:
+//   o <клетка> | o <строка> <столбец>     ход ноликом (x — крестиком)
+//   bg <r> <g> <b>                         цвет фона
+//   grid <r> <g> <b>                       цвет сетки
+//   new                                    новая партия
+//   k <n>                                  сколько в ряд для победы
+//   undo [n] | redo [n]                    по истории ходов
+//   sleep <мс>                             пауза (в частоту не входит)
+
+#include "SharedGrid.h"
+
+#include <stdio.h>
+
+#define LOADGEN_SCRIPT_MAX  (1u << 20)     // команд в сценарии
+#define LOADGEN_DEFAULT_OPS 10000          // случайному потоку без ops и duration
+
+enum LoadgenMode { LOADGEN_OFF, LOADGEN_REPLAY, LOADGEN_RANDOM };
+
+struct LoadgenOptions {
+    int         mode;                      // LoadgenMode
+    const char* script;                    // для LOADGEN_REPLAY
+    uint32_t    repeat;                    // сколько раз проиграть сценарий; 0 — до duration/ops
+    uint32_t    rate;                      // операций в секунду; 0 — без ограничения
+    uint64_t    ops;                       // остановиться после стольких; 0 — без ограничения
+    uint32_t    durationMs;                // и/или через столько; 0 — без ограничения
+    uint32_t    seed;                      // 0 — от pid и времени
+    uint32_t    colorPermille;             // доля смен цвета в случайном потоке, ‰
+
+    // Поле — как у окна
+    uint32_t    boardId;                   // 0 — SHARED_MEM_NAME, иначе доска арены
+    int         gridSize;                  // при создании; с resize — и для подключения
+    bool        resize;
+    int         winLength;                 // 0 — не трогать
+    const char* journalFile;               // у доски арены — data.<id>.bin; nullptr — без журнала
+    uint32_t    frameMs;                   // как часто будить окна и сбрасывать журнал
+};
+
+struct LoadgenReport {
+    uint64_t ops;                          // выполнено команд (без sleep)
+    uint64_t moves;
+    uint64_t accepted;
+    uint64_t rejected[MOVE_DROPPED + 1];   // по MoveResult
+    uint64_t colors;
+    uint64_t newGames;
+    uint64_t travels;                      // undo/redo, которые сдвинули поле
+    uint64_t notifies;
+    uint64_t elapsedUs;
+    double   opsPerSec;
+    uint64_t submitNsMax;                  // худшее время MoveSubmit
+    uint64_t submitNsSum;
+    // Итоговое поле
+    uint32_t version;
+    int      gridSize;
+    int      winner;
+    uint32_t pieces;                       // countO + countX
+    uint64_t checksum;
+};
+
+// Значения по умолчанию: случайный поток, без ограничения частоты
+void     LoadgenDefaults(LoadgenOptions* o);
+
+// Открыть поле, прогнать нагрузку, закрыть. false — поле не открылось
+// или сценарий не прочитался (причина уже в err).
+bool     LoadgenRun(const LoadgenOptions* o, LoadgenReport* r, FILE* err);
+void     LoadgenPrintReport(FILE* out, const LoadgenOptions* o, const LoadgenReport* r);
+
+// -destroy id: удалить доску арены и её сегменты истории и счётчиков.
+// Подключённые экземпляры доигрывают, память уходит за последним из них.
+bool     LoadgenDestroyBoard(uint32_t id, FILE* out);
+
+// FNV-1a по размеру, цветам, партии и клеткам снимка: одинаковое поле —
+// одинаковая сумма в любом процессе
+uint64_t LoadgenChecksum(const GridSnapshot* s);
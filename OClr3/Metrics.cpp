@@ -0,0 +1,259 @@
+﻿#include "Metrics.h"
+#include "Platform.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define METRICS_MAGIC 0x5354414Du      // "MATS"
+
+struct MetricsSharedHist {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sumNs;
+    std::atomic<uint64_t> maxNs;
+    std::atomic<uint32_t> buckets[METRICS_BUCKETS];
+};
+
+struct MetricsSlot {
+    std::atomic<uint32_t> pid;         // 0 — свободен
+    uint32_t              pad;
+    std::atomic<uint64_t> startedNs;
+    std::atomic<uint64_t> counters[METRIC_COUNTERS];
+    MetricsSharedHist     hist[METRIC_HISTS];
+};
+
+struct MetricsHeader {
+    uint32_t              magic;
+    uint32_t              slots;
+    std::atomic<uint64_t> writeNs;     // последняя опубликованная запись поля
+    MetricsSlot           slot[METRICS_SLOTS];
+};
+
+struct Metrics {
+    MetricsHeader* mh;
+    MetricsSlot*   own;                // nullptr у читателя
+#ifdef _WIN32
+    HANDLE         hMap;
+#endif
+};
+
+#ifdef _WIN32
+uint64_t MetricsNow() {
+    static LARGE_INTEGER freq = {};
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER t; QueryPerformanceCounter(&t);
+    return (uint64_t)(t.QuadPart / freq.QuadPart) * 1000000000ull
+        + (uint64_t)(t.QuadPart % freq.QuadPart) * 1000000000ull / (uint64_t)freq.QuadPart;
+}
+#else
+uint64_t MetricsNow() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+// ——————————————————————————————— Корзины ——————————————————————————————————————
+
+// Ниже 2^SUB_BITS — по корзине на значение, дальше октава msb делится
+// на 2^SUB_BITS частей по старшим битам после msb
+static inline uint32_t BucketOf(uint64_t v) {
+    const uint64_t top = (1ull << METRICS_MAX_BITS) - 1;
+    if (v > top) v = top;
+    if (v < (1u << METRICS_SUB_BITS)) return (uint32_t)v;
+    int msb = 63;
+    while (!(v >> msb)) msb--;
+    uint32_t sub = (uint32_t)(v >> (msb - METRICS_SUB_BITS)) & ((1u << METRICS_SUB_BITS) - 1);
+    return (uint32_t)(msb - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS | sub;
+}
+
+static inline uint64_t BucketMid(uint32_t b) {
+    if (b < (1u << METRICS_SUB_BITS)) return b;
+    int shift = (int)(b >> METRICS_SUB_BITS) - 1;
+    uint64_t lo = (uint64_t)((1u << METRICS_SUB_BITS) | (b & ((1u << METRICS_SUB_BITS) - 1))) << shift;
+    return lo + ((1ull << shift) >> 1);
+}
+
+// ——————————————————————————————— Сегмент ——————————————————————————————————————
+
+static void ClearSlot(MetricsSlot* s) {
+    s->startedNs.store(MetricsNow(), std::memory_order_relaxed);
+    for (int c = 0; c < METRIC_COUNTERS; c++) s->counters[c].store(0, std::memory_order_relaxed);
+    for (int h = 0; h < METRIC_HISTS; h++) {
+        MetricsSharedHist& mh = s->hist[h];
+        mh.count.store(0, std::memory_order_relaxed);
+        mh.sumNs.store(0, std::memory_order_relaxed);
+        mh.maxNs.store(0, std::memory_order_relaxed);
+        for (int b = 0; b < METRICS_BUCKETS; b++) mh.buckets[b].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Свободный слот или слот умершего процесса
+static MetricsSlot* ClaimSlot(MetricsHeader* mh) {
+    uint32_t self = SelfPid();
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < mh->slots; i++) {
+            MetricsSlot* s = &mh->slot[i];
+            uint32_t pid = s->pid.load(std::memory_order_relaxed);
+            if (pass == 0 ? pid != 0 : (pid == 0 || ProcessAlive(pid))) continue;
+            if (s->pid.compare_exchange_strong(pid, self, std::memory_order_acquire)) {
+                ClearSlot(s);
+                return s;
+            }
+        }
+    }
+    return nullptr;
+}
+
+Metrics* MetricsOpen(const char* name, bool create, bool join) {
+    char sn[96];
+    snprintf(sn, sizeof(sn), "%s.stats", name);
+    size_t bytes = sizeof(MetricsHeader);
+    void* p = nullptr;
+    Metrics* m = new Metrics();
+
+#ifdef _WIN32
+    m->hMap = create
+        ? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)bytes, sn)
+        : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, sn);
+    if (m->hMap) {
+        p = MapViewOfFile(m->hMap, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+        if (!p) CloseHandle(m->hMap);
+    }
+#else
+    if (create) shm_unlink(sn);        // хвост от прошлого запуска
+    int fd = shm_open(sn, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    if (fd >= 0) {
+        struct stat st;
+        bool sized = create ? ftruncate(fd, (off_t)bytes) == 0
+                            : fstat(fd, &st) == 0 && (size_t)st.st_size >= bytes;
+        if (sized) {
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) p = nullptr;
+        }
+        close(fd);
+    }
+#endif
+    if (!p) {
+        delete m;
+        return nullptr;
+    }
+    m->mh = (MetricsHeader*)p;
+    // свежий сегмент нулевой: все слоты свободны
+    if (create) {
+        m->mh->slots = METRICS_SLOTS;
+        m->mh->magic = METRICS_MAGIC;
+    }
+    else if (m->mh->magic != METRICS_MAGIC) {
+        MetricsClose(m);
+        return nullptr;
+    }
+    if (join && !(m->own = ClaimSlot(m->mh))) {
+        MetricsClose(m);
+        return nullptr;
+    }
+    return m;
+}
+
+void MetricsClose(Metrics* m) {
+    if (!m) return;
+    if (m->own) m->own->pid.store(0, std::memory_order_release);
+#ifdef _WIN32
+    UnmapViewOfFile(m->mh);
+    CloseHandle(m->hMap);
+#else
+    munmap(m->mh, sizeof(MetricsHeader));
+#endif
+    delete m;
+}
+
+// ——————————————————————————————— Писатели ——————————————————————————————————————
+
+void MetricsRecord(Metrics* m, int hist, uint64_t ns) {
+    if (!m || !m->own) return;
+    MetricsSharedHist& h = m->own->hist[hist];
+    h.buckets[BucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sumNs.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t mx = h.maxNs.load(std::memory_order_relaxed);
+    while (ns > mx && !h.maxNs.compare_exchange_weak(mx, ns, std::memory_order_relaxed)) {}
+}
+
+void MetricsCount(Metrics* m, int counter, uint64_t n) {
+    if (!m || !m->own) return;
+    m->own->counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void MetricsPublishWrite(Metrics* m, uint64_t writeNs) {
+    if (!m) return;
+    m->mh->writeNs.store(writeNs, std::memory_order_release);
+}
+
+uint64_t MetricsLastWrite(Metrics* m) {
+    return m ? m->mh->writeNs.load(std::memory_order_acquire) : 0;
+}
+
+// ——————————————————————————————— Читатель ——————————————————————————————————————
+
+void MetricsRead(Metrics* m, MetricsSample* out) {
+    out->takenNs = MetricsNow();
+    out->instances = 0;
+    for (uint32_t i = 0; i < m->mh->slots && i < METRICS_SLOTS; i++) {
+        const MetricsSlot& s = m->mh->slot[i];
+        uint32_t pid = s.pid.load(std::memory_order_acquire);
+        if (!pid || !ProcessAlive(pid)) continue;
+        MetricsInstance& o = out->inst[out->instances++];
+        o.pid = pid;
+        o.startedNs = s.startedNs.load(std::memory_order_relaxed);
+        for (int c = 0; c < METRIC_COUNTERS; c++) o.counters[c] = s.counters[c].load(std::memory_order_relaxed);
+        for (int h = 0; h < METRIC_HISTS; h++) {
+            const MetricsSharedHist& sh = s.hist[h];
+            MetricsHistogram& oh = o.hist[h];
+            // count/sum и корзины читаются не атомарно вместе — процентили
+            // считаем по корзинам, count только для справки
+            oh.count = sh.count.load(std::memory_order_relaxed);
+            oh.sumNs = sh.sumNs.load(std::memory_order_relaxed);
+            oh.maxNs = sh.maxNs.load(std::memory_order_relaxed);
+            for (int b = 0; b < METRICS_BUCKETS; b++) oh.buckets[b] = sh.buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void MetricsHistogramDiff(const MetricsHistogram* a, const MetricsHistogram* b, MetricsHistogram* dst) {
+    dst->count = a->count - b->count;
+    dst->sumNs = a->sumNs - b->sumNs;
+    dst->maxNs = a->maxNs;             // максимум за окно не восстановить — берём общий
+    for (int i = 0; i < METRICS_BUCKETS; i++) dst->buckets[i] = a->buckets[i] - b->buckets[i];
+}
+
+void MetricsHistogramAdd(MetricsHistogram* dst, const MetricsHistogram* src) {
+    dst->count += src->count;
+    dst->sumNs += src->sumNs;
+    if (src->maxNs > dst->maxNs) dst->maxNs = src->maxNs;
+    for (int i = 0; i < METRICS_BUCKETS; i++) dst->buckets[i] += src->buckets[i];
+}
+
+uint64_t MetricsPercentile(const MetricsHistogram* h, double q) {
+    uint64_t total = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) total += h->buckets[i];
+    if (!total) return 0;
+    uint64_t rank = (uint64_t)(q * (double)total);
+    if (rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            uint64_t v = BucketMid((uint32_t)i);
+            return v < h->maxNs || !h->maxNs ? v : h->maxNs;
+        }
+    }
+    return h->maxNs;
+}
@@ -0,0 +1,83 @@
+﻿#pragma once
+
+// Задержки горячего пути окна и счётчики, видимые снаружи без остановки
+// экземпляров (OClr3 -stats).
+//
+// Сегмент name.stats лежит рядом с SharedData: заголовок и METRICS_SLOTS
+// слотов, по одному на процесс. Каждый процесс пишет только в свой слот
+// атомарными инкрементами без блокировок; читатель просто копирует слоты
+// и считает процентили сам. Гистограммы лог-линейные, как в HDR: октава
+// делится на 2^METRICS_SUB_BITS равных корзин, ошибка значения — до 6%.
+//
+// Время — наносекунды MetricsNow(): монотонные часы, общие для всех
+// процессов машины, поэтому «записал в одном — проснулся в другом» можно
+// вычитать напрямую.
+
+#include <stdint.h>
+
+#define METRICS_SLOTS     64           // процессов одновременно
+#define METRICS_SUB_BITS  4            // 16 корзин на октаву
+#define METRICS_MAX_BITS  40           // до 2^40 нс (~18 минут); больше — в последнюю
+#define METRICS_BUCKETS   ((METRICS_MAX_BITS - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS)
+
+enum MetricsHist {
+    METRIC_INPUT_TO_WRITE,             // клик -> ход записан в поле
+    METRIC_WRITE_TO_NOTIFY,            // запись (любой процесс) -> проснулся поток уведомлений
+    METRIC_NOTIFY_TO_PAINT,            // уведомление -> начало WM_PAINT
+    METRIC_PAINT,                      // длительность WM_PAINT
+    METRIC_HISTS
+};
+
+enum MetricsCounter {
+    METRIC_REPAINTS,
+    METRIC_BRUSHES,                    // CreateSolidBrush
+    METRIC_PENS,                       // CreatePen
+    METRIC_BROADCASTS,                 // BroadcastUpdate
+    METRIC_COUNTERS
+};
+
+struct Metrics;
+
+// Копия гистограммы у читателя
+struct MetricsHistogram {
+    uint64_t count;
+    uint64_t sumNs;
+    uint64_t maxNs;
+    uint32_t buckets[METRICS_BUCKETS];
+};
+
+struct MetricsInstance {
+    uint32_t         pid;
+    uint64_t         startedNs;
+    uint64_t         counters[METRIC_COUNTERS];
+    MetricsHistogram hist[METRIC_HISTS];
+};
+
+// Все живые экземпляры на момент чтения; большая — держать в куче
+struct MetricsSample {
+    uint64_t        takenNs;
+    uint32_t        instances;
+    MetricsInstance inst[METRICS_SLOTS];
+};
+
+// join — занять слот этого процесса (окно); без него только чтение (-stats).
+// nullptr — сегмента нет или все слоты заняты живыми процессами.
+Metrics* MetricsOpen(const char* name, bool create, bool join);
+void     MetricsClose(Metrics* m);
+
+uint64_t MetricsNow();
+
+// Писатели; m == nullptr — ничего не делают
+void     MetricsRecord(Metrics* m, int hist, uint64_t ns);
+void     MetricsCount(Metrics* m, int counter, uint64_t n = 1);
+// Время записи, о которой сейчас будут уведомлены остальные (BroadcastUpdate)
+void     MetricsPublishWrite(Metrics* m, uint64_t writeNs);
+uint64_t MetricsLastWrite(Metrics* m);
+
+// Читатель: копия всех живых слотов; писателей не останавливает
+void     MetricsRead(Metrics* m, MetricsSample* out);
+// dst = a - b по корзинам (окно между двумя чтениями одного pid)
+void     MetricsHistogramDiff(const MetricsHistogram* a, const MetricsHistogram* b, MetricsHistogram* dst);
+void     MetricsHistogramAdd(MetricsHistogram* dst, const MetricsHistogram* src);
+// Значение q-го квантиля (0..1) в нс, середина корзины; 0 — пусто
+uint64_t MetricsPercentile(const MetricsHistogram* h, double q);
@@ -0,0 +1,573 @@
+﻿#include "Mirror.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define MIRROR_LOG_MAX      (1u << 18)   // изменений в журнале сервера для отставших клиентов
+#define MIRROR_PENDING_MAX  (1u << 16)   // клеток, ждущих поток сервера; больше — копируем весь снимок
+
+struct MirrorChange {
+    uint32_t version;
+    uint32_t cell;
+    uint32_t value;
+};
+
+typedef std::shared_ptr<const std::vector<uint8_t>> Message;
+
+struct MirrorClient {
+#ifdef _WIN32
+    OVERLAPPED ov;
+    HANDLE     pipe;
+    bool       connected;
+    bool       ioPending;
+    bool       closing;                // хэндл закрыт, ждём завершения операции
+#else
+    int        fd;
+#endif
+    Message    out;                    // сообщение в пути; пока оно есть, новых не шлём
+    size_t     off;
+    uint32_t   version;                // версия поля у клиента после out
+    uint64_t   updates;                // сколько обновлений сервера он видел
+    bool       hasImage;
+};
+
+struct MirrorServer {
+    std::string  endpoint;
+    std::thread  thread;
+    std::mutex   lock;                 // всё, что ниже до «потока сервера», и stats
+    bool         stop;
+    MirrorStats  stats;
+
+    // от окна (MirrorPublish)
+    bool                      pendingFull;
+    std::vector<uint64_t>     pendingWords;
+    std::vector<MirrorChange> pendingCells;
+    MirrorState               pendingState;
+    uint32_t                  pendingVersion;
+    uint32_t                  pendingUpdates;
+    bool                      pendingAny;
+
+    // поток сервера
+    std::vector<uint64_t>     image;
+    MirrorState               state;
+    uint32_t                  version;
+    uint64_t                  updates;       // забрано MirrorPublish
+    uint32_t                  fullVersion;   // последняя смена размера
+    std::deque<MirrorChange>  log;
+    uint32_t                  logFloor;      // изменения после этой версии все в log
+    std::vector<MirrorClient*> clients;
+#ifdef _WIN32
+    HANDLE        iocp;
+    MirrorClient* listener;
+    int           closing;       // закрыты, но операция ещё не завершилась
+#else
+    int           listenFd;
+    int           wake[2];
+#endif
+};
+
+static void StateFrom(const GridSnapshot* snap, MirrorState* st) {
+    st->gridSize = snap->gridSize;
+    st->backgroundColor = snap->backgroundColor;
+    st->gridColor = snap->gridColor;
+    st->winLength = snap->winLength;
+    st->winner = snap->winner;
+    st->winCell = snap->winCell;
+    st->winDir = snap->winDir;
+}
+
+// ——————————————————————————————— Кодирование ——————————————————————————————————————
+
+static void Put(std::vector<uint8_t>& out, const void* p, size_t n) {
+    out.insert(out.end(), (const uint8_t*)p, (const uint8_t*)p + n);
+}
+
+static void PutVarint(std::vector<uint8_t>& out, uint64_t x) {
+    while (x >= 0x80) {
+        out.push_back((uint8_t)(x | 0x80));
+        x >>= 7;
+    }
+    out.push_back((uint8_t)x);
+}
+
+static void FinishHeader(std::vector<uint8_t>& out, uint32_t type, uint32_t version) {
+    MirrorHeader h = { MIRROR_MAGIC, type, version, (uint32_t)(out.size() - sizeof(MirrorHeader)) };
+    memcpy(out.data(), &h, sizeof(h));
+}
+
+static Message EncodeFull(MirrorServer* s) {
+    std::vector<uint8_t>* out = new std::vector<uint8_t>(sizeof(MirrorHeader));
+    Put(*out, &s->state, sizeof(s->state));
+    Put(*out, s->image.data(), s->image.size() * sizeof(uint64_t));
+    FinishHeader(*out, MIRROR_FULL, s->version);
+    return Message(out);
+}
+
+// Всё, что изменилось после from, по клетке один раз (последнее значение).
+// nullptr — полный снимок выйдет не больше.
+static Message EncodeDelta(MirrorServer* s, uint32_t from) {
+    auto first = std::upper_bound(s->log.begin(), s->log.end(), from,
+        [](uint32_t v, const MirrorChange& c) { return v < c.version; });
+    std::vector<MirrorChange> cells(first, s->log.end());
+    std::stable_sort(cells.begin(), cells.end(),
+        [](const MirrorChange& a, const MirrorChange& b) { return a.cell < b.cell; });
+
+    std::vector<uint8_t>* out = new std::vector<uint8_t>(sizeof(MirrorHeader));
+    Put(*out, &s->state, sizeof(s->state));
+    Put(*out, &from, sizeof(from));
+    size_t countAt = out->size();
+    uint32_t count = 0, prev = 0;
+    Put(*out, &count, sizeof(count));
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (i + 1 < cells.size() && cells[i + 1].cell == cells[i].cell) continue;
+        PutVarint(*out, (uint64_t)(cells[i].cell - prev) << 2 | cells[i].value);
+        prev = cells[i].cell;
+        count++;
+    }
+    if (out->size() >= s->image.size() * sizeof(uint64_t)) {
+        delete out;
+        return nullptr;
+    }
+    memcpy(out->data() + countAt, &count, sizeof(count));
+    FinishHeader(*out, MIRROR_DELTA, s->version);
+    return Message(out);
+}
+
+// ——————————————————————————————— Поток сервера ——————————————————————————————————
+
+static void LogChange(MirrorServer* s, uint32_t version, uint32_t cell, uint32_t value) {
+    MirrorChange c = { version, cell, value };
+    s->log.push_back(c);
+    if (s->log.size() > MIRROR_LOG_MAX) {
+        s->logFloor = s->log.front().version;
+        s->log.pop_front();
+    }
+}
+
+// Забрать то, что накопило окно, в образ поля и журнал изменений
+static void Absorb(MirrorServer* s) {
+    bool full;
+    std::vector<uint64_t> words;
+    std::vector<MirrorChange> cells;
+    MirrorState st;
+    uint32_t version;
+    {
+        std::lock_guard<std::mutex> g(s->lock);
+        if (!s->pendingAny) return;
+        s->updates += s->pendingUpdates;
+        s->pendingUpdates = 0;
+        full = s->pendingFull;
+        words.swap(s->pendingWords);
+        cells.swap(s->pendingCells);
+        st = s->pendingState;
+        version = s->pendingVersion;
+        s->pendingFull = false;
+        s->pendingAny = false;
+    }
+
+    if (full && (st.gridSize != s->state.gridSize || s->image.empty())) {
+        // другой размер: отставшим и новым — только полный снимок
+        s->image.swap(words);
+        s->log.clear();
+        s->fullVersion = s->logFloor = version;
+    }
+    else if (full) {
+        // поменялись цвета, а клетки сверяем с образом сами — клиентам уйдёт дельта
+        for (size_t w = 0; w < words.size(); w++) {
+            uint64_t x = s->image[w] ^ words[w];
+            for (int k = 0; x; k++, x >>= 2)
+                if (x & 3) LogChange(s, version, (uint32_t)(w * GRID_CELLS_WORD + k), (uint32_t)(words[w] >> (2 * k)) & 3);
+        }
+        s->image.swap(words);
+    }
+    else {
+        for (const MirrorChange& c : cells) {
+            GridCellSet(s->image.data(), (int)c.cell, (int)c.value);
+            LogChange(s, c.version, c.cell, c.value);
+        }
+    }
+    s->state = st;
+    s->version = version;
+}
+
+static bool StartSend(MirrorServer* s, MirrorClient* c);
+static void DropClient(MirrorServer* s, MirrorClient* c);
+
+// Каждому свободному клиенту — всё, что он ещё не видел, одним сообщением.
+// Клиенты в одной версии получают один и тот же буфер.
+static void Service(MirrorServer* s) {
+    std::map<uint32_t, Message> cache;   // версия клиента -> сообщение; UINT32_MAX — полный
+    std::vector<MirrorClient*> dead;
+    uint64_t messages = 0, fulls = 0, coalesced = 0, bytes = 0;
+    for (MirrorClient* c : s->clients) {
+        if (c->out || (c->hasImage && c->version == s->version)) continue;
+        bool full = !c->hasImage || c->version < s->logFloor || c->version < s->fullVersion;
+        uint32_t key = full ? UINT32_MAX : c->version;
+        auto it = cache.find(key);
+        if (it == cache.end()) {
+            Message m = full ? nullptr : EncodeDelta(s, c->version);
+            if (!m) {
+                key = UINT32_MAX;
+                it = cache.find(key);
+                m = it != cache.end() ? it->second : EncodeFull(s);
+            }
+            it = cache.insert(std::make_pair(key, m)).first;
+        }
+        if (key == UINT32_MAX) fulls++;
+        else if (s->updates - c->updates > 1) coalesced++;
+        c->out = it->second;
+        c->off = 0;
+        c->version = s->version;
+        c->updates = s->updates;
+        c->hasImage = true;
+        messages++;
+        bytes += c->out->size();
+        if (!StartSend(s, c)) dead.push_back(c);
+    }
+    for (MirrorClient* c : dead) DropClient(s, c);
+    std::lock_guard<std::mutex> g(s->lock);
+    s->stats.messages += messages;
+    s->stats.fullMessages += fulls;
+    s->stats.coalesced += coalesced;
+    s->stats.bytes += bytes;
+    s->stats.clients = (uint32_t)s->clients.size();
+}
+
+static void ServerMain(MirrorServer* s);
+static bool Listen(MirrorServer* s);
+static void Wake(MirrorServer* s);
+static void Shutdown(MirrorServer* s);
+
+// ——————————————————————————————— Общая часть ——————————————————————————————————
+
+MirrorServer* MirrorStart(const char* endpoint, const GridSnapshot* snap) {
+    MirrorServer* s = new MirrorServer();
+    s->endpoint = endpoint;
+    s->stop = false;
+    s->stats = MirrorStats();
+    s->pendingFull = false;
+    s->pendingAny = false;
+    s->pendingVersion = 0;
+    s->pendingUpdates = 0;
+    StateFrom(snap, &s->pendingState);
+    StateFrom(snap, &s->state);
+    s->image.assign(snap->cells, snap->cells + GridWordsFor(snap->gridSize));
+    s->version = snap->version;
+    s->updates = 0;
+    s->fullVersion = s->logFloor = snap->version;
+    if (!Listen(s)) {
+        delete s;
+        return nullptr;
+    }
+    s->thread = std::thread(ServerMain, s);
+    return s;
+}
+
+void MirrorStop(MirrorServer* s) {
+    if (!s) return;
+    {
+        std::lock_guard<std::mutex> g(s->lock);
+        s->stop = true;
+    }
+    Wake(s);
+    s->thread.join();
+    Shutdown(s);
+    delete s;
+}
+
+void MirrorPublish(MirrorServer* s, const GridSnapshot* snap, const GridDelta* delta, bool full) {
+    if (!s) return;
+    {
+        std::lock_guard<std::mutex> g(s->lock);
+        s->stats.updates++;
+        StateFrom(snap, &s->pendingState);
+        s->pendingVersion = snap->version;
+        s->pendingUpdates++;
+        if (full || s->pendingCells.size() + delta->count > MIRROR_PENDING_MAX) {
+            s->pendingFull = true;
+            s->pendingWords.assign(snap->cells, snap->cells + GridWordsFor(snap->gridSize));
+            s->pendingCells.clear();
+        }
+        else if (s->pendingFull) {
+            // полный снимок ещё не забран — дописываем прямо в него
+            for (uint32_t i = 0; i < delta->count; i++) {
+                int cell = (int)delta->cells[i];
+                GridCellSet(s->pendingWords.data(), cell, GridCellGet(snap->cells, cell));
+            }
+        }
+        else {
+            for (uint32_t i = 0; i < delta->count; i++) {
+                uint32_t cell = delta->cells[i];
+                MirrorChange c = { snap->version, cell, (uint32_t)GridCellGet(snap->cells, (int)cell) };
+                s->pendingCells.push_back(c);
+            }
+        }
+        s->pendingAny = true;
+    }
+    Wake(s);
+}
+
+MirrorStats MirrorGetStats(MirrorServer* s) {
+    std::lock_guard<std::mutex> g(s->lock);
+    return s->stats;
+}
+
+static bool StopRequested(MirrorServer* s) {
+    std::lock_guard<std::mutex> g(s->lock);
+    return s->stop;
+}
+
+static void CountAccepted(MirrorServer* s) {
+    std::lock_guard<std::mutex> g(s->lock);
+    s->stats.accepted++;
+}
+
+// ——————————————————————————————— Windows ——————————————————————————————————————
+#ifdef _WIN32
+
+// Экземпляр канала, ждущий следующего клиента
+static MirrorClient* NewListener(MirrorServer* s) {
+    MirrorClient* c = new MirrorClient();
+    c->pipe = CreateNamedPipeA(s->endpoint.c_str(), PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED,
+        PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES, 1 << 16, 0, 0, nullptr);
+    if (c->pipe == INVALID_HANDLE_VALUE) {
+        delete c;
+        return nullptr;
+    }
+    CreateIoCompletionPort(c->pipe, s->iocp, (ULONG_PTR)c, 0);
+    if (!ConnectNamedPipe(c->pipe, &c->ov)) {
+        DWORD e = GetLastError();
+        // клиент успел между созданием и ConnectNamedPipe — пакета не будет, шлём сами
+        if (e == ERROR_PIPE_CONNECTED)
+            PostQueuedCompletionStatus(s->iocp, 0, (ULONG_PTR)c, &c->ov);
+        else if (e != ERROR_IO_PENDING) {
+            CloseHandle(c->pipe);
+            delete c;
+            return nullptr;
+        }
+    }
+    c->ioPending = true;
+    return c;
+}
+
+static bool Listen(MirrorServer* s) {
+    s->iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    if (!s->iocp) return false;
+    s->listener = NewListener(s);
+    if (!s->listener) {
+        CloseHandle(s->iocp);
+        return false;
+    }
+    return true;
+}
+
+static void Wake(MirrorServer* s) {
+    PostQueuedCompletionStatus(s->iocp, 0, 0, nullptr);
+}
+
+static bool StartSend(MirrorServer*, MirrorClient* c) {
+    memset(&c->ov, 0, sizeof(c->ov));
+    if (!WriteFile(c->pipe, c->out->data(), (DWORD)c->out->size(), nullptr, &c->ov)
+        && GetLastError() != ERROR_IO_PENDING)
+        return false;
+    c->ioPending = true;
+    return true;
+}
+
+static void DropClient(MirrorServer* s, MirrorClient* c) {
+    s->clients.erase(std::find(s->clients.begin(), s->clients.end(), c));
+    CloseHandle(c->pipe);
+    if (c->ioPending) {
+        c->closing = true;
+        s->closing++;
+    }
+    else {
+        delete c;
+    }
+}
+
+static void ServerMain(MirrorServer* s) {
+    for (;;) {
+        DWORD n; ULONG_PTR key; OVERLAPPED* ov = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(s->iocp, &n, &key, &ov, INFINITE);
+        if (!ov) {
+            if (!ok || StopRequested(s)) break;   // пробуждение от MirrorPublish/MirrorStop
+        }
+        else {
+            MirrorClient* c = (MirrorClient*)key;
+            c->ioPending = false;
+            if (c->closing) {
+                s->closing--;
+                delete c;
+            }
+            else if (!c->connected) {
+                s->listener = NewListener(s);
+                if (ok) {
+                    c->connected = true;
+                    s->clients.push_back(c);
+                    CountAccepted(s);
+                }
+                else {
+                    CloseHandle(c->pipe);
+                    delete c;
+                }
+            }
+            else if (!ok) {
+                DropClient(s, c);      // клиент закрыл канал
+            }
+            else {
+                c->out.reset();
+            }
+        }
+        Absorb(s);
+        Service(s);
+    }
+
+    while (!s->clients.empty()) DropClient(s, s->clients.back());
+    if (s->listener) {
+        CloseHandle(s->listener->pipe);
+        s->listener->closing = true;
+        s->closing++;
+    }
+    // закрытые хэндлы завершают свои операции с ошибкой — дожидаемся их
+    while (s->closing > 0) {
+        DWORD n; ULONG_PTR key; OVERLAPPED* ov = nullptr;
+        GetQueuedCompletionStatus(s->iocp, &n, &key, &ov, 1000);
+        if (!ov) break;
+        MirrorClient* c = (MirrorClient*)key;
+        s->closing--;
+        delete c;
+    }
+}
+
+static void Shutdown(MirrorServer* s) {
+    CloseHandle(s->iocp);
+}
+
+// ——————————————————————————————— POSIX ——————————————————————————————————————
+#else
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static bool Listen(MirrorServer* s) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (s->endpoint.size() >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, s->endpoint.c_str());
+
+    s->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s->listenFd < 0) return false;
+    unlink(addr.sun_path);             // сокет от прошлого запуска
+    if (bind(s->listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(s->listenFd, SOMAXCONN) != 0
+        || pipe(s->wake) != 0)
+    {
+        close(s->listenFd);
+        return false;
+    }
+    fcntl(s->listenFd, F_SETFL, O_NONBLOCK);
+    fcntl(s->wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(s->wake[1], F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+static void Wake(MirrorServer* s) {
+    char x = 1;
+    // полный канал — поток и так проснётся
+    ssize_t r = write(s->wake[1], &x, 1);
+    (void)r;
+}
+
+// Отправить сколько примет сокет; остаток — по POLLOUT
+static bool StartSend(MirrorServer*, MirrorClient* c) {
+    while (c->off < c->out->size()) {
+        ssize_t n = send(c->fd, c->out->data() + c->off, c->out->size() - c->off, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->off += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    c->out.reset();
+    return true;
+}
+
+static void DropClient(MirrorServer* s, MirrorClient* c) {
+    s->clients.erase(std::find(s->clients.begin(), s->clients.end(), c));
+    close(c->fd);
+    delete c;
+}
+
+static void ServerMain(MirrorServer* s) {
+    std::vector<pollfd> pfds;
+    std::vector<MirrorClient*> dead;
+    while (!StopRequested(s)) {
+        pfds.clear();
+        pfds.push_back({ s->wake[0], POLLIN, 0 });
+        pfds.push_back({ s->listenFd, POLLIN, 0 });
+        for (MirrorClient* c : s->clients)
+            pfds.push_back({ c->fd, (short)(POLLIN | (c->out ? POLLOUT : 0)), 0 });
+        if (poll(pfds.data(), pfds.size(), -1) < 0 && errno != EINTR) break;
+
+        char buf[256];
+        if (pfds[0].revents) while (read(s->wake[0], buf, sizeof(buf)) > 0) {}
+
+        // клиенты только читают: входящие байты выбрасываем, 0 — отключился
+        dead.clear();
+        for (size_t i = 0; i + 2 < pfds.size(); i++) {
+            MirrorClient* c = s->clients[i];
+            short re = pfds[i + 2].revents;
+            bool gone = (re & (POLLERR | POLLNVAL)) != 0;
+            if (!gone && (re & (POLLIN | POLLHUP))) {
+                ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+                gone = n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR);
+            }
+            if (!gone && (re & POLLOUT) && c->out) gone = !StartSend(s, c);
+            if (gone) dead.push_back(c);
+        }
+        for (MirrorClient* c : dead) DropClient(s, c);
+
+        if (pfds[1].revents & POLLIN) {
+            for (;;) {
+                int fd = accept(s->listenFd, nullptr, nullptr);
+                if (fd < 0) break;
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                MirrorClient* c = new MirrorClient();
+                c->fd = fd;
+                s->clients.push_back(c);
+                CountAccepted(s);
+            }
+        }
+        Absorb(s);
+        Service(s);
+    }
+}
+
+static void Shutdown(MirrorServer* s) {
+    while (!s->clients.empty()) DropClient(s, s->clients.back());
+    close(s->listenFd);
+    close(s->wake[0]);
+    close(s->wake[1]);
+    unlink(s->endpoint.c_str());
+}
+
+#endif
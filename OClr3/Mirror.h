@@ -0,0 +1,70 @@
+﻿#pragma once
+
+// Зеркало поля для тех, кто не может отобразить разделяемую память:
+// Unix-сокет (POSIX) или именованный канал (Windows), только на отправку.
+//
+// Окно отдаёт серверу то же, что само получило от SharedRefreshSnapshot
+// (MirrorPublish из UpdateFromShared): изменившиеся клетки или, при смене
+// цветов и размера, весь снимок. Это короткое копирование под мьютексом —
+// окно клиентов не ждёт никогда. Рассылает свой поток сервера.
+//
+// Протокол — сообщения MirrorHeader + тело, всё little-endian:
+//   MIRROR_FULL  — MirrorState, затем слова клеток (по 2 бита на клетку,
+//                  как в SharedCells); шлётся при подключении, смене
+//                  размера и когда клиент отстал дальше журнала сервера.
+//   MIRROR_DELTA — MirrorState, uint32 fromVersion, uint32 count, затем
+//                  count varint-ов ((разность индексов << 2) | значение)
+//                  по возрастанию клеток; первая разность — от 0.
+// Клиенту, у которого не ушло прошлое сообщение, новые не копятся: когда
+// он освободится, всё накопленное уйдёт одной дельтой, по клетке один раз.
+
+#include "SharedGrid.h"
+
+#ifdef _WIN32
+#define MIRROR_ENDPOINT "\\\\.\\pipe\\GridMirror"
+#else
+#define MIRROR_ENDPOINT "/tmp/grid-mirror.sock"
+#endif
+
+#define MIRROR_MAGIC 0x524D4D47u       // "GMMR"
+
+enum { MIRROR_FULL = 1, MIRROR_DELTA = 2 };
+
+#pragma pack(push, 1)
+struct MirrorHeader {
+    uint32_t magic;
+    uint32_t type;
+    uint32_t version;                  // версия поля после этого сообщения
+    uint32_t bytes;                    // тела после заголовка
+};
+
+struct MirrorState {
+    int32_t  gridSize;
+    uint32_t backgroundColor;
+    uint32_t gridColor;
+    int32_t  winLength;
+    int32_t  winner;
+    int32_t  winCell;
+    int32_t  winDir;
+};
+#pragma pack(pop)
+
+struct MirrorServer;
+
+struct MirrorStats {
+    uint32_t clients;                  // подключено сейчас
+    uint64_t accepted;                 // подключений всего
+    uint64_t updates;                  // MirrorPublish
+    uint64_t messages;
+    uint64_t fullMessages;
+    uint64_t coalesced;                // дельт, покрывших несколько обновлений сразу
+    uint64_t bytes;
+};
+
+// Слушает endpoint; snap — поле на момент запуска. nullptr — не вышло.
+MirrorServer* MirrorStart(const char* endpoint, const GridSnapshot* snap);
+void          MirrorStop(MirrorServer* s);
+// Новое состояние поля: full — snap перечитан целиком (цвета или размер),
+// иначе изменились только клетки delta
+void          MirrorPublish(MirrorServer* s, const GridSnapshot* snap, const GridDelta* delta, bool full);
+MirrorStats   MirrorGetStats(MirrorServer* s);
@@ -0,0 +1,188 @@
+﻿#include "MoveQueue.h"
+#include "Platform.h"
+
+#include <chrono>
+#include <mutex>
+
+static std::mutex     statsLock;
+static MoveQueueStats stats;
+
+#define MOVE_STALL_SPINS  4096      // ожиданий до проверки, живы ли разборщик и авторы
+#define MOVE_BACKOFF_MAX  16        // ожиданий между попытками разбора, не больше
+#define MOVE_ORPHAN_MS    1000      // номер взят, а claim так и не появился
+
+// state свободного слота на круге заявки t. Считается от t в uint32_t,
+// поэтому при переполнении номера круги сходятся сами. Дальше на круге:
+// +1 — заявка опубликована, +2 — итог готов, +3 — разборщик пропускает
+// заявку и пишет её итог сам.
+static inline uint32_t LapTag(uint32_t t) {
+    return t / MOVE_QUEUE_SLOTS * 4;
+}
+
+// Заявка в голове не опубликована, хотя номер взят. Если взявший умер (или
+// так и не отметился в claim за MOVE_ORPHAN_MS), ход получает
+// MOVE_DROPPED и очередь идёт дальше. Слот сначала забирается CAS-ом в
+// +3 и только потом заполняется: автор, успевший опубликовать заявку,
+// выигрывает, и его pid никто не затирает. Живой автор, опоздавший с
+// публикацией, дождётся итога пропуска и заберёт его сам.
+static bool SkipAbandoned(SharedMoveQueue& q, uint32_t head, uint32_t waitedMs) {
+    if (q.tail.load(std::memory_order_acquire) == head) return false;   // номер никто не брал
+    SharedMoveSlot& s = q.slots[head % MOVE_QUEUE_SLOTS];
+    uint32_t tag = LapTag(head);
+    uint32_t st = s.state.load(std::memory_order_acquire);
+    // прошлый круг слота не забран, и забирать некому
+    if (st == LapTag(head - MOVE_QUEUE_SLOTS) + 2) {
+        uint32_t prevPid = s.pid.load(std::memory_order_relaxed);
+        if (!prevPid || !ProcessAlive(prevPid)) s.state.compare_exchange_strong(st, tag, std::memory_order_acq_rel);
+    }
+
+    uint64_t c = s.claim.load(std::memory_order_acquire);
+    uint32_t pid = (uint32_t)(c >> 32) == head ? (uint32_t)c : 0;
+    if (st == tag) {
+        if (pid ? ProcessAlive(pid) : waitedMs < MOVE_ORPHAN_MS) return false;
+        if (!s.state.compare_exchange_strong(st, tag + 3, std::memory_order_acq_rel)) return false;   // автор успел
+    }
+    // +3 — прошлый разборщик умер посреди пропуска: разбираем теперь мы, доводим
+    else if (st != tag + 3) {
+        return false;
+    }
+    s.pid.store(pid, std::memory_order_relaxed);
+    s.result = MOVE_DROPPED;
+    s.version = 0;
+    s.state.store(tag + 2, std::memory_order_release);
+    q.head.store(head + 1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> g(statsLock);
+    stats.abandoned++;
+    return true;
+}
+
+// Разобрать всё, что лежит в кольце подряд от head. false — разбирает другой.
+// check — вызывающий ждёт долго: можно проверить pid разборщика и автора
+// заявки в голове (это системные вызовы); waitedMs — сколько он ждёт.
+static bool Drain(SharedMapping* m, bool check, uint32_t waitedMs) {
+    SharedMoveQueue& q = m->data->moves;
+    uint32_t self = SelfPid();
+    uint32_t owner = 0;
+    if (!q.consumer.compare_exchange_strong(owner, self, std::memory_order_acquire)) {
+        // разборщик умер посреди работы — его место свободно
+        if (!check || owner == self || ProcessAlive(owner)) return false;
+        if (!q.consumer.compare_exchange_strong(owner, self, std::memory_order_acquire)) return false;
+    }
+
+    MoveRequest batch[MOVE_QUEUE_SLOTS];
+    for (;;) {
+        uint32_t head = q.head.load(std::memory_order_relaxed);
+        int n = 0;
+        for (; n < MOVE_QUEUE_SLOTS; n++) {
+            uint32_t t = head + n;
+            const SharedMoveSlot& s = q.slots[t % MOVE_QUEUE_SLOTS];
+            if (s.state.load(std::memory_order_acquire) != LapTag(t) + 1) break;
+            batch[n].cell = s.cell;
+            batch[n].player = s.player;
+            batch[n].result = MOVE_PENDING;
+        }
+        if (n == 0) {
+            if (check && SkipAbandoned(q, head, waitedMs)) continue;
+            break;
+        }
+
+        uint32_t v = SharedApplyMoves(m, batch, n);
+        for (int i = 0; i < n; i++) {
+            uint32_t t = head + i;
+            SharedMoveSlot& s = q.slots[t % MOVE_QUEUE_SLOTS];
+            s.result = batch[i].result;
+            s.version = v;
+            s.state.store(LapTag(t) + 2, std::memory_order_release);
+        }
+        q.head.store(head + n, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> g(statsLock);
+        stats.batches++;
+        stats.batchMoves += n;
+    }
+    // заявка, поданная после последней проверки, разберёт себя сама:
+    // её автор после публикации тоже зовёт Drain
+    q.consumer.store(0, std::memory_order_release);
+    return true;
+}
+
+static uint32_t MsSince(std::chrono::steady_clock::time_point t0) {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+}
+
+int MoveSubmit(SharedMapping* m, int cell, int player, uint32_t* version) {
+    SharedMoveQueue& q = m->data->moves;
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t self = SelfPid();
+    uint32_t t = q.tail.fetch_add(1, std::memory_order_relaxed);
+    SharedMoveSlot& s = q.slots[t % MOVE_QUEUE_SLOTS];
+    uint32_t tag = LapTag(t), prev = LapTag(t - MOVE_QUEUE_SLOTS);
+    bool claimed = false;
+
+    // ждём, пока слот освободится с прошлого круга, и публикуем заявку
+    for (uint32_t spins = 1; ; spins++) {
+        uint32_t st = s.state.load(std::memory_order_acquire);
+        // claim прошлого круга нужен, только пока тот не опубликован
+        if (!claimed && (int32_t)(st - prev) > 0) {
+            s.claim.store((uint64_t)t << 32 | self, std::memory_order_release);
+            claimed = true;
+        }
+        if (st == tag) {
+            s.pid.store(self, std::memory_order_relaxed);
+            s.cell = cell;
+            s.player = player;
+            if (s.state.compare_exchange_strong(st, tag + 1, std::memory_order_release)) break;
+        }
+        // разборщик счёл заявку брошенной: итог пропуска ждём, как свой
+        if ((int32_t)(st - tag) >= 2) break;
+        // автор прошлого круга умер, не забрав итог
+        if (spins % MOVE_STALL_SPINS == 0 && st == prev + 2) {
+            uint32_t prevPid = s.pid.load(std::memory_order_relaxed);
+            if (!prevPid || !ProcessAlive(prevPid)) s.state.compare_exchange_strong(st, tag, std::memory_order_acq_rel);
+        }
+        if (spins > 64) ThreadYield();
+    }
+
+    // Разбирать пробуем не на каждом круге ожидания: после неудачи — через
+    // вдвое больший промежуток, а pid проверяем раз в MOVE_STALL_SPINS
+    uint32_t backoff = 1, nextDrain = 0, st;
+    for (uint32_t spins = 0; (st = s.state.load(std::memory_order_acquire)) != tag + 2; spins++) {
+        // слот уже на следующем круге: итог пропуска забрал не автор
+        if ((int32_t)(st - tag) > 3) break;
+        bool check = spins && spins % MOVE_STALL_SPINS == 0;
+        if (spins >= nextDrain || check) {
+            if (Drain(m, check, check ? MsSince(t0) : 0)) backoff = 1;
+            else if (backoff < MOVE_BACKOFF_MAX) backoff *= 2;
+            nextDrain = spins + backoff;
+        }
+        if (spins > 64) ThreadYield();
+    }
+    int result = MOVE_DROPPED;
+    if (version) *version = 0;
+    if (st == tag + 2) {
+        int r = s.result;
+        uint32_t v = s.version;
+        // итог пропуска (pid 0) мог уже освободить автор следующего круга —
+        // тогда прочитанное могло быть чужим
+        if (s.state.compare_exchange_strong(st, LapTag(t + MOVE_QUEUE_SLOTS), std::memory_order_acq_rel)) {
+            result = r;
+            if (version) *version = v;
+        }
+    }
+
+    uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::lock_guard<std::mutex> g(statsLock);
+    stats.submitted++;
+    if (result == MOVE_ACCEPTED) stats.accepted++;
+    else stats.rejected++;
+    stats.waitUsLast = us;
+    if (us > stats.waitUsMax) stats.waitUsMax = us;
+    return result;
+}
+
+MoveQueueStats MoveQueueGetStats() {
+    std::lock_guard<std::mutex> g(statsLock);
+    return stats;
+}
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+// Подача ходов через очередь в разделяемой памяти.
+//
+// Заявки ставятся в кольцо SharedData::moves без блокировок: номер берётся
+// fetch_add-ом на tail, слот заполняется и публикуется сменой state.
+// Разбирает кольцо по порядку номеров тот, кто первым захватит consumer
+// (CAS 0 -> свой pid) — обычно один из ждущих авторов. Он применяет всю
+// накопившуюся пачку одной версией поля (SharedApplyMoves): клетка
+// должна быть пуста и ход должен быть того игрока, чья очередь.
+// Итог разборщик кладёт обратно в слот, автор видит его по state и
+// освобождает слот сам — никто из авторов не держит блокировку.
+//
+// Умерший разборщик или автор, бросивший слот, подменяются по проверке pid.
+// Номер заявки вместе с pid взявшего лежит в слоте (claim) ещё до
+// публикации: заявку умершего автора разборщик пропускает с
+// MOVE_DROPPED, а не ждёт её вечно. Без claim заявка пропускается только
+// через MOVE_ORPHAN_MS (MoveQueue.cpp): автор мог умереть, не успев его
+// записать, но мог и просто стоять — тогда он получит MOVE_DROPPED и
+// сможет подать ход заново. pid проверяются только после
+// долгого ожидания, а ждущие авторы пробуют разбирать с нарастающей паузой.
+
+#include "SharedGrid.h"
+
+struct MoveQueueStats {
+    uint64_t submitted;
+    uint64_t accepted;
+    uint64_t rejected;
+    uint64_t batches;                  // пачек разобрано этим процессом
+    uint64_t batchMoves;               // ходов в них
+    uint64_t abandoned;                // заявок умерших авторов пропущено этим процессом
+    uint32_t waitUsLast;               // от подачи до итога
+    uint32_t waitUsMax;
+};
+
+// Подать ход и дождаться итога (MoveResult). version — версия поля,
+// в которой ход разобран, может быть nullptr.
+int  MoveSubmit(SharedMapping* m, int cell, int player, uint32_t* version);
+
+// Счётчики этого процесса
+MoveQueueStats MoveQueueGetStats();
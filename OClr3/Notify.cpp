@@ -0,0 +1,155 @@
+﻿#include "Notify.h"
+#include "Platform.h"
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+// ——————————————————————————————— Платформа ——————————————————————————————————————
+#ifdef _WIN32
+
+static void EventName(char* out, size_t n, SharedMapping* m, int slot) {
+    snprintf(out, n, "%s.evt.%d", m->name, slot);
+}
+
+// Хэндлы событий слотов кэшируются в маппинге по паре (слот, pid):
+// открывать событие на каждое уведомление — лишний системный вызов.
+// Вызывать под m->slotEventsLock.
+static HANDLE SlotEvent(SharedMapping* m, int slot, uint32_t pid, bool create) {
+    if (m->slotEvents[slot] && m->slotEventPid[slot] == pid) return m->slotEvents[slot];
+    if (m->slotEvents[slot]) CloseHandle(m->slotEvents[slot]);
+    char name[96]; EventName(name, sizeof(name), m, slot);
+    m->slotEvents[slot] = create
+        ? CreateEventA(nullptr, FALSE, FALSE, name)
+        : OpenEventA(EVENT_MODIFY_STATE, FALSE, name);
+    m->slotEventPid[slot] = m->slotEvents[slot] ? pid : 0;
+    return m->slotEvents[slot];
+}
+
+// Чужой хэндл может закрыть другой поток, увидевший в слоте новый pid,
+// поэтому SetEvent — не выходя из-под блокировки
+static void WakeSlot(SharedMapping* m, int slot, uint32_t pid) {
+    AcquireSRWLockExclusive(&m->slotEventsLock);
+    HANDLE h = SlotEvent(m, slot, pid, false);
+    if (h) SetEvent(h);
+    ReleaseSRWLockExclusive(&m->slotEventsLock);
+}
+
+// Свой слот всегда с нашим pid, так что его хэндл не заменяется и живёт
+// до ReleaseSlot: ждать на нём можно без блокировки
+static void WaitSlot(SharedMapping* m, int slot, uint32_t, int timeoutMs) {
+    AcquireSRWLockExclusive(&m->slotEventsLock);
+    HANDLE h = SlotEvent(m, slot, SelfPid(), true);
+    ReleaseSRWLockExclusive(&m->slotEventsLock);
+    if (h) WaitForSingleObject(h, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs);
+}
+
+static void PrepareSlot(SharedMapping* m, int slot) {
+    AcquireSRWLockExclusive(&m->slotEventsLock);
+    SlotEvent(m, slot, SelfPid(), true);
+    ReleaseSRWLockExclusive(&m->slotEventsLock);
+}
+
+static void ReleaseSlot(SharedMapping* m, int slot) {
+    AcquireSRWLockExclusive(&m->slotEventsLock);
+    if (m->slotEvents[slot]) CloseHandle(m->slotEvents[slot]);
+    m->slotEvents[slot] = nullptr;
+    m->slotEventPid[slot] = 0;
+    ReleaseSRWLockExclusive(&m->slotEventsLock);
+}
+
+#else
+
+static void WakeSlot(SharedMapping* m, int slot, uint32_t) {
+#ifdef __linux__
+    // без FUTEX_PRIVATE_FLAG: слово лежит в разделяемой памяти разных процессов
+    syscall(SYS_futex, &m->data->subscribers[slot].wake, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+    (void)m; (void)slot;
+#endif
+}
+
+static void WaitSlot(SharedMapping* m, int slot, uint32_t seen, int timeoutMs) {
+#ifdef __linux__
+    struct timespec ts, * pts = nullptr;
+    if (timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (long)(timeoutMs % 1000) * 1000000;
+        pts = &ts;
+    }
+    syscall(SYS_futex, &m->data->subscribers[slot].wake, FUTEX_WAIT, seen, pts, nullptr, 0);
+#else
+    // без futex — короткий опрос
+    (void)m; (void)slot; (void)seen;
+    if (timeoutMs != 0) usleep(1000);
+#endif
+}
+
+static void PrepareSlot(SharedMapping*, int) {
+}
+
+static void ReleaseSlot(SharedMapping*, int) {
+}
+
+#endif
+
+// ——————————————————————————————— Реестр ——————————————————————————————————————
+
+int NotifySubscribe(SharedMapping* m) {
+    uint32_t self = SelfPid();
+    SharedSubscriber* subs = m->data->subscribers;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < GRID_MAX_SUBSCRIBERS; i++) {
+            uint32_t owner = subs[i].pid.load(std::memory_order_relaxed);
+            // второй проход забирает слоты процессов, которые упали не отписавшись
+            if (owner != 0 && (pass == 0 || ProcessAlive(owner))) continue;
+            if (subs[i].pid.compare_exchange_strong(owner, self, std::memory_order_acq_rel)) {
+                PrepareSlot(m, i);
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void NotifyUnsubscribe(SharedMapping* m, int slot) {
+    if (slot < 0 || slot >= GRID_MAX_SUBSCRIBERS) return;
+    ReleaseSlot(m, slot);
+    m->data->subscribers[slot].pid.store(0, std::memory_order_release);
+}
+
+void NotifyWake(SharedMapping* m, int slot) {
+    SharedSubscriber& s = m->data->subscribers[slot];
+    uint32_t pid = s.pid.load(std::memory_order_acquire);
+    if (!pid) return;
+    s.wake.fetch_add(1, std::memory_order_release);
+    WakeSlot(m, slot, pid);
+}
+
+void NotifyAll(SharedMapping* m, int exceptSlot) {
+    for (int i = 0; i < GRID_MAX_SUBSCRIBERS; i++)
+        if (i != exceptSlot) NotifyWake(m, i);
+}
+
+uint32_t NotifySeen(SharedMapping* m, int slot) {
+    return m->data->subscribers[slot].wake.load(std::memory_order_acquire);
+}
+
+bool NotifyWait(SharedMapping* m, int slot, uint32_t* seen, int timeoutMs) {
+    SharedSubscriber& s = m->data->subscribers[slot];
+    uint32_t cur = s.wake.load(std::memory_order_acquire);
+    if (cur == *seen) {
+        WaitSlot(m, slot, *seen, timeoutMs);
+        cur = s.wake.load(std::memory_order_acquire);
+    }
+    if (cur == *seen) return false;
+    *seen = cur;
+    return true;
+}
@@ -0,0 +1,23 @@
+﻿#pragma once
+
+// Уведомления об изменениях поля только для экземпляров сетки.
+// Каждый экземпляр занимает слот в SharedData::subscribers и ждёт на своём
+// примитиве: futex на слове wake (Linux) или именованное событие (Windows).
+// Писатель будит подписчиков и никогда не ждёт их сам.
+
+#include "SharedGrid.h"
+
+// Занимает свободный слот (или слот умершего процесса). -1, если мест нет.
+int      NotifySubscribe(SharedMapping* m);
+void     NotifyUnsubscribe(SharedMapping* m, int slot);
+
+// Разбудить всех подписчиков, кроме exceptSlot (-1 — всех)
+void     NotifyAll(SharedMapping* m, int exceptSlot);
+// Разбудить один слот (например, чтобы свой поток ожидания вышел)
+void     NotifyWake(SharedMapping* m, int slot);
+
+// Текущее значение счётчика слота — отправная точка для NotifyWait
+uint32_t NotifySeen(SharedMapping* m, int slot);
+// Ждёт, пока счётчик слота уйдёт от *seen. timeoutMs < 0 — без таймаута.
+// true — было пробуждение, *seen обновлён.
+bool     NotifyWait(SharedMapping* m, int slot, uint32_t* seen, int timeoutMs);
@@ -0,0 +1,50 @@
+﻿#include "Platform.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+uint32_t SelfPid() {
+    return (uint32_t)GetCurrentProcessId();
+}
+
+bool ProcessAlive(uint32_t pid) {
+    HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!h) return GetLastError() == ERROR_ACCESS_DENIED;
+    bool alive = WaitForSingleObject(h, 0) == WAIT_TIMEOUT;
+    CloseHandle(h);
+    return alive;
+}
+
+void ThreadYield() {
+    SwitchToThread();
+}
+
+void SleepMs(uint32_t ms) {
+    Sleep(ms);
+}
+
+#else
+
+uint32_t SelfPid() {
+    return (uint32_t)getpid();
+}
+
+bool ProcessAlive(uint32_t pid) {
+    return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+}
+
+void ThreadYield() {
+    sched_yield();
+}
+
+void SleepMs(uint32_t ms) {
+    usleep((useconds_t)ms * 1000);
+}
+
+#endif
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+// Минимальная прослойка, чтобы общий код собирался и без <windows.h>.
+// Под Windows берём настоящие COLORREF/RGB, под POSIX — совместимые
+// по раскладке определения (0x00BBGGRR). Тут же — процессы и потоки
+// для модулей разделяемой памяти (Platform.cpp).
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+typedef uint32_t COLORREF;
+#define RGB(r, g, b)   ((COLORREF)(((uint8_t)(r)) | ((uint32_t)((uint8_t)(g)) << 8) | ((uint32_t)((uint8_t)(b)) << 16)))
+#define GetRValue(c)   ((uint8_t)(c))
+#define GetGValue(c)   ((uint8_t)((c) >> 8))
+#define GetBValue(c)   ((uint8_t)((c) >> 16))
+#endif
+
+uint32_t SelfPid();
+// Жив ли процесс pid. Сомнение — в пользу живого: мёртвым считается только
+// тот, кого система точно не знает (ESRCH; под Windows — не открывается
+// и не из-за прав). Чужой слот по ошибке не отберётся, но процесс,
+// оставивший зомби, жив, пока родитель не дождался его.
+bool     ProcessAlive(uint32_t pid);
+// Отдать квант другим потокам
+void     ThreadYield();
+void     SleepMs(uint32_t ms);
@@ -0,0 +1,359 @@
+﻿#include "Render.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RENDER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define TARGET_AVX2
+#define TARGET_SSE2
+#endif
+
+#define CELL_PADDING 5      // отступ O/X от границ клетки, как в WM_PAINT
+#define O_FILL_COLOR 0x00FFFFFF   // белая кисть GDI по умолчанию
+
+// ——————————————————————————————— Ядра заливки ——————————————————————————————————————
+
+static void FillSpanScalar(uint32_t* dst, int count, uint32_t color) {
+    for (int i = 0; i < count; i++) dst[i] = color;
+}
+
+#ifdef RENDER_X86
+TARGET_SSE2 static void FillSpanSSE2(uint32_t* dst, int count, uint32_t color) {
+    __m128i v = _mm_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    for (; i < count; i++) dst[i] = color;
+}
+
+TARGET_AVX2 static void FillSpanAVX2(uint32_t* dst, int count, uint32_t color) {
+    __m256i v = _mm256_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+        _mm256_storeu_si256((__m256i*)(dst + i + 8), v);
+    }
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    for (; i < count; i++) dst[i] = color;
+}
+
+bool RenderCpuHasAVX2() {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuid(r, 0);
+    if (r[0] < 7) return false;
+    __cpuid(r, 1);
+    // OSXSAVE + AVX, и ОС сохраняет YMM-регистры
+    if ((r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0) return false;
+    if ((_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(r, 7, 0);
+    return (r[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+typedef void (*FillSpanFn)(uint32_t*, int, uint32_t);
+static FillSpanFn fillSpan = nullptr;
+
+RenderKernel RenderSetKernel(RenderKernel k) {
+#ifdef RENDER_X86
+    if (k == KERNEL_AUTO) k = RenderCpuHasAVX2() ? KERNEL_AVX2 : KERNEL_SSE2;
+    if (k == KERNEL_AVX2 && !RenderCpuHasAVX2()) k = KERNEL_SSE2;
+    switch (k) {
+    case KERNEL_AVX2: fillSpan = FillSpanAVX2; break;
+    case KERNEL_SSE2: fillSpan = FillSpanSSE2; break;
+    default:          fillSpan = FillSpanScalar; k = KERNEL_SCALAR; break;
+    }
+#else
+    k = KERNEL_SCALAR;
+    fillSpan = FillSpanScalar;
+#endif
+    return k;
+}
+
+const char* RenderKernelName(RenderKernel k) {
+    switch (k) {
+    case KERNEL_AVX2:   return "avx2";
+    case KERNEL_SSE2:   return "sse2";
+    case KERNEL_SCALAR: return "scalar";
+    default:            return "auto";
+    }
+}
+
+void FillSpan(uint32_t* dst, int count, uint32_t color) {
+    if (!fillSpan) RenderSetKernel(KERNEL_AUTO);
+    fillSpan(dst, count, color);
+}
+
+// ——————————————————————————————— Буфер ——————————————————————————————————————
+
+void FramebufferResize(Framebuffer* fb, int width, int height) {
+    if (width < 0) width = 0;
+    if (height < 0) height = 0;
+    size_t need = (size_t)width * height;
+    if (need > fb->capPixels) {
+        free(fb->pixels);
+        fb->pixels = (uint32_t*)malloc(need * sizeof(uint32_t));
+        fb->capPixels = fb->pixels ? need : 0;
+        if (!fb->pixels) width = height = 0;
+    }
+    fb->width = width;
+    fb->height = height;
+}
+
+void FramebufferFree(Framebuffer* fb) {
+    free(fb->pixels);
+    fb->pixels = nullptr;
+    fb->capPixels = 0;
+    fb->width = fb->height = 0;
+}
+
+GridLayout GridLayoutMake(int gridSize, int width, int height) {
+    GridLayout l;
+    l.gridSize = gridSize < 1 ? 1 : gridSize;
+    l.width = width;
+    l.height = height;
+    l.cw = width / l.gridSize;
+    l.ch = height / l.gridSize;
+    // поле крупнее окна — по пикселю на клетку, остальное обрежется
+    if (l.cw < 1) l.cw = 1;
+    if (l.ch < 1) l.ch = 1;
+    return l;
+}
+
+RenderClip GridCellBounds(const GridLayout* lay, int index) {
+    int x0 = (index % lay->gridSize) * lay->cw, y0 = (index / lay->gridSize) * lay->ch;
+    // +1 — линия сетки справа/снизу принадлежит соседу, но задевается пером
+    RenderClip r = { x0, y0, x0 + lay->cw + 1, y0 + lay->ch + 1 };
+    if (lay->cw <= 2 * CELL_PADDING) { r.left -= CELL_PADDING; r.right += CELL_PADDING; }
+    if (lay->ch <= 2 * CELL_PADDING) { r.top -= CELL_PADDING; r.bottom += CELL_PADDING; }
+    return r;
+}
+
+// ——————————————————————————————— Примитивы ——————————————————————————————————————
+
+// COLORREF (0x00BBGGRR) -> пиксель DIB (0x00RRGGBB)
+static uint32_t PixelOf(COLORREF c) {
+    return ((uint32_t)GetRValue(c) << 16) | ((uint32_t)GetGValue(c) << 8) | GetBValue(c);
+}
+
+// Куда рисуем и сколько пикселей уже записано
+struct Target {
+    Framebuffer* fb;
+    RenderClip   clip;
+    uint64_t     pixels;
+};
+
+// Горизонтальный пролёт [x0, x1) в строке y
+static void HSpan(Target* t, int y, int x0, int x1, uint32_t color) {
+    const RenderClip* clip = &t->clip;
+    if (y < clip->top || y >= clip->bottom) return;
+    if (x0 < clip->left) x0 = clip->left;
+    if (x1 > clip->right) x1 = clip->right;
+    if (x1 <= x0) return;
+    fillSpan(t->fb->pixels + (size_t)y * t->fb->width + x0, x1 - x0, color);
+    t->pixels += (uint64_t)(x1 - x0);
+}
+
+// Вертикальная линия [y0, y1) в столбце x
+static void VLine(Target* t, int x, int y0, int y1, uint32_t color) {
+    const RenderClip* clip = &t->clip;
+    if (x < clip->left || x >= clip->right) return;
+    if (y0 < clip->top) y0 = clip->top;
+    if (y1 > clip->bottom) y1 = clip->bottom;
+    if (y1 <= y0) return;
+    int w = t->fb->width;
+    uint32_t* p = t->fb->pixels + (size_t)y0 * w + x;
+    for (int y = y0; y < y1; y++, p += w) *p = color;
+    t->pixels += (uint64_t)(y1 - y0);
+}
+
+static void Plot(Target* t, int x, int y, uint32_t color) {
+    const RenderClip* clip = &t->clip;
+    if (x >= clip->left && x < clip->right && y >= clip->top && y < clip->bottom) {
+        t->fb->pixels[(size_t)y * t->fb->width + x] = color;
+        t->pixels++;
+    }
+}
+
+// Брезенхем, конечная точка не рисуется — как у LineTo
+static void RasterLine(Target* tg, int x0, int y0, int x1, int y1, uint32_t color) {
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    while (x0 != x1 || y0 != y1) {
+        Plot(tg, x0, y0, color);
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x0 += sx; }
+        if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+}
+
+// Половина ширины эллипса с полуосями rx, ry на высоте dy от центра
+static bool EllipseSpan(double cx, double rx, double ry, double dy, int* x0, int* x1) {
+    if (rx <= 0 || ry <= 0) return false;
+    double t = dy / ry;
+    if (t <= -1 || t >= 1) return false;
+    double half = rx * sqrt(1 - t * t);
+    *x0 = (int)ceil(cx - half - 0.5);
+    *x1 = (int)floor(cx + half - 0.5) + 1;
+    return *x1 > *x0;
+}
+
+// Эллипс в рамке [l, r) x [t, b): контур цветом пера, внутри белая кисть
+static void RasterEllipse(Target* tg, int l, int t, int r, int b, uint32_t pen) {
+    if (r - l < 2 || b - t < 2) return;
+    int y0 = t > tg->clip.top ? t : tg->clip.top;
+    int y1 = b < tg->clip.bottom ? b : tg->clip.bottom;
+    double cx = (l + r) * 0.5, cy = (t + b) * 0.5;
+    double rx = (r - l) * 0.5, ry = (b - t) * 0.5;
+    for (int y = y0; y < y1; y++) {
+        double dy = y + 0.5 - cy;
+        int ox0, ox1, ix0, ix1;
+        if (!EllipseSpan(cx, rx, ry, dy, &ox0, &ox1)) continue;
+        HSpan(tg, y, ox0, ox1, pen);
+        if (EllipseSpan(cx, rx - 1, ry - 1, dy, &ix0, &ix1))
+            HSpan(tg, y, ix0, ix1, O_FILL_COLOR);
+    }
+}
+
+// ——————————————————————————————— Кадр ——————————————————————————————————————
+
+uint64_t RenderGrid(Framebuffer* fb, const GridSnapshot* snap, const GridLayout* lay, const RenderClip* in,
+    const uint32_t* cellPixels)
+{
+    if (!fillSpan) RenderSetKernel(KERNEL_AUTO);
+    Target tg = { fb, *in, 0 };
+    RenderClip& clip = tg.clip;
+    if (clip.left < 0) clip.left = 0;
+    if (clip.top < 0) clip.top = 0;
+    if (clip.right > fb->width) clip.right = fb->width;
+    if (clip.bottom > fb->height) clip.bottom = fb->height;
+    if (clip.right <= clip.left || clip.bottom <= clip.top) return 0;
+
+    int sz = lay->gridSize, cw = lay->cw, ch = lay->ch;
+    uint32_t bg = PixelOf(snap->backgroundColor);
+    uint32_t pen = PixelOf(snap->gridColor);
+
+    // Фон; со слоем цветов — пролёт на клетку её цветом, фон только за полем
+    if (!cellPixels) {
+        for (int y = clip.top; y < clip.bottom; y++)
+            HSpan(&tg, y, clip.left, clip.right, bg);
+    }
+    else {
+        int fc1 = (clip.right - 1) / cw;
+        if (fc1 >= sz) fc1 = sz - 1;
+        for (int y = clip.top; y < clip.bottom; y++) {
+            int r = y / ch;
+            if (r >= sz) {
+                HSpan(&tg, y, clip.left, clip.right, bg);
+                continue;
+            }
+            const uint32_t* row = cellPixels + (size_t)r * sz;
+            for (int c = clip.left / cw; c <= fc1; c++)
+                HSpan(&tg, y, c * cw, c * cw + cw, row[c]);
+            if (sz * cw < clip.right) HSpan(&tg, y, sz * cw, clip.right, bg);
+        }
+    }
+
+    // Сетка: только линии, попадающие в clip
+    int i0 = clip.left / cw, i1 = clip.right / cw;
+    for (int i = i0; i <= i1 && i <= sz; i++)
+        VLine(&tg, i * cw, 0, lay->height, pen);
+    i0 = clip.top / ch; i1 = clip.bottom / ch;
+    for (int i = i0; i <= i1 && i <= sz; i++)
+        HSpan(&tg, i * ch, 0, lay->width, pen);
+
+    // Клетки, пересекающие clip. В клетках уже 2*CELL_PADDING значок
+    // вылезает за свою клетку (как и у GDI), поэтому берём соседей с запасом
+    int mx = cw > 2 * CELL_PADDING ? 0 : CELL_PADDING / cw + 1;
+    int my = ch > 2 * CELL_PADDING ? 0 : CELL_PADDING / ch + 1;
+    int r0 = clip.top / ch - my, r1 = (clip.bottom - 1) / ch + my;
+    int c0 = clip.left / cw - mx, c1 = (clip.right - 1) / cw + mx;
+    if (r0 < 0) r0 = 0;
+    if (c0 < 0) c0 = 0;
+    if (r1 >= sz) r1 = sz - 1;
+    if (c1 >= sz) c1 = sz - 1;
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int v = GridCellGet(snap->cells, r * sz + c);
+            if (v == CELL_EMPTY) continue;
+            int x0 = c * cw, y0 = r * ch;
+            int l = x0 + CELL_PADDING, t = y0 + CELL_PADDING;
+            int rr = x0 + cw - CELL_PADDING, b = y0 + ch - CELL_PADDING;
+            if (v == CELL_O) RasterEllipse(&tg, l, t, rr, b, pen);
+            else if (v == CELL_X) {
+                RasterLine(&tg, l, t, rr, b, pen);
+                RasterLine(&tg, l, b, rr, t, pen);
+            }
+        }
+    }
+    return tg.pixels;
+}
+
+// ——————————————————————————————— Тайлы ——————————————————————————————————————
+
+struct TileJob {
+    Framebuffer*          fb;
+    const GridSnapshot*   snap;
+    const GridLayout*     lay;
+    RenderClip            clip;
+    int                   tileSize;
+    int                   tilesX;
+    const uint32_t*       cellPixels;
+    std::atomic<uint64_t> pixels;
+};
+
+static void RenderTile(int index, void* ctx) {
+    TileJob* job = (TileJob*)ctx;
+    RenderClip t;
+    t.left = job->clip.left + (index % job->tilesX) * job->tileSize;
+    t.top = job->clip.top + (index / job->tilesX) * job->tileSize;
+    t.right = t.left + job->tileSize < job->clip.right ? t.left + job->tileSize : job->clip.right;
+    t.bottom = t.top + job->tileSize < job->clip.bottom ? t.top + job->tileSize : job->clip.bottom;
+    uint64_t n = RenderGrid(job->fb, job->snap, job->lay, &t, job->cellPixels);
+    job->pixels.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t RenderGridTiled(ThreadPool* pool, Framebuffer* fb, const GridSnapshot* snap,
+    const GridLayout* lay, const RenderClip* clip, int tileSize, const uint32_t* cellPixels)
+{
+    // ядро выбираем до запуска потоков, а не наперегонки в них
+    if (!fillSpan) RenderSetKernel(KERNEL_AUTO);
+    if (tileSize < 16) tileSize = RENDER_TILE_SIZE;
+
+    RenderClip c = *clip;
+    if (c.left < 0) c.left = 0;
+    if (c.top < 0) c.top = 0;
+    if (c.right > fb->width) c.right = fb->width;
+    if (c.bottom > fb->height) c.bottom = fb->height;
+    if (c.right <= c.left || c.bottom <= c.top) return 0;
+
+    TileJob job;
+    job.fb = fb;
+    job.snap = snap;
+    job.lay = lay;
+    job.clip = c;
+    job.tileSize = tileSize;
+    job.cellPixels = cellPixels;
+    job.tilesX = (c.right - c.left + tileSize - 1) / tileSize;
+    job.pixels.store(0);
+    int tilesY = (c.bottom - c.top + tileSize - 1) / tileSize;
+    ThreadPoolRun(pool, job.tilesX * tilesY, RenderTile, &job);
+    return job.pixels.load();
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+// Программная отрисовка поля в память — та же картинка, что рисует GDI
+// в WM_PAINT (фон, линии сетки, O — эллипс с белой заливкой, X — крест),
+// но без окна. Пиксели 0x00RRGGBB сверху вниз, т.е. ровно формат
+// 32-битного top-down DIB: буфер можно сразу отдать в SetDIBitsToDevice.
+//
+// Горизонтальные пролёты (фон, линии, строки эллипсов) заливает ядро
+// AVX2/SSE2 со скалярным запасным вариантом; результат у всех ядер один.
+
+#include "SharedGrid.h"
+#include "ThreadPool.h"
+
+struct Framebuffer {
+    uint32_t* pixels;
+    int       width;
+    int       height;
+    size_t    capPixels;
+};
+
+void FramebufferResize(Framebuffer* fb, int width, int height);
+void FramebufferFree(Framebuffer* fb);
+
+// Раскладка клеток в клиентской области — те же формулы, что в WM_PAINT
+struct GridLayout {
+    int gridSize;
+    int width, height;      // клиентская область
+    int cw, ch;             // размер клетки, не меньше 1 пикселя
+};
+GridLayout GridLayoutMake(int gridSize, int width, int height);
+
+// Прямоугольник отсечения, правая/нижняя границы не включаются (как RECT)
+struct RenderClip {
+    int left, top, right, bottom;
+};
+
+// Все пиксели, которые может задеть отрисовка клетки index (включая линии
+// сетки по краям и значки, вылезающие из слишком мелких клеток)
+RenderClip GridCellBounds(const GridLayout* lay, int index);
+
+// Рисует поле из снимка в fb, затрагивая только пиксели внутри clip.
+// cellPixels — заливка каждой клетки вместо фона, уже пикселями DIB
+// (слой цветов, Color.h); nullptr — везде фон снимка.
+// Возвращает число записанных пикселей (с повторами).
+uint64_t RenderGrid(Framebuffer* fb, const GridSnapshot* snap, const GridLayout* lay, const RenderClip* clip,
+    const uint32_t* cellPixels = nullptr);
+
+// То же самое, но clip режется на тайлы tileSize x tileSize, которые
+// рисуются параллельно на pool. Каждый пиксель принадлежит ровно одному
+// тайлу, поэтому результат совпадает с RenderGrid бит в бит.
+#define RENDER_TILE_SIZE 128
+uint64_t RenderGridTiled(ThreadPool* pool, Framebuffer* fb, const GridSnapshot* snap,
+    const GridLayout* lay, const RenderClip* clip, int tileSize, const uint32_t* cellPixels = nullptr);
+
+// Ядро заливки пролётов
+enum RenderKernel { KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+// Выбор ядра (KERNEL_AUTO — лучшее из поддерживаемых процессором).
+// Возвращает реально выбранное.
+RenderKernel RenderSetKernel(RenderKernel k);
+const char*  RenderKernelName(RenderKernel k);
+bool         RenderCpuHasAVX2();
+
+void FillSpan(uint32_t* dst, int count, uint32_t color);
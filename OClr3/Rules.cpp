@@ -0,0 +1,197 @@
+﻿#include "Rules.h"
+#include "SharedGrid.h"
+
+static const int dirRow[4] = { 0, 1, 1, 1 };
+static const int dirCol[4] = { 1, 0, 1, -1 };
+
+int RulesWinLength(int gridSize, int k) {
+    if (k <= 0) k = WIN_DEFAULT_LENGTH;
+    return k < gridSize ? k : gridSize;
+}
+
+// Поля 3×3 … 10×10 встречаются почти всегда, для них ядра инстанцируются
+// с размером N как константой (N = 0 — размер берётся из n во время работы):
+// деление индекса на строку и шаги по линиям становятся константными.
+// Для них же полный перебор заменён битбордами — всё поле игрока в 128 бит.
+#define RULES_DISPATCH(fn, n, ...)                                  \
+    switch (sizeKernels ? n : 0) {                                  \
+    case 3:  return fn<3>(__VA_ARGS__);                             \
+    case 4:  return fn<4>(__VA_ARGS__);                             \
+    case 5:  return fn<5>(__VA_ARGS__);                             \
+    case 6:  return fn<6>(__VA_ARGS__);                             \
+    case 7:  return fn<7>(__VA_ARGS__);                             \
+    case 8:  return fn<8>(__VA_ARGS__);                             \
+    case 9:  return fn<9>(__VA_ARGS__);                             \
+    case 10: return fn<10>(__VA_ARGS__);                            \
+    default: return fn<0>(__VA_ARGS__);                             \
+    }
+
+static bool sizeKernels = true;        // false — всё через fn<0>, для сравнения
+
+void RulesUseSizeKernels(bool on) { sizeKernels = on; }
+
+// Сколько подряд клеток игрока p от (r, c) в направлении (dr, dc), не считая саму (r, c)
+template <int N>
+static int Run(const uint64_t* cells, int n, int r, int c, int dr, int dc, int p, int limit) {
+    const int sz = N ? N : n;
+    int count = 0;
+    for (r += dr, c += dc; count < limit; r += dr, c += dc, count++) {
+        if (r < 0 || r >= sz || c < 0 || c >= sz) break;
+        if (GridCellGet(cells, r * sz + c) != p) break;
+    }
+    return count;
+}
+
+template <int N>
+static bool CheckMove(const uint64_t* cells, int n, int k, int index, WinLine* out) {
+    const int sz = N ? N : n;
+    int p = GridCellGet(cells, index);
+    if (p == CELL_EMPTY || k < 1) return false;
+    int r = index / sz, c = index % sz;
+    for (int d = 0; d < 4; d++) {
+        int back = Run<N>(cells, sz, r, c, -dirRow[d], -dirCol[d], p, k - 1);
+        int fwd = Run<N>(cells, sz, r, c, dirRow[d], dirCol[d], p, k - 1);
+        if (1 + back + fwd < k) continue;
+        if (out) {
+            out->player = p;
+            out->start = (r - back * dirRow[d]) * sz + (c - back * dirCol[d]);
+            out->dir = d;
+            out->length = 1 + back + fwd;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool RulesCheckMove(const uint64_t* cells, int gridSize, int k, int index, WinLine* out) {
+    RULES_DISPATCH(CheckMove, gridSize, cells, gridSize, k, index, out);
+}
+
+// Полный перебор для произвольного размера
+static bool FindWinAny(const uint64_t* cells, int gridSize, int k, WinLine* out) {
+    if (k < 1) return false;
+    for (int r = 0; r < gridSize; r++) {
+        for (int c = 0; c < gridSize; c++) {
+            int p = GridCellGet(cells, r * gridSize + c);
+            if (p == CELL_EMPTY) continue;
+            for (int d = 0; d < 4; d++) {
+                int er = r + (k - 1) * dirRow[d], ec = c + (k - 1) * dirCol[d];
+                if (er >= gridSize || ec < 0 || ec >= gridSize) continue;
+                int i = 1;
+                while (i < k && GridCellGet(cells, (r + i * dirRow[d]) * gridSize + c + i * dirCol[d]) == p) i++;
+                if (i < k) continue;
+                if (out) {
+                    out->player = p;
+                    out->start = r * gridSize + c;
+                    out->dir = d;
+                    out->length = k;
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Битборд маленького поля: клетка (r, c) — бит r·(N+1) + c. Лишний пустой
+// столбец N не даёт линии перескочить с конца строки на начало следующей.
+struct Bits128 {
+    uint64_t lo, hi;
+};
+
+static inline Bits128 Shr(Bits128 a, int s) {
+    if (s == 0) return a;
+    if (s >= 64) return { a.hi >> (s - 64), 0 };
+    return { (a.lo >> s) | (a.hi << (64 - s)), a.hi >> s };
+}
+
+static inline int LowestBit(Bits128 a) {
+    uint64_t w = a.lo ? a.lo : a.hi;
+    int i = 0;
+    while (!(w & 1)) { w >>= 1; i++; }
+    return a.lo ? i : 64 + i;
+}
+
+// Младшие биты пар (клетки O) или, после сдвига на 1, старшие (клетки X) — подряд
+static inline uint64_t EvenBits(uint64_t x) {
+    x &= 0x5555555555555555ull;
+    x = (x | (x >> 1)) & 0x3333333333333333ull;
+    x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+    return x;
+}
+
+template <int N>
+static Bits128 PlayerBits(const uint64_t* cells, int p) {
+    // клетки игрока подряд, по биту на клетку: N·N <= 100, это максимум 4 слова
+    const int words = (N * N + GRID_CELLS_WORD - 1) / GRID_CELLS_WORD;
+    const int sh = p == CELL_O ? 0 : 1;
+    Bits128 lin = { 0, 0 };
+    for (int w = 0; w < words; w++) {
+        uint64_t e = EvenBits(cells[w] >> sh);
+        if (w < 2) lin.lo |= e << (32 * w);
+        else lin.hi |= e << (32 * (w - 2));
+    }
+    // разносим строки с шагом N+1
+    Bits128 m = { 0, 0 };
+    for (int r = 0; r < N; r++) {
+        uint64_t row = Shr(lin, r * N).lo & ((1ull << N) - 1);
+        int bit = r * (N + 1);
+        if (bit < 64) {
+            m.lo |= row << bit;
+            if (bit + N > 64) m.hi |= row >> (64 - bit);
+        }
+        else {
+            m.hi |= row << (bit - 64);
+        }
+    }
+    return m;
+}
+
+// Та же линия, что нашёл бы перебор: первая клетка в порядке строк,
+// при равенстве — первое направление
+template <int N>
+static bool FindWinFixed(const uint64_t* cells, int, int k, WinLine* out) {
+    static_assert(N * (N + 1) <= 128, "board does not fit the bitboard");
+    if (k < 1) return false;
+    if (k > N) return false;
+    const int shift[4] = { 1, N + 1, N + 2, N };    // →, ↓, ↘, ↙
+    int bestBit = -1, bestDir = 0, bestPlayer = 0;
+    for (int p = CELL_O; p <= CELL_X; p++) {
+        Bits128 m = PlayerBits<N>(cells, p);
+        for (int d = 0; d < 4; d++) {
+            Bits128 x = m;
+            for (int j = 1; j < k && (x.lo | x.hi); j++) {
+                Bits128 y = Shr(m, j * shift[d]);
+                x.lo &= y.lo;
+                x.hi &= y.hi;
+            }
+            if (!(x.lo | x.hi)) continue;
+            int bit = LowestBit(x);
+            if (bestBit < 0 || bit < bestBit) {
+                bestBit = bit;
+                bestDir = d;
+                bestPlayer = p;
+            }
+        }
+    }
+    if (bestBit < 0) return false;
+    if (out) {
+        out->player = bestPlayer;
+        out->start = (bestBit / (N + 1)) * N + bestBit % (N + 1);
+        out->dir = bestDir;
+        out->length = k;
+    }
+    return true;
+}
+
+template <>
+bool FindWinFixed<0>(const uint64_t* cells, int gridSize, int k, WinLine* out) {
+    return FindWinAny(cells, gridSize, k, out);
+}
+
+bool RulesFindWin(const uint64_t* cells, int gridSize, int k, WinLine* out) {
+    RULES_DISPATCH(FindWinFixed, gridSize, cells, gridSize, k, out);
+}
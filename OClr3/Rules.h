@@ -0,0 +1,37 @@
+﻿#pragma once
+
+// Правила: K в ряд на поле N×N.
+// Работают прямо по упакованным клеткам поля (2 бита на клетку, GridCellGet) —
+// это и есть битборды обоих игроков, отдельной копии рядом с cells не держим.
+// Проверка после хода смотрит только четыре линии через поставленную клетку:
+// не больше 8·(K−1) чтений, от размера поля не зависит.
+// Для полей 3×3 … 10×10 обе функции собраны с размером-константой
+// (Rules.cpp), остальные размеры идут общим путём.
+
+#include <stdint.h>
+
+#define WIN_DEFAULT_LENGTH  5      // K для полей больше 5×5, если не задан явно
+
+// Направления линий: →, ↓, ↘, ↙
+enum RulesDir { DIR_ROW, DIR_COL, DIR_DIAG, DIR_ANTI };
+
+struct WinLine {
+    int player;                    // CELL_O / CELL_X
+    int start;                     // индекс крайней клетки линии
+    int dir;                       // RulesDir, от start
+    int length;                    // длина серии (может быть больше K)
+};
+
+// Действующее K: k <= 0 — по умолчанию, и не больше размера поля
+int  RulesWinLength(int gridSize, int k);
+
+// Выиграл ли ход в клетку index. O(K).
+bool RulesCheckMove(const uint64_t* cells, int gridSize, int k, int index, WinLine* out);
+
+// Эталон: перебор всех клеток и направлений, O(N²·K). Нужен там, где
+// инкрементальная проверка неприменима — после смены размера поля или K.
+bool RulesFindWin(const uint64_t* cells, int gridSize, int k, WinLine* out);
+
+// Ядра по размеру (3×3 … 10×10): false — все размеры общим путём.
+// Для сравнения в бенчмарке и тестах; по умолчанию включены.
+void RulesUseSizeKernels(bool on);
@@ -0,0 +1,444 @@
+﻿#include "Search.h"
+#include "Rules.h"
+#include "SharedGrid.h"
+#include "ThreadPool.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define SEARCH_MAX_PLY      32
+#define SEARCH_ROOT_MOVES   64     // кандидатов корня, которые смотрим глубже
+#define SEARCH_BRANCH       16     // ходов во внутреннем узле
+#define SEARCH_NODE_MOVES   (SEARCH_ROOT_MOVES + 8 * SEARCH_MAX_PLY)
+#define SCORE_WIN           30000
+#define SCORE_INF           32000
+#define SCORE_EVAL_MAX      20000
+
+typedef std::chrono::steady_clock Clock;
+
+static inline int Opponent(int p) { return p == CELL_O ? CELL_X : CELL_O; }
+
+// splitmix64 — «случайное» число для (клетка, игрок) без таблицы
+static inline uint64_t ZobristKey(int index, int player) {
+    uint64_t x = ((uint64_t)(uint32_t)index << 2 | (uint64_t)player) + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static inline int Popcount64(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((x * 0x0101010101010101ull) >> 56);
+}
+
+// ——————————————————————————— Таблица транспозиций ———————————————————————————————
+
+enum { TT_EXACT = 1, TT_LOWER = 2, TT_UPPER = 3 };
+
+struct TTEntry {
+    std::atomic<uint64_t> key;         // ключ позиции ^ data
+    std::atomic<uint64_t> data;        // ход | оценка | глубина | флаг
+};
+
+static inline uint64_t TTPack(int move, int score, int depth, int flag) {
+    return (uint64_t)(uint32_t)(move + 1)
+        | (uint64_t)(uint16_t)(int16_t)score << 32
+        | (uint64_t)(uint8_t)depth << 48
+        | (uint64_t)(uint8_t)flag << 56;
+}
+static inline int TTMove(uint64_t d)  { return (int)(uint32_t)d - 1; }
+static inline int TTScore(uint64_t d) { return (int16_t)(uint16_t)(d >> 32); }
+static inline int TTDepth(uint64_t d) { return (int)(uint8_t)(d >> 48); }
+static inline int TTFlag(uint64_t d)  { return (int)(uint8_t)(d >> 56); }
+
+// ——————————————————————————— Рабочая копия поля ———————————————————————————————
+
+struct Board {
+    std::vector<uint64_t> cells;
+    int      n, k;
+    uint64_t key;
+    int      eval;                     // в пользу O, относительно корня
+    int      ply;
+    int      path[SEARCH_MAX_PLY];
+    int      pathDelta[SEARCH_MAX_PLY];
+    uint64_t nodes;
+};
+
+struct SearchEngine {
+    ThreadPool*                 pool;
+    std::unique_ptr<TTEntry[]>  tt;
+    uint64_t                    ttMask;
+    std::atomic<bool>           stop;
+
+    // на время одного SearchBestMove
+    std::vector<Board>          boards;
+    std::vector<int>            freeBoards;
+    std::mutex                  boardsLock;
+    std::vector<int>            rootMoves;     // общие для всех потоков кандидаты
+    Clock::time_point           deadline;
+};
+
+static inline int Weight(int c) {
+    return c <= 0 ? 0 : 1 << std::min(2 * (c - 1), 12);
+}
+
+// Окно из K клеток, где стоят только фигуры одного игрока, стоит Weight(число)
+static inline int WindowValue(int o, int x) {
+    return (x == 0 ? Weight(o) : 0) - (o == 0 ? Weight(x) : 0);
+}
+
+// Сколько шагов (не больше limit) можно сделать из (r, c) в направлении (dr, dc)
+static inline int Reach(int n, int r, int c, int dr, int dc, int limit) {
+    int s = limit;
+    if (dr > 0) s = std::min(s, n - 1 - r);
+    if (dr < 0) s = std::min(s, r);
+    if (dc > 0) s = std::min(s, n - 1 - c);
+    if (dc < 0) s = std::min(s, c);
+    return s;
+}
+
+static const int dirRow[4] = { 0, 1, 1, 1 };
+static const int dirCol[4] = { 1, 0, 1, -1 };
+
+// Изменение оценки (в пользу O), если p встанет в пустую клетку idx.
+// Смотрим только окна из K клеток, проходящие через idx, скользящим счётом.
+static int PlaceDelta(const Board& b, int idx, int p) {
+    int n = b.n, k = b.k, r = idx / n, c = idx % n, delta = 0;
+    const uint64_t* cells = b.cells.data();
+    for (int d = 0; d < 4; d++) {
+        int dr = dirRow[d], dc = dirCol[d];
+        int tmin = -Reach(n, r, c, -dr, -dc, k - 1);
+        int tmax = Reach(n, r, c, dr, dc, k - 1);
+        int s0 = std::max(-(k - 1), tmin), s1 = std::min(0, tmax - (k - 1));
+        if (s0 > s1) continue;
+        int cnt[4] = { 0, 0, 0, 0 };
+        for (int t = s0; t < s0 + k; t++)
+            if (t) cnt[GridCellGet(cells, idx + t * (dr * n + dc))]++;
+        for (int s = s0; ; s++) {
+            int o = cnt[CELL_O], x = cnt[CELL_X];
+            delta += (p == CELL_O ? WindowValue(o + 1, x) : WindowValue(o, x + 1)) - WindowValue(o, x);
+            if (s == s1) break;
+            if (s) cnt[GridCellGet(cells, idx + s * (dr * n + dc))]--;
+            if (s + k) cnt[GridCellGet(cells, idx + (s + k) * (dr * n + dc))]++;
+        }
+    }
+    return delta;
+}
+
+static inline void Place(Board& b, int idx, int p) {
+    int d = PlaceDelta(b, idx, p);
+    b.eval += d;
+    b.key ^= ZobristKey(idx, p);
+    GridCellSet(b.cells.data(), idx, p);
+    b.pathDelta[b.ply] = d;
+    b.path[b.ply++] = idx;
+}
+
+static inline void Undo(Board& b, int idx, int p) {
+    b.ply--;
+    b.eval -= b.pathDelta[b.ply];
+    b.key ^= ZobristKey(idx, p);
+    GridCellSet(b.cells.data(), idx, CELL_EMPTY);
+}
+
+// Насколько ход хорош для p: своя выгода плюс сорванная выгода соперника
+static inline int MoveOrderKey(const Board& b, int idx, int p) {
+    int own = PlaceDelta(b, idx, p), opp = PlaceDelta(b, idx, Opponent(p));
+    return p == CELL_O ? own - opp : opp - own;
+}
+
+// Упорядоченные ходы: сначала ход из таблицы, потом по MoveOrderKey.
+// Кандидаты — кандидаты корня и соседи ходов на пути к узлу.
+static int GenerateMoves(const SearchEngine* e, const Board& b, int p, int ttMove, int* out, int maxOut) {
+    int cand[SEARCH_NODE_MOVES];
+    int m = 0;
+    for (int idx : e->rootMoves)
+        cand[m++] = idx;
+    for (int i = 0; i < b.ply; i++) {
+        int r = b.path[i] / b.n, c = b.path[i] % b.n;
+        for (int dr = -1; dr <= 1; dr++)
+            for (int dc = -1; dc <= 1; dc++) {
+                int rr = r + dr, cc = c + dc;
+                if ((dr || dc) && rr >= 0 && rr < b.n && cc >= 0 && cc < b.n)
+                    cand[m++] = rr * b.n + cc;
+            }
+    }
+    std::sort(cand, cand + m);
+    m = (int)(std::unique(cand, cand + m) - cand);
+
+    struct Scored { int key, idx; };
+    Scored sc[SEARCH_NODE_MOVES];
+    int count = 0;
+    for (int i = 0; i < m; i++) {
+        if (GridCellGet(b.cells.data(), cand[i]) != CELL_EMPTY) continue;
+        sc[count].idx = cand[i];
+        sc[count].key = cand[i] == ttMove ? INT32_MAX : MoveOrderKey(b, cand[i], p);
+        count++;
+    }
+    int take = std::min(count, maxOut);
+    std::partial_sort(sc, sc + take, sc + count,
+        [](const Scored& a, const Scored& b) { return a.key > b.key; });
+    for (int i = 0; i < take; i++) out[i] = sc[i].idx;
+    return take;
+}
+
+static int Negamax(SearchEngine* e, Board& b, int depth, int alpha, int beta, int p) {
+    if ((++b.nodes & 1023) == 0 && Clock::now() >= e->deadline)
+        e->stop.store(true, std::memory_order_relaxed);
+    if (e->stop.load(std::memory_order_relaxed)) return 0;
+
+    int alphaOrig = alpha, ttMove = -1;
+    TTEntry& te = e->tt[b.key & e->ttMask];
+    uint64_t td = te.data.load(std::memory_order_relaxed);
+    if ((te.key.load(std::memory_order_relaxed) ^ td) == b.key) {
+        ttMove = TTMove(td);
+        if (TTDepth(td) >= depth) {
+            int s = TTScore(td);
+            if (TTFlag(td) == TT_EXACT) return s;
+            if (TTFlag(td) == TT_LOWER) alpha = std::max(alpha, s);
+            if (TTFlag(td) == TT_UPPER) beta = std::min(beta, s);
+            if (alpha >= beta) return s;
+        }
+    }
+
+    if (depth == 0 || b.ply >= SEARCH_MAX_PLY) {
+        int s = std::max(-SCORE_EVAL_MAX, std::min(SCORE_EVAL_MAX, b.eval));
+        return p == CELL_O ? s : -s;
+    }
+
+    int moves[SEARCH_BRANCH];
+    int count = GenerateMoves(e, b, p, ttMove, moves, SEARCH_BRANCH);
+    if (!count) return 0;
+
+    int best = -SCORE_INF, bestMove = moves[0];
+    for (int i = 0; i < count; i++) {
+        int m = moves[i], s;
+        Place(b, m, p);
+        if (RulesCheckMove(b.cells.data(), b.n, b.k, m, nullptr))
+            s = SCORE_WIN - b.ply;
+        else
+            s = -Negamax(e, b, depth - 1, -beta, -alpha, Opponent(p));
+        Undo(b, m, p);
+        if (e->stop.load(std::memory_order_relaxed)) return 0;
+        if (s > best) { best = s; bestMove = m; }
+        if (s > alpha) alpha = s;
+        if (alpha >= beta) break;
+    }
+
+    int flag = best <= alphaOrig ? TT_UPPER : best >= beta ? TT_LOWER : TT_EXACT;
+    uint64_t nd = TTPack(bestMove, best, depth, flag);
+    te.data.store(nd, std::memory_order_relaxed);
+    te.key.store(b.key ^ nd, std::memory_order_relaxed);
+    return best;
+}
+
+// ——————————————————————————————— Корень ——————————————————————————————————————
+
+struct RootIteration {
+    SearchEngine*    e;
+    const int*       order;
+    int*             scores;
+    int              depth;
+    int              player;
+    std::atomic<int> alpha;
+    std::mutex       lock;
+    int              bestMove;
+    int              bestScore;
+};
+
+static int SearchRootMove(SearchEngine* e, Board& b, int m, int player, int depth, int alpha) {
+    Place(b, m, player);
+    int s = RulesCheckMove(b.cells.data(), b.n, b.k, m, nullptr)
+        ? SCORE_WIN - b.ply
+        : -Negamax(e, b, depth - 1, -SCORE_INF, -alpha, Opponent(player));
+    Undo(b, m, player);
+    return s;
+}
+
+static void RootTask(int i, void* ctx) {
+    RootIteration* it = (RootIteration*)ctx;
+    SearchEngine* e = it->e;
+    int bi;
+    {
+        std::lock_guard<std::mutex> g(e->boardsLock);
+        bi = e->freeBoards.back();
+        e->freeBoards.pop_back();
+    }
+    int m = it->order[i + 1];
+    int s = SearchRootMove(e, e->boards[bi], m, it->player, it->depth, it->alpha.load());
+    {
+        std::lock_guard<std::mutex> g(e->boardsLock);
+        e->freeBoards.push_back(bi);
+    }
+    if (e->stop.load(std::memory_order_relaxed)) return;
+    it->scores[i + 1] = s;
+    std::lock_guard<std::mutex> g(it->lock);
+    // окно снизу открыто на alpha, поэтому s > alpha — точная оценка
+    if (s > it->bestScore) {
+        it->bestScore = s;
+        it->bestMove = m;
+        int a = it->alpha.load();
+        while (s > a && !it->alpha.compare_exchange_weak(a, s)) {}
+    }
+}
+
+// Пустые клетки рядом с занятыми; на пустом поле — центр
+static void RootCandidates(const Board& b, std::vector<int>& out) {
+    out.clear();
+    const uint64_t* cells = b.cells.data();
+    uint32_t words = GridWordsFor(b.n);
+    int total = b.n * b.n;
+    for (uint32_t w = 0; w < words; w++) {
+        uint64_t x = cells[w];
+        for (int j = 0; x; j++, x >>= 2) {
+            if (!(x & 3)) continue;
+            int idx = (int)w * GRID_CELLS_WORD + j;
+            if (idx >= total) break;
+            int r = idx / b.n, c = idx % b.n;
+            for (int dr = -1; dr <= 1; dr++)
+                for (int dc = -1; dc <= 1; dc++) {
+                    int rr = r + dr, cc = c + dc;
+                    if (rr < 0 || rr >= b.n || cc < 0 || cc >= b.n) continue;
+                    if (GridCellGet(cells, rr * b.n + cc) == CELL_EMPTY)
+                        out.push_back(rr * b.n + cc);
+                }
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    if (out.empty() && GridCellGet(cells, (b.n / 2) * b.n + b.n / 2) == CELL_EMPTY)
+        out.push_back((b.n / 2) * b.n + b.n / 2);
+}
+
+int SearchBestMove(SearchEngine* e, const uint64_t* cells, int gridSize, int k,
+                   int player, const SearchLimits* limits, SearchStats* stats)
+{
+    Clock::time_point t0 = Clock::now();
+    e->stop = false;
+    e->deadline = t0 + std::chrono::milliseconds(limits->timeMs);
+
+    int workers = e->pool ? ThreadPoolSize(e->pool) : 1;
+    e->boards.resize(workers);
+    e->freeBoards.clear();
+    for (int i = 0; i < workers; i++) {
+        Board& b = e->boards[i];
+        b.cells.assign(cells, cells + GridWordsFor(gridSize));
+        b.n = gridSize;
+        b.k = k;
+        b.eval = 0;
+        b.ply = 0;
+        b.nodes = 0;
+        e->freeBoards.push_back(i);
+    }
+    Board& b0 = e->boards[0];
+    b0.key = 0;
+    for (int i = 0; i < gridSize * gridSize; i++) {
+        int v = GridCellGet(cells, i);
+        if (v != CELL_EMPTY) b0.key ^= ZobristKey(i, v);
+    }
+    for (int i = 1; i < workers; i++) e->boards[i].key = b0.key;
+
+    // кандидаты корня: лучшие по порядку ходов, они же база для внутренних узлов
+    std::vector<int> all;
+    RootCandidates(b0, all);
+    std::vector<int> keys(all.size());
+    for (size_t i = 0; i < all.size(); i++) keys[i] = MoveOrderKey(b0, all[i], player);
+    std::vector<int> order(all.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+    size_t keep = std::min(order.size(), (size_t)SEARCH_ROOT_MOVES);
+    std::partial_sort(order.begin(), order.begin() + keep, order.end(),
+        [&](int a, int b) { return keys[a] > keys[b]; });
+    e->rootMoves.clear();
+    for (size_t i = 0; i < keep; i++) e->rootMoves.push_back(all[order[i]]);
+
+    int count = (int)e->rootMoves.size();
+    int bestMove = count ? e->rootMoves[0] : -1, bestScore = 0, doneDepth = 0;
+    std::vector<int> moves(e->rootMoves), scores(count, -SCORE_INF);
+    int maxDepth = limits->maxDepth > 0 ? std::min(limits->maxDepth, SEARCH_MAX_PLY - 1) : SEARCH_MAX_PLY - 1;
+
+    for (int depth = 1; count && depth <= maxDepth; depth++) {
+        // первым — лучший ход прошлой итерации, дальше по её оценкам
+        std::vector<int> idx(count);
+        for (int i = 0; i < count; i++) idx[i] = i;
+        std::stable_sort(idx.begin(), idx.end(), [&](int a, int b) { return scores[a] > scores[b]; });
+        std::vector<int> ord(count), sc(count, -SCORE_INF);
+        for (int i = 0; i < count; i++) ord[i] = moves[idx[i]];
+
+        RootIteration it;
+        it.e = e;
+        it.order = ord.data();
+        it.scores = sc.data();
+        it.depth = depth;
+        it.player = player;
+        it.bestMove = ord[0];
+        it.bestScore = SearchRootMove(e, b0, ord[0], player, depth, -SCORE_INF);
+        if (e->stop) break;
+        sc[0] = it.bestScore;
+        it.alpha = it.bestScore;
+
+        if (count > 1) {
+            if (e->pool)
+                ThreadPoolRun(e->pool, count - 1, RootTask, &it);
+            else
+                for (int i = 0; i < count - 1; i++) RootTask(i, &it);
+        }
+        // даже прерванная итерация годится: первый ход досчитан, а лучший
+        // из остальных принят только по точной оценке
+        bestMove = it.bestMove;
+        bestScore = it.bestScore;
+        if (e->stop) break;
+        doneDepth = depth;
+        moves.swap(ord);
+        scores.swap(sc);
+        if (bestScore >= SCORE_WIN - SEARCH_MAX_PLY || bestScore <= -SCORE_WIN + SEARCH_MAX_PLY) break;
+    }
+
+    if (stats) {
+        stats->nodes = 0;
+        for (const Board& b : e->boards) stats->nodes += b.nodes;
+        stats->depth = doneDepth;
+        stats->score = bestScore;
+        stats->elapsedMs = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+    }
+    return bestMove;
+}
+
+void SearchAbort(SearchEngine* e) {
+    e->stop = true;
+}
+
+SearchEngine* SearchCreate(ThreadPool* pool, int ttBits) {
+    SearchEngine* e = new SearchEngine();
+    e->pool = pool;
+    if (ttBits < 10) ttBits = 10;
+    if (ttBits > 28) ttBits = 28;
+    e->ttMask = (1ull << ttBits) - 1;
+    e->tt.reset(new TTEntry[(size_t)1 << ttBits]);
+    for (size_t i = 0; i <= e->ttMask; i++) {
+        e->tt[i].key.store(0, std::memory_order_relaxed);
+        e->tt[i].data.store(0, std::memory_order_relaxed);
+    }
+    e->stop = false;
+    return e;
+}
+
+void SearchDestroy(SearchEngine* e) {
+    delete e;
+}
+
+int SearchSideToMove(const uint64_t* cells, int gridSize) {
+    int o = 0, x = 0;
+    uint32_t words = GridWordsFor(gridSize);
+    for (uint32_t w = 0; w < words; w++) {
+        o += Popcount64(cells[w] & 0x5555555555555555ull);
+        x += Popcount64(cells[w] & 0xAAAAAAAAAAAAAAAAull);
+    }
+    return o <= x ? CELL_O : CELL_X;
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+// Поиск хода для K в ряд (Rules.h): альфа-бета с итеративным углублением.
+//
+// - Ключ позиции — Zobrist: XOR случайных чисел по (клетка, игрок). Числа
+//   не хранятся таблицей, а считаются хэшем от индекса: поле бывает до
+//   16384×16384, таблица на каждую клетку туда не влезет.
+// - Таблица транспозиций без блокировок: запись из двух 64-битных слов,
+//   ключ хранится XOR-нутым с данными, так что разорванная чужой записью
+//   пара просто не совпадёт по ключу.
+// - Параллельно по корню: первый (лучший с прошлой итерации) ход считается
+//   одним потоком, остальные — пулом (ThreadPool.h) с общей нижней границей.
+// - Ходы — пустые клетки рядом с уже занятыми; оценка и ключ обновляются
+//   инкрементально по линиям через клетку, поле целиком не пересматривается.
+
+#include <stdint.h>
+
+struct ThreadPool;
+struct SearchEngine;
+
+struct SearchLimits {
+    uint32_t timeMs;                   // бюджет на ход
+    int      maxDepth;                 // 0 — пока хватает времени
+};
+
+struct SearchStats {
+    uint64_t nodes;
+    int      depth;                    // последняя завершённая итерация
+    int      score;                    // с точки зрения ходящего
+    uint32_t elapsedMs;
+};
+
+// pool может быть nullptr — тогда поиск однопоточный.
+// ttBits — log2 числа записей таблицы транспозиций (по 16 байт).
+SearchEngine* SearchCreate(ThreadPool* pool, int ttBits);
+void          SearchDestroy(SearchEngine* e);
+
+// Лучший ход player (CELL_O / CELL_X) на поле cells; -1 — ходить некуда.
+// Блокирует до конца поиска; из другого потока его можно прервать SearchAbort.
+int           SearchBestMove(SearchEngine* e, const uint64_t* cells, int gridSize, int k,
+                             int player, const SearchLimits* limits, SearchStats* stats);
+void          SearchAbort(SearchEngine* e);
+
+// Чей ход по числу фигур: O ходит первым
+int           SearchSideToMove(const uint64_t* cells, int gridSize);
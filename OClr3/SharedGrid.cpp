@@ -0,0 +1,962 @@
+﻿#include "SharedGrid.h"
+#include "Rules.h"
+#include "Journal.h"
+#include "History.h"
+#include "Arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static void CellsName(char* out, size_t n, const char* name, uint32_t gen) {
+    snprintf(out, n, "%s.%u", name, gen);
+}
+
+static size_t CellsBytes(int gridSize) {
+    uint32_t words = GridWordsFor(gridSize);
+    uint32_t blocks = (words + GRID_BLOCK_WORDS - 1) / GRID_BLOCK_WORDS;
+    return sizeof(SharedCells) + (size_t)words * sizeof(uint64_t) + (size_t)blocks * sizeof(uint32_t);
+}
+
+// Платформенная часть (внизу файла)
+static bool         MapRoot(SharedMapping* m, bool* created);
+static void         UnmapRoot(SharedMapping* m);
+static SharedCells* CreateCells(const char* name, uint32_t gen, int gridSize, void** handle, size_t* bytes);
+static SharedCells* OpenCells(const char* name, uint32_t gen, void** handle, size_t* bytes);
+static void         UnmapCells(SharedCells* c, void* handle, size_t bytes);
+static void         RemoveCells(const char* name, uint32_t gen);
+
+static void SetCells(SharedMapping* m, SharedCells* c, void* handle, size_t bytes) {
+    if (m->cells && !m->arena) {
+#ifdef _WIN32
+        UnmapCells(m->cells, m->hCells, m->cellsBytes);
+#else
+        UnmapCells(m->cells, nullptr, m->cellsBytes);
+#endif
+    }
+    m->cells = c;
+    m->cellsBytes = bytes;
+    m->generation = c ? c->generation : 0;
+#ifdef _WIN32
+    m->hCells = (HANDLE)handle;
+#else
+    (void)handle;
+#endif
+}
+
+// Перемапить payload, если поколение сменилось
+static bool SyncGeneration(SharedMapping* m, uint32_t gen) {
+    if (m->cells && m->generation == gen) return true;
+    if (m->arena) return m->cells != nullptr;   // у доски в арене поколение одно
+    void* h = nullptr; size_t bytes = 0;
+    SharedCells* c = OpenCells(m->name, gen, &h, &bytes);
+    if (!c) return false;
+    SetCells(m, c, h, bytes);
+    return true;
+}
+
+// ——————————————————————————————— Seqlock ——————————————————————————————————————
+
+static void RepairAbandoned(SharedMapping* m, uint32_t v);
+static void RebaseIfRepaired(SharedMapping* m);
+
+// Забрать запись у умершего owner. true — запись наша: seq нечётный,
+// поле после оборванной записи починено (журнал и история — ещё нет,
+// см. RebaseIfRepaired), дальше — как после BeginWrite.
+static bool TakeOverWriter(SharedMapping* m, uint32_t owner, uint32_t* v) {
+    SharedData* d = m->data;
+    if (ProcessAlive(owner) || !d->writer.compare_exchange_strong(owner, SelfPid(), std::memory_order_acquire))
+        return false;
+    uint32_t s = d->seq.load(std::memory_order_relaxed);
+    if (s & 1) {
+        *v = (s + 1) >> 1;
+        RepairAbandoned(m, *v);
+    }
+    else {
+        // умер до или сразу после своей записи: чинить нечего
+        d->seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        *v = (s + 2) >> 1;
+    }
+    return true;
+}
+
+// Захват записи: CAS своего pid в writer, затем seq — в нечётный.
+// Писатели на мгновение упорядочиваются друг за другом, читатели ждут
+// только саму запись. Пока запись держит чужой pid, ждём; раз в
+// SHARED_STALL_SPINS проверяем, жив ли он (это системный вызов).
+static uint32_t BeginWrite(SharedMapping* m) {
+    SharedData* d = m->data;
+    uint32_t self = SelfPid(), v;
+    for (int spins = 1; ; spins++) {
+        uint32_t owner = 0;
+        if (d->writer.compare_exchange_weak(owner, self, std::memory_order_acquire)) break;
+        if (owner && spins % SHARED_STALL_SPINS == 0 && TakeOverWriter(m, owner, &v)) {
+            RebaseIfRepaired(m);
+            return v;
+        }
+        if (spins > 64) ThreadYield();
+    }
+    uint32_t s = d->seq.load(std::memory_order_relaxed);
+    d->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    RebaseIfRepaired(m);
+    return (s + 2) >> 1;
+}
+
+static void EndWrite(SharedData* d) {
+    d->seq.fetch_add(1, std::memory_order_release);
+    d->writer.store(0, std::memory_order_release);
+}
+
+// Ждёт чётного seq и возвращает его. Запись, которая идёт слишком
+// долго, проверяется так же, как у писателей: мёртвую закрываем сами,
+// но в журнал и историю читатель не пишет — у потока снимков их нет
+// вовсе, а окну незачем сбрасывать контрольную точку посреди отрисовки.
+static uint32_t ReadBegin(SharedMapping* m) {
+    SharedData* d = m->data;
+    uint32_t s, v;
+    for (int spins = 1; (s = d->seq.load(std::memory_order_acquire)) & 1; spins++) {
+        if (spins % SHARED_STALL_SPINS == 0) {
+            uint32_t owner = d->writer.load(std::memory_order_relaxed);
+            if (owner && TakeOverWriter(m, owner, &v)) EndWrite(d);
+        }
+        if (spins > 64) ThreadYield();
+    }
+    return s;
+}
+
+static bool ReadRetry(const SharedData* d, uint32_t s) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return d->seq.load(std::memory_order_relaxed) != s;
+}
+
+// ——————————————————————————————— Запись ——————————————————————————————————————
+
+static inline int Popcount64(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((x * 0x0101010101010101ull) >> 56);
+}
+
+// Счётчики фишек при замене слова клеток old на now
+static void CountWord(SharedData* d, uint64_t old, uint64_t now) {
+    d->countO += Popcount64(now & 0x5555555555555555ull) - Popcount64(old & 0x5555555555555555ull);
+    d->countX += Popcount64(now & 0xAAAAAAAAAAAAAAAAull) - Popcount64(old & 0xAAAAAAAAAAAAAAAAull);
+}
+
+// Пересчёт с нуля — когда поле меняется целиком
+static void CountAll(SharedData* d, SharedCells* c) {
+    const uint64_t* words = SharedCellWords(c);
+    d->countO = d->countX = 0;
+    for (uint32_t w = 0; w < c->words; w++) CountWord(d, 0, words[w]);
+}
+
+// Победитель по итогам записи. index >= 0 — хватает проверки линий через
+// эту клетку, иначе (новый размер или K) — полный перебор.
+// Вызывается под записью.
+static void UpdateWinner(SharedData* d, SharedCells* c, int index) {
+    WinLine w;
+    int k = RulesWinLength(c->gridSize, d->winLength);
+    bool won = index >= 0
+        ? RulesCheckMove(SharedCellWords(c), c->gridSize, k, index, &w)
+        : RulesFindWin(SharedCellWords(c), c->gridSize, k, &w);
+    if (won) {
+        d->winner = w.player;
+        d->winCell = w.start;
+        d->winDir = w.dir;
+    }
+    else if (index < 0) {
+        d->winner = CELL_EMPTY;
+    }
+}
+
+// История начинается заново с текущего поля: после смены размера, K или
+// загрузки всего поля старые версии к нему уже не подходят.
+// Вызывается под записью.
+static void RebaseHistory(SharedMapping* m) {
+    SharedData* d = m->data;
+    SharedCells* c = m->cells;
+    HistoryRebase(m->history, SharedCellWords(c), c->words, d->winner, d->winCell, d->winDir);
+}
+
+// Запись прежнего владельца оборвалась на середине: поле как есть
+// становится новой точкой отсчёта. Счётчики и победитель пересчитываются,
+// читатели перечитывают поле целиком (colorVersion). Журнал и история
+// начинаются с него заново уже у писателя — в RebaseIfRepaired.
+// Вызывается под записью версии v.
+static void RepairAbandoned(SharedMapping* m, uint32_t v) {
+    SharedData* d = m->data;
+    d->colorVersion = v;
+    d->rebasePending = 1;
+    if (!SyncGeneration(m, d->generation)) return;
+    d->gridSize = m->cells->gridSize;
+    CountAll(d, m->cells);
+    UpdateWinner(d, m->cells, -1);
+}
+
+// Поле починено после умершего писателя, а журнал и история ещё помнят
+// оборванную запись: контрольная точка и новая история с текущего поля.
+// Вызывается писателем сразу после захвата записи.
+static void RebaseIfRepaired(SharedMapping* m) {
+    SharedData* d = m->data;
+    if (!d->rebasePending || !SyncGeneration(m, d->generation)) return;
+    JournalCheckpoint(m->journal, m);
+    RebaseHistory(m);
+    d->rebasePending = 0;
+}
+
+// Клетка, победитель, журнал и история — всё, что стоит за одним ходом.
+// Вызывается под записью, клетка уже проверена.
+static void PlaceCell(SharedMapping* m, uint32_t v, int index, int value) {
+    SharedData* d = m->data;
+    uint64_t* words = SharedCellWords(m->cells);
+    uint32_t w = (uint32_t)index / GRID_CELLS_WORD;
+    uint64_t old = words[w];
+    GridCellSet(words, index, value);
+    CountWord(d, old, words[w]);
+    SharedBlockVersions(m->cells)[index / GRID_BLOCK_CELLS] = v;
+    UpdateWinner(d, m->cells, index);
+    JournalAppend(m->journal, m, JR_CELL, (uint32_t)index, (uint32_t)value);
+    HistoryRecord(m->history, w, words[w], d->winner, d->winCell, d->winDir);
+}
+
+static bool CellInRange(SharedMapping* m, int index) {
+    return index >= 0 && (size_t)index < (size_t)m->cells->gridSize * m->cells->gridSize;
+}
+
+uint32_t SharedWriteCell(SharedMapping* m, int index, int value) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    if (d->winner != CELL_EMPTY) {
+        // партия окончена: версию всё равно публикуем, но поле не трогаем
+        EndWrite(d);
+        return 0;
+    }
+    if (SyncGeneration(m, d->generation) && CellInRange(m, index))
+        PlaceCell(m, v, index, value);
+    EndWrite(d);
+    return v;
+}
+
+uint32_t SharedApplyMoves(SharedMapping* m, MoveRequest* moves, int count) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    bool mapped = SyncGeneration(m, d->generation);
+    for (int i = 0; i < count; i++) {
+        MoveRequest& r = moves[i];
+        if (!mapped || !CellInRange(m, r.cell))
+            r.result = MOVE_OUT_OF_RANGE;
+        else if (d->winner != CELL_EMPTY)
+            r.result = MOVE_GAME_OVER;
+        else if (GridCellGet(SharedCellWords(m->cells), r.cell) != CELL_EMPTY)
+            r.result = MOVE_OCCUPIED;
+        else if (r.player != (d->countO <= d->countX ? CELL_O : CELL_X))
+            r.result = MOVE_NOT_YOUR_TURN;
+        else {
+            PlaceCell(m, v, r.cell, r.player);
+            r.result = MOVE_ACCEPTED;
+        }
+    }
+    EndWrite(d);
+    return v;
+}
+
+int SharedSideToMove(const SharedMapping* m) {
+    return m->data->countO <= m->data->countX ? CELL_O : CELL_X;
+}
+
+uint32_t SharedWriteBackground(SharedMapping* m, COLORREF c) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    d->backgroundColor = c;
+    d->colorVersion = v;
+    JournalAppend(m->journal, m, JR_BACKGROUND, c, 0);
+    EndWrite(d);
+    return v;
+}
+
+uint32_t SharedWriteGridColor(SharedMapping* m, COLORREF c) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    d->gridColor = c;
+    d->colorVersion = v;
+    JournalAppend(m->journal, m, JR_GRIDCOLOR, c, 0);
+    EndWrite(d);
+    return v;
+}
+
+uint32_t SharedWriteColors(SharedMapping* m, COLORREF background, COLORREF grid) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    d->backgroundColor = background;
+    d->gridColor = grid;
+    d->colorVersion = v;
+    JournalAppend(m->journal, m, JR_COLORS, background, grid);
+    EndWrite(d);
+    return v;
+}
+
+void SharedReset(SharedMapping* m, COLORREF background, COLORREF grid) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    d->backgroundColor = background;
+    d->gridColor = grid;
+    d->colorVersion = v;
+    d->winLength = 0;
+    d->winner = CELL_EMPTY;
+    d->countO = d->countX = 0;
+    if (SyncGeneration(m, d->generation)) {
+        SharedCells* c = m->cells;
+        memset(SharedCellWords(c), 0, (size_t)c->words * sizeof(uint64_t));
+        uint32_t* bv = SharedBlockVersions(c);
+        for (uint32_t i = 0; i < c->blocks; i++) bv[i] = v;
+        JournalAppend(m->journal, m, JR_RESET, background, grid);
+        RebaseHistory(m);
+    }
+    EndWrite(d);
+}
+
+uint32_t SharedNewGame(SharedMapping* m) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    d->winner = CELL_EMPTY;
+    d->countO = d->countX = 0;
+    if (SyncGeneration(m, d->generation)) {
+        SharedCells* c = m->cells;
+        uint64_t* words = SharedCellWords(c);
+        uint32_t* bv = SharedBlockVersions(c);
+        // версию получают только блоки, где что-то стояло
+        for (uint32_t b = 0; b < c->blocks; b++) {
+            uint32_t w1 = (b + 1) * GRID_BLOCK_WORDS;
+            if (w1 > c->words) w1 = c->words;
+            uint64_t any = 0;
+            for (uint32_t w = b * GRID_BLOCK_WORDS; w < w1; w++) {
+                any |= words[w];
+                words[w] = 0;
+            }
+            if (any) bv[b] = v;
+        }
+        JournalAppend(m->journal, m, JR_NEWGAME, 0, 0);
+        HistoryRecordClear(m->history);
+    }
+    EndWrite(d);
+    return v;
+}
+
+uint32_t SharedSetWinLength(SharedMapping* m, int k) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    d->winLength = k > 0 ? k : 0;
+    if (SyncGeneration(m, d->generation)) {
+        UpdateWinner(d, m->cells, -1);
+        JournalAppend(m->journal, m, JR_WINLENGTH, (uint32_t)d->winLength, 0);
+        RebaseHistory(m);
+    }
+    EndWrite(d);
+    return v;
+}
+
+bool SharedLoadCells(SharedMapping* m, int gridSize, const uint64_t* words) {
+    if (!SharedResize(m, gridSize)) return false;
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    bool ok = SyncGeneration(m, d->generation) && m->cells->gridSize == gridSize;
+    if (ok) {
+        SharedCells* c = m->cells;
+        memcpy(SharedCellWords(c), words, (size_t)c->words * sizeof(uint64_t));
+        uint32_t* bv = SharedBlockVersions(c);
+        for (uint32_t i = 0; i < c->blocks; i++) bv[i] = v;
+        UpdateWinner(d, c, -1);
+        CountAll(d, c);
+        JournalCheckpoint(m->journal, m);
+        RebaseHistory(m);
+    }
+    EndWrite(d);
+    return ok;
+}
+
+void SharedAttachJournal(SharedMapping* m, Journal* j, bool checkpoint) {
+    SharedData* d = m->data;
+    BeginWrite(m);
+    m->journal = j;
+    if (checkpoint && SyncGeneration(m, d->generation))
+        JournalCheckpoint(j, m);
+    EndWrite(d);
+}
+
+void SharedAttachHistory(SharedMapping* m, History* h, bool rebase) {
+    SharedData* d = m->data;
+    BeginWrite(m);
+    m->history = h;
+    if (rebase && SyncGeneration(m, d->generation))
+        RebaseHistory(m);
+    EndWrite(d);
+}
+
+struct TravelCtx {
+    SharedMapping* m;
+    uint32_t       v;
+};
+
+// Слово поля по версии истории; каждая изменившаяся клетка — в журнал
+static void TravelWord(void* ctx, uint32_t w, uint64_t value) {
+    TravelCtx* t = (TravelCtx*)ctx;
+    SharedCells* c = t->m->cells;
+    uint64_t* words = SharedCellWords(c);
+    if (w >= c->words) return;
+    uint64_t x = words[w] ^ value;
+    for (int k = 0; x; k++, x >>= 2) {
+        if (x & 3)
+            JournalAppend(t->m->journal, t->m, JR_TRAVEL, w * GRID_CELLS_WORD + k, (uint32_t)(value >> (2 * k)) & 3);
+    }
+    CountWord(t->m->data, words[w], value);
+    words[w] = value;
+    SharedBlockVersions(c)[w / GRID_BLOCK_WORDS] = t->v;
+}
+
+uint32_t SharedTimeTravel(SharedMapping* m, int steps) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    HistoryVersion to;
+    TravelCtx t = { m, v };
+    bool ok = SyncGeneration(m, d->generation) && HistorySeek(m->history, steps, TravelWord, &t, &to);
+    if (ok) {
+        d->winner = to.winner;
+        d->winCell = to.winCell;
+        d->winDir = to.winDir;
+        JournalAppend(m->journal, m, JR_WINNER, (uint32_t)to.winner, (uint32_t)to.winCell | (uint32_t)to.winDir << 28);
+    }
+    EndWrite(d);
+    return ok ? v : 0;
+}
+
+uint32_t SharedRestoreCell(SharedMapping* m, int index, int value) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    if (SyncGeneration(m, d->generation) && CellInRange(m, index)) {
+        uint64_t* words = SharedCellWords(m->cells);
+        uint32_t w = (uint32_t)index / GRID_CELLS_WORD;
+        uint64_t old = words[w];
+        GridCellSet(words, index, value);
+        CountWord(d, old, words[w]);
+        SharedBlockVersions(m->cells)[index / GRID_BLOCK_CELLS] = v;
+        JournalAppend(m->journal, m, JR_TRAVEL, (uint32_t)index, (uint32_t)value);
+    }
+    EndWrite(d);
+    return v;
+}
+
+uint32_t SharedRestoreWinner(SharedMapping* m, int winner, int winCell, int winDir) {
+    SharedData* d = m->data;
+    uint32_t v = BeginWrite(m);
+    d->winner = winner;
+    d->winCell = winCell;
+    d->winDir = winDir;
+    JournalAppend(m->journal, m, JR_WINNER, (uint32_t)winner, (uint32_t)winCell | (uint32_t)winDir << 28);
+    EndWrite(d);
+    return v;
+}
+
+bool SharedResize(SharedMapping* m, int gridSize) {
+    if (gridSize < 1 || gridSize > GRID_MAX_SIZE) return false;
+    SharedData* d = m->data;
+    if (m->arena) return d->gridSize == gridSize;
+    uint32_t v = BeginWrite(m);
+    if (!SyncGeneration(m, d->generation) || d->gridSize == gridSize) {
+        EndWrite(d);
+        return d->gridSize == gridSize;
+    }
+
+    uint32_t oldGen = d->generation;
+    void* h = nullptr; size_t bytes = 0;
+    SharedCells* nc = CreateCells(m->name, oldGen + 1, gridSize, &h, &bytes);
+    if (!nc) {
+        EndWrite(d);
+        return false;
+    }
+
+    // переносим пересекающийся угол поля
+    const uint64_t* src = SharedCellWords(m->cells);
+    uint64_t* dst = SharedCellWords(nc);
+    int oldSize = m->cells->gridSize;
+    int keep = oldSize < gridSize ? oldSize : gridSize;
+    for (int r = 0; r < keep; r++)
+        for (int c = 0; c < keep; c++)
+            GridCellSet(dst, r * gridSize + c, GridCellGet(src, r * oldSize + c));
+    uint32_t* bv = SharedBlockVersions(nc);
+    for (uint32_t i = 0; i < nc->blocks; i++) bv[i] = v;
+
+    d->generation = nc->generation;
+    d->gridSize = gridSize;
+    d->colorVersion = v;
+    UpdateWinner(d, nc, -1);
+    CountAll(d, nc);
+    SetCells(m, nc, h, bytes);
+    JournalAppend(m->journal, m, JR_RESIZE, (uint32_t)gridSize, 0);
+    RebaseHistory(m);
+    EndWrite(d);
+
+    RemoveCells(m->name, oldGen);
+    return true;
+}
+
+// ——————————————————————————————— Чтение ——————————————————————————————————————
+
+uint32_t SharedVersion(const SharedMapping* m) {
+    return m->data->seq.load(std::memory_order_acquire) >> 1;
+}
+
+int SharedGridSize(SharedMapping* m) {
+    return m->data->gridSize;
+}
+
+void SharedReadSnapshot(SharedMapping* m, GridSnapshot* out) {
+    const SharedData* d = m->data;
+    uint32_t s;
+    for (;;) {
+        s = ReadBegin(m);
+        if (!SyncGeneration(m, d->generation)) {
+            ThreadYield();
+            continue;
+        }
+        SharedCells* c = m->cells;
+        if (out->capWords < c->words) {
+            free(out->cells);
+            out->cells = (uint64_t*)malloc((size_t)c->words * sizeof(uint64_t));
+            out->capWords = out->cells ? c->words : 0;
+            if (!out->cells) continue;
+        }
+        out->gridSize = c->gridSize;
+        out->backgroundColor = d->backgroundColor;
+        out->gridColor = d->gridColor;
+        out->winLength = RulesWinLength(c->gridSize, d->winLength);
+        out->winner = d->winner;
+        out->winCell = d->winCell;
+        out->winDir = d->winDir;
+        memcpy(out->cells, SharedCellWords(c), (size_t)c->words * sizeof(uint64_t));
+        if (!ReadRetry(d, s)) break;
+    }
+    out->version = s >> 1;
+}
+
+void SharedChangedSince(SharedMapping* m, uint32_t since, GridChanges* out) {
+    const SharedData* d = m->data;
+    uint32_t s;
+    for (;;) {
+        s = ReadBegin(m);
+        if (!SyncGeneration(m, d->generation)) {
+            ThreadYield();
+            continue;
+        }
+        SharedCells* c = m->cells;
+        uint32_t bitWords = (c->blocks + 63) / 64;
+        if (out->capBlocks < c->blocks) {
+            free(out->dirty);
+            out->dirty = (uint64_t*)malloc((size_t)bitWords * sizeof(uint64_t));
+            out->capBlocks = out->dirty ? bitWords * 64 : 0;
+            if (!out->dirty) continue;
+        }
+        memset(out->dirty, 0, (size_t)bitWords * sizeof(uint64_t));
+        out->gridSize = c->gridSize;
+        out->blocks = c->blocks;
+        out->colorsChanged = d->colorVersion > since;
+        const uint32_t* bv = SharedBlockVersions(c);
+        for (uint32_t i = 0; i < c->blocks; i++)
+            if (bv[i] > since)
+                out->dirty[i >> 6] |= 1ull << (i & 63);
+        if (!ReadRetry(d, s)) break;
+    }
+    out->version = s >> 1;
+}
+
+static bool GrowU32(uint32_t** p, uint32_t* cap, uint32_t need) {
+    if (need <= *cap) return true;
+    uint32_t n = *cap ? *cap * 2 : 64;
+    while (n < need) n *= 2;
+    uint32_t* q = (uint32_t*)realloc(*p, (size_t)n * sizeof(uint32_t));
+    if (!q) return false;
+    *p = q;
+    *cap = n;
+    return true;
+}
+
+bool SharedRefreshSnapshot(SharedMapping* m, GridSnapshot* snap, GridDelta* delta) {
+    delta->count = 0;
+    if (!snap->cells) {
+        SharedReadSnapshot(m, snap);
+        return false;
+    }
+    const SharedData* d = m->data;
+    uint32_t s;
+    bool full = false;
+    int winLength = 0, winner = 0, winCell = 0, winDir = 0;
+    for (;;) {
+        s = ReadBegin(m);
+        if (!SyncGeneration(m, d->generation)) {
+            ThreadYield();
+            continue;
+        }
+        SharedCells* c = m->cells;
+        full = c->gridSize != snap->gridSize || d->colorVersion > snap->version;
+        if (full) break;
+        winLength = RulesWinLength(c->gridSize, d->winLength);
+        winner = d->winner;
+        winCell = d->winCell;
+        winDir = d->winDir;
+
+        // копируем изменившиеся слова во временный буфер: снимок трогаем
+        // только после того, как чтение оказалось согласованным
+        delta->wordCount = 0;
+        const uint32_t* bv = SharedBlockVersions(c);
+        const uint64_t* words = SharedCellWords(c);
+        bool oom = false;
+        for (uint32_t b = 0; b < c->blocks && !oom; b++) {
+            if (bv[b] <= snap->version) continue;
+            uint32_t w1 = (b + 1) * GRID_BLOCK_WORDS;
+            if (w1 > c->words) w1 = c->words;
+            for (uint32_t w = b * GRID_BLOCK_WORDS; w < w1; w++) {
+                uint32_t n = delta->wordCount;
+                if (n >= delta->wordCap) {
+                    uint32_t cap = delta->wordCap;
+                    uint64_t* q = (uint64_t*)realloc(delta->words, (size_t)(cap ? cap * 2 : 64) * sizeof(uint64_t));
+                    if (!q) { oom = true; break; }
+                    delta->words = q;
+                    if (!GrowU32(&delta->wordIdx, &delta->wordCap, cap ? cap * 2 : 64)) { oom = true; break; }
+                }
+                delta->wordIdx[n] = w;
+                delta->words[n] = words[w];
+                delta->wordCount = n + 1;
+            }
+        }
+        if (oom) { full = true; break; }
+        if (!ReadRetry(d, s)) break;
+    }
+    if (full) {
+        SharedReadSnapshot(m, snap);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < delta->wordCount; i++) {
+        uint32_t w = delta->wordIdx[i];
+        uint64_t x = snap->cells[w] ^ delta->words[i];
+        for (int k = 0; x; k++, x >>= 2) {
+            if (!(x & 3)) continue;
+            if (!GrowU32(&delta->cells, &delta->cap, delta->count + 1)) break;
+            delta->cells[delta->count++] = w * GRID_CELLS_WORD + k;
+        }
+        snap->cells[w] = delta->words[i];
+    }
+    snap->winLength = winLength;
+    snap->winner = winner;
+    snap->winCell = winCell;
+    snap->winDir = winDir;
+    snap->version = s >> 1;
+    return true;
+}
+
+void GridDeltaFree(GridDelta* d) {
+    free(d->cells);
+    free(d->wordIdx);
+    free(d->words);
+    memset(d, 0, sizeof(*d));
+}
+
+void GridSnapshotFree(GridSnapshot* s) {
+    free(s->cells);
+    s->cells = nullptr;
+    s->capWords = 0;
+}
+
+void GridChangesFree(GridChanges* c) {
+    free(c->dirty);
+    c->dirty = nullptr;
+    c->capBlocks = 0;
+}
+
+// ——————————————————————————————— Открытие ——————————————————————————————————————
+
+bool SharedOpen(SharedMapping* m, const char* name, int gridSize, bool* created) {
+    memset(m, 0, sizeof(*m));
+#ifndef _WIN32
+    m->fd = -1;
+#endif
+    snprintf(m->name, sizeof(m->name), "%s", name);
+    if (gridSize < 1 || gridSize > GRID_MAX_SIZE) return false;
+    if (!MapRoot(m, created)) return false;
+    SharedData* d = m->data;
+
+    if (*created) {
+        void* h = nullptr; size_t bytes = 0;
+        RemoveCells(name, 1);   // хвост от прошлого запуска (только POSIX)
+        SharedCells* c = CreateCells(name, 1, gridSize, &h, &bytes);
+        if (!c) {
+            UnmapRoot(m);
+            SharedUnlink(name);
+            return false;
+        }
+        d->generation = 1;
+        d->gridSize = gridSize;
+        SetCells(m, c, h, bytes);
+        d->ready.store(1, std::memory_order_release);
+        return true;
+    }
+
+    // ждём, пока создатель опубликует первое поколение
+    for (int tries = 0; !d->ready.load(std::memory_order_acquire); tries++) {
+        if (tries > 100000) { UnmapRoot(m); return false; }
+        ThreadYield();
+    }
+    for (int tries = 0; ; tries++) {
+        uint32_t s = ReadBegin(m);
+        if (SyncGeneration(m, d->generation) && !ReadRetry(d, s)) break;
+        if (tries > 100000) { SharedClose(m); return false; }
+        ThreadYield();
+    }
+    return true;
+}
+
+bool SharedOpenBoard(SharedMapping* m, Arena* a, uint32_t id, int gridSize, bool* created) {
+    memset(m, 0, sizeof(*m));
+#ifndef _WIN32
+    m->fd = -1;
+#endif
+    // имя нужно только для событий Notify и сегмента истории
+    snprintf(m->name, sizeof(m->name), "%s.%u", ARENA_NAME, id);
+    if (gridSize < 1 || gridSize > ARENA_MAX_GRID) return false;
+    int b = ArenaAttach(a, id, sizeof(SharedData), CellsBytes(gridSize), true, created);
+    if (b < 0) return false;
+    m->arena = a;
+    m->board = b;
+    m->data = (SharedData*)ArenaBoardData(a, b);
+    SharedCells* c = (SharedCells*)ArenaBoardCells(a, b);
+    if (*created) {
+        c->generation = 1;
+        c->gridSize = gridSize;
+        c->words = GridWordsFor(gridSize);
+        c->blocks = (c->words + GRID_BLOCK_WORDS - 1) / GRID_BLOCK_WORDS;
+        m->data->generation = 1;
+        m->data->gridSize = gridSize;
+        m->data->ready.store(1, std::memory_order_release);
+        ArenaPublish(a, b);
+    }
+    SetCells(m, c, nullptr, CellsBytes(c->gridSize));
+    return true;
+}
+
+void SharedClose(SharedMapping* m) {
+#ifdef _WIN32
+    for (int i = 0; i < GRID_MAX_SUBSCRIBERS; i++)
+        if (m->slotEvents[i]) CloseHandle(m->slotEvents[i]);
+    memset(m->slotEvents, 0, sizeof(m->slotEvents));
+    memset(m->slotEventPid, 0, sizeof(m->slotEventPid));
+#endif
+    SetCells(m, nullptr, nullptr, 0);
+    if (m->arena) {
+        ArenaDetach(m->arena, m->board);
+        m->arena = nullptr;
+        m->data = nullptr;
+        return;
+    }
+    UnmapRoot(m);
+}
+
+// ——————————————————————————————— Windows ——————————————————————————————————————
+#ifdef _WIN32
+
+static bool MapRoot(SharedMapping* m, bool* created) {
+    m->hMap = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        0, sizeof(SharedData), m->name
+    );
+    if (!m->hMap) return false;
+    // GetLastError надо снять сразу, MapViewOfFile его перезапишет
+    *created = (GetLastError() != ERROR_ALREADY_EXISTS);
+
+    m->data = (SharedData*)MapViewOfFile(
+        m->hMap, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedData)
+    );
+    if (!m->data) {
+        CloseHandle(m->hMap);
+        m->hMap = nullptr;
+        return false;
+    }
+    return true;
+}
+
+static void UnmapRoot(SharedMapping* m) {
+    if (m->data) UnmapViewOfFile(m->data);
+    if (m->hMap) CloseHandle(m->hMap);
+    m->data = nullptr;
+    m->hMap = nullptr;
+}
+
+static SharedCells* CreateCells(const char* name, uint32_t gen, int gridSize, void** handle, size_t* bytes) {
+    char cn[96]; CellsName(cn, sizeof(cn), name, gen);
+    size_t sz = CellsBytes(gridSize);
+    HANDLE h = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)sz >> 32), (DWORD)sz, cn
+    );
+    if (!h) return nullptr;
+    SharedCells* c = (SharedCells*)MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, sz);
+    if (!c) { CloseHandle(h); return nullptr; }
+    c->generation = gen;
+    c->gridSize = gridSize;
+    c->words = GridWordsFor(gridSize);
+    c->blocks = (c->words + GRID_BLOCK_WORDS - 1) / GRID_BLOCK_WORDS;
+    *handle = h;
+    *bytes = sz;
+    return c;
+}
+
+static SharedCells* OpenCells(const char* name, uint32_t gen, void** handle, size_t* bytes) {
+    char cn[96]; CellsName(cn, sizeof(cn), name, gen);
+    HANDLE h = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, cn);
+    if (!h) return nullptr;
+    SharedCells* c = (SharedCells*)MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!c) { CloseHandle(h); return nullptr; }
+    *handle = h;
+    *bytes = CellsBytes(c->gridSize);
+    return c;
+}
+
+static void UnmapCells(SharedCells* c, void* handle, size_t) {
+    UnmapViewOfFile(c);
+    if (handle) CloseHandle((HANDLE)handle);
+}
+
+static void RemoveCells(const char*, uint32_t) {
+}
+
+void SharedUnlink(const char*) {
+}
+
+// ——————————————————————————————— POSIX ——————————————————————————————————————
+#else
+
+static bool MapRoot(SharedMapping* m, bool* created) {
+    *created = false;
+
+    // O_EXCL отличает создателя от подключающихся, как ERROR_ALREADY_EXISTS в Win32
+    m->fd = shm_open(m->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (m->fd >= 0) {
+        *created = true;
+        if (ftruncate(m->fd, sizeof(SharedData)) != 0) {
+            close(m->fd);
+            shm_unlink(m->name);
+            m->fd = -1;
+            return false;
+        }
+    }
+    else {
+        if (errno != EEXIST) return false;
+        m->fd = shm_open(m->name, O_RDWR, 0600);
+        if (m->fd < 0) return false;
+
+        // создатель мог ещё не успеть сделать ftruncate
+        struct stat st;
+        for (int tries = 0; ; tries++) {
+            if (fstat(m->fd, &st) != 0 || tries > 1000) {
+                close(m->fd);
+                m->fd = -1;
+                return false;
+            }
+            if ((size_t)st.st_size >= sizeof(SharedData)) break;
+            ThreadYield();
+        }
+    }
+
+    void* p = mmap(nullptr, sizeof(SharedData), PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+    if (p == MAP_FAILED) {
+        close(m->fd);
+        m->fd = -1;
+        if (*created) shm_unlink(m->name);
+        return false;
+    }
+    m->data = (SharedData*)p;
+    return true;
+}
+
+static void UnmapRoot(SharedMapping* m) {
+    if (m->data) munmap(m->data, sizeof(SharedData));
+    if (m->fd >= 0) close(m->fd);
+    m->data = nullptr;
+    m->fd = -1;
+}
+
+static SharedCells* CreateCells(const char* name, uint32_t gen, int gridSize, void** handle, size_t* bytes) {
+    char cn[96]; CellsName(cn, sizeof(cn), name, gen);
+    size_t sz = CellsBytes(gridSize);
+    int fd = shm_open(cn, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, (off_t)sz) != 0) {
+        close(fd);
+        shm_unlink(cn);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(cn);
+        return nullptr;
+    }
+    SharedCells* c = (SharedCells*)p;
+    c->generation = gen;
+    c->gridSize = gridSize;
+    c->words = GridWordsFor(gridSize);
+    c->blocks = (c->words + GRID_BLOCK_WORDS - 1) / GRID_BLOCK_WORDS;
+    *handle = nullptr;
+    *bytes = sz;
+    return c;
+}
+
+static SharedCells* OpenCells(const char* name, uint32_t gen, void** handle, size_t* bytes) {
+    char cn[96]; CellsName(cn, sizeof(cn), name, gen);
+    int fd = shm_open(cn, O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SharedCells)) {
+        close(fd);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return nullptr;
+    *handle = nullptr;
+    *bytes = (size_t)st.st_size;
+    return (SharedCells*)p;
+}
+
+static void UnmapCells(SharedCells* c, void*, size_t bytes) {
+    munmap(c, bytes);
+}
+
+static void RemoveCells(const char* name, uint32_t gen) {
+    char cn[96]; CellsName(cn, sizeof(cn), name, gen);
+    shm_unlink(cn);
+}
+
+void SharedUnlink(const char* name) {
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd >= 0) {
+        void* p = mmap(nullptr, sizeof(SharedData), PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            RemoveCells(name, ((SharedData*)p)->generation);
+            munmap(p, sizeof(SharedData));
+        }
+        close(fd);
+    }
+    shm_unlink(name);
+}
+
+#endif
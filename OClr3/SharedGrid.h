@@ -0,0 +1,273 @@
+﻿#pragma once
+
+// Состояние поля в именованной разделяемой памяти.
+// Один и тот же интерфейс поверх CreateFileMapping (Windows) и shm_open/mmap (POSIX).
+//
+// Память из двух сегментов:
+//   name          — заголовок SharedData фиксированного размера (seqlock, цвета,
+//                   размер поля, номер поколения);
+//   name.<gen>    — SharedCells: клетки по 2 бита + версии блоков, размер
+//                   считается из gridSize при создании.
+// Изменение размера создаёт новое поколение; остальные процессы замечают
+// смену generation и перемапливают payload сами.
+
+#include "Platform.h"
+
+#include <stddef.h>
+#include <atomic>
+
+#ifdef _WIN32
+#define SHARED_MEM_NAME "Local\\GridSharedMemory"
+#else
+#define SHARED_MEM_NAME "/GridSharedMemory"
+#endif
+
+#define GRID_MAX_SIZE     16384
+#define GRID_CELLS_WORD   32     // клеток в одном uint64_t (по 2 бита)
+#define GRID_BLOCK_WORDS  4      // слов на одну отметку версии
+#define GRID_BLOCK_CELLS  (GRID_CELLS_WORD * GRID_BLOCK_WORDS)
+#define SHARED_STALL_SPINS 4096  // ожиданий записи до проверки, жив ли писатель
+
+// Значения клетки
+enum { CELL_EMPTY = 0, CELL_O = 1, CELL_X = 2 };
+
+#define GRID_MAX_SUBSCRIBERS 128
+#define MOVE_QUEUE_SLOTS     256       // степень двойки: номер заявки переполняется ровно на круге
+
+// Итог хода, поданного через очередь (MoveQueue.h)
+enum MoveResult {
+    MOVE_PENDING = 0,
+    MOVE_ACCEPTED,
+    MOVE_OCCUPIED,                     // клетка уже занята
+    MOVE_NOT_YOUR_TURN,
+    MOVE_GAME_OVER,
+    MOVE_OUT_OF_RANGE,
+    MOVE_DROPPED,                      // заявку пропустили: номер взят, а сама она не опубликована вовремя
+};
+
+// Слот подписчика на изменения (см. Notify.h)
+struct SharedSubscriber {
+    std::atomic<uint32_t> pid;         // 0 — слот свободен
+    std::atomic<uint32_t> wake;        // счётчик пробуждений, он же futex-слово
+};
+
+// Заявка на ход в кольце MPSC. state на круге lap: 4*lap — свободна,
+// +1 — заявка записана, +2 — ход разобран и result готов, +3 — разборщик
+// пропускает брошенную заявку; автор, забрав результат, сам переводит
+// слот в 4*(lap+1).
+// claim пишется сразу, как взят номер (когда прошлый круг слота уже
+// опубликован): по нему разборщик узнаёт, что автор неопубликованной
+// заявки умер, и пропускает её.
+struct SharedMoveSlot {
+    std::atomic<uint32_t> state;
+    std::atomic<uint32_t> pid;         // автор заявки; 0 — брошена, автор неизвестен
+    std::atomic<uint64_t> claim;       // номер заявки << 32 | pid того, кто его взял
+    int      cell;
+    int      player;
+    int      result;                   // MoveResult
+    uint32_t version;                  // версия поля, в которой ход разобран
+};
+
+struct SharedMoveQueue {
+    std::atomic<uint32_t> tail;        // следующий номер заявки
+    std::atomic<uint32_t> head;        // первая неразобранная (меняет только разборщик)
+    std::atomic<uint32_t> consumer;    // pid того, кто сейчас разбирает; 0 — никто
+    SharedMoveSlot slots[MOVE_QUEUE_SLOTS];
+};
+
+// Запись идёт под seqlock: писатель переводит seq в нечётное значение,
+// меняет данные и возвращает чётное. Читатель копирует данные и
+// проверяет, что seq не изменился — читатели не ждут никого, кроме
+// идущей записи. Номер версии поля = seq / 2.
+// Писатели упорядочиваются CAS-ом на writer — pid того, кто пишет.
+// Умер посреди записи — seq остался нечётным; кто ждёт дольше
+// SHARED_STALL_SPINS, проверяет pid и забирает запись у мёртвого.
+// Читатель при этом чинит только само поле; журнал и историю с него
+// начинает следующий писатель (rebasePending).
+struct SharedData {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> writer;      // 0 — никто не пишет
+    std::atomic<uint32_t> ready;       // payload первого поколения создан
+    uint32_t generation;
+    int      gridSize;
+    COLORREF backgroundColor;
+    COLORREF gridColor;
+    uint32_t colorVersion;             // версия последней смены цветов или размера
+
+    // Партия (Rules.h): победитель определяется тем же писателем, что ставит клетку
+    int      winLength;                // K в ряд; 0 — по размеру поля
+    int      winner;                   // CELL_O / CELL_X, CELL_EMPTY — партия идёт
+    int      winCell;                  // выигравшая линия: крайняя клетка
+    int      winDir;                   // и направление (RulesDir)
+    uint32_t countO;                   // фишек на поле: чей ход — по ним,
+    uint32_t countX;                   // как в SearchSideToMove
+    uint32_t rebasePending;            // поле починил читатель: журнал и историю заново начнёт писатель
+
+    std::atomic<uint32_t> colorGeneration;   // слой цветов клеток name.color.<n> (Color.h); 0 — нет
+
+    SharedMoveQueue  moves;
+    SharedSubscriber subscribers[GRID_MAX_SUBSCRIBERS];
+};
+
+struct SharedCells {
+    uint32_t generation;
+    int      gridSize;
+    uint32_t words;                    // uint64_t под клетки
+    uint32_t blocks;                   // отметок версий
+    // далее: uint64_t cells[words]; uint32_t blockVersion[blocks];
+};
+
+inline uint64_t* SharedCellWords(SharedCells* c) { return (uint64_t*)(c + 1); }
+inline uint32_t* SharedBlockVersions(SharedCells* c) { return (uint32_t*)(SharedCellWords(c) + c->words); }
+
+inline int GridCellGet(const uint64_t* words, int index) {
+    return (int)(words[index / GRID_CELLS_WORD] >> ((index % GRID_CELLS_WORD) * 2)) & 3;
+}
+inline void GridCellSet(uint64_t* words, int index, int value) {
+    uint64_t& w = words[index / GRID_CELLS_WORD];
+    int shift = (index % GRID_CELLS_WORD) * 2;
+    w = (w & ~(3ull << shift)) | ((uint64_t)(value & 3) << shift);
+}
+inline uint32_t GridWordsFor(int gridSize) {
+    return (uint32_t)(((size_t)gridSize * gridSize + GRID_CELLS_WORD - 1) / GRID_CELLS_WORD);
+}
+
+struct Journal;
+struct History;
+struct Arena;
+
+struct SharedMapping {
+    SharedData*  data;
+    SharedCells* cells;
+    uint32_t     generation;          // поколение, которое сейчас замаплено
+    size_t       cellsBytes;
+    char         name[64];
+    Journal*     journal;             // куда писать изменения (Journal.h), может не быть
+    History*     history;             // версии для отмены ходов (History.h), может не быть
+    Arena*       arena;               // доска из арены (Arena.h); nullptr — свои сегменты
+    int          board;               // запись каталога арены
+#ifdef _WIN32
+    HANDLE       hMap;
+    HANDLE       hCells;
+    // события слотов подписчиков этого поля по паре (слот, pid), Notify.cpp;
+    // с маппингом работают несколько потоков — под slotEventsLock
+    HANDLE       slotEvents[GRID_MAX_SUBSCRIBERS];
+    uint32_t     slotEventPid[GRID_MAX_SUBSCRIBERS];
+    SRWLOCK      slotEventsLock;
+#else
+    int          fd;
+#endif
+};
+
+// Согласованная копия поля на момент version. Буфер cells растёт по мере
+// надобности и переиспользуется между вызовами; освобождать GridSnapshotFree.
+struct GridSnapshot {
+    uint32_t  version;
+    int       gridSize;
+    COLORREF  backgroundColor;
+    COLORREF  gridColor;
+    int       winLength;               // действующее K
+    int       winner;
+    int       winCell;
+    int       winDir;
+    uint64_t* cells;
+    uint32_t  capWords;
+};
+void GridSnapshotFree(GridSnapshot* s);
+
+// Что поменялось после заданной версии: по биту на блок из GRID_BLOCK_CELLS
+// клеток + флаг цветов/размера. Буфер dirty тоже переиспользуется.
+struct GridChanges {
+    uint32_t  version;
+    int       gridSize;
+    bool      colorsChanged;
+    uint32_t  blocks;
+    uint64_t* dirty;
+    uint32_t  capBlocks;
+};
+void GridChangesFree(GridChanges* c);
+
+// Изменённые клетки при инкрементальном обновлении снимка.
+// words/wordIdx — рабочий буфер слов, скопированных из разделяемой памяти.
+struct GridDelta {
+    uint32_t* cells;
+    uint32_t  count;
+    uint32_t  cap;
+    uint32_t* wordIdx;
+    uint64_t* words;
+    uint32_t  wordCount;
+    uint32_t  wordCap;
+};
+void GridDeltaFree(GridDelta* d);
+
+// Ход из очереди: клетка, игрок и итог разбора
+struct MoveRequest {
+    int cell;
+    int player;
+    int result;                        // MoveResult
+};
+
+// Открывает (или создаёт) поле name. gridSize используется только при создании.
+// created = true, если сегмент создан этим процессом и его надо инициализировать.
+bool SharedOpen(SharedMapping* m, const char* name, int gridSize, bool* created);
+void SharedClose(SharedMapping* m);
+// То же для доски id в арене a. Размер доски задаётся при создании и
+// дальше не меняется (SharedResize откажет): блок клеток в арене один.
+bool SharedOpenBoard(SharedMapping* m, Arena* a, uint32_t id, int gridSize, bool* created);
+
+// Под POSIX сегменты живут до явного удаления, в отличие от Windows,
+// где они исчезают вместе с последним хэндлом.
+void SharedUnlink(const char* name);
+
+// ——— Запись (каждая функция — одна атомарно опубликованная версия) ———
+// Возвращают номер новой версии.
+// Ход проверяется правилами в той же версии; после победы поле не
+// принимает ходы до SharedNewGame (тогда возвращается 0).
+uint32_t SharedWriteCell(SharedMapping* m, int index, int value);
+uint32_t SharedWriteBackground(SharedMapping* m, COLORREF c);
+uint32_t SharedWriteGridColor(SharedMapping* m, COLORREF c);
+uint32_t SharedWriteColors(SharedMapping* m, COLORREF background, COLORREF grid);
+
+// Ходы из очереди одной версией: каждый принимается, только если клетка
+// пуста, партия идёт и сейчас очередь этого игрока; иначе — отказ в result.
+uint32_t SharedApplyMoves(SharedMapping* m, MoveRequest* moves, int count);
+// Чей ход: CELL_O, пока ноликов не больше, чем крестиков
+int      SharedSideToMove(const SharedMapping* m);
+
+// Сброс поля создателем сегмента
+void     SharedReset(SharedMapping* m, COLORREF background, COLORREF grid);
+// Новая партия: пустое поле, цвета и размер остаются
+uint32_t SharedNewGame(SharedMapping* m);
+// Сколько в ряд нужно для победы (0 — по размеру поля); победитель пересчитывается
+uint32_t SharedSetWinLength(SharedMapping* m, int k);
+// Всё поле разом (восстановление из журнала): размер и упакованные клетки
+bool     SharedLoadCells(SharedMapping* m, int gridSize, const uint64_t* words);
+
+// С этого момента каждая запись в m попадает ещё и в журнал j.
+// checkpoint — начать журнал со снимка текущего поля (первый экземпляр).
+void     SharedAttachJournal(SharedMapping* m, Journal* j, bool checkpoint);
+
+// С этого момента клетки каждой записи попадают ещё и в историю h.
+// rebase — начать историю с текущего поля (первый экземпляр).
+void     SharedAttachHistory(SharedMapping* m, History* h, bool rebase);
+// Отмена (steps < 0) и повтор ходов: поле и победитель становятся как в
+// той версии истории (насколько её хватает). 0 — идти некуда.
+uint32_t SharedTimeTravel(SharedMapping* m, int steps);
+// Для повтора журнала: клетка без проверки правил и победитель как есть
+uint32_t SharedRestoreCell(SharedMapping* m, int index, int value);
+uint32_t SharedRestoreWinner(SharedMapping* m, int winner, int winCell, int winDir);
+
+// Новое поколение payload под другой размер; содержимое пересекающейся
+// части поля сохраняется. Остальные процессы перемапятся при следующем доступе.
+bool     SharedResize(SharedMapping* m, int gridSize);
+
+// ——— Чтение ———
+uint32_t SharedVersion(const SharedMapping* m);
+int      SharedGridSize(SharedMapping* m);
+void     SharedReadSnapshot(SharedMapping* m, GridSnapshot* out);
+// Заполняет out изменениями после версии since (без копирования всего поля)
+void     SharedChangedSince(SharedMapping* m, uint32_t since, GridChanges* out);
+// Доводит снимок до текущей версии, копируя только блоки, изменившиеся
+// после snap->version, и складывает в delta индексы изменившихся клеток.
+// false — поменялись цвета или размер поля: снимок перечитан целиком, delta пуст.
+bool     SharedRefreshSnapshot(SharedMapping* m, GridSnapshot* snap, GridDelta* delta);
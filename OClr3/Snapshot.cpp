@@ -0,0 +1,353 @@
+﻿#include "Snapshot.h"
+#include "SharedGrid.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SNAPSHOT_MAGIC         0x504E5347u     // "GSNP"
+#define SNAPSHOT_VERSION       1
+#define SNAPSHOT_HEADER_BYTES  4096u
+#define SNAPSHOT_PAGE_WORDS    512u            // 4 КБ клеток на страницу
+
+typedef std::chrono::steady_clock Clock;
+
+struct SnapshotHeader {
+    uint32_t magic;                    // 0 — слот пишется прямо сейчас
+    uint32_t version;
+    uint64_t seq;                      // номер снимка: у целого слота больше — новее
+    uint32_t boardVersion;
+    int32_t  gridSize;
+    uint32_t words;
+    uint32_t backgroundColor;
+    uint32_t gridColor;
+    int32_t  winLength;
+    uint32_t check;                    // FNV-1a всех полей выше
+};
+
+static uint32_t HeaderCheck(const SnapshotHeader* h) {
+    const uint8_t* p = (const uint8_t*)h;
+    uint32_t x = 2166136261u;
+    for (size_t i = 0; i < offsetof(SnapshotHeader, check); i++) {
+        x ^= p[i];
+        x *= 16777619u;
+    }
+    return x;
+}
+
+// ——————————————————————————————— Файлы слотов ——————————————————————————————————————
+
+#ifdef _WIN32
+typedef HANDLE FileHandle;
+#define NO_FILE INVALID_HANDLE_VALUE
+#else
+typedef int FileHandle;
+#define NO_FILE (-1)
+#endif
+
+static FileHandle OpenSlot(const char* path, bool write) {
+#ifdef _WIN32
+    return CreateFileA(path, write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        FILE_SHARE_READ, nullptr, write ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+    return open(path, write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+#endif
+}
+
+static void CloseSlot(FileHandle f) {
+#ifdef _WIN32
+    CloseHandle(f);
+#else
+    close(f);
+#endif
+}
+
+static bool WriteAt(FileHandle f, uint64_t off, const void* data, size_t len) {
+#ifdef _WIN32
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)off;
+    ov.OffsetHigh = (DWORD)(off >> 32);
+    DWORD written = 0;
+    return WriteFile(f, data, (DWORD)len, &written, &ov) && written == len;
+#else
+    return pwrite(f, data, len, (off_t)off) == (ssize_t)len;
+#endif
+}
+
+static bool ReadAt(FileHandle f, uint64_t off, void* data, size_t len) {
+#ifdef _WIN32
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)off;
+    ov.OffsetHigh = (DWORD)(off >> 32);
+    DWORD rd = 0;
+    return ReadFile(f, data, (DWORD)len, &rd, &ov) && rd == len;
+#else
+    return pread(f, data, len, (off_t)off) == (ssize_t)len;
+#endif
+}
+
+static void SyncSlot(FileHandle f) {
+#ifdef _WIN32
+    FlushFileBuffers(f);
+#else
+    fsync(f);
+#endif
+}
+
+static void SlotName(char* out, size_t n, const char* path, int slot) {
+    snprintf(out, n, "%s.%d", path, slot);
+}
+
+// ——————————————————————————————— Запись ——————————————————————————————————————
+
+struct SnapshotWriter {
+    std::string                  shmName;
+    std::string                  path;
+    uint32_t                     intervalMs;
+    std::thread                  thread;
+    std::mutex                   lock;
+    std::condition_variable      wake;
+    bool                         stop;
+    SnapshotStats                stats;            // под lock
+
+    // дальше — только поток снимков
+    SharedMapping                map;
+    GridSnapshot                 snap;
+    GridDelta                    delta;
+    FileHandle                   lockFile;
+    FileHandle                   slots[2];
+    std::vector<uint8_t>         dirty[2];         // страницы, не записанные в слот
+    uint32_t                     slotVersion[2];   // версия поля в слоте; 0 — слот не наш
+    int                          slotSize[2];
+    uint64_t                     seq;
+};
+
+// Пишет один экземпляр: держим path.lock, пока живы
+static bool TakeWriterLock(SnapshotWriter* w) {
+    if (w->lockFile != NO_FILE) return true;
+    char name[260];
+    snprintf(name, sizeof(name), "%s.lock", w->path.c_str());
+#ifdef _WIN32
+    // чужой открытый хэндл без общего доступа — блокировка; умрёт с процессом
+    w->lockFile = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+    int fd = open(name, O_RDWR | O_CREAT, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) != 0) { close(fd); fd = -1; }
+    w->lockFile = fd;
+#endif
+    return w->lockFile != NO_FILE;
+}
+
+static void MarkAll(SnapshotWriter* w, size_t pages) {
+    for (int s = 0; s < 2; s++) w->dirty[s].assign(pages, 1);
+}
+
+// Номер следующего снимка — после самого нового из целых слотов на диске
+static void ReadSeq(SnapshotWriter* w) {
+    w->seq = 0;
+    for (int s = 0; s < 2; s++) {
+        SnapshotHeader h;
+        if (ReadAt(w->slots[s], 0, &h, sizeof(h)) && h.magic == SNAPSHOT_MAGIC && h.check == HeaderCheck(&h))
+            w->seq = h.seq > w->seq ? h.seq : w->seq;
+    }
+}
+
+static uint64_t WriteSlot(SnapshotWriter* w, int s) {
+    FileHandle f = w->slots[s];
+    const GridSnapshot& sn = w->snap;
+    uint32_t words = GridWordsFor(sn.gridSize);
+    uint64_t bytes = 0;
+
+    // 1) слот помечается как пишущийся
+    SnapshotHeader h = {};
+    if (!WriteAt(f, 0, &h, sizeof(h))) return 0;
+    SyncSlot(f);
+
+    // 2) изменившиеся страницы; при другом размере поля — все
+    std::vector<uint8_t>& dirty = w->dirty[s];
+    bool all = w->slotSize[s] != sn.gridSize;
+    size_t pages = dirty.size();
+    for (size_t p = 0; p < pages; p++) {
+        if (!all && !dirty[p]) continue;
+        uint32_t w0 = (uint32_t)p * SNAPSHOT_PAGE_WORDS;
+        uint32_t n = words - w0 < SNAPSHOT_PAGE_WORDS ? words - w0 : SNAPSHOT_PAGE_WORDS;
+        size_t len = (size_t)n * sizeof(uint64_t);
+        if (!WriteAt(f, SNAPSHOT_HEADER_BYTES + (uint64_t)w0 * sizeof(uint64_t), sn.cells + w0, len)) return 0;
+        bytes += len;
+        dirty[p] = 0;
+    }
+    SyncSlot(f);
+
+    // 3) заголовок — последним
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    h.seq = ++w->seq;
+    h.boardVersion = sn.version;
+    h.gridSize = sn.gridSize;
+    h.words = words;
+    h.backgroundColor = sn.backgroundColor;
+    h.gridColor = sn.gridColor;
+    h.winLength = w->map.data->winLength;
+    h.check = HeaderCheck(&h);
+    if (!WriteAt(f, 0, &h, sizeof(h))) return 0;
+    SyncSlot(f);
+    w->slotVersion[s] = sn.version;
+    w->slotSize[s] = sn.gridSize;
+    return bytes + sizeof(h);
+}
+
+static void TakeSnapshot(SnapshotWriter* w) {
+    if (!TakeWriterLock(w)) return;
+    if (w->slots[0] == NO_FILE) {
+        char name[260];
+        for (int s = 0; s < 2; s++) {
+            SlotName(name, sizeof(name), w->path.c_str(), s);
+            w->slots[s] = OpenSlot(name, true);
+        }
+        if (w->slots[0] == NO_FILE || w->slots[1] == NO_FILE) return;
+        ReadSeq(w);
+    }
+
+    // согласованная копия: только блоки, изменившиеся с прошлого раза
+    Clock::time_point t0 = Clock::now();
+    int oldSize = w->snap.gridSize;
+    bool incremental = SharedRefreshSnapshot(&w->map, &w->snap, &w->delta);
+    uint32_t copyUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+
+    size_t pages = (GridWordsFor(w->snap.gridSize) + SNAPSHOT_PAGE_WORDS - 1) / SNAPSHOT_PAGE_WORDS;
+    if (!incremental || w->snap.gridSize != oldSize) {
+        // цвета или размер: снимок перечитан целиком, слоты переписываем целиком
+        MarkAll(w, pages);
+    }
+    else {
+        for (uint32_t i = 0; i < w->delta.count; i++) {
+            size_t p = w->delta.cells[i] / GRID_CELLS_WORD / SNAPSHOT_PAGE_WORDS;
+            w->dirty[0][p] = w->dirty[1][p] = 1;
+        }
+    }
+
+    int s = (int)((w->seq + 1) & 1);
+    if (w->slotVersion[s] == w->snap.version && w->slotVersion[s ^ 1] == w->snap.version) return;
+    if (w->slotVersion[s ^ 1] == w->snap.version) return;   // новейший слот уже такой
+
+    t0 = Clock::now();
+    uint64_t bytes = WriteSlot(w, s);
+    uint32_t writeMs = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+    if (!bytes) {
+        // слот не дописан: в следующий раз — целиком
+        w->slotSize[s] = 0;
+        w->slotVersion[s] = 0;
+        return;
+    }
+
+    std::lock_guard<std::mutex> g(w->lock);
+    w->stats.snapshots++;
+    w->stats.bytesTotal += bytes;
+    w->stats.bytesLast = bytes;
+    w->stats.copyUsLast = copyUs;
+    if (copyUs > w->stats.copyUsMax) w->stats.copyUsMax = copyUs;
+    w->stats.writeMsLast = writeMs;
+}
+
+static void WriterMain(SnapshotWriter* w) {
+    std::unique_lock<std::mutex> g(w->lock);
+    while (!w->stop) {
+        w->wake.wait_for(g, std::chrono::milliseconds(w->intervalMs));
+        if (w->stop) break;
+        g.unlock();
+        TakeSnapshot(w);
+        g.lock();
+    }
+}
+
+SnapshotWriter* SnapshotStart(const char* shmName, const char* path, uint32_t intervalMs) {
+    SnapshotWriter* w = new SnapshotWriter();
+    bool created = false;
+    if (!SharedOpen(&w->map, shmName, 1, &created) || created) {
+        // поля нет — снимать нечего (созданный пустой сегмент убираем)
+        if (created) { SharedClose(&w->map); SharedUnlink(shmName); }
+        delete w;
+        return nullptr;
+    }
+    w->shmName = shmName;
+    w->path = path;
+    w->intervalMs = intervalMs ? intervalMs : 1000;
+    w->stop = false;
+    w->lockFile = NO_FILE;
+    w->slots[0] = w->slots[1] = NO_FILE;
+    w->thread = std::thread(WriterMain, w);
+    return w;
+}
+
+void SnapshotStop(SnapshotWriter* w) {
+    if (!w) return;
+    {
+        std::lock_guard<std::mutex> g(w->lock);
+        w->stop = true;
+    }
+    w->wake.notify_all();
+    w->thread.join();
+    for (int s = 0; s < 2; s++)
+        if (w->slots[s] != NO_FILE) CloseSlot(w->slots[s]);
+    if (w->lockFile != NO_FILE) CloseSlot(w->lockFile);
+    GridSnapshotFree(&w->snap);
+    GridDeltaFree(&w->delta);
+    SharedClose(&w->map);
+    delete w;
+}
+
+SnapshotStats SnapshotGetStats(SnapshotWriter* w) {
+    std::lock_guard<std::mutex> g(w->lock);
+    return w->stats;
+}
+
+// ——————————————————————————————— Восстановление ——————————————————————————————————
+
+bool SnapshotRestore(const char* path, SharedMapping* m) {
+    char name[260];
+    FileHandle f[2];
+    SnapshotHeader h[2];
+    int best = -1;
+    for (int s = 0; s < 2; s++) {
+        SlotName(name, sizeof(name), path, s);
+        f[s] = OpenSlot(name, false);
+        bool ok = f[s] != NO_FILE && ReadAt(f[s], 0, &h[s], sizeof(h[s]))
+            && h[s].magic == SNAPSHOT_MAGIC && h[s].version == SNAPSHOT_VERSION
+            && h[s].check == HeaderCheck(&h[s])
+            && h[s].gridSize >= 1 && h[s].gridSize <= GRID_MAX_SIZE
+            && h[s].words == GridWordsFor(h[s].gridSize);
+        if (ok && (best < 0 || h[s].seq > h[best].seq)) best = s;
+    }
+
+    bool restored = false;
+    if (best >= 0) {
+        // одно чтение всех клеток и одна запись в поле
+        size_t bytes = (size_t)h[best].words * sizeof(uint64_t);
+        uint64_t* words = (uint64_t*)malloc(bytes);
+        if (words && ReadAt(f[best], SNAPSHOT_HEADER_BYTES, words, bytes)
+            && SharedLoadCells(m, h[best].gridSize, words))
+        {
+            SharedWriteColors(m, h[best].backgroundColor, h[best].gridColor);
+            SharedSetWinLength(m, h[best].winLength);
+            restored = true;
+        }
+        free(words);
+    }
+    for (int s = 0; s < 2; s++)
+        if (f[s] != NO_FILE) CloseSlot(f[s]);
+    return restored;
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+// Периодические снимки поля на диск из фонового потока.
+//
+// Поток открывает поле своим SharedMapping и читает его как обычный
+// читатель seqlock: SharedRefreshSnapshot даёт согласованную копию на
+// один момент, писатели (окно, другие экземпляры) его не ждут совсем.
+//
+// Снимок лежит в двух файлах-слотах path.0 / path.1, по очереди. В слот
+// пишутся только страницы клеток, изменившиеся с прошлой записи в этот
+// же слот, так что снимок большого поля стоит примерно столько, сколько
+// в нём поменялось. Порядок записи: заголовок слота гасится, страницы,
+// сброс, новый заголовок, сброс — оборванный слот не читается, а второй
+// остаётся целым.
+//
+// Пишет один экземпляр на каталог: тот, кто держит path.lock.
+
+#include <stdint.h>
+
+struct SharedMapping;
+struct SnapshotWriter;
+
+struct SnapshotStats {
+    uint64_t snapshots;                // записано снимков
+    uint64_t bytesTotal;               // байт записано всего
+    uint64_t bytesLast;                // в последнем снимке
+    uint32_t copyUsLast;               // согласованное копирование поля, мкс
+    uint32_t copyUsMax;
+    uint32_t writeMsLast;              // запись и сброс на диск
+};
+
+// shmName — имя поля (SHARED_MEM_NAME), раз в intervalMs — снимок,
+// если поле изменилось. nullptr — поток не запустился.
+SnapshotWriter* SnapshotStart(const char* shmName, const char* path, uint32_t intervalMs);
+void            SnapshotStop(SnapshotWriter* w);
+// Копия счётчиков (поток их обновляет)
+SnapshotStats   SnapshotGetStats(SnapshotWriter* w);
+
+// Загрузить последний целый снимок в поле m. false — снимка нет.
+bool            SnapshotRestore(const char* path, SharedMapping* m);
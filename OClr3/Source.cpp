@@ -9,74 +9,148 @@
 #include <sstream>
 #include <shellapi.h>
 #include <iostream>
+#include <atomic>
+#include <utility>
 #include <winuser.h>
 
-#define DEFAULT_GRID_SIZE      3
-#define DEFAULT_WIN_WIDTH      320
-#define DEFAULT_WIN_HEIGHT     240
+#include "SharedGrid.h"
+#include "Notify.h"
+#include "UpdateScheduler.h"
+#include "Render.h"
+#include "Config.h"
+#include "Search.h"
+#include "Journal.h"
+#include "Snapshot.h"
+#include "History.h"
+#include "MoveQueue.h"
+#include "Arena.h"
+#include "Mirror.h"
+#include "Metrics.h"
+#include "Loadgen.h"
+#include "Layout.h"
+#include "Color.h"
 
 // ———————————————————————————————————————————————————————————————————————————————
 // Структуры и глобальные переменные
 
-struct Config {
-    int gridSize;
-    int clientWidth;
-    int clientHeight;
-    COLORREF backgroundColor;
-    COLORREF gridColor;
-};
-
-// Конфиг
-Config currentConfig = {
-    DEFAULT_GRID_SIZE,
-    DEFAULT_WIN_WIDTH,
-    DEFAULT_WIN_HEIGHT,
-    RGB(0, 0, 255),
-    RGB(255, 0, 0)
-};
-
 // Имена файлов
 const TCHAR szWinClass[] = _T("Win32SampleApp");
 const TCHAR szWinName[] = _T("Win32SampleWindow");
-const TCHAR* configFileName = _T("config.txt");
-const TCHAR* dataFileName = _T("data.bin");
+const char*  dataFileName = "data.bin";
+const char*  snapshotFileName = "board.snap";   // слоты board.snap.0 / board.snap.1
+#define SNAPSHOT_INTERVAL_MS 2000
+
+// Размер поля задан явно через -grid (тогда подключившийся экземпляр меняет размер общего поля).
+// Конфиг читается после разбора ключей, поэтому значение хранится отдельно
+// и накладывается поверх прочитанного.
+bool gridFromCmdLine = false;
+int  gridSizeArg = 0;
+
+// Доска в общей арене (-board id, Arena.h); 0 — отдельное поле SHARED_MEM_NAME
+uint32_t boardId = 0;
+uint32_t destroyBoardId = 0;          // -destroy id: удалить доску и выйти
+Arena*   arena = nullptr;
 
-// Механизмы чтения/записи конфига
-enum ConfigMethod { METHOD_MAPPING, METHOD_FILEVARS, METHOD_FSTREAM, METHOD_WINAPI };
-ConfigMethod configMethod = METHOD_MAPPING;
+// Зеркало поля в сокет/канал (-mirror [endpoint], Mirror.h); у доски арены к имени добавляется .id
+bool          mirrorOn = false;
+char          mirrorEndpoint[MAX_PATH] = MIRROR_ENDPOINT;
+MirrorServer* mirror = nullptr;
+
+// Сколько в ряд для победы (-k); 0 — не задано, остаётся как в общем поле
+int  winLengthArg = 0;
+int  shownWinner = -1;             // что сейчас показано в заголовке
+int  shownWinLength = 0;
+
+// Компьютерный игрок (-ai o|x): ищет ход в своём потоке и ставит его
+// через WM_AI_MOVE тем же SharedWriteCell, что и клик
+#define WM_AI_MOVE  (WM_APP + 2)
+int           aiPlayer = CELL_EMPTY;
+uint32_t      aiThinkMs = 500;
+SearchEngine* aiEngine = nullptr;
+ThreadPool*   aiPool = nullptr;
+HANDLE        hAiThread = nullptr;
+GridSnapshot  aiSnap = {};         // поле, на котором идёт поиск
+
+// Чем рисовать WM_PAINT: GDI напрямую или программный растеризатор (Render.h)
+enum RenderMode { RENDER_GDI, RENDER_RASTER, RENDER_TILED };
+RenderMode  renderMode = RENDER_GDI;
+Framebuffer paintFb = {};
+ThreadPool* renderPool = nullptr;   // для RENDER_TILED
+int         renderThreads = 0;      // 0 — по числу ядер
 
 // Для хелперов GDI и WinAPI
 HINSTANCE hInst;
 HWND      hwnd;
 HBRUSH    hBackgroundBrush = NULL;
 
-// Для классического поля крестиков-ноликов
-int* gridCells = nullptr;
-void      InitializeGrid() {
-    if (gridCells) free(gridCells);
-    gridCells = (int*)calloc(currentConfig.gridSize * currentConfig.gridSize, sizeof(int));
-}
-void      CleanupGrid() {
-    if (gridCells) { free(gridCells); gridCells = nullptr; }
-}
-
 // ———————————————————————————————————————————————————————————————————————————————
 // IPC через именованную память
 
 UINT WM_IPC_UPDATE;
 
-// Named shared memory for grid state:
-const TCHAR* SHARED_MEM_NAME = _T("Local\\GridSharedMemory");
+// Named shared memory for grid state (SharedGrid.h):
+SharedMapping sharedMap = {};
+SharedData*   pShared = nullptr;
+GridSnapshot  paintSnap = {};     // то, что сейчас нарисовано в окне
+GridDelta     paintDelta = {};    // клетки, изменившиеся с прошлой перерисовки
+Journal*      journal = nullptr;  // журнал поля в data.bin (Journal.h)
+JournalFlusher* journalFlusher = nullptr;   // сбрасывает журнал на диск вместо окна
+SnapshotWriter* snapshots = nullptr;   // фоновые снимки поля (Snapshot.h)
+// Сколько окно стоит на сохранности поля: подъём из журнала или снимка
+// при старте и будильник потока журнала раз в кадр. Контрольные точки
+// журнала идут внутри записи поля — их время в JournalStats.
+uint32_t      restoreMs = 0;
+uint32_t      kickUsLast = 0, kickUsMax = 0;
+History*      history = nullptr;  // общая история ходов для Ctrl+Z / Ctrl+Y (History.h)
 
-struct SharedData {
-    int      gridSize;
-    COLORREF backgroundColor;
-    COLORREF gridColor;
-    int      cells[100];
-};
+// Сколько пикселей затронула перерисовка: последняя и всего
+uint64_t paintPixelsLast = 0;
+uint64_t paintPixelsTotal = 0;
+uint64_t paintCount = 0;
+
+// Подписка на изменения (Notify.h): свой слот и поток, который его ждёт
+int               notifySlot = -1;
+HANDLE            hNotifyThread = nullptr;
+std::atomic<bool> notifyStop(false);
+std::atomic<bool> updatePending(false);   // WM_IPC_UPDATE уже в очереди
+
+// Задержки и счётчики в общем сегменте name.stats (Metrics.h); читает -stats
+Metrics*              metrics = nullptr;
+uint64_t              firstWriteNs = 0;   // первая запись, ещё не разосланная
+std::atomic<uint64_t> notifiedNs(0);      // первое уведомление после прошлой перерисовки
+bool                  statsMode = false;  // -stats [мс]: только печатать, окна нет
+uint32_t              statsIntervalMs = 0;   // 0 — напечатать один раз
+
+// Без окна: сценарий (-replay файл) или случайный поток ходов (-load), Loadgen.h
+LoadgenOptions loadOpts;
+
+// Склейка обновлений: свои публикации и перерисовки по чужим — не чаще кадра
+#define TIMER_PUBLISH  1
+#define TIMER_REPAINT  2
+#define TIMER_HEATMAP  3
+uint32_t        frameIntervalMs = DEFAULT_FRAME_INTERVAL;
+UpdateScheduler publishSched;
+UpdateScheduler repaintSched;
+
+// Свой цвет у каждой клетки (Color.h): слой читают все, рисует кадры -heatmap.
+// cellPixels — слой, уже переведённый в пиксели для растеризатора
+bool        heatmapOn = false;
+ColorLayer* colorLayer = nullptr;
+uint32_t*   cellPixels = nullptr;
+size_t      cellPixelsCap = 0;
+int         cellPixelsSize = 0;       // поле, под которое переведено; 0 — нечего рисовать
+uint32_t    cellPixelsVersion = 0;
+uint32_t*   heatBorn = nullptr;       // кадр, в котором клетку заняли (для -heatmap)
+size_t      heatBornCap = 0;
+uint32_t    heatFrame = 0;
 
-SharedData* pShared = nullptr;
-HANDLE      hMapFile = nullptr;
+// Место окна на экране (Layout.h): плитки общие для всех экземпляров
+Layout*     layout = nullptr;
+LayoutPlace layoutPlace = { -1 };
+
+// Горячая перезагрузка конфига: поток наблюдателя только будит окно
+#define WM_CONFIG_RELOAD  (WM_APP + 1)
+ConfigWatcher*  configWatcher = nullptr;
 
 // ———————————————————————————————————————————————————————————————————————————————
 // Прототипы
@@ -85,20 +159,30 @@ void    UpdateBackgroundBrush(HWND hWnd, COLORREF c) {
     if (hBackgroundBrush)
         DeleteObject(hBackgroundBrush);
     hBackgroundBrush = CreateSolidBrush(c);
+    MetricsCount(metrics, METRIC_BRUSHES);
     SetClassLongPtr(hWnd, GCLP_HBRBACKGROUND, (LONG_PTR)hBackgroundBrush);
 }
-COLORREF HSVtoRGB(float H, float S, float V);
 void    ChangeGridLineColor(int delta);
 void    LaunchNotepad();
 void    ParseCommandLine(LPCTSTR);
-void    LoadConfig(), SaveConfig();
-void    LoadConfigMapping(), SaveConfigMapping();
-void    LoadConfigFileVars(), SaveConfigFileVars();
-void    LoadConfigFStream(), SaveConfigFStream();
-void    LoadConfigWinAPI(), SaveConfigWinAPI();
 void    BroadcastUpdate();
+void    RequestBroadcast();
+void    MarkNotified(uint64_t now);
+int     RunStatsReader();
+int     RunLoadgen();
+int     RunDestroyBoard();
+DWORD WINAPI NotifyThreadProc(LPVOID);
 void    UpdateFromShared(HWND hWnd);
+void    ConfigChangedProc(void*);
+void    ApplyReloadedConfig();
+void    UpdateWindowTitle(HWND hWnd);
+void    MaybeStartAiMove();
+DWORD WINAPI AiThreadProc(LPVOID);
 void    PlaceWindowNonOverlapping(HWND hNew);
+void    RefreshCellColors(HWND hWnd);
+void    HeatmapFrame(HWND hWnd);
+uint64_t PaintGDI(HDC dc, const GridSnapshot& snap, const GridLayout& lay, const RECT& rcPaint);
+uint64_t PaintRaster(HDC dc, const GridSnapshot& snap, const GridLayout& lay, const RECT& rcPaint);
 
 // ———————————————————————————————————————————————————————————————————————————————
 // main
@@ -106,37 +190,72 @@ int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE, LPTSTR lpCmdLine, int nCmdS
     hInst = hInstance;
 
     // Параметры + конфиг
+    LoadgenDefaults(&loadOpts);
+    loadOpts.mode = LOADGEN_OFF;
     ParseCommandLine(lpCmdLine);
+    if (statsMode) return RunStatsReader();
+    if (destroyBoardId) return RunDestroyBoard();
     LoadConfig();
+    if (gridFromCmdLine) currentConfig.gridSize = gridSizeArg;
+    if (loadOpts.mode != LOADGEN_OFF) return RunLoadgen();
 
-    // Поле
-    InitializeGrid();
+    SchedulerInit(&publishSched, frameIntervalMs);
+    SchedulerInit(&repaintSched, frameIntervalMs);
+    // цвет клеток рисует только растеризатор
+    if (heatmapOn && renderMode == RENDER_GDI)
+        renderMode = RENDER_RASTER;
+    if (renderMode == RENDER_TILED)
+        renderPool = ThreadPoolCreate(renderThreads);
+    if (aiPlayer != CELL_EMPTY) {
+        aiPool = ThreadPoolCreate(0);
+        aiEngine = SearchCreate(aiPool, 22);
+    }
 
     // Shared Memory
-    hMapFile = CreateFileMapping(
-        INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
-        0, sizeof(SharedData), SHARED_MEM_NAME
-    );
-    if (!hMapFile) {
-        MessageBox(NULL, _T("Cannot create/open shared memory"), _T("Error"), MB_ICONERROR);
-        return 1;
+    if (currentConfig.gridSize < 1 || currentConfig.gridSize > GRID_MAX_SIZE)
+        currentConfig.gridSize = DEFAULT_GRID_SIZE;
+    bool firstInstance = false;
+    bool opened;
+    if (boardId) {
+        if (currentConfig.gridSize > ARENA_MAX_GRID) currentConfig.gridSize = ARENA_MAX_GRID;
+        arena = ArenaOpen(ARENA_NAME);
+        opened = arena && SharedOpenBoard(&sharedMap, arena, boardId, currentConfig.gridSize, &firstInstance);
     }
-    pShared = (SharedData*)MapViewOfFile(
-        hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedData)
-    );
-    if (!pShared) {
-        MessageBox(NULL, _T("Cannot map shared memory"), _T("Error"), MB_ICONERROR);
-        CloseHandle(hMapFile);
+    else {
+        opened = SharedOpen(&sharedMap, SHARED_MEM_NAME, currentConfig.gridSize, &firstInstance);
+    }
+    if (!opened) {
+        MessageBox(NULL, _T("Cannot create/open shared memory"), _T("Error"), MB_ICONERROR);
         return 1;
     }
+    pShared = sharedMap.data;
 
-    bool firstInstance = (GetLastError() != ERROR_ALREADY_EXISTS);
+    // Первый экземпляр поднимает поле из журнала прошлых запусков;
+    // у каждой доски арены журнал свой, снимки (Snapshot.h) — только у основного поля
+    char boardDataFile[64];
+    if (boardId) sprintf_s(boardDataFile, "data.%u.bin", boardId);
+    journal = JournalOpen(boardId ? boardDataFile : dataFileName, firstInstance);
     if (firstInstance) {
-        currentConfig.gridSize = DEFAULT_GRID_SIZE;
-        pShared->backgroundColor = RGB(0, 0, 255);
-        pShared->gridColor = RGB(255, 0, 0);
-        memset(pShared->cells, 0, sizeof(pShared->cells));
+        uint64_t t0 = MetricsNow();
+        SharedReset(&sharedMap, RGB(0, 0, 255), RGB(255, 0, 0));
+        // журнала нет или он битый — берём последний снимок
+        if (!JournalReplay(journal, &sharedMap) && !boardId)
+            SnapshotRestore(snapshotFileName, &sharedMap);
+        restoreMs = (uint32_t)((MetricsNow() - t0) / 1000000);
+    }
+    SharedAttachJournal(&sharedMap, journal, firstInstance);
+    journalFlusher = JournalFlusherStart(journal);
+    history = HistoryOpen(sharedMap.name, firstInstance);
+    SharedAttachHistory(&sharedMap, history, firstInstance);
+    metrics = MetricsOpen(sharedMap.name, firstInstance, true);
+    colorLayer = heatmapOn ? ColorLayerCreate(&sharedMap) : ColorLayerOpen(&sharedMap);
+    if (gridFromCmdLine && currentConfig.gridSize != SharedGridSize(&sharedMap)) {
+        SharedResize(&sharedMap, currentConfig.gridSize);
     }
+    if (winLengthArg > 0)
+        SharedSetWinLength(&sharedMap, winLengthArg);
+    currentConfig.gridSize = SharedGridSize(&sharedMap);
+    SharedReadSnapshot(&sharedMap, &paintSnap);
 
     // Window class
     WNDCLASS wc = {};
@@ -144,6 +263,7 @@ int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE, LPTSTR lpCmdLine, int nCmdS
     wc.hInstance = hInst;
     wc.lpszClassName = _T("IPCGridClass");
     wc.hbrBackground = CreateSolidBrush(pShared->backgroundColor);
+    MetricsCount(metrics, METRIC_BRUSHES);
     WM_IPC_UPDATE = RegisterWindowMessage(_T("IPCGRID_UPDATE"));
     RegisterClass(&wc);
 
@@ -156,11 +276,41 @@ int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE, LPTSTR lpCmdLine, int nCmdS
     );
     if (!hwnd) return 0;
 
+    UpdateWindowTitle(hwnd);
+
     // Размещаем без перекрытия
     PlaceWindowNonOverlapping(hwnd);
 
+    RefreshCellColors(hwnd);
     ShowWindow(hwnd, nCmdShow);
     UpdateWindow(hwnd);
+    if (heatmapOn)
+        SetTimer(hwnd, TIMER_HEATMAP, frameIntervalMs, nullptr);
+
+    // Подписываемся на изменения от других экземпляров
+    notifySlot = NotifySubscribe(&sharedMap);
+    if (notifySlot >= 0)
+        hNotifyThread = CreateThread(nullptr, 0, NotifyThreadProc, nullptr, 0, nullptr);
+
+    // Следим за файлом конфига
+    configWatcher = ConfigWatchStart(configMethod, &currentConfig, ConfigChangedProc, nullptr);
+
+    // Снимки поля на диск — в своём потоке, окно их не ждёт
+    if (!boardId)
+        snapshots = SnapshotStart(SHARED_MEM_NAME, snapshotFileName, SNAPSHOT_INTERVAL_MS);
+
+    // Зеркало для внешних клиентов; рассылает свой поток
+    if (mirrorOn) {
+        if (boardId) {
+            char base[MAX_PATH];
+            strcpy_s(base, mirrorEndpoint);
+            sprintf_s(mirrorEndpoint, "%s.%u", base, boardId);
+        }
+        mirror = MirrorStart(mirrorEndpoint, &paintSnap);
+    }
+
+    // Если первый ход наш — начинаем
+    MaybeStartAiMove();
 
     // Message loop
     MSG msg;
@@ -170,220 +320,45 @@ int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE, LPTSTR lpCmdLine, int nCmdS
     }
 
     // Clean up
-    CleanupGrid();
-    UnmapViewOfFile(pShared);
-    CloseHandle(hMapFile);
-    UnregisterClass(_T("IPCGridClass"), hInst);
-    return (int)msg.wParam;
-}
-
-
-// ————————————————————————————— Работа с конфигом (4 способа) ——————————————————————————————————
-
-void LoadConfig() {
-    switch (configMethod) {
-    case METHOD_MAPPING:   LoadConfigMapping(); break;
-    case METHOD_FILEVARS:  LoadConfigFileVars(); break;
-    case METHOD_FSTREAM:   LoadConfigFStream(); break;
-    case METHOD_WINAPI:    LoadConfigWinAPI(); break;
-    }
-}
-void SaveConfig() {
-    switch (configMethod) {
-    case METHOD_MAPPING:   SaveConfigMapping(); break;
-    case METHOD_FILEVARS:  SaveConfigFileVars(); break;
-    case METHOD_FSTREAM:   SaveConfigFStream(); break;
-    case METHOD_WINAPI:    SaveConfigWinAPI(); break;
-    }
-}
-
-// — Memory Mapping
-void LoadConfigMapping() {
-    HANDLE f = CreateFile(configFileName, GENERIC_READ,
-        FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (f == INVALID_HANDLE_VALUE) return;
-    LARGE_INTEGER sz; GetFileSizeEx(f, &sz);
-    HANDLE m = CreateFileMapping(f, nullptr, PAGE_READONLY, sz.HighPart, sz.LowPart, nullptr);
-    LPVOID p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, sz.LowPart);
-    if (!p) { CloseHandle(m); CloseHandle(f); return; }
-    char* buf = new char[sz.LowPart + 1];
-    memcpy(buf, p, sz.LowPart); buf[sz.LowPart] = 0;
-    int r1, g1, b1, r2, g2, b2;
-    if (sscanf_s(buf,
-        "GridSize=%d\nWindowWidth=%d\nWindowHeight=%d\n"
-        "BackgroundColor=%d;%d;%d\nGridColor=%d;%d;%d",
-        &currentConfig.gridSize,
-        &currentConfig.clientWidth,
-        &currentConfig.clientHeight,
-        &r1, &g1, &b1,
-        &r2, &g2, &b2) == 9)
-    {
-        currentConfig.backgroundColor = RGB(r1, g1, b1);
-        currentConfig.gridColor = RGB(r2, g2, b2);
-    }
-    delete[] buf;
-    UnmapViewOfFile(p);
-    CloseHandle(m);
-    CloseHandle(f);
-}
-void SaveConfigMapping() {
-    char buf[512];
-    int len = snprintf(buf, 512,
-        "GridSize=%d\nWindowWidth=%d\nWindowHeight=%d\n"
-        "BackgroundColor=%d;%d;%d\nGridColor=%d;%d;%d\n",
-        currentConfig.gridSize,
-        currentConfig.clientWidth,
-        currentConfig.clientHeight,
-        GetRValue(currentConfig.backgroundColor),
-        GetGValue(currentConfig.backgroundColor),
-        GetBValue(currentConfig.backgroundColor),
-        GetRValue(currentConfig.gridColor),
-        GetGValue(currentConfig.gridColor),
-        GetBValue(currentConfig.gridColor)
-    );
-    HANDLE f = CreateFile(configFileName,
-        GENERIC_READ | GENERIC_WRITE, 0, nullptr,
-        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (f == INVALID_HANDLE_VALUE) return;
-    // расширяем файл и мапим для записи
-    LARGE_INTEGER size; size.QuadPart = len;
-    SetFilePointerEx(f, size, nullptr, FILE_BEGIN);
-    SetEndOfFile(f);
-    HANDLE m = CreateFileMapping(f, nullptr, PAGE_READWRITE, 0, len, nullptr);
-    LPVOID p = MapViewOfFile(m, FILE_MAP_WRITE, 0, 0, len);
-    memcpy(p, buf, len);
-    FlushViewOfFile(p, len);
-    UnmapViewOfFile(p);
-    CloseHandle(m);
-    CloseHandle(f);
-}
-
-// — FILEVARS
-void LoadConfigFileVars() {
-    FILE* fp = fopen("config.txt", "r");
-    if (!fp) return;
-    fseek(fp, 0, SEEK_END);
-    long s = ftell(fp); rewind(fp);
-    char* buf = new char[s + 1];
-    fread(buf, 1, s, fp); buf[s] = 0; fclose(fp);
-    char* line = strtok(buf, "\n");
-    while (line) {
-        if (!strncmp(line, "GridSize=", 9))
-            currentConfig.gridSize = atoi(line + 9);
-        else if (!strncmp(line, "WindowWidth=", 12))
-            currentConfig.clientWidth = atoi(line + 12);
-        else if (!strncmp(line, "WindowHeight=", 13))
-            currentConfig.clientHeight = atoi(line + 13);
-        else if (!strncmp(line, "BackgroundColor=", 16)) {
-            int r, g, b; sscanf_s(line + 16, "%d;%d;%d", &r, &g, &b);
-            currentConfig.backgroundColor = RGB(r, g, b);
-        }
-        else if (!strncmp(line, "GridColor=", 10)) {
-            int r, g, b; sscanf_s(line + 10, "%d;%d;%d", &r, &g, &b);
-            currentConfig.gridColor = RGB(r, g, b);
-        }
-        line = strtok(nullptr, "\n");
+    if (hNotifyThread) {
+        notifyStop = true;
+        NotifyWake(&sharedMap, notifySlot);
+        WaitForSingleObject(hNotifyThread, INFINITE);
+        CloseHandle(hNotifyThread);
     }
-    delete[] buf;
-}
-void SaveConfigFileVars() {
-    FILE* fp = fopen("config.txt", "w");
-    if (!fp) return;
-    fprintf(fp,
-        "GridSize=%d\nWindowWidth=%d\nWindowHeight=%d\n"
-        "BackgroundColor=%d;%d;%d\nGridColor=%d;%d;%d\n",
-        currentConfig.gridSize,
-        currentConfig.clientWidth,
-        currentConfig.clientHeight,
-        GetRValue(currentConfig.backgroundColor),
-        GetGValue(currentConfig.backgroundColor),
-        GetBValue(currentConfig.backgroundColor),
-        GetRValue(currentConfig.gridColor),
-        GetGValue(currentConfig.gridColor),
-        GetBValue(currentConfig.gridColor)
-    );
-    fclose(fp);
-}
-
-// — FSTREAM
-void LoadConfigFStream() {
-    std::ifstream f("config.txt");
-    if (!f) return;
-    std::string line; int r, g, b;
-    while (std::getline(f, line)) {
-        if (sscanf(line.c_str(), "GridSize=%d", &currentConfig.gridSize) == 1) continue;
-        if (sscanf(line.c_str(), "WindowWidth=%d", &currentConfig.clientWidth) == 1) continue;
-        if (sscanf(line.c_str(), "WindowHeight=%d", &currentConfig.clientHeight) == 1) continue;
-        if (sscanf(line.c_str(), "BackgroundColor=%d;%d;%d", &r, &g, &b) == 3)
-            currentConfig.backgroundColor = RGB(r, g, b);
-        if (sscanf(line.c_str(), "GridColor=%d;%d;%d", &r, &g, &b) == 3)
-            currentConfig.gridColor = RGB(r, g, b);
+    if (hAiThread) {
+        SearchAbort(aiEngine);
+        WaitForSingleObject(hAiThread, INFINITE);
+        CloseHandle(hAiThread);
     }
-}
-void SaveConfigFStream() {
-    std::ofstream f("config.txt");
-    f << "GridSize=" << currentConfig.gridSize << "\n"
-        << "WindowWidth=" << currentConfig.clientWidth << "\n"
-        << "WindowHeight=" << currentConfig.clientHeight << "\n"
-        << "BackgroundColor="
-        << GetRValue(currentConfig.backgroundColor) << ";"
-        << GetGValue(currentConfig.backgroundColor) << ";"
-        << GetBValue(currentConfig.backgroundColor) << "\n"
-        << "GridColor="
-        << GetRValue(currentConfig.gridColor) << ";"
-        << GetGValue(currentConfig.gridColor) << ";"
-        << GetBValue(currentConfig.gridColor) << "\n";
+    SearchDestroy(aiEngine);
+    ThreadPoolDestroy(aiPool);
+    GridSnapshotFree(&aiSnap);
+    NotifyUnsubscribe(&sharedMap, notifySlot);
+    GridSnapshotFree(&paintSnap);
+    GridDeltaFree(&paintDelta);
+    FramebufferFree(&paintFb);
+    ThreadPoolDestroy(renderPool);
+    SnapshotStop(snapshots);
+    MirrorStop(mirror);
+    sharedMap.history = nullptr;
+    HistoryClose(history);
+    JournalFlusherStop(journalFlusher);
+    sharedMap.journal = nullptr;
+    JournalClose(journal);
+    MetricsClose(metrics);
+    ColorLayerClose(colorLayer);
+    free(cellPixels);
+    free(heatBorn);
+    LayoutRelease(layout, &layoutPlace);
+    LayoutClose(layout);
+    SharedClose(&sharedMap);
+    ArenaClose(arena);
+    pShared = nullptr;
+    UnregisterClass(_T("IPCGridClass"), hInst);
+    return (int)msg.wParam;
 }
 
-// — WinAPI
-void LoadConfigWinAPI() {
-    HANDLE f = CreateFile(configFileName, GENERIC_READ, FILE_SHARE_READ,
-        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (f == INVALID_HANDLE_VALUE) return;
-    LARGE_INTEGER sz; GetFileSizeEx(f, &sz);
-    char* buf = new char[sz.LowPart + 1];
-    DWORD rd;
-    ReadFile(f, buf, sz.LowPart, &rd, nullptr);
-    buf[rd] = 0;
-    int r, g, b;
-    if (sscanf_s(buf,
-        "GridSize=%d\nWindowWidth=%d\nWindowHeight=%d\n"
-        "BackgroundColor=%d;%d;%d\nGridColor=%d;%d;%d",
-        &currentConfig.gridSize,
-        &currentConfig.clientWidth,
-        &currentConfig.clientHeight,
-        &r, &g, &b,
-        &r, &g, &b) == 9)
-    {
-        currentConfig.backgroundColor = RGB(r, g, b);
-        currentConfig.gridColor = RGB(r, g, b);
-    }
-    delete[] buf;
-    CloseHandle(f);
-}
-void SaveConfigWinAPI() {
-    HANDLE f = CreateFile(configFileName, GENERIC_WRITE, 0, nullptr,
-        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (f == INVALID_HANDLE_VALUE) return;
-    char buf[512];
-    int len = sprintf_s(buf,
-        "GridSize=%d\nWindowWidth=%d\nWindowHeight=%d\n"
-        "BackgroundColor=%d;%d;%d\nGridColor=%d;%d;%d\n",
-        currentConfig.gridSize,
-        currentConfig.clientWidth,
-        currentConfig.clientHeight,
-        GetRValue(currentConfig.backgroundColor),
-        GetGValue(currentConfig.backgroundColor),
-        GetBValue(currentConfig.backgroundColor),
-        GetRValue(currentConfig.gridColor),
-        GetGValue(currentConfig.gridColor),
-        GetBValue(currentConfig.gridColor)
-    );
-    DWORD written;
-    WriteFile(f, buf, len, &written, nullptr);
-    CloseHandle(f);
-}
 
 // ———————————————————————————————— Парсинг аргументов —————————————————————————————————————
 void ParseCommandLine(LPCTSTR lpCmdLine) {
@@ -393,12 +368,65 @@ void ParseCommandLine(LPCTSTR lpCmdLine) {
         if (!_wcsicmp(argv[i], L"-m2")) configMethod = METHOD_FILEVARS;
         if (!_wcsicmp(argv[i], L"-m3")) configMethod = METHOD_FSTREAM;
         if (!_wcsicmp(argv[i], L"-m4")) configMethod = METHOD_WINAPI;
-        if (!_wcsicmp(argv[i], L"-grid") && i + 1 < argc)
-            currentConfig.gridSize = _wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-m5")) configMethod = METHOD_BINARY;
+        if (!_wcsicmp(argv[i], L"-grid") && i + 1 < argc) {
+            gridSizeArg = _wtoi(argv[++i]);
+            gridFromCmdLine = true;
+        }
+        if (!_wcsicmp(argv[i], L"-board") && i + 1 < argc)
+            boardId = (uint32_t)_wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-destroy") && i + 1 < argc)
+            destroyBoardId = (uint32_t)_wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-mirror")) {
+            mirrorOn = true;
+            if (i + 1 < argc && argv[i + 1][0] != L'-')
+                sprintf_s(mirrorEndpoint, "%ls", argv[++i]);
+        }
+        if (!_wcsicmp(argv[i], L"-stats")) {
+            statsMode = true;
+            if (i + 1 < argc && iswdigit(argv[i + 1][0]))
+                statsIntervalMs = (uint32_t)_wtoi(argv[++i]);
+        }
+        if (!_wcsicmp(argv[i], L"-k") && i + 1 < argc)
+            winLengthArg = _wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-replay") && i + 1 < argc) {
+            static char script[MAX_PATH];
+            sprintf_s(script, "%ls", argv[++i]);
+            loadOpts.mode = LOADGEN_REPLAY;
+            loadOpts.script = script;
+        }
+        if (!_wcsicmp(argv[i], L"-load")) loadOpts.mode = LOADGEN_RANDOM;
+        if (!_wcsicmp(argv[i], L"-rate") && i + 1 < argc)
+            loadOpts.rate = (uint32_t)_wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-ops") && i + 1 < argc)
+            loadOpts.ops = (uint64_t)_wtoi64(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-duration") && i + 1 < argc)
+            loadOpts.durationMs = (uint32_t)_wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-repeat") && i + 1 < argc)
+            loadOpts.repeat = (uint32_t)_wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-seed") && i + 1 < argc)
+            loadOpts.seed = (uint32_t)_wtoi64(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-colors") && i + 1 < argc)
+            loadOpts.colorPermille = (uint32_t)_wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-ai") && i + 1 < argc) {
+            ++i;
+            if (!_wcsicmp(argv[i], L"o")) aiPlayer = CELL_O;
+            if (!_wcsicmp(argv[i], L"x")) aiPlayer = CELL_X;
+        }
+        if (!_wcsicmp(argv[i], L"-think") && i + 1 < argc)
+            aiThinkMs = (uint32_t)_wtoi(argv[++i]);
         if (!_wcsicmp(argv[i], L"-width") && i + 1 < argc)
             currentConfig.clientWidth = _wtoi(argv[++i]);
         if (!_wcsicmp(argv[i], L"-height") && i + 1 < argc)
             currentConfig.clientHeight = _wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-heatmap")) heatmapOn = true;
+        if (!_wcsicmp(argv[i], L"-gdi")) renderMode = RENDER_GDI;
+        if (!_wcsicmp(argv[i], L"-raster")) renderMode = RENDER_RASTER;
+        if (!_wcsicmp(argv[i], L"-tiles")) renderMode = RENDER_TILED;
+        if (!_wcsicmp(argv[i], L"-threads") && i + 1 < argc)
+            renderThreads = _wtoi(argv[++i]);
+        if (!_wcsicmp(argv[i], L"-frame") && i + 1 < argc)
+            frameIntervalMs = (uint32_t)_wtoi(argv[++i]);
     }
     LocalFree(argv);
 }
@@ -406,43 +434,238 @@ void ParseCommandLine(LPCTSTR lpCmdLine) {
 // ——————————————————————————————— IPC helpers ——————————————————————————————————————
 
 void BroadcastUpdate() {
-    // 1) Local window: invalidate+immediate repaint
-    InvalidateRect(hwnd, NULL, TRUE);
-    UpdateWindow(hwnd);
+    uint64_t now = MetricsNow();
+    MetricsCount(metrics, METRIC_BROADCASTS);
 
-    SendMessageTimeout(
-        HWND_BROADCAST,
-        WM_IPC_UPDATE,
-        0, 0,
-        SMTO_ABORTIFHUNG | SMTO_NOTIMEOUTIFNOTHUNG,
-        100,
-        nullptr
-    );
+    // 1) Local window: invalidate changed cells + immediate repaint
+    MarkNotified(now);
+    UpdateFromShared(hwnd);
+
+    // 2) Остальные экземпляры сетки: только будим их слоты, сами не ждём.
+    // Время записи — для их write->notify
+    if (firstWriteNs) {
+        MetricsPublishWrite(metrics, firstWriteNs);
+        firstWriteNs = 0;
+    }
+    NotifyAll(&sharedMap, notifySlot);
+
+    // 3) Всё, что накопилось в журнале за кадр, — на диск одним сбросом;
+    // сбрасывает поток журнала, окно диска не ждёт
+    uint64_t t0 = MetricsNow();
+    JournalFlusherKick(journalFlusher);
+    kickUsLast = (uint32_t)((MetricsNow() - t0) / 1000);
+    if (kickUsLast > kickUsMax) kickUsMax = kickUsLast;
+}
+
+// Вызывается на каждое изменение от ввода; сама публикация — не чаще кадра
+void RequestBroadcast() {
+    if (!firstWriteNs) firstWriteNs = MetricsNow();
+    uint32_t delay = 0;
+    switch (SchedulerOnInput(&publishSched, GetTickCount64(), &delay)) {
+    case SCHED_NOW:    BroadcastUpdate(); break;
+    case SCHED_DEFER:  SetTimer(hwnd, TIMER_PUBLISH, delay, nullptr); break;
+    case SCHED_MERGED: break;
+    }
 }
 
+// Поток ожидания: на каждое пробуждение ставит в очередь окна не больше
+// одного WM_IPC_UPDATE, пока предыдущий не обработан
+DWORD WINAPI NotifyThreadProc(LPVOID) {
+    uint32_t seen = NotifySeen(&sharedMap, notifySlot);
+    uint64_t lastWrite = MetricsLastWrite(metrics);
+    while (!notifyStop) {
+        if (!NotifyWait(&sharedMap, notifySlot, &seen, -1) || notifyStop) continue;
+        uint64_t now = MetricsNow(), w = MetricsLastWrite(metrics);
+        if (w > lastWrite && w <= now)
+            MetricsRecord(metrics, METRIC_WRITE_TO_NOTIFY, now - w);
+        lastWrite = w;
+        MarkNotified(now);
+        if (!updatePending.exchange(true))
+            PostMessage(hwnd, WM_IPC_UPDATE, 0, 0);
+    }
+    return 0;
+}
+
+// Начало отсчёта notify->paint: первое уведомление после прошлой перерисовки
+void MarkNotified(uint64_t now) {
+    uint64_t none = 0;
+    notifiedNs.compare_exchange_strong(none, now);
+}
+
+// Подтягивает в paintSnap только изменившиеся блоки и инвалидирует
+// прямоугольники изменившихся клеток. Целиком окно перерисовывается
+// только при смене цветов или размера поля.
 void UpdateFromShared(HWND hWnd) {
-    UpdateBackgroundBrush(hWnd, pShared->backgroundColor);
-    InvalidateRect(hWnd, NULL, TRUE);
+    bool incremental = SharedRefreshSnapshot(&sharedMap, &paintSnap, &paintDelta);
+    MirrorPublish(mirror, &paintSnap, &paintDelta, !incremental);
+    if (heatBorn) {
+        // новое поле или размер — все фишки считаем старыми
+        size_t cells = (size_t)paintSnap.gridSize * paintSnap.gridSize;
+        if (!incremental) for (size_t i = 0; i < heatBornCap && i < cells; i++) heatBorn[i] = heatFrame - 1000;
+        else for (uint32_t i = 0; i < paintDelta.count; i++) heatBorn[paintDelta.cells[i]] = heatFrame;
+    }
+    RefreshCellColors(hWnd);
+    if (!incremental) {
+        UpdateBackgroundBrush(hWnd, paintSnap.backgroundColor);
+        InvalidateRect(hWnd, NULL, FALSE);
+    }
+    else if (paintDelta.count) {
+        RECT rc; GetClientRect(hWnd, &rc);
+        GridLayout lay = GridLayoutMake(paintSnap.gridSize, rc.right - rc.left, rc.bottom - rc.top);
+        for (uint32_t i = 0; i < paintDelta.count; i++) {
+            RenderClip b = GridCellBounds(&lay, (int)paintDelta.cells[i]);
+            RECT cell = { b.left, b.top, b.right, b.bottom };
+            InvalidateRect(hWnd, &cell, FALSE);
+        }
+    }
+    UpdateWindowTitle(hWnd);
     UpdateWindow(hWnd);
+    MaybeStartAiMove();
 }
 
-void PlaceWindowNonOverlapping(HWND hNew) {
-    int offsetX = 0;
-    HWND cur = nullptr;
-    while ((cur = FindWindowEx(
-        nullptr, cur,
-        _T("IPCGridClass"), nullptr)) != nullptr) 
-    {
-        if (cur == hNew) {
-            continue;
-        }
-        if (IsWindowVisible(cur)) {
-            RECT r;
-            GetWindowRect(cur, &r);
-            offsetX += (r.right - r.left) + 10;
+// Запускает поиск, если наш ход, партия идёт и поиск ещё не запущен
+void MaybeStartAiMove() {
+    if (aiPlayer == CELL_EMPTY || hAiThread || paintSnap.winner != CELL_EMPTY) return;
+    if (SearchSideToMove(paintSnap.cells, paintSnap.gridSize) != aiPlayer) return;
+    SharedReadSnapshot(&sharedMap, &aiSnap);
+    hAiThread = CreateThread(nullptr, 0, AiThreadProc, nullptr, 0, nullptr);
+}
+
+// Поток поиска: один ход и обратно в окно
+DWORD WINAPI AiThreadProc(LPVOID) {
+    SearchLimits limits = { aiThinkMs, 0 };
+    SearchStats st;
+    int move = SearchBestMove(aiEngine, aiSnap.cells, aiSnap.gridSize, aiSnap.winLength,
+        aiPlayer, &limits, &st);
+    TCHAR buf[160];
+    _stprintf_s(buf, _T("IPC Grid AI: move %d, depth %d, score %d, nodes %llu in %u ms\n"),
+        move, st.depth, st.score, st.nodes, st.elapsedMs);
+    OutputDebugString(buf);
+    PostMessage(hwnd, WM_AI_MOVE, (WPARAM)(INT_PTR)move, 0);
+    return 0;
+}
+
+// Итог партии — в заголовке окна
+void UpdateWindowTitle(HWND hWnd) {
+    if (paintSnap.winner == shownWinner && paintSnap.winLength == shownWinLength) return;
+    shownWinner = paintSnap.winner;
+    shownWinLength = paintSnap.winLength;
+    TCHAR title[96], board[24] = _T("");
+    if (boardId) _stprintf_s(board, _T(" #%u"), boardId);
+    if (shownWinner == CELL_EMPTY)
+        _stprintf_s(title, _T("IPC Grid%s — %d in a row"), board, paintSnap.winLength);
+    else
+        _stprintf_s(title, _T("IPC Grid%s — %s wins, N for a new game"), board, shownWinner == CELL_O ? _T("O") : _T("X"));
+    SetWindowText(hWnd, title);
+}
+
+// Зовётся из потока наблюдателя — только ставит перезагрузку в очередь окна
+void ConfigChangedProc(void*) {
+    PostMessage(hwnd, WM_CONFIG_RELOAD, 0, 0);
+}
+
+// Конфиг поменяли на диске: размер поля и цвета общие — публикуем всем.
+// Размер окна у каждого экземпляра свой, его при перезагрузке не трогаем.
+void ApplyReloadedConfig() {
+    Config c;
+    if (!configWatcher || !ConfigWatchTake(configWatcher, &c)) return;
+    bool changed = false;
+    if (c.gridSize >= 1 && c.gridSize <= GRID_MAX_SIZE && c.gridSize != SharedGridSize(&sharedMap))
+        changed = SharedResize(&sharedMap, c.gridSize);
+    if (c.backgroundColor != currentConfig.backgroundColor || c.gridColor != currentConfig.gridColor) {
+        SharedWriteColors(&sharedMap, c.backgroundColor, c.gridColor);
+        currentConfig.backgroundColor = c.backgroundColor;
+        currentConfig.gridColor = c.gridColor;
+        changed = true;
+    }
+    currentConfig.gridSize = SharedGridSize(&sharedMap);
+    if (changed) RequestBroadcast();
+}
+
+// Слой цветов клеток -> пиксели для растеризатора, если слой сменился.
+// Слой пересоздан (другой размер поля) — переоткрываем.
+void RefreshCellColors(HWND hWnd) {
+    if (!ColorLayerCurrent(colorLayer, &sharedMap)) {
+        ColorLayerClose(colorLayer);
+        colorLayer = ColorLayerOpen(&sharedMap);
+        cellPixelsVersion = 0;
+        if (cellPixelsSize) InvalidateRect(hWnd, NULL, FALSE);
+        cellPixelsSize = 0;
+    }
+    int sz = ColorLayerGridSize(colorLayer);
+    uint32_t ver = ColorLayerVersion(colorLayer);
+    if (!colorLayer || sz != paintSnap.gridSize || (ver == cellPixelsVersion && cellPixelsSize == sz)) return;
+    size_t cells = (size_t)sz * sz;
+    if (cells > cellPixelsCap) {
+        free(cellPixels);
+        cellPixels = (uint32_t*)malloc(cells * sizeof(uint32_t));
+        cellPixelsCap = cellPixels ? cells : 0;
+        if (!cellPixels) { cellPixelsSize = 0; return; }
+    }
+    cellPixelsVersion = ColorLayerConvert(colorLayer, cellPixels);
+    cellPixelsSize = sz;
+    // заливка клеток под всем окном
+    InvalidateRect(hWnd, NULL, FALSE);
+}
+
+// Кадр -heatmap: у свежей фишки оттенок красный и за ~4 с остывает до
+// синего (O ярче X), пустые клетки — тусклая бегущая радуга
+void HeatmapFrame(HWND hWnd) {
+    heatFrame++;
+    int sz = paintSnap.gridSize;
+    if (!ColorLayerCurrent(colorLayer, &sharedMap) || ColorLayerGridSize(colorLayer) != sz) {
+        ColorLayerClose(colorLayer);
+        colorLayer = ColorLayerCreate(&sharedMap);
+        if (!colorLayer) return;
+    }
+    size_t cells = (size_t)sz * sz;
+    if (cells > heatBornCap) {
+        free(heatBorn);
+        heatBorn = (uint32_t*)malloc(cells * sizeof(uint32_t));
+        heatBornCap = heatBorn ? cells : 0;
+        if (!heatBorn) return;
+        for (size_t i = 0; i < cells; i++) heatBorn[i] = heatFrame - 1000;
+    }
+    ColorLayerBegin(colorLayer);
+    float* hue = ColorLayerHue(colorLayer);
+    float* sat = ColorLayerSaturation(colorLayer);
+    float* val = ColorLayerValue(colorLayer);
+    uint32_t base = heatFrame * 2 % 360;
+    for (int r = 0, i = 0; r < sz; r++) {
+        for (int c = 0; c < sz; c++, i++) {
+            int v = GridCellGet(paintSnap.cells, i);
+            if (v == CELL_EMPTY) {
+                hue[i] = (float)((base + (uint32_t)(r + c) * 4) % 360);
+                sat[i] = 0.35f;
+                val[i] = 0.35f;
+            }
+            else {
+                uint32_t age = heatFrame - heatBorn[i];
+                hue[i] = age < 240 ? (float)age : 240.0f;
+                sat[i] = 1.0f;
+                val[i] = v == CELL_O ? 1.0f : 0.8f;
+            }
         }
     }
-    SetWindowPos(hNew, HWND_TOP, offsetX, 0, 0, 0,
+    ColorLayerPublish(colorLayer);
+    NotifyAll(&sharedMap, notifySlot);
+    RefreshCellColors(hWnd);
+}
+
+// Плитка под окно из общей раскладки: ни FindWindowEx, ни GetWindowRect
+// по чужим окнам — место берётся за несколько атомарных операций
+void PlaceWindowNonOverlapping(HWND hNew) {
+    RECT r; GetWindowRect(hNew, &r);
+    int w = r.right - r.left, h = r.bottom - r.top;
+    RECT wa;
+    if (!SystemParametersInfo(SPI_GETWORKAREA, 0, &wa, 0))
+        SetRect(&wa, 0, 0, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN));
+    LayoutRect work = { wa.left, wa.top, wa.right - wa.left, wa.bottom - wa.top };
+    if (!layout) layout = LayoutOpen(LAYOUT_NAME, &work, w, h);
+    layoutPlace = LayoutClaim(layout, w, h);
+    // места нет — остаётся там, куда поставил CW_USEDEFAULT
+    if (layoutPlace.tile < 0) return;
+    SetWindowPos(hNew, HWND_TOP, layoutPlace.rect.x, layoutPlace.rect.y, 0, 0,
         SWP_NOZORDER | SWP_NOSIZE);
 }
 
@@ -451,10 +674,50 @@ void PlaceWindowNonOverlapping(HWND hNew) {
 
 LRESULT CALLBACK WindowProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     if (msg == WM_IPC_UPDATE) {
-        UpdateFromShared(hWnd);
+        updatePending = false;
+        uint32_t delay = 0;
+        switch (SchedulerOnInput(&repaintSched, GetTickCount64(), &delay)) {
+        case SCHED_NOW:    UpdateFromShared(hWnd); break;
+        case SCHED_DEFER:  SetTimer(hWnd, TIMER_REPAINT, delay, nullptr); break;
+        case SCHED_MERGED: break;
+        }
         return 0;
     }
     switch (msg) {
+    case WM_CONFIG_RELOAD:
+        ApplyReloadedConfig();
+        return 0;
+
+    case WM_AI_MOVE: {
+        WaitForSingleObject(hAiThread, INFINITE);
+        CloseHandle(hAiThread);
+        hAiThread = nullptr;
+        // ход годится, только если поле с начала поиска не менялось;
+        // кто успеет между проверкой и разбором — тому очередь и откажет
+        int move = (int)(INT_PTR)wParam;
+        if (move >= 0 && SharedVersion(&sharedMap) == aiSnap.version
+            && MoveSubmit(&sharedMap, move, aiPlayer, nullptr) == MOVE_ACCEPTED)
+        {
+            RequestBroadcast();
+        }
+        else {
+            UpdateFromShared(hWnd);
+        }
+        return 0;
+    }
+
+    case WM_TIMER:
+        KillTimer(hWnd, wParam);
+        if (wParam == TIMER_PUBLISH && SchedulerOnTimer(&publishSched, GetTickCount64()))
+            BroadcastUpdate();
+        if (wParam == TIMER_REPAINT && SchedulerOnTimer(&repaintSched, GetTickCount64()))
+            UpdateFromShared(hWnd);
+        if (wParam == TIMER_HEATMAP) {
+            HeatmapFrame(hWnd);
+            SetTimer(hWnd, TIMER_HEATMAP, frameIntervalMs, nullptr);
+        }
+        return 0;
+
     case WM_CREATE:
         // Фон из SHARED
         UpdateBackgroundBrush(hWnd, pShared->backgroundColor);
@@ -463,71 +726,60 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_SIZE:
         currentConfig.clientWidth = LOWORD(lParam);
         currentConfig.clientHeight = HIWORD(lParam);
-        InvalidateRect(hWnd, nullptr, TRUE);
+        InvalidateRect(hWnd, nullptr, FALSE);
         return 0;
 
-    case WM_ERASEBKGND: {
-        HDC dc = (HDC)wParam;
-        RECT rc;
-        GetClientRect(hWnd, &rc);
-        // paint with the *current* shared background color
-        HBRUSH hbr = CreateSolidBrush(pShared->backgroundColor);
-        FillRect(dc, &rc, hbr);
-        DeleteObject(hbr);
+    case WM_ERASEBKGND:
+        // фон рисует WM_PAINT из того же снимка, что и сетку
         return 1;
-    }
 
     case WM_PAINT: {
+        // paintSnap — один согласованный снимок (его обновляет UpdateFromShared):
+        // фон, сетка и клетки не могут оказаться из разных версий
+        const GridSnapshot& snap = paintSnap;
+        currentConfig.gridSize = snap.gridSize;
+        uint64_t t0 = MetricsNow(), notified = notifiedNs.exchange(0);
+        if (notified && notified <= t0)
+            MetricsRecord(metrics, METRIC_NOTIFY_TO_PAINT, t0 - notified);
+
         PAINTSTRUCT ps; HDC dc = BeginPaint(hWnd, &ps);
-        int sz = currentConfig.gridSize;
         RECT rc; GetClientRect(hWnd, &rc);
-        int cw = (rc.right - rc.left) / sz, ch = (rc.bottom - rc.top) / sz;
-
-        // Сетка
-        HPEN pen = CreatePen(PS_SOLID, 1, pShared->gridColor);
-        SelectObject(dc, pen);
-        for (int i = 0; i <= sz; i++) {
-            MoveToEx(dc, i * cw, 0, nullptr);
-            LineTo(dc, i * cw, rc.bottom);
-            MoveToEx(dc, 0, i * ch, nullptr);
-            LineTo(dc, rc.right, i * ch);
-        }
-        DeleteObject(pen);
-
-        // Клетки
-        for (int r = 0; r < sz; r++) {
-            for (int c = 0; c < sz; c++) {
-                int v = pShared->cells[r * sz + c];
-                int x0 = c * cw, y0 = r * ch;
-                if (v == 1) Ellipse(dc, x0 + 5, y0 + 5, x0 + cw - 5, y0 + ch - 5);
-                else if (v == 2) {
-                    MoveToEx(dc, x0 + 5, y0 + 5, nullptr);
-                    LineTo(dc, x0 + cw - 5, y0 + ch - 5);
-                    MoveToEx(dc, x0 + 5, y0 + ch - 5, nullptr);
-                    LineTo(dc, x0 + cw - 5, y0 + 5);
-                }
-            }
-        }
+        GridLayout lay = GridLayoutMake(snap.gridSize, rc.right - rc.left, rc.bottom - rc.top);
+        paintPixelsLast = (renderMode == RENDER_GDI)
+            ? PaintGDI(dc, snap, lay, ps.rcPaint)
+            : PaintRaster(dc, snap, lay, ps.rcPaint);
+        paintPixelsTotal += paintPixelsLast;
+        paintCount++;
         EndPaint(hWnd, &ps);
+        MetricsRecord(metrics, METRIC_PAINT, MetricsNow() - t0);
+        MetricsCount(metrics, METRIC_REPAINTS);
         return 0;
     }
 
     case WM_LBUTTONDOWN:
     case WM_RBUTTONDOWN: {
         // Мышь в клетку
+        uint64_t t0 = MetricsNow();
         POINT pt = { LOWORD(lParam), HIWORD(lParam) };
         RECT rc; GetClientRect(hWnd, &rc);
-        int sz = currentConfig.gridSize;
-        int cw = (rc.right - rc.left) / sz, ch = (rc.bottom - rc.top) / sz;
-        int col = pt.x / cw, row = pt.y / ch;
-        pShared->cells[row * sz + col] = (msg == WM_LBUTTONDOWN ? 1 : 2);
-        BroadcastUpdate();
+        int sz = SharedGridSize(&sharedMap);
+        GridLayout lay = GridLayoutMake(sz, rc.right - rc.left, rc.bottom - rc.top);
+        int col = pt.x / lay.cw, row = pt.y / lay.ch;
+        // клик правее/ниже последней клетки
+        if (col >= sz || row >= sz) return 0;
+        // занятая клетка или не свой ход — очередь откажет
+        int r = MoveSubmit(&sharedMap, row * sz + col, (msg == WM_LBUTTONDOWN ? CELL_O : CELL_X), nullptr);
+        if (r == MOVE_ACCEPTED) {
+            MetricsRecord(metrics, METRIC_INPUT_TO_WRITE, MetricsNow() - t0);
+            RequestBroadcast();
+        }
+        else MessageBeep(MB_ICONWARNING);
         return 0;
     }
 
     case WM_MOUSEWHEEL: {
         ChangeGridLineColor(GET_WHEEL_DELTA_WPARAM(wParam));
-        BroadcastUpdate();
+        RequestBroadcast();
         return 0;
     }
 
@@ -539,53 +791,193 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             do { nc = RGB(rand() % 256, rand() % 256, rand() % 256); } while (nc == RGB(255, 0, 0));
 
             // store it
-            pShared->backgroundColor = nc;
+            SharedWriteBackground(&sharedMap, nc);
 
             // repaint self + everyone else
-            BroadcastUpdate();
+            RequestBroadcast();
         }
         if (wParam == 'C' && (GetKeyState(VK_SHIFT) & 0x8000)) LaunchNotepad();
+        if (wParam == 'N') {
+            SharedNewGame(&sharedMap);
+            RequestBroadcast();
+        }
+        if ((wParam == 'Z' || wParam == 'Y') && (GetKeyState(VK_CONTROL) & 0x8000)) {
+            // против ИИ откатываем и его ответ, иначе он тут же сходит снова
+            int steps = aiPlayer != CELL_EMPTY ? 2 : 1;
+            if (SharedTimeTravel(&sharedMap, wParam == 'Z' ? -steps : steps))
+                RequestBroadcast();
+        }
         return 0;
 
-    case WM_DESTROY:
+    case WM_DESTROY: {
+        TCHAR stats[256];
+        _stprintf_s(stats, _T("IPC Grid: input %llu, published %llu, coalesced %llu; ")
+            _T("notifications %llu, repaints %llu, coalesced %llu; ")
+            _T("paints %llu, pixels %llu (last %llu)\n"),
+            publishSched.inputEvents, publishSched.published, publishSched.coalesced,
+            repaintSched.inputEvents, repaintSched.published, repaintSched.coalesced,
+            paintCount, paintPixelsTotal, paintPixelsLast);
+        OutputDebugString(stats);
+        // свой же SaveConfig наблюдатель видеть не должен
+        ConfigWatchStop(configWatcher);
+        configWatcher = nullptr;
         SaveConfig();
+        _stprintf_s(stats, _T("Config I/O: opens %llu, reads %llu, writes %llu, maps %llu, flushes %llu, renames %llu\n"),
+            configIOStats.opens, configIOStats.reads, configIOStats.writes,
+            configIOStats.maps, configIOStats.flushes, configIOStats.renames);
+        OutputDebugString(stats);
+        if (journal) {
+            const JournalStats* js = JournalGetStats(journal);
+            _stprintf_s(stats, _T("Journal: appended %llu, checkpoints %llu, flushes %llu, replayed %llu\n"),
+                js->appended, js->checkpoints, js->flushes, js->replayed);
+            OutputDebugString(stats);
+        }
+        // пауза окна: сброс на диск и снимки идут в своих потоках, тут —
+        // то, что всё же выполняет оно само
+        _stprintf_s(stats, _T("UI pause: restore %u ms, journal kick %u us (max %u), checkpoint %u us (max %u)\n"),
+            restoreMs, kickUsLast, kickUsMax,
+            journal ? JournalGetStats(journal)->checkpointUsLast : 0,
+            journal ? JournalGetStats(journal)->checkpointUsMax : 0);
+        OutputDebugString(stats);
+        if (arena) {
+            ArenaStats as = ArenaGetStats(arena);
+            _stprintf_s(stats, _T("Arena: boards %u, directory %u, in use %llu, carved %llu of %llu bytes, free chunks %llu\n"),
+                as.boards, as.directory, as.bytesInUse, as.bytesCarved, as.bytesTotal, as.bytesFreeChunks);
+            OutputDebugString(stats);
+        }
+        if (layout) {
+            LayoutStats ls = LayoutGetStats(layout);
+            _stprintf_s(stats, _T("Layout: tile %d, tiles used %u of %u per screen, retries %llu, reclaimed %llu\n"),
+                layoutPlace.tile, ls.used, ls.perLayer, ls.retries, ls.reclaimed);
+            OutputDebugString(stats);
+        }
+        MoveQueueStats mq = MoveQueueGetStats();
+        _stprintf_s(stats, _T("Moves: submitted %llu, accepted %llu, rejected %llu; batches %llu (%llu moves), abandoned %llu; wait %u us, max %u us\n"),
+            mq.submitted, mq.accepted, mq.rejected, mq.batches, mq.batchMoves, mq.abandoned, mq.waitUsLast, mq.waitUsMax);
+        OutputDebugString(stats);
+        if (history) {
+            HistoryInfo hi = HistoryGetInfo(history);
+            _stprintf_s(stats, _T("History: undo %u, redo %u, nodes %u (%llu bytes), seeks %llu, last %u us, max %u us\n"),
+                hi.undo, hi.redo, hi.nodes, (unsigned long long)hi.nodes * HISTORY_LEAF_WORDS * sizeof(uint64_t), hi.seeks, hi.seekUsLast, hi.seekUsMax);
+            OutputDebugString(stats);
+        }
+        if (mirror) {
+            MirrorStats ms = MirrorGetStats(mirror);
+            _stprintf_s(stats, _T("Mirror: clients %u (accepted %llu), updates %llu, messages %llu (full %llu, coalesced %llu), bytes %llu\n"),
+                ms.clients, ms.accepted, ms.updates, ms.messages, ms.fullMessages, ms.coalesced, ms.bytes);
+            OutputDebugString(stats);
+        }
+        if (snapshots) {
+            // копирует поток снимков своим SharedMapping, читателем seqlock,
+            // окно его не ждёт; своя пауза окна — в строке UI pause выше
+            SnapshotStats ss = SnapshotGetStats(snapshots);
+            _stprintf_s(stats, _T("Snapshots: %llu, bytes %llu (last %llu), ")
+                _T("copy %u us (max %u), write %u ms\n"),
+                ss.snapshots, ss.bytesTotal, ss.bytesLast, ss.copyUsLast, ss.copyUsMax, ss.writeMsLast);
+            OutputDebugString(stats);
+        }
         PostQuitMessage(0);
         return 0;
     }
+    }
     return DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
+// Отрисовка через GDI — только линии и клетки, задевающие rcPaint.
+// Возвращает площадь rcPaint: сколько пикселей реально тронул GDI, не узнать.
+uint64_t PaintGDI(HDC dc, const GridSnapshot& snap, const GridLayout& lay, const RECT& rcPaint) {
+    int sz = lay.gridSize, cw = lay.cw, ch = lay.ch;
+    RECT rc = { 0, 0, lay.width, lay.height };
+
+    // Фон
+    HBRUSH hbr = CreateSolidBrush(snap.backgroundColor);
+    MetricsCount(metrics, METRIC_BRUSHES);
+    FillRect(dc, &rcPaint, hbr);
+    DeleteObject(hbr);
+
+    // Сетка
+    HPEN pen = CreatePen(PS_SOLID, 1, snap.gridColor);
+    MetricsCount(metrics, METRIC_PENS);
+    SelectObject(dc, pen);
+    for (int i = rcPaint.left / cw; i <= sz && i <= rcPaint.right / cw; i++) {
+        MoveToEx(dc, i * cw, 0, nullptr);
+        LineTo(dc, i * cw, rc.bottom);
+    }
+    for (int i = rcPaint.top / ch; i <= sz && i <= rcPaint.bottom / ch; i++) {
+        MoveToEx(dc, 0, i * ch, nullptr);
+        LineTo(dc, rc.right, i * ch);
+    }
+    DeleteObject(pen);
+
+    // Клетки; в мелких клетках значки вылезают к соседям — берём с запасом
+    int mx = cw > 10 ? 0 : 5 / cw + 1, my = ch > 10 ? 0 : 5 / ch + 1;
+    int r0 = rcPaint.top / ch - my, r1 = (rcPaint.bottom - 1) / ch + my;
+    int c0 = rcPaint.left / cw - mx, c1 = (rcPaint.right - 1) / cw + mx;
+    if (r0 < 0) r0 = 0;
+    if (c0 < 0) c0 = 0;
+    if (r1 >= sz) r1 = sz - 1;
+    if (c1 >= sz) c1 = sz - 1;
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int v = GridCellGet(snap.cells, r * sz + c);
+            int x0 = c * cw, y0 = r * ch;
+            if (v == CELL_O) Ellipse(dc, x0 + 5, y0 + 5, x0 + cw - 5, y0 + ch - 5);
+            else if (v == CELL_X) {
+                MoveToEx(dc, x0 + 5, y0 + 5, nullptr);
+                LineTo(dc, x0 + cw - 5, y0 + ch - 5);
+                MoveToEx(dc, x0 + 5, y0 + ch - 5, nullptr);
+                LineTo(dc, x0 + cw - 5, y0 + 5);
+            }
+        }
+    }
+    return (uint64_t)(rcPaint.right - rcPaint.left) * (rcPaint.bottom - rcPaint.top);
+}
+
+// Отрисовка в память (одним потоком или тайлами на пуле) и блит
+// только испорченного прямоугольника
+uint64_t PaintRaster(HDC dc, const GridSnapshot& snap, const GridLayout& lay, const RECT& rcPaint) {
+    if (paintFb.width != lay.width || paintFb.height != lay.height) {
+        // новый размер — буфер перерисуется целиком
+        FramebufferResize(&paintFb, lay.width, lay.height);
+        InvalidateRect(hwnd, nullptr, FALSE);
+    }
+    if (!paintFb.pixels) return 0;
+    RenderClip clip = { rcPaint.left, rcPaint.top, rcPaint.right, rcPaint.bottom };
+    const uint32_t* colors = cellPixelsSize == snap.gridSize ? cellPixels : nullptr;
+    uint64_t pixels = (renderMode == RENDER_TILED)
+        ? RenderGridTiled(renderPool, &paintFb, &snap, &lay, &clip, RENDER_TILE_SIZE, colors)
+        : RenderGrid(&paintFb, &snap, &lay, &clip, colors);
+
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = lay.width;
+    bmi.bmiHeader.biHeight = -lay.height;     // сверху вниз, как в буфере
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    // у top-down DIB начало координат источника — левый верхний угол
+    SetDIBitsToDevice(dc, rcPaint.left, rcPaint.top,
+        rcPaint.right - rcPaint.left, rcPaint.bottom - rcPaint.top,
+        rcPaint.left, rcPaint.top, 0, lay.height, paintFb.pixels, &bmi, DIB_RGB_COLORS);
+    return pixels;
+}
+
 // Меняем кисть фона
 void UpdateBackgroundBrush(COLORREF c) {
     if (hBackgroundBrush)
         DeleteObject(hBackgroundBrush);
     hBackgroundBrush = CreateSolidBrush(c);
+    MetricsCount(metrics, METRIC_BRUSHES);
     // используем глобальный hwnd
     SetClassLongPtr(hwnd, GCLP_HBRBACKGROUND, (LONG_PTR)hBackgroundBrush);
 }
 
-// HSV→RGB
-COLORREF HSVtoRGB(float H, float S, float V) {
-    float r, g, b;
-    int i = (int)(H / 60) % 6;
-    float f = (H / 60) - i, p = V * (1 - S), q = V * (1 - f * S), t = V * (1 - (1 - f) * S);
-    switch (i) {
-    case 0: r = V, g = t, b = p; break;
-    case 1: r = q, g = V, b = p; break;
-    case 2: r = p, g = V, b = t; break;
-    case 3: r = p, g = q, b = V; break;
-    case 4: r = t, g = p, b = V; break;
-    default:r = V, g = p, b = q; break;
-    }
-    return RGB((int)(r * 255), (int)(g * 255), (int)(b * 255));
-}
-
 // Колёсико меняет цвет линии
 void ChangeGridLineColor(int delta) {
     static float hue = 0;
     hue += (delta / 120) * 5;
     if (hue < 0) hue += 360; if (hue >= 360) hue -= 360;
-    pShared->gridColor = HSVtoRGB(hue, 1, 1);
+    SharedWriteGridColor(&sharedMap, HSVtoRGB(hue, 1, 1));
 }
 
 // Запуск блокнота
@@ -603,3 +995,116 @@ void LaunchNotepad() {
         CloseHandle(pi.hThread);
     }
 }
+
+
+// ——————————————————————————————— Чтение статистики (-stats) ——————————————————————————————————————
+
+static const char* const metricHistNames[METRIC_HISTS] = {
+    "input->write", "write->notify", "notify->paint", "paint"
+};
+
+// Процентили одной гистограммы в микросекундах
+static void PrintHistogram(const char* name, const MetricsHistogram& h) {
+    uint64_t n = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) n += h.buckets[b];
+    printf("  %-14s n=%-8llu p50 %9.1f  p90 %9.1f  p99 %9.1f  p99.9 %9.1f  max %9.1f us\n", name,
+        (unsigned long long)n, MetricsPercentile(&h, 0.5) / 1000.0, MetricsPercentile(&h, 0.9) / 1000.0,
+        MetricsPercentile(&h, 0.99) / 1000.0, MetricsPercentile(&h, 0.999) / 1000.0, h.maxNs / 1000.0);
+}
+
+// prev — прошлое чтение: печатаем только окно между ними; nullptr — всё с запуска
+static void PrintStatsSample(const MetricsSample* cur, const MetricsSample* prev) {
+    static MetricsHistogram win, all[METRIC_HISTS];
+    memset(all, 0, sizeof(all));
+    printf("instances: %u\n", cur->instances);
+    for (uint32_t i = 0; i < cur->instances; i++) {
+        const MetricsInstance& in = cur->inst[i];
+        const MetricsInstance* was = nullptr;
+        for (uint32_t j = 0; prev && j < prev->instances; j++)
+            if (prev->inst[j].pid == in.pid && prev->inst[j].startedNs == in.startedNs) was = &prev->inst[j];
+        uint64_t c[METRIC_COUNTERS];
+        for (int k = 0; k < METRIC_COUNTERS; k++) c[k] = in.counters[k] - (was ? was->counters[k] : 0);
+        printf("pid %u: repaints %llu, brushes %llu, pens %llu, broadcasts %llu\n", in.pid,
+            (unsigned long long)c[METRIC_REPAINTS], (unsigned long long)c[METRIC_BRUSHES],
+            (unsigned long long)c[METRIC_PENS], (unsigned long long)c[METRIC_BROADCASTS]);
+        for (int h = 0; h < METRIC_HISTS; h++) {
+            if (was) MetricsHistogramDiff(&in.hist[h], &was->hist[h], &win);
+            else win = in.hist[h];
+            PrintHistogram(metricHistNames[h], win);
+            MetricsHistogramAdd(&all[h], &win);
+        }
+    }
+    if (cur->instances > 1) {
+        printf("all:\n");
+        for (int h = 0; h < METRIC_HISTS; h++) PrintHistogram(metricHistNames[h], all[h]);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// Отдельный режим без окна: копирует слоты всех живых экземпляров
+// (они при этом не останавливаются) и печатает процентили в консоль.
+// С интервалом — раз в интервал за прошедшее окно, до Ctrl+C.
+int RunStatsReader() {
+    if (!AttachConsole(ATTACH_PARENT_PROCESS)) AllocConsole();
+    FILE* out = nullptr;
+    freopen_s(&out, "CONOUT$", "w", stdout);
+
+    char name[64];
+    if (boardId) sprintf_s(name, "%s.%u", ARENA_NAME, boardId);
+    else strcpy_s(name, SHARED_MEM_NAME);
+    Metrics* m = MetricsOpen(name, false, false);
+    if (!m) {
+        printf("no stats region %s.stats: no running instances\n", name);
+        return 1;
+    }
+    MetricsSample* cur = new MetricsSample();
+    MetricsSample* prev = new MetricsSample();
+    for (;;) {
+        MetricsRead(m, cur);
+        PrintStatsSample(cur, statsIntervalMs ? prev : nullptr);
+        if (!statsIntervalMs) break;
+        std::swap(cur, prev);
+        Sleep(statsIntervalMs);
+    }
+    delete cur;
+    delete prev;
+    MetricsClose(m);
+    return 0;
+}
+
+
+// ——————————————————————————————— Нагрузка без окна (-replay / -load) ——————————————————————————————————————
+
+// Сценарий или случайный поток против общего поля; итог — в консоль.
+// На Linux то же самое запускает Headless.cpp.
+int RunLoadgen() {
+    if (!AttachConsole(ATTACH_PARENT_PROCESS)) AllocConsole();
+    FILE* out = nullptr;
+    freopen_s(&out, "CONOUT$", "w", stdout);
+    freopen_s(&out, "CONOUT$", "w", stderr);
+
+    if (currentConfig.gridSize < 1 || currentConfig.gridSize > GRID_MAX_SIZE)
+        currentConfig.gridSize = DEFAULT_GRID_SIZE;
+    char boardDataFile[64];
+    if (boardId) sprintf_s(boardDataFile, "data.%u.bin", boardId);
+    loadOpts.boardId = boardId;
+    loadOpts.gridSize = currentConfig.gridSize;
+    loadOpts.resize = gridFromCmdLine;
+    loadOpts.winLength = winLengthArg;
+    loadOpts.journalFile = boardId ? boardDataFile : dataFileName;
+    loadOpts.frameMs = frameIntervalMs;
+
+    LoadgenReport r;
+    if (!LoadgenRun(&loadOpts, &r, stderr)) return 1;
+    LoadgenPrintReport(stdout, &loadOpts, &r);
+    return 0;
+}
+
+// -destroy id: доска уходит из арены, окна с ней доигрывают до закрытия
+int RunDestroyBoard() {
+    if (!AttachConsole(ATTACH_PARENT_PROCESS)) AllocConsole();
+    FILE* out = nullptr;
+    freopen_s(&out, "CONOUT$", "w", stdout);
+    return LoadgenDestroyBoard(destroyBoardId, stdout) ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+﻿#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkQueue {
+    std::mutex      lock;
+    std::deque<int> tasks;
+};
+
+struct ThreadPool {
+    int                      size;
+    std::vector<std::thread> threads;
+    std::vector<WorkQueue>   queues;     // [0] — очередь вызывающего потока
+
+    std::mutex               lock;
+    std::condition_variable  wake;       // рабочим: появилась работа
+    std::condition_variable  done;       // вызывающему: работа кончилась
+    unsigned                 round;      // номер текущего ThreadPoolRun
+    bool                     stop;
+
+    PoolTaskFn               fn;
+    void*                    ctx;
+    std::atomic<int>         remaining;
+
+    explicit ThreadPool(int n) : size(n), queues(n), round(0), stop(false),
+        fn(nullptr), ctx(nullptr), remaining(0) {}
+};
+
+static bool PopOwn(WorkQueue& q, int* task) {
+    std::lock_guard<std::mutex> g(q.lock);
+    if (q.tasks.empty()) return false;
+    *task = q.tasks.front();
+    q.tasks.pop_front();
+    return true;
+}
+
+static bool Steal(WorkQueue& q, int* task) {
+    std::lock_guard<std::mutex> g(q.lock);
+    if (q.tasks.empty()) return false;
+    *task = q.tasks.back();
+    q.tasks.pop_back();
+    return true;
+}
+
+// Выполняет задачи, пока их можно найти у себя или у соседей
+static void Drain(ThreadPool* p, int self) {
+    int task;
+    for (;;) {
+        bool got = PopOwn(p->queues[self], &task);
+        for (int k = 1; !got && k < p->size; k++)
+            got = Steal(p->queues[(self + k) % p->size], &task);
+        if (!got) return;
+        p->fn(task, p->ctx);
+        if (p->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> g(p->lock);
+            p->done.notify_all();
+        }
+    }
+}
+
+static void WorkerMain(ThreadPool* p, int self) {
+    unsigned seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> g(p->lock);
+            p->wake.wait(g, [&] { return p->stop || p->round != seen; });
+            if (p->stop) return;
+            seen = p->round;
+        }
+        Drain(p, self);
+    }
+}
+
+ThreadPool* ThreadPoolCreate(int threads) {
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    ThreadPool* p = new ThreadPool(threads);
+    for (int i = 1; i < threads; i++)
+        p->threads.emplace_back(WorkerMain, p, i);
+    return p;
+}
+
+void ThreadPoolDestroy(ThreadPool* p) {
+    if (!p) return;
+    {
+        std::lock_guard<std::mutex> g(p->lock);
+        p->stop = true;
+    }
+    p->wake.notify_all();
+    for (auto& t : p->threads) t.join();
+    delete p;
+}
+
+int ThreadPoolSize(const ThreadPool* p) {
+    return p->size;
+}
+
+void ThreadPoolRun(ThreadPool* p, int count, PoolTaskFn fn, void* ctx) {
+    if (count <= 0) return;
+    if (p->size == 1) {
+        for (int i = 0; i < count; i++) fn(i, ctx);
+        return;
+    }
+
+    // задачу публикуем до раздачи: рабочий, ещё не вышедший из прошлого
+    // Drain, может подхватить новую задачу раньше, чем увидит round
+    p->fn = fn;
+    p->ctx = ctx;
+    p->remaining.store(count, std::memory_order_release);
+    // раздаём по кругу — соседние тайлы достаются разным потокам
+    for (int i = 0; i < count; i++) {
+        WorkQueue& q = p->queues[i % p->size];
+        std::lock_guard<std::mutex> g(q.lock);
+        q.tasks.push_back(i);
+    }
+    {
+        std::lock_guard<std::mutex> g(p->lock);
+        p->round++;
+    }
+    p->wake.notify_all();
+
+    Drain(p, 0);
+    std::unique_lock<std::mutex> g(p->lock);
+    p->done.wait(g, [&] { return p->remaining.load(std::memory_order_acquire) == 0; });
+}
@@ -0,0 +1,18 @@
+﻿#pragma once
+
+// Пул потоков с кражей работы для параллельных циклов.
+// У каждого участника своя очередь задач: свои берёт с головы,
+// опустев — крадёт с хвоста чужой. Вызывающий поток работает наравне
+// с остальными и возвращается, когда выполнены все задачи.
+
+typedef void (*PoolTaskFn)(int index, void* ctx);
+
+struct ThreadPool;
+
+// threads — число участников вместе с вызывающим; 0 — по числу ядер
+ThreadPool* ThreadPoolCreate(int threads);
+void        ThreadPoolDestroy(ThreadPool* pool);
+int         ThreadPoolSize(const ThreadPool* pool);
+
+// fn(i, ctx) для всех i из [0, count). Вызывать из одного потока за раз.
+void        ThreadPoolRun(ThreadPool* pool, int count, PoolTaskFn fn, void* ctx);
@@ -0,0 +1,33 @@
+﻿#include "UpdateScheduler.h"
+
+#include <string.h>
+
+void SchedulerInit(UpdateScheduler* s, uint32_t intervalMs) {
+    memset(s, 0, sizeof(*s));
+    s->intervalMs = intervalMs;
+}
+
+SchedResult SchedulerOnInput(UpdateScheduler* s, uint64_t nowMs, uint32_t* delayMs) {
+    s->inputEvents++;
+    if (s->pending) {
+        s->coalesced++;
+        return SCHED_MERGED;
+    }
+    uint64_t since = nowMs - s->lastPublishMs;
+    if (s->published == 0 || since >= s->intervalMs) {
+        s->lastPublishMs = nowMs;
+        s->published++;
+        return SCHED_NOW;
+    }
+    s->pending = true;
+    *delayMs = (uint32_t)(s->intervalMs - since);
+    return SCHED_DEFER;
+}
+
+bool SchedulerOnTimer(UpdateScheduler* s, uint64_t nowMs) {
+    if (!s->pending) return false;
+    s->pending = false;
+    s->lastPublishMs = nowMs;
+    s->published++;
+    return true;
+}
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+// Склейка частых изменений: не больше одной публикации за intervalMs.
+// Всё, что пришло между публикациями, сливается в одну отложенную.
+// Время передаёт вызывающий (GetTickCount64 и т.п.), таймер тоже его.
+
+#include <stdint.h>
+
+#define DEFAULT_FRAME_INTERVAL 16   // ~60 кадров в секунду
+
+enum SchedResult {
+    SCHED_NOW,      // публиковать сразу
+    SCHED_DEFER,    // завести таймер на *delayMs и опубликовать по нему
+    SCHED_MERGED    // уже ждём таймер — событие слито с отложенной публикацией
+};
+
+struct UpdateScheduler {
+    uint32_t intervalMs;
+    uint64_t lastPublishMs;
+    bool     pending;
+
+    // Счётчики: input = published + coalesced + (pending ? 1 : 0)
+    uint64_t inputEvents;
+    uint64_t published;
+    uint64_t coalesced;
+};
+
+void        SchedulerInit(UpdateScheduler* s, uint32_t intervalMs);
+SchedResult SchedulerOnInput(UpdateScheduler* s, uint64_t nowMs, uint32_t* delayMs);
+// Сработал таймер: true — публиковать
+bool        SchedulerOnTimer(UpdateScheduler* s, uint64_t nowMs);
@@ -0,0 +1,248 @@
+﻿// Арена досок (Arena): сколько стоит завести, подключить и удалить
+// доску и сколько памяти уходит на одну доску.
+//
+//   ArenaBench [-sizes 10,100,1000] [-boards 1000] [-procs 1,4,16] [-ops 20000]
+//
+// Арена своя, с именем от pid, и в конце удаляется.
+// 1. Память: для каждого размера поля boards досок через SharedOpenBoard —
+//    задержка создания и выдано/нарезано байт на доску против полезных
+//    (SharedData и клетки). Потом все удаляются ArenaDestroy; после этого
+//    выданного ноль, а все нарезанные куски — в общем списке.
+// 2. Подключения: procs процессов подключаются к случайной из 256 живых
+//    досок и отключаются, ops раз каждый.
+// 3. Оборот: procs процессов заводят и удаляют свои доски трёх размеров
+//    вперемешку, ops раз каждый. Печатаются задержки создания и удаления
+//    и нарезанное в конце: куски, освободившиеся у одного размера,
+//    должны доставаться другим, а не нарезаться заново.
+
+#include "Bench.h"
+#include "Arena.h"
+#include "SharedGrid.h"
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// Как SharedOpenBoard: данные доски и клетки поля n
+static size_t CellsFor(int n) {
+    uint32_t words = GridWordsFor(n);
+    uint32_t blocks = (words + GRID_BLOCK_WORDS - 1) / GRID_BLOCK_WORDS;
+    return sizeof(SharedCells) + (size_t)words * sizeof(uint64_t) + (size_t)blocks * sizeof(uint32_t);
+}
+
+// Все доски удалены: выданного нет, нарезанное целиком в общем списке
+static bool Drained(Arena* a, const char* what) {
+    ArenaStats s = ArenaGetStats(a);
+    printf("  after %s: %u boards, in use %llu, carved %llu, free chunks %llu, attach tables %llu bytes\n", what,
+        s.boards, (unsigned long long)s.bytesInUse, (unsigned long long)s.bytesCarved,
+        (unsigned long long)s.bytesFreeChunks, (unsigned long long)s.bytesTables);
+    if (s.boards == 0 && s.bytesInUse == 0 && s.bytesFreeChunks + s.bytesTables == s.bytesCarved) return true;
+    fprintf(stderr, "%s: the arena did not get its memory back\n", what);
+    return false;
+}
+
+static bool Memory(Arena* a, const std::vector<int>& sizes, int boards, uint32_t* nextId) {
+    bool ok = true;
+    printf("%6s %7s | %10s %10s %10s %9s  (bytes per board)\n", "size", "boards", "payload", "in use", "carved", "overhead");
+    for (int n : sizes) {
+        if (n < 1 || n > ARENA_MAX_GRID) {
+            fprintf(stderr, "sizes must be 1..%d\n", ARENA_MAX_GRID);
+            return false;
+        }
+        ArenaStats s0 = ArenaGetStats(a);
+        std::vector<uint64_t> create, destroy;
+        std::vector<uint32_t> ids;
+        size_t payload = 0;
+        for (int i = 0; i < boards; i++) {
+            SharedMapping m;
+            bool created = false;
+            uint32_t id = (*nextId)++;
+            uint64_t t0 = BenchNow();
+            bool opened = SharedOpenBoard(&m, a, id, n, &created);
+            uint64_t t = BenchNow() - t0;
+            if (!opened || !created) break;      // арена кончилась
+            create.push_back(t);
+            payload = sizeof(SharedData) + m.cellsBytes;
+            SharedClose(&m);
+            ids.push_back(id);
+        }
+        if (ids.empty()) {
+            fprintf(stderr, "size %d: not a single board fits\n", n);
+            return false;
+        }
+        ArenaStats s1 = ArenaGetStats(a);
+        double used = (double)(s1.bytesInUse - s0.bytesInUse) / ids.size();
+        double carved = (double)(s1.bytesCarved - s1.bytesFreeChunks - (s0.bytesCarved - s0.bytesFreeChunks)) / ids.size();
+        printf("%6d %7zu | %10zu %10.0f %10.0f %8.2fx\n", n, ids.size(), payload, used, carved, used / payload);
+        for (uint32_t id : ids) {
+            uint64_t t0 = BenchNow();
+            ok &= ArenaDestroy(a, id);
+            destroy.push_back(BenchNow() - t0);
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "  create %d", n);
+        BenchPrintLatency(label, create);
+        snprintf(label, sizeof(label), "  destroy %d", n);
+        BenchPrintLatency(label, destroy);
+        ok &= Drained(a, "destroy");
+    }
+    return ok;
+}
+
+static bool Attaches(Arena* a, const char* name, int procs, int ops, uint32_t* nextId) {
+    const int live = 256;
+    uint32_t first = *nextId;
+    for (int i = 0; i < live; i++) {
+        bool created = false;
+        int b = ArenaAttach(a, first + i, sizeof(SharedData), CellsFor(100), true, &created);
+        if (b < 0) return false;
+        ArenaPublish(a, b);
+        ArenaDetach(a, b);
+    }
+    *nextId += live;
+
+    uint64_t* samples = BenchShared<uint64_t>((size_t)procs * ops);
+    uint32_t* counts = BenchShared<uint32_t>(procs);
+    std::atomic<uint32_t>* failed = BenchShared<std::atomic<uint32_t>>(1);
+    BenchGate* gate = BenchShared<BenchGate>(1);
+    std::vector<pid_t> pids;
+    bool ok = BenchSpawn(procs, [&](int i) {
+        Arena* own = ArenaOpen(name);
+        if (!own) return 2;
+        uint64_t rnd = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+        BenchGateWait(gate);
+        for (int k = 0; k < ops; k++) {
+            bool created = false;
+            uint32_t id = first + (uint32_t)(NextRandom(&rnd) % live);
+            uint64_t t0 = BenchNow();
+            int b = ArenaAttach(own, id, 0, 0, false, &created);
+            if (b >= 0) ArenaDetach(own, b);
+            else failed->fetch_add(1);
+            samples[(size_t)i * ops + counts[i]++] = BenchNow() - t0;
+        }
+        ArenaClose(own);
+        return 0;
+    }, &pids);
+    BenchGateOpen(gate, procs);
+    ok &= BenchWait(&pids);
+    double sec = (BenchNow() - gate->startNs) / 1e9;
+
+    std::vector<uint64_t> lat;
+    BenchCollect(samples, (uint32_t)ops, counts, procs, &lat);
+    char label[64];
+    snprintf(label, sizeof(label), "%2d procs: attach+detach", procs);
+    BenchPrintLatency(label, lat);
+    printf("%2d procs: %.0f attach+detach/s over %d boards\n", procs, (double)procs * ops / sec, live);
+    if (failed->load()) {
+        fprintf(stderr, "%u attaches to a live board failed\n", failed->load());
+        ok = false;
+    }
+    for (int i = 0; i < live; i++) ok &= ArenaDestroy(a, first + i);
+
+    BenchSharedFree(samples, (size_t)procs * ops);
+    BenchSharedFree(counts, procs);
+    BenchSharedFree(failed, 1);
+    BenchSharedFree(gate, 1);
+    return ok;
+}
+
+static bool Churn(Arena* a, const char* name, int procs, int ops, uint32_t* nextId) {
+    const int sizes[3] = { 10, 300, 1000 };
+    const int keep = 8;                          // своих досок у процесса одновременно
+    uint32_t first = *nextId;
+    *nextId += (uint32_t)procs * keep;
+
+    uint64_t* create = BenchShared<uint64_t>((size_t)procs * ops);
+    uint64_t* destroy = BenchShared<uint64_t>((size_t)procs * ops);
+    uint32_t* creates = BenchShared<uint32_t>(procs);
+    uint32_t* destroys = BenchShared<uint32_t>(procs);
+    std::atomic<uint32_t>* failed = BenchShared<std::atomic<uint32_t>>(1);
+    BenchGate* gate = BenchShared<BenchGate>(1);
+    std::vector<pid_t> pids;
+    bool ok = BenchSpawn(procs, [&](int i) {
+        Arena* own = ArenaOpen(name);
+        if (!own) return 2;
+        uint64_t rnd = 0xD1B54A32D192ED03ull * (uint64_t)(i + 1);
+        bool have[keep] = {};
+        BenchGateWait(gate);
+        for (int k = 0; k < ops; k++) {
+            int j = (int)(NextRandom(&rnd) % keep);
+            uint32_t id = first + (uint32_t)(i * keep + j);
+            if (have[j]) {
+                uint64_t t0 = BenchNow();
+                if (!ArenaDestroy(own, id)) failed->fetch_add(1);
+                destroy[(size_t)i * ops + destroys[i]++] = BenchNow() - t0;
+                have[j] = false;
+                continue;
+            }
+            bool created = false;
+            uint64_t t0 = BenchNow();
+            int b = ArenaAttach(own, id, sizeof(SharedData), CellsFor(sizes[NextRandom(&rnd) % 3]), true, &created);
+            if (b >= 0) {
+                ArenaPublish(own, b);
+                ArenaDetach(own, b);
+            }
+            create[(size_t)i * ops + creates[i]++] = BenchNow() - t0;
+            if (b < 0 || !created) failed->fetch_add(1);
+            else have[j] = true;
+        }
+        for (int j = 0; j < keep; j++)
+            if (have[j]) ArenaDestroy(own, first + (uint32_t)(i * keep + j));
+        ArenaClose(own);
+        return 0;
+    }, &pids);
+    BenchGateOpen(gate, procs);
+    ok &= BenchWait(&pids);
+    double sec = (BenchNow() - gate->startNs) / 1e9;
+
+    std::vector<uint64_t> c, d;
+    BenchCollect(create, (uint32_t)ops, creates, procs, &c);
+    BenchCollect(destroy, (uint32_t)ops, destroys, procs, &d);
+    char label[64];
+    snprintf(label, sizeof(label), "%2d procs: create", procs);
+    BenchPrintLatency(label, c);
+    snprintf(label, sizeof(label), "%2d procs: destroy", procs);
+    BenchPrintLatency(label, d);
+    printf("%2d procs: %.0f create/s, %.0f destroy/s\n", procs, c.size() / sec, d.size() / sec);
+    if (failed->load()) {
+        fprintf(stderr, "%u creates or destroys failed\n", failed->load());
+        ok = false;
+    }
+    ok &= Drained(a, "churn");
+
+    BenchSharedFree(create, (size_t)procs * ops);
+    BenchSharedFree(destroy, (size_t)procs * ops);
+    BenchSharedFree(creates, procs);
+    BenchSharedFree(destroys, procs);
+    BenchSharedFree(failed, 1);
+    BenchSharedFree(gate, 1);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = BenchList(argc, argv, "-sizes", "10,100,1000");
+    int boards = (int)BenchArg(argc, argv, "-boards", 1000);
+    std::vector<int> procs = BenchList(argc, argv, "-procs", "1,4,16");
+    int ops = (int)BenchArg(argc, argv, "-ops", 20000);
+
+    char name[64];
+    BenchName(name, sizeof(name), "ArenaBench");
+    Arena* a = ArenaOpen(name);
+    if (!a) {
+        fprintf(stderr, "cannot create %s\n", name);
+        return 1;
+    }
+    uint32_t nextId = 1;
+    bool ok = Memory(a, sizes, boards, &nextId);
+    printf("\n");
+    for (int n : procs) ok &= n >= 1 && Attaches(a, name, n, ops, &nextId);
+    printf("\n");
+    for (int n : procs) ok &= n >= 1 && Churn(a, name, n, ops, &nextId);
+
+    ArenaClose(a);
+    shm_unlink(name);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+﻿#pragma once
+
+// Общее для бенчмарков: ключи командной строки, время, процентили и
+// процессы-участники. Только POSIX — бенчмарки гоняются на Linux,
+// рядом с oclr3-headless.
+//
+// Участники — дочерние процессы fork(): у каждого свой SharedOpen, как у
+// отдельного экземпляра окна. Результаты они пишут в анонимную общую
+// память (BenchShared), выделенную до fork.
+
+#include "Metrics.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+inline uint64_t BenchNow() { return MetricsNow(); }
+
+// -name <число>; нет ключа — def
+inline long long BenchArg(int argc, char** argv, const char* name, long long def) {
+    for (int i = 1; i + 1 < argc; i++)
+        if (!strcmp(argv[i], name)) return strtoll(argv[i + 1], nullptr, 10);
+    return def;
+}
+
+inline const char* BenchArgStr(int argc, char** argv, const char* name, const char* def) {
+    for (int i = 1; i + 1 < argc; i++)
+        if (!strcmp(argv[i], name)) return argv[i + 1];
+    return def;
+}
+
+inline bool BenchFlag(int argc, char** argv, const char* name) {
+    for (int i = 1; i < argc; i++)
+        if (!strcmp(argv[i], name)) return true;
+    return false;
+}
+
+// -name 1,2,4,8
+inline std::vector<int> BenchList(int argc, char** argv, const char* name, const char* def) {
+    std::vector<int> out;
+    for (const char* p = BenchArgStr(argc, argv, name, def); *p; ) {
+        char* end;
+        long v = strtol(p, &end, 10);
+        if (end == p) break;
+        out.push_back((int)v);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return out;
+}
+
+// Имя сегмента, не пересекающееся с окнами и с другими прогонами
+inline void BenchName(char* out, size_t n, const char* base) {
+    snprintf(out, n, "/%s.%d", base, (int)getpid());
+}
+
+// n элементов T в общей памяти, обнулённых; видны детям после fork
+template <class T>
+T* BenchShared(size_t n) {
+    void* p = mmap(nullptr, n * sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    return (T*)p;
+}
+
+template <class T>
+void BenchSharedFree(T* p, size_t n) {
+    munmap(p, n * sizeof(T));
+}
+
+// Старт по команде: участники отмечаются и ждут go, чтобы время шло у
+// всех с одного момента, а не с fork очередного процесса
+struct BenchGate {
+    std::atomic<int>      ready;
+    std::atomic<int>      go;
+    std::atomic<uint64_t> startNs;
+};
+
+inline void BenchGateWait(BenchGate* g) {
+    g->ready.fetch_add(1);
+    while (!g->go.load(std::memory_order_acquire)) sched_yield();
+}
+
+inline void BenchGateOpen(BenchGate* g, int participants) {
+    while (g->ready.load() < participants) sched_yield();
+    g->startNs.store(BenchNow());
+    g->go.store(1, std::memory_order_release);
+}
+
+// Запускает n процессов body(i) (int body(int), 0 — успех); pids — для
+// BenchWait. Родитель продолжает сразу.
+template <class F>
+bool BenchSpawn(int n, F body, std::vector<pid_t>* pids) {
+    fflush(stdout);                    // иначе буфер напечатают и дети
+    for (int i = 0; i < n; i++) {
+        pid_t p = fork();
+        if (p < 0) {
+            perror("fork");
+            return false;
+        }
+        if (p == 0) _exit(body(i));
+        pids->push_back(p);
+    }
+    return true;
+}
+
+// Ждёт всех; true — все вышли с 0
+inline bool BenchWait(std::vector<pid_t>* pids) {
+    bool ok = true;
+    for (pid_t p : *pids) {
+        int st = 0;
+        if (waitpid(p, &st, 0) != p || !WIFEXITED(st) || WEXITSTATUS(st) != 0) ok = false;
+    }
+    pids->clear();
+    return ok;
+}
+
+template <class F>
+bool BenchFork(int n, F body) {
+    std::vector<pid_t> pids;
+    bool ok = BenchSpawn(n, body, &pids);
+    return BenchWait(&pids) && ok;
+}
+
+// q-й квантиль (0..1); v сортируется на месте
+inline uint64_t BenchPercentile(std::vector<uint64_t>& v, double q) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(q * (double)(v.size() - 1) + 0.5);
+    return v[i < v.size() ? i : v.size() - 1];
+}
+
+// "label: n 1000, p50 1.2 us, p99 3.4 us, p99.9 5.6 us, max 7.8 us"
+inline void BenchPrintLatency(const char* label, std::vector<uint64_t>& ns) {
+    if (ns.empty()) {
+        printf("%s: no samples\n", label);
+        return;
+    }
+    uint64_t p50 = BenchPercentile(ns, 0.50), p99 = BenchPercentile(ns, 0.99);
+    uint64_t p999 = BenchPercentile(ns, 0.999), mx = ns.back();
+    printf("%s: n %zu, p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us\n",
+        label, ns.size(), p50 / 1e3, p99 / 1e3, p999 / 1e3, mx / 1e3);
+}
+
+// Выборки задержек участников: у i-го — samples[i*cap ..], counts[i] штук.
+// Участник пишет каждую stride-ю, пока не наберёт cap.
+inline void BenchCollect(const uint64_t* samples, uint32_t cap, const uint32_t* counts, int participants,
+                         std::vector<uint64_t>* out) {
+    out->clear();
+    for (int i = 0; i < participants; i++)
+        out->insert(out->end(), samples + (size_t)i * cap, samples + (size_t)i * cap + counts[i]);
+}
@@ -0,0 +1,246 @@
+﻿// Цвета клеток (Color): пачка HSVtoPixels по ядрам против цикла HSVtoRGB
+// и перевод слоя, пока его переписывает писатель.
+//
+//   ColorBench [-grids 100,1000,2048] [-reps 5] [-check 1000003] [-layer 512] [-frames 2000]
+//
+// 1. Совпадение: check случайных HSV, среди них оттенки вне [0, 720)
+//    (отрицательные, большие, NaN, бесконечности), и все оттенки 0..720 с
+//    шагом 1/64 — каждое ядро обязано дать ровно HSVtoRGB. Расхождение —
+//    провал.
+// 2. Скорость: поле grid x grid, лучшее из reps. Цикл HSVtoRGB по клетке
+//    (как красила бы клетки окно без пачки) против HSVtoPixels скалярным
+//    ядром, SSE2 и AVX2: нс на клетку и во сколько раз быстрее цикла.
+// 3. Слой layer x layer: процесс-писатель публикует кадры без перерыва,
+//    каждый целиком одного цвета по номеру кадра, а родитель frames раз
+//    переводит слой ColorLayerConvert. Все пиксели должны быть цвета той
+//    версии, что вернулась; смесь двух кадров — провал.
+
+#include "Bench.h"
+#include "Color.h"
+
+#include <math.h>
+
+static volatile uint64_t sink;
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static float Unit(uint64_t* s) {
+    return (float)(NextRandom(s) >> 40) / (float)(1 << 24);
+}
+
+// Как PixelOfRGB в Color.cpp
+static uint32_t Pixel(COLORREF c) {
+    return ((uint32_t)GetRValue(c) << 16) | ((uint32_t)GetGValue(c) << 8) | GetBValue(c);
+}
+
+static void Loop(const float* h, const float* s, const float* v, uint32_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = Pixel(HSVtoRGB(h[i], s[i], v[i]));
+}
+
+static const RenderKernel kernels[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+
+static bool Check(size_t n) {
+    std::vector<float> h, s, v;
+    uint64_t rnd = 2024;
+    for (size_t i = 0; i < n; i++) {
+        float hue = Unit(&rnd) * 720;
+        switch (NextRandom(&rnd) % 64) {
+        case 0: hue = -Unit(&rnd) * 1000; break;
+        case 1: hue = 720 + Unit(&rnd) * 1e6f; break;
+        case 2: hue = NAN; break;
+        case 3: hue = INFINITY; break;
+        case 4: hue = -0.0f; break;
+        case 5: hue = 719.99994f; break;
+        }
+        h.push_back(hue);
+        s.push_back(Unit(&rnd));
+        v.push_back(Unit(&rnd));
+    }
+    // все оттенки подряд: границы секторов и переход через 360
+    for (int k = 0; k < 720 * 64; k++) {
+        h.push_back((float)k / 64);
+        s.push_back(Unit(&rnd));
+        v.push_back(Unit(&rnd));
+    }
+    size_t all = h.size();
+    std::vector<uint32_t> want(all), got(all);
+    Loop(h.data(), s.data(), v.data(), want.data(), all);
+
+    bool ok = true;
+    printf("kernels vs HSVtoRGB, %zu colours:", all);
+    for (RenderKernel k : kernels) {
+        if (ColorSetKernel(k) != k) {
+            printf("  %s -", RenderKernelName(k));
+            continue;
+        }
+        std::fill(got.begin(), got.end(), 0xFFFFFFFFu);
+        HSVtoPixels(h.data(), s.data(), v.data(), got.data(), all);
+        size_t bad = 0, first = all;
+        for (size_t i = 0; i < all; i++) {
+            if (got[i] == want[i]) continue;
+            if (!bad++) first = i;
+        }
+        printf("  %s %zu differ", RenderKernelName(k), bad);
+        if (bad) {
+            fprintf(stderr, "\n%s: HSV(%g, %g, %g) -> %06X, HSVtoRGB gives %06X\n", RenderKernelName(k),
+                h[first], s[first], v[first], got[first], want[first]);
+            ok = false;
+        }
+    }
+    printf("\n");
+    ColorSetKernel(KERNEL_AUTO);
+    return ok;
+}
+
+// Лучшее из reps прогонов f(), нс
+template <class F>
+static uint64_t Best(int reps, F f) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < reps; r++) {
+        uint64_t t0 = BenchNow();
+        f();
+        uint64_t t = BenchNow() - t0;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+static void Throughput(const std::vector<int>& grids, int reps) {
+    printf("\n%6s | %12s", "grid", "loop ns/cell");
+    for (RenderKernel k : kernels) printf(" | %6s ns/cell  x loop", RenderKernelName(k));
+    printf("\n");
+    for (int g : grids) {
+        size_t n = (size_t)g * g;
+        std::vector<float> h(n), s(n), v(n);
+        std::vector<uint32_t> out(n);
+        uint64_t rnd = (uint64_t)g;
+        // как у -heatmap: оттенки 0..360, насыщенность и яркость разные
+        for (size_t i = 0; i < n; i++) h[i] = Unit(&rnd) * 360, s[i] = Unit(&rnd), v[i] = Unit(&rnd);
+        uint64_t tLoop = Best(reps, [&] {
+            Loop(h.data(), s.data(), v.data(), out.data(), n);
+            sink = out[n / 2];
+        });
+        printf("%6d | %12.2f", g, (double)tLoop / n);
+        for (RenderKernel k : kernels) {
+            if (ColorSetKernel(k) != k) {
+                printf(" | %22s", "-");
+                continue;
+            }
+            uint64_t t = Best(reps, [&] {
+                HSVtoPixels(h.data(), s.data(), v.data(), out.data(), n);
+                sink = out[n / 2];
+            });
+            printf(" | %14.2f %7.1f", (double)t / n, (double)tLoop / t);
+        }
+        printf("\n");
+    }
+    ColorSetKernel(KERNEL_AUTO);
+}
+
+// Цвет кадра f: первый кадр (0) — белый, как у свежего слоя
+static uint32_t FramePixel(uint32_t f) {
+    return f ? Pixel(HSVtoRGB((float)(f * 7 % 360), 1.0f, 1.0f)) : Pixel(HSVtoRGB(0, 0, 1));
+}
+
+static int Writer(const char* name, int grid, std::atomic<uint32_t>* stop, std::atomic<uint32_t>* published) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created)) return 2;
+    ColorLayer* l = ColorLayerOpen(&m);
+    if (!l) return 3;
+    size_t n = (size_t)grid * grid;
+    while (!stop->load(std::memory_order_relaxed)) {
+        uint32_t f = ColorLayerBegin(l);
+        float* h = ColorLayerHue(l);
+        float* s = ColorLayerSaturation(l);
+        float* v = ColorLayerValue(l);
+        float hue = (float)(f * 7 % 360);
+        for (size_t i = 0; i < n; i++) h[i] = hue, s[i] = 1.0f, v[i] = 1.0f;
+        ColorLayerPublish(l);
+        published->store(f, std::memory_order_relaxed);
+    }
+    ColorLayerClose(l);
+    SharedClose(&m);
+    return 0;
+}
+
+static bool Layer(int grid, int frames) {
+    if (grid < 1 || (uint64_t)grid * grid > COLOR_MAX_CELLS) {
+        fprintf(stderr, "layer must be 1..2048\n");
+        return false;
+    }
+    char name[64];
+    BenchName(name, sizeof(name), "ColorBench");
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created) || !created) {
+        fprintf(stderr, "cannot create %s\n", name);
+        return false;
+    }
+    ColorLayer* l = ColorLayerCreate(&m);
+    if (!l) {
+        fprintf(stderr, "cannot create the colour layer of %s\n", name);
+        SharedClose(&m);
+        SharedUnlink(name);
+        return false;
+    }
+    std::atomic<uint32_t>* stop = BenchShared<std::atomic<uint32_t>>(2);
+    std::vector<pid_t> pids;
+    bool ok = BenchSpawn(1, [&](int) { return Writer(name, grid, &stop[0], &stop[1]); }, &pids);
+
+    size_t n = (size_t)grid * grid;
+    std::vector<uint32_t> out(n);
+    std::vector<uint64_t> lat;
+    uint32_t torn = 0, last = 0, distinct = 0;
+    for (int k = 0; k < frames; k++) {
+        uint64_t t0 = BenchNow();
+        uint32_t ver = ColorLayerConvert(l, out.data());
+        lat.push_back(BenchNow() - t0);
+        uint32_t want = FramePixel(ver);
+        for (size_t i = 0; i < n; i++) {
+            if (out[i] == want) continue;
+            torn++;
+            break;
+        }
+        if (ver != last) distinct++;
+        last = ver;
+    }
+    stop[0].store(1);
+    ok &= BenchWait(&pids);
+
+    char label[96];
+    snprintf(label, sizeof(label), "\nlayer %dx%d under a writer: ColorLayerConvert", grid, grid);
+    BenchPrintLatency(label, lat);
+    printf("layer %dx%d: %u frames published, %u distinct frames converted, %u mixed\n", grid, grid,
+        stop[1].load(), distinct, torn);
+    ok &= torn == 0;
+
+    BenchSharedFree(stop, 2);
+    ColorLayerClose(l);
+    char sn[96];
+    snprintf(sn, sizeof(sn), "%s.color.%u", name, m.data->colorGeneration.load());
+    shm_unlink(sn);
+    SharedClose(&m);
+    SharedUnlink(name);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> grids = BenchList(argc, argv, "-grids", "100,1000,2048");
+    int reps = (int)BenchArg(argc, argv, "-reps", 5);
+    size_t check = (size_t)BenchArg(argc, argv, "-check", 1000003);
+    int layer = (int)BenchArg(argc, argv, "-layer", 512);
+    int frames = (int)BenchArg(argc, argv, "-frames", 2000);
+
+    bool checkOk = Check(check);
+    if (!checkOk) fprintf(stderr, "a kernel differs from HSVtoRGB\n");
+    Throughput(grids, reps);
+    bool layerOk = Layer(layer, frames);
+    if (!layerOk) fprintf(stderr, "a converted frame mixed two published frames\n");
+    return checkOk && layerOk ? 0 : 1;
+}
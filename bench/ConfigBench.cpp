@@ -0,0 +1,269 @@
+﻿// Конфиг пятью способами (-m1..-m5): загрузка, пары Save/Load и
+// одновременные сохранения из многих процессов.
+//
+//   ConfigBench [-dir /tmp] [-loads 2000] [-cold 50] [-pairs 200]
+//               [-savers 1,2,4,8,16,32,64] [-saves 50]
+//
+// Работает во временном каталоге внутри dir: config.txt и config.bin
+// пишутся сохранялками самой программы.
+// 1. Загрузка. Тёплый кэш — подряд loads чтений ConfigRead; холодный —
+//    перед каждым из cold чтений страницы файла выгоняются из page cache
+//    (fdatasync + POSIX_FADV_DONTNEED, проверка через mincore). Если
+//    файловая система их не отдаёт (tmpfs), холодный замер помечается.
+//    Отдельно — первый запуск -m5: бинарного файла ещё нет,
+//    LoadConfigBinary читает текст и переводит его в config.bin.
+// 2. Пары Save*/Load* в цикле, тёплые и холодные: задержка сохранения и
+//    загрузки и файловые вызовы на каждую половину (ConfigIOStats).
+// 3. N процессов сохраняют одновременно, как экземпляры в WM_DESTROY, а
+//    родитель всё это время читает файл. Каждый писатель сохраняет свой,
+//    внутренне согласованный конфиг; прочитанное считается обрезанным,
+//    если файла нет или не хватает ключей, и испорченным, если поля от
+//    разных писателей или не сходится контрольная сумма. Печатаются
+//    задержки сохранений, вызовы на сохранение и доля плохих чтений.
+
+#include "Bench.h"
+#include "Config.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+static const char* methodNames[] = { "-m1 mapping", "-m2 filevars", "-m3 fstream", "-m4 winapi", "-m5 binary" };
+
+// Выгоняет файл из page cache; false — страницы остались в памяти
+static bool Evict(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    struct stat st;
+    bool cold = false;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            unsigned char vec[1] = { 1 };
+            cold = mincore(p, 1, vec) == 0 && !(vec[0] & 1);
+            munmap(p, (size_t)st.st_size);
+        }
+    }
+    close(fd);
+    return cold;
+}
+
+// Конфиг писателя i: все поля выводятся из i
+static Config SaverConfig(int i) {
+    Config c;
+    c.gridSize = 3 + i;
+    c.clientWidth = 1000 + i;
+    c.clientHeight = 2000 + i;
+    c.backgroundColor = RGB(i, 255 - i, 7);
+    c.gridColor = RGB(255 - i, i, 9);
+    return c;
+}
+
+static uint64_t Calls(const ConfigIOStats& s) {
+    return s.opens + s.reads + s.writes + s.maps + s.flushes + s.renames;
+}
+
+static void SaveWith(ConfigMethod method) {
+    ConfigMethod keep = configMethod;
+    configMethod = method;
+    SaveConfig();
+    configMethod = keep;
+}
+
+static bool SameConfig(const Config& a, const Config& b) {
+    return a.gridSize == b.gridSize && a.clientWidth == b.clientWidth && a.clientHeight == b.clientHeight
+        && a.backgroundColor == b.backgroundColor && a.gridColor == b.gridColor;
+}
+
+// Пары Save*/Load*; cold — выгнать файл перед сохранением и перед загрузкой
+static bool Pairs(int pairs, bool coldCache) {
+    bool ok = true;
+    printf("\nSave/Load pairs, %s cache, %d per method\n", coldCache ? "cold" : "warm", pairs);
+    for (int m = METHOD_MAPPING; m <= METHOD_BINARY; m++) {
+        ConfigMethod method = (ConfigMethod)m;
+        const char* file = method == METHOD_BINARY ? configBinFileName : configFileName;
+        std::vector<uint64_t> save, load;
+        ConfigIOStats before = configIOStats;
+        uint64_t saveCalls = 0;
+        for (int i = 0; i < pairs; i++) {
+            currentConfig = SaverConfig(i % 200);
+            if (coldCache) Evict(file);
+            ConfigIOStats s0 = configIOStats;
+            uint64_t t0 = BenchNow();
+            SaveWith(method);
+            save.push_back(BenchNow() - t0);
+            saveCalls += Calls(configIOStats) - Calls(s0);
+            if (coldCache) Evict(file);
+            Config c = {};
+            uint64_t t1 = BenchNow();
+            bool read = ConfigRead(method, &c);
+            load.push_back(BenchNow() - t1);
+            ok &= read && SameConfig(c, currentConfig);
+        }
+        uint64_t all = Calls(configIOStats) - Calls(before);
+        char label[96];
+        snprintf(label, sizeof(label), "%-13s save", methodNames[m]);
+        BenchPrintLatency(label, save);
+        snprintf(label, sizeof(label), "%-13s load", methodNames[m]);
+        BenchPrintLatency(label, load);
+        printf("%-13s file calls per save %.1f, per load %.1f\n", methodNames[m],
+            (double)saveCalls / pairs, (double)(all - saveCalls) / pairs);
+    }
+    return ok;
+}
+
+struct SaverStats {
+    ConfigIOStats io;
+    uint32_t      failed;
+};
+
+// Что увидел читатель: 0 — целый конфиг одного из n писателей,
+// 1 — обрезан (нет файла, не все ключи), 2 — испорчен
+static int Classify(ConfigMethod method, int n) {
+    Config c = { -1, -1, -1, 0xFFFFFFFFu, 0xFFFFFFFFu };
+    if (!ConfigRead(method, &c)) return method == METHOD_BINARY ? 2 : 1;
+    if (c.gridSize < 0 || c.clientWidth < 0 || c.clientHeight < 0
+        || c.backgroundColor == 0xFFFFFFFFu || c.gridColor == 0xFFFFFFFFu) return 1;
+    int i = c.gridSize - 3;
+    if (i < 0 || i >= n || !SameConfig(c, SaverConfig(i))) return 2;
+    return 0;
+}
+
+static bool Concurrent(const std::vector<int>& savers, int saves) {
+    bool ok = true;
+    printf("\nconcurrent saves, %d per process, parent reading meanwhile\n", saves);
+    for (int m = METHOD_MAPPING; m <= METHOD_BINARY; m++) {
+        ConfigMethod method = (ConfigMethod)m;
+        for (int n : savers) {
+            if (n < 1 || n > 200) {
+                fprintf(stderr, "savers must be 1..200\n");
+                return false;
+            }
+            currentConfig = SaverConfig(0);
+            SaveWith(method);
+            uint64_t* samples = BenchShared<uint64_t>((size_t)n * saves);
+            uint32_t* counts = BenchShared<uint32_t>(n);
+            SaverStats* stats = BenchShared<SaverStats>(n);
+            std::atomic<uint32_t>* done = BenchShared<std::atomic<uint32_t>>(1);
+            BenchGate* gate = BenchShared<BenchGate>(1);
+
+            std::vector<pid_t> pids;
+            ok &= BenchSpawn(n, [&](int i) {
+                configIOStats = ConfigIOStats();
+                currentConfig = SaverConfig(i);
+                configMethod = method;
+                BenchGateWait(gate);
+                for (int k = 0; k < saves; k++) {
+                    uint64_t t0 = BenchNow();
+                    SaveConfig();
+                    samples[(size_t)i * saves + counts[i]++] = BenchNow() - t0;
+                }
+                stats[i].io = configIOStats;
+                done->fetch_add(1);
+                return 0;
+            }, &pids);
+            BenchGateOpen(gate, n);
+            uint64_t reads = 0, bad[3] = {};
+            do {
+                bad[Classify(method, n)]++;
+                reads++;
+            } while (done->load() < (uint32_t)n);
+            ok &= BenchWait(&pids);
+            for (int k = 0; k < 20; k++, reads++) bad[Classify(method, n)]++;
+
+            std::vector<uint64_t> lat;
+            BenchCollect(samples, (uint32_t)saves, counts, n, &lat);
+            uint64_t calls = 0;
+            for (int i = 0; i < n; i++) calls += Calls(stats[i].io);
+            char label[96];
+            snprintf(label, sizeof(label), "%-13s %2d savers: save", methodNames[m], n);
+            BenchPrintLatency(label, lat);
+            printf("%-13s %2d savers: file calls per save %.1f, %llu reads, truncated %.3f%%, corrupt %.3f%%\n",
+                methodNames[m], n, (double)calls / ((double)n * saves), (unsigned long long)reads,
+                100.0 * bad[1] / reads, 100.0 * bad[2] / reads);
+            if (bad[1] || bad[2]) ok = false;
+
+            BenchSharedFree(samples, (size_t)n * saves);
+            BenchSharedFree(counts, n);
+            BenchSharedFree(stats, n);
+            BenchSharedFree(done, 1);
+            BenchSharedFree(gate, 1);
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = BenchArgStr(argc, argv, "-dir", "/tmp");
+    int loads = (int)BenchArg(argc, argv, "-loads", 2000);
+    int colds = (int)BenchArg(argc, argv, "-cold", 50);
+    int pairs = (int)BenchArg(argc, argv, "-pairs", 200);
+    std::vector<int> savers = BenchList(argc, argv, "-savers", "1,2,4,8,16,32,64");
+    int saves = (int)BenchArg(argc, argv, "-saves", 50);
+
+    char work[512];
+    snprintf(work, sizeof(work), "%s/ConfigBench.XXXXXX", dir);
+    if (!mkdtemp(work) || chdir(work) != 0) {
+        perror(work);
+        return 1;
+    }
+
+    Config saved = { 17, 640, 480, RGB(12, 34, 56), RGB(200, 100, 50) };
+    currentConfig = saved;
+    bool ok = true;
+
+    // первый запуск -m5: текст есть, бинарного нет
+    SaveConfigMapping();
+    std::vector<uint64_t> migrate;
+    for (int i = 0; i < colds; i++) {
+        unlink(configBinFileName);
+        currentConfig = Config();
+        uint64_t t0 = BenchNow();
+        LoadConfigBinary();
+        migrate.push_back(BenchNow() - t0);
+        ok &= SameConfig(currentConfig, saved);
+    }
+    currentConfig = saved;
+
+    printf("config in %s, %d warm and %d cold loads per method\n", work, loads, colds);
+    for (int m = METHOD_MAPPING; m <= METHOD_BINARY; m++) {
+        ConfigMethod method = (ConfigMethod)m;
+        const char* file = method == METHOD_BINARY ? configBinFileName : configFileName;
+        std::vector<uint64_t> warm, cold;
+        bool evicted = true;
+        for (int i = 0; i < colds; i++) {
+            evicted &= Evict(file);
+            Config c = {};
+            uint64_t t0 = BenchNow();
+            bool read = ConfigRead(method, &c);
+            cold.push_back(BenchNow() - t0);
+            ok &= read && SameConfig(c, saved);
+        }
+        for (int i = 0; i < loads; i++) {
+            Config c = {};
+            uint64_t t0 = BenchNow();
+            bool read = ConfigRead(method, &c);
+            warm.push_back(BenchNow() - t0);
+            ok &= read && SameConfig(c, saved);
+        }
+        char label[96];
+        snprintf(label, sizeof(label), "%-13s cold%s", methodNames[m], evicted ? "" : " (cache not evicted)");
+        BenchPrintLatency(label, cold);
+        snprintf(label, sizeof(label), "%-13s warm", methodNames[m]);
+        BenchPrintLatency(label, warm);
+    }
+    BenchPrintLatency("-m5 first run (text -> config.bin)", migrate);
+    if (!ok) fprintf(stderr, "a load returned a different config\n");
+
+    bool pairsOk = Pairs(pairs, false) && Pairs(colds, true);
+    if (!pairsOk) fprintf(stderr, "a load after a save returned a different config\n");
+    bool concOk = Concurrent(savers, saves);
+    if (!concOk) fprintf(stderr, "concurrent saves left a truncated or corrupt file\n");
+    ok &= pairsOk && concOk;
+
+    unlink(configFileName);
+    unlink(configBinFileName);
+    if (chdir("/") == 0) rmdir(work);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+﻿// История поля (History): память на версию и время перехода.
+//
+//   HistoryBench [-sizes 1000,4000] [-versions 5000] [-fill 50] [-seeks 200]
+//
+// Поле size x size сначала заливается случайно на fill процентов
+// (SharedLoadCells — с неё история начинается заново), потом на нём
+// ставятся versions случайных ходов SharedWriteCell — каждый ход новая
+// версия. Память: узлы на заливку и на версию против полной копии поля
+// на версию. Переход: SharedTimeTravel на d версий назад и обратно для
+// d = 1, 10, 100, 1000 и всей истории, по seeks раз; печатается задержка.
+// Круг туда и обратно должен вернуть поле в точности.
+
+#include "Bench.h"
+#include "History.h"
+#include "SharedGrid.h"
+
+#define NODE_BYTES (HISTORY_LEAF_WORDS * sizeof(uint64_t))
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static bool SameBoard(const GridSnapshot& a, const GridSnapshot& b) {
+    return a.gridSize == b.gridSize
+        && !memcmp(a.cells, b.cells, (size_t)GridWordsFor(a.gridSize) * sizeof(uint64_t));
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = BenchList(argc, argv, "-sizes", "1000,4000");
+    int versions = (int)BenchArg(argc, argv, "-versions", 5000);
+    int fill = (int)BenchArg(argc, argv, "-fill", 50);
+    int seeks = (int)BenchArg(argc, argv, "-seeks", 200);
+
+    char name[64], histName[96];
+    BenchName(name, sizeof(name), "HistoryBench");
+    snprintf(histName, sizeof(histName), "%s.hist", name);
+    bool ok = true;
+    uint64_t rnd = 88172645463325252ull;
+
+    for (int n : sizes) {
+        SharedMapping m;
+        bool created = false;
+        History* h = nullptr;
+        if (!SharedOpen(&m, name, n, &created) || !created || !(h = HistoryOpen(name, true))) {
+            fprintf(stderr, "cannot create %s\n", name);
+            return 1;
+        }
+        SharedReset(&m, RGB(0, 0, 255), RGB(255, 0, 0));
+        SharedSetWinLength(&m, n + 1);     // без побед: ходы принимаются все
+        SharedAttachHistory(&m, h, true);
+
+        uint32_t words = GridWordsFor(n);
+        uint64_t cells = (uint64_t)n * n;
+        std::vector<uint64_t> board(words);
+        for (uint64_t c = 0; c < cells; c++)
+            if (NextRandom(&rnd) % 100 < (uint64_t)fill) GridCellSet(board.data(), (int)c, CELL_O + (int)(c & 1));
+        uint64_t t0 = BenchNow();
+        SharedLoadCells(&m, n, board.data());
+        double rebaseMs = (BenchNow() - t0) / 1e6;
+        HistoryInfo base = HistoryGetInfo(h);
+
+        GridSnapshot first = {}, cur = {};
+        SharedReadSnapshot(&m, &first);
+        std::vector<uint64_t> rec;
+        for (int v = 0; v < versions; v++) {
+            uint64_t x = NextRandom(&rnd);
+            int cell = (int)(x % cells);
+            int value = GridCellGet(board.data(), cell) == CELL_EMPTY ? CELL_O + (int)((x >> 40) & 1) : CELL_EMPTY;
+            GridCellSet(board.data(), cell, value);     // каждый ход меняет клетку — новая версия
+            uint64_t t1 = BenchNow();
+            SharedWriteCell(&m, cell, value);
+            rec.push_back(BenchNow() - t1);
+        }
+        HistoryInfo after = HistoryGetInfo(h);
+        SharedReadSnapshot(&m, &cur);
+        GridSnapshot last = {};
+        SharedReadSnapshot(&m, &last);
+
+        uint32_t kept = after.undo;
+        double perVersion = kept ? (double)(after.nodes - base.nodes) * NODE_BYTES / kept : 0;
+        printf("board %dx%d (%u words, %u levels), fill %d%%: base %u nodes (%.1f MB) in %.1f ms\n",
+            n, n, words, after.levels, fill, base.nodes, base.nodes * (double)NODE_BYTES / 1e6, rebaseMs);
+        printf("  %d moves -> %u versions kept, %u nodes: %.0f bytes/version (%.2f nodes), full copy %zu bytes/version (%.0fx)\n",
+            versions, kept, after.nodes, perVersion, perVersion / NODE_BYTES, (size_t)words * sizeof(uint64_t),
+            perVersion > 0 ? words * sizeof(uint64_t) / perVersion : 0);
+        BenchPrintLatency("  record (SharedWriteCell + version)", rec);
+
+        // назад на d и обратно: туда и обратно — по задержке
+        int dists[] = { 1, 10, 100, 1000, (int)kept };
+        for (int d : dists) {
+            if (d <= 0 || (uint32_t)d > kept) continue;
+            std::vector<uint64_t> back, fwd;
+            for (int i = 0; i < seeks; i++) {
+                uint64_t t1 = BenchNow();
+                bool b = SharedTimeTravel(&m, -d) != 0;
+                uint64_t t2 = BenchNow();
+                bool f = SharedTimeTravel(&m, d) != 0;
+                back.push_back(t2 - t1);
+                fwd.push_back(BenchNow() - t2);
+                if (!b || !f) {
+                    fprintf(stderr, "time travel by %d failed\n", d);
+                    ok = false;
+                    break;
+                }
+            }
+            SharedReadSnapshot(&m, &cur);
+            if (!SameBoard(cur, last)) {
+                fprintf(stderr, "board %d: round trip by %d did not come back\n", n, d);
+                ok = false;
+            }
+            char label[96];
+            snprintf(label, sizeof(label), "  %5d versions back", d);
+            BenchPrintLatency(label, back);
+            snprintf(label, sizeof(label), "  %5d versions forward", d);
+            BenchPrintLatency(label, fwd);
+        }
+        // вся история назад — это поле после заливки, если ничего не вытеснено
+        if (kept == (uint32_t)versions) {
+            SharedTimeTravel(&m, -(int)kept);
+            SharedReadSnapshot(&m, &cur);
+            if (!SameBoard(cur, first)) {
+                fprintf(stderr, "board %d: undoing every move did not restore the fill\n", n);
+                ok = false;
+            }
+        }
+
+        GridSnapshotFree(&first);
+        GridSnapshotFree(&cur);
+        GridSnapshotFree(&last);
+        m.history = nullptr;
+        HistoryClose(h);
+        SharedClose(&m);
+        SharedUnlink(name);
+        shm_unlink(histName);
+    }
+    return ok ? 0 : 1;
+}
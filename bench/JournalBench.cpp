@@ -0,0 +1,159 @@
+﻿// Запись в поле с журналом (Journal) и без.
+//
+//   JournalBench [-grid 1000] [-writers 1,4] [-batch 1,16,256] [-ms 1000] [-dir /tmp] [-k 5]
+//
+// writers процессов ставят случайные клетки SharedWriteCell (после победы —
+// SharedNewGame), как SharedBench. Без журнала — это основа; с журналом
+// каждый писатель зовёт JournalCommit раз в batch записей: batch 1 — сброс
+// на каждую запись, больше — пачка ходов за кадр на один сброс (group
+// commit). Файл журнала — в dir, чтобы сбросы шли на настоящий диск.
+// Печатает записи в секунду и долю от записи без журнала, сбросы на
+// запись, контрольные точки и задержку записи и JournalCommit.
+
+#include "Bench.h"
+#include "Journal.h"
+#include "SharedGrid.h"
+
+#define SAMPLE_CAP 65536
+
+struct Counters {
+    std::atomic<uint64_t> writes;
+    std::atomic<uint64_t> commits;
+    std::atomic<uint64_t> flushes;
+    std::atomic<uint64_t> checkpoints;
+};
+
+// batch 0 — без журнала
+static int Writer(const char* name, const char* path, int grid, int id, int batch, BenchGate* gate, uint64_t ms,
+                  Counters* c, uint64_t* writeNs, uint32_t* writeCount, uint64_t* commitNs, uint32_t* commitCount) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created) || created) return 1;
+    Journal* j = nullptr;
+    if (batch) {
+        if (!(j = JournalOpen(path, false))) return 2;
+        SharedAttachJournal(&m, j, false);
+    }
+    uint64_t rnd = 0x9E3779B97F4A7C15ull * (uint64_t)(id + 1);
+    uint64_t cells = (uint64_t)grid * grid, n = 0, commits = 0;
+    BenchGateWait(gate);
+    uint64_t stop = gate->startNs.load() + ms * 1000000;
+    for (;;) {
+        rnd ^= rnd >> 12; rnd ^= rnd << 25; rnd ^= rnd >> 27;
+        uint64_t x = rnd * 0x2545F4914F6CDD1Dull;
+        uint64_t t0 = BenchNow();
+        if (!SharedWriteCell(&m, (int)(x % cells), (int)((x >> 40) & 1) + CELL_O))
+            SharedNewGame(&m);
+        uint64_t t1 = BenchNow();
+        if ((n & 15) == 0 && *writeCount < SAMPLE_CAP) writeNs[(*writeCount)++] = t1 - t0;
+        n++;
+        if (j && n % (uint64_t)batch == 0) {
+            JournalCommit(j);
+            uint64_t t2 = BenchNow();
+            if (*commitCount < SAMPLE_CAP) commitNs[(*commitCount)++] = t2 - t1;
+            commits++;
+            t1 = t2;
+        }
+        if (t1 >= stop) break;
+    }
+    c->writes.fetch_add(n);
+    c->commits.fetch_add(commits);
+    if (j) {
+        JournalCommit(j);
+        c->flushes.fetch_add(JournalGetStats(j)->flushes);
+        c->checkpoints.fetch_add(JournalGetStats(j)->checkpoints);
+        m.journal = nullptr;
+        JournalClose(j);
+    }
+    SharedClose(&m);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int grid = (int)BenchArg(argc, argv, "-grid", 1000);
+    std::vector<int> writers = BenchList(argc, argv, "-writers", "1,4");
+    std::vector<int> batches = BenchList(argc, argv, "-batch", "1,16,256");
+    uint64_t ms = (uint64_t)BenchArg(argc, argv, "-ms", 1000);
+    const char* dir = BenchArgStr(argc, argv, "-dir", "/tmp");
+    int k = (int)BenchArg(argc, argv, "-k", 5);
+
+    char work[512], path[600];
+    snprintf(work, sizeof(work), "%s/JournalBench.XXXXXX", dir);
+    if (!mkdtemp(work)) {
+        perror(work);
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/data.bin", work);
+
+    char name[64];
+    BenchName(name, sizeof(name), "JournalBench");
+    SharedMapping m;
+    bool created = false;
+    Journal* j = nullptr;
+    if (!SharedOpen(&m, name, grid, &created) || !created || !(j = JournalOpen(path, true))) {
+        fprintf(stderr, "cannot create %s / %s\n", name, path);
+        return 1;
+    }
+    SharedReset(&m, RGB(0, 0, 255), RGB(255, 0, 0));
+    SharedAttachJournal(&m, j, true);
+    SharedSetWinLength(&m, k);
+    JournalCommit(j);
+    printf("board %dx%d, K %d, journal %s\n", grid, grid, k, path);
+    printf("%7s %9s %12s %8s %13s %11s\n", "writers", "batch", "writes/s", "vs off", "flushes/write", "checkpoints");
+
+    int maxWriters = *std::max_element(writers.begin(), writers.end());
+    uint64_t* samples = BenchShared<uint64_t>((size_t)maxWriters * SAMPLE_CAP * 2);
+    uint32_t* counts = BenchShared<uint32_t>((size_t)maxWriters * 2);
+    bool ok = true;
+    for (int w : writers) {
+        double base = 0;
+        std::vector<int> modes(1, 0);
+        modes.insert(modes.end(), batches.begin(), batches.end());
+        for (int batch : modes) {
+            BenchGate* gate = BenchShared<BenchGate>(1);
+            Counters* c = BenchShared<Counters>(1);
+            memset(counts, 0, sizeof(uint32_t) * maxWriters * 2);
+            std::vector<pid_t> pids;
+            ok &= BenchSpawn(w, [&](int i) {
+                return Writer(name, path, grid, i, batch, gate, ms, c,
+                    samples + (size_t)i * SAMPLE_CAP, counts + i,
+                    samples + (size_t)(maxWriters + i) * SAMPLE_CAP, counts + maxWriters + i);
+            }, &pids);
+            BenchGateOpen(gate, w);
+            ok &= BenchWait(&pids);
+            double secs = (BenchNow() - gate->startNs.load()) / 1e9;
+            double rate = c->writes.load() / secs;
+            if (!batch) base = rate;
+
+            char mode[32];
+            if (batch) snprintf(mode, sizeof(mode), "%d", batch);
+            else snprintf(mode, sizeof(mode), "off");
+            printf("%7d %9s %12.0f %7.2fx %13.4f %11llu\n", w, mode, rate, base > 0 ? rate / base : 0,
+                c->writes.load() ? (double)c->flushes.load() / c->writes.load() : 0,
+                (unsigned long long)c->checkpoints.load());
+            std::vector<uint64_t> all;
+            BenchCollect(samples, SAMPLE_CAP, counts, w, &all);
+            char label[96];
+            snprintf(label, sizeof(label), "  write, %d writer(s), batch %s", w, mode);
+            BenchPrintLatency(label, all);
+            if (batch) {
+                all.clear();
+                BenchCollect(samples + (size_t)maxWriters * SAMPLE_CAP, SAMPLE_CAP, counts + maxWriters, w, &all);
+                snprintf(label, sizeof(label), "  JournalCommit, %d writer(s), batch %s", w, mode);
+                BenchPrintLatency(label, all);
+            }
+            BenchSharedFree(gate, 1);
+            BenchSharedFree(c, 1);
+        }
+    }
+
+    m.journal = nullptr;
+    JournalClose(j);
+    SharedClose(&m);
+    SharedUnlink(name);
+    unlink(path);
+    rmdir(work);
+    BenchSharedFree(samples, (size_t)maxWriters * SAMPLE_CAP * 2);
+    BenchSharedFree(counts, (size_t)maxWriters * 2);
+    return ok ? 0 : 1;
+}
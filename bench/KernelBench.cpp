@@ -0,0 +1,96 @@
+﻿// Ядра правил по размеру (3×3 … 10×10) против общего пути.
+//
+//   KernelBench [-sizes 3,4,5,6,7,8,9,10] [-k 0] [-boards 4096] [-reps 50]
+//
+// Для каждого размера — boards случайных позиций (от почти пустых до
+// почти полных). Замеряются полный перебор RulesFindWin по каждой позиции
+// и RulesCheckMove по каждой занятой клетке, сначала ядрами по размеру,
+// потом общим путём (RulesUseSizeKernels(false)). Результаты обоих путей
+// сверяются: расхождение — код выхода 1.
+
+#include "Bench.h"
+#include "Rules.h"
+#include "SharedGrid.h"
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static volatile uint64_t sink;
+
+struct Timing {
+    double   findNs, checkNs;
+    uint64_t findSum, checkSum;        // сколько раз нашёлся выигрыш — для сверки
+};
+
+static Timing Measure(int n, int k, const std::vector<uint64_t>& boards, int words,
+                      const std::vector<uint32_t>& moves, int reps) {
+    size_t count = boards.size() / words;
+    Timing t = {};
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < reps; r++) {
+        uint64_t t0 = BenchNow(), found = 0;
+        for (size_t b = 0; b < count; b++) found += RulesFindWin(&boards[b * words], n, k, nullptr);
+        uint64_t d = BenchNow() - t0;
+        if (d < best) best = d;
+        t.findSum = found;
+    }
+    t.findNs = (double)best / count;
+    best = UINT64_MAX;
+    for (int r = 0; r < reps; r++) {
+        uint64_t t0 = BenchNow(), found = 0;
+        for (uint32_t m : moves) found += RulesCheckMove(&boards[(m >> 8) * words], n, k, (int)(m & 0xFF), nullptr);
+        uint64_t d = BenchNow() - t0;
+        if (d < best) best = d;
+        t.checkSum = found;
+    }
+    t.checkNs = (double)best / moves.size();
+    sink = t.findSum + t.checkSum;
+    return t;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = BenchList(argc, argv, "-sizes", "3,4,5,6,7,8,9,10");
+    int k0 = (int)BenchArg(argc, argv, "-k", 0);
+    int count = (int)BenchArg(argc, argv, "-boards", 4096);
+    int reps = (int)BenchArg(argc, argv, "-reps", 50);
+
+    printf("%5s %3s | %11s %11s %7s | %11s %11s %7s\n", "size", "K",
+        "FindWin ns", "generic ns", "x", "Check ns", "generic ns", "x");
+    bool ok = true;
+    uint64_t rnd = 0xB0A4D5;
+    for (int n : sizes) {
+        if (n < 1 || n > 15) {
+            fprintf(stderr, "sizes must be 1..15\n");
+            return 1;
+        }
+        int k = RulesWinLength(n, k0);
+        int words = (int)GridWordsFor(n);
+        std::vector<uint64_t> boards((size_t)count * words, 0);
+        std::vector<uint32_t> moves;                  // доска << 8 | клетка
+        for (int b = 0; b < count; b++) {
+            uint64_t* cells = &boards[(size_t)b * words];
+            int fill = (int)(NextRandom(&rnd) % 100);
+            for (int i = 0; i < n * n; i++) {
+                if ((int)(NextRandom(&rnd) % 100) >= fill) continue;
+                GridCellSet(cells, i, CELL_O + (int)(NextRandom(&rnd) & 1));
+                moves.push_back((uint32_t)b << 8 | (uint32_t)i);
+            }
+        }
+        RulesUseSizeKernels(true);
+        Timing sp = Measure(n, k, boards, words, moves, reps);
+        RulesUseSizeKernels(false);
+        Timing gen = Measure(n, k, boards, words, moves, reps);
+        RulesUseSizeKernels(true);
+
+        bool same = sp.findSum == gen.findSum && sp.checkSum == gen.checkSum;
+        printf("%5d %3d | %11.1f %11.1f %7.2f | %11.2f %11.2f %7.2f%s\n", n, k,
+            sp.findNs, gen.findNs, gen.findNs / sp.findNs, sp.checkNs, gen.checkNs, gen.checkNs / sp.checkNs,
+            same ? "" : "  RESULTS DIFFER");
+        ok &= same;
+    }
+    return ok ? 0 : 1;
+}
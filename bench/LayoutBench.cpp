@@ -0,0 +1,197 @@
+﻿// Раскладка окон (Layout): сколько стоит поставить очередной экземпляр,
+// когда открыты сотни, и возвращаются ли места убитых.
+//
+//   LayoutBench [-work 1920x1080] [-window 300] [-instances 100,300,1000]
+//
+// Раскладка своя, с именем от pid, и в конце удаляется; окна квадратные
+// window x window, по плитке на окно.
+// 1. Подряд из одного процесса: LayoutClaim до заполнения всех слоёв.
+//    Задержка по числу уже открытых окон рядом с прежним обходом — сумма
+//    ширин всех открытых окон (только память, без FindWindowEx и
+//    GetWindowRect на каждое окно, так что это нижняя граница). Окна
+//    слоя не должны пересекаться и вылезать из рабочей области.
+// 2. instances процессов стартуют разом и берут по месту, как окна при
+//    массовом запуске. Проверяется, что окна одного слоя не пересекаются
+//    и все лежат в рабочей области. Печатаются задержка и проигранные CAS.
+// 3. Эти процессы получают SIGKILL. Родитель занимает места, пока
+//    они есть: должны достаться все плитки всех слоёв, включая плитки
+//    убитых (их отбирает Sweep, когда свободные кончаются).
+
+#include "Bench.h"
+#include "Layout.h"
+
+#include <signal.h>
+
+static volatile uint64_t sink;
+
+struct Placed {
+    LayoutPlace place;
+    uint64_t    ns;
+    uint64_t    retries;
+};
+
+static bool Overlap(const LayoutRect& a, const LayoutRect& b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+// Окна одного слоя не пересекаются, все — внутри рабочей области
+static uint32_t BadPlaces(const std::vector<LayoutPlace>& v, const LayoutRect& work, uint32_t perLayer) {
+    uint32_t bad = 0;
+    for (size_t i = 0; i < v.size(); i++) {
+        const LayoutRect& r = v[i].rect;
+        if (v[i].tile < 0 || r.x < work.x || r.y < work.y || r.x + r.width > work.x + work.width
+            || r.y + r.height > work.y + work.height) {
+            bad++;
+            continue;
+        }
+        for (size_t j = 0; j < i; j++) {
+            if ((uint32_t)v[i].tile / perLayer == (uint32_t)v[j].tile / perLayer && Overlap(r, v[j].rect)) {
+                bad++;
+                break;
+            }
+        }
+    }
+    return bad;
+}
+
+static bool Sequential(Layout* l, const LayoutRect* work, int window) {
+    std::vector<LayoutPlace> places;
+    std::vector<uint64_t> claim, walk;
+    std::vector<LayoutRect> open;
+    for (;;) {
+        uint64_t t0 = BenchNow();
+        int off = 0;
+        for (const LayoutRect& r : open) off += r.width + LAYOUT_GAP;
+        sink = (uint64_t)off;
+        uint64_t t1 = BenchNow();
+        LayoutPlace p = LayoutClaim(l, window, window);
+        uint64_t t2 = BenchNow();
+        if (p.tile < 0) break;
+        walk.push_back(t1 - t0);
+        claim.push_back(t2 - t1);
+        places.push_back(p);
+        open.push_back(p.rect);
+    }
+    LayoutStats s = LayoutGetStats(l);
+    printf("one process: %zu windows placed, %u per screen\n", places.size(), s.perLayer);
+    printf("%14s %14s %14s\n", "open windows", "claim p50 ns", "walk p50 ns");
+    static const size_t edges[] = { 0, 10, 100, 1000, 2000, 3000, 5000 };
+    for (int k = 0; k + 1 < 7 && edges[k] < claim.size(); k++) {
+        size_t hi = edges[k + 1] < claim.size() ? edges[k + 1] : claim.size();
+        std::vector<uint64_t> c(claim.begin() + edges[k], claim.begin() + hi);
+        std::vector<uint64_t> w(walk.begin() + edges[k], walk.begin() + hi);
+        char range[32];
+        snprintf(range, sizeof(range), "%zu..%zu", edges[k], hi - 1);
+        printf("%14s %14llu %14llu\n", range, (unsigned long long)BenchPercentile(c, 0.5),
+            (unsigned long long)BenchPercentile(w, 0.5));
+    }
+    BenchPrintLatency("  claim, all", claim);
+
+    uint32_t bad = BadPlaces(places, *work, s.perLayer);
+    printf("  %u misplaced\n", bad);
+    bool ok = places.size() == s.used && bad == 0;
+    for (const LayoutPlace& p : places) LayoutRelease(l, &p);
+    ok &= LayoutGetStats(l).used == 0;
+    if (!ok) fprintf(stderr, "tiles left after releasing every window\n");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const char* workArg = BenchArgStr(argc, argv, "-work", "1920x1080");
+    int window = (int)BenchArg(argc, argv, "-window", 300);
+    std::vector<int> instances = BenchList(argc, argv, "-instances", "100,300,1000");
+
+    LayoutRect work = { 0, 0, 1920, 1080 };
+    if (sscanf(workArg, "%dx%d", &work.width, &work.height) != 2 || work.width < 1 || work.height < 1) {
+        fprintf(stderr, "-work must be WxH\n");
+        return 1;
+    }
+    char name[64];
+    BenchName(name, sizeof(name), "LayoutBench");
+    Layout* l = LayoutOpen(name, &work, window, window);
+    if (!l) {
+        fprintf(stderr, "cannot create %s\n", name);
+        return 1;
+    }
+    uint32_t perLayer = LayoutGetStats(l).perLayer;
+    uint32_t capacity = LAYOUT_TILES / perLayer * perLayer;
+
+    bool ok = Sequential(l, &work, window);
+    for (int n : instances) {
+        if (n < 1 || (uint32_t)n > capacity) {
+            fprintf(stderr, "instances must be 1..%u\n", capacity);
+            return 1;
+        }
+        Placed* placed = BenchShared<Placed>(n);
+        std::atomic<uint32_t>* acks = BenchShared<std::atomic<uint32_t>>(1);
+        BenchGate* gate = BenchShared<BenchGate>(1);
+        std::vector<pid_t> pids;
+        ok &= BenchSpawn(n, [&](int i) -> int {
+            Layout* own = LayoutOpen(name, &work, window, window);
+            BenchGateWait(gate);
+            uint64_t t0 = BenchNow();
+            placed[i].place = LayoutClaim(own, window, window);
+            placed[i].ns = BenchNow() - t0;
+            placed[i].retries = LayoutGetStats(own).retries;
+            acks->fetch_add(1, std::memory_order_release);
+            // окно живёт, пока его не убьют
+            for (;;) pause();
+        }, &pids);
+        BenchGateOpen(gate, n);
+        while (acks->load(std::memory_order_acquire) < (uint32_t)n) sched_yield();
+
+        std::vector<uint64_t> lat;
+        std::vector<LayoutPlace> places;
+        uint64_t retries = 0;
+        for (int i = 0; i < n; i++) {
+            lat.push_back(placed[i].ns);
+            places.push_back(placed[i].place);
+            retries += placed[i].retries;
+        }
+        uint32_t bad = BadPlaces(places, work, perLayer);
+        uint32_t used = LayoutGetStats(l).used;
+        char label[96];
+        snprintf(label, sizeof(label), "\n%d instances at once: claim", n);
+        BenchPrintLatency(label, lat);
+        printf("%d instances: %u tiles used, %llu lost CAS, %u misplaced\n", n, used, (unsigned long long)retries,
+            bad);
+        ok &= bad == 0 && used == (uint32_t)n;
+
+        // 3. Все убиты; их плитки достаются родителю, когда свободные кончатся
+        for (pid_t p : pids) kill(p, SIGKILL);
+        for (pid_t p : pids) waitpid(p, nullptr, 0);
+        pids.clear();
+        LayoutStats before = LayoutGetStats(l);
+        std::vector<LayoutPlace> mine;
+        std::vector<uint64_t> claim;
+        uint64_t sweepNs = 0;
+        for (;;) {
+            uint64_t t0 = BenchNow();
+            LayoutPlace p = LayoutClaim(l, window, window);
+            uint64_t t = BenchNow() - t0;
+            if (p.tile < 0) break;
+            // свободные кончились на этом месте — оно взято после Sweep
+            if (mine.size() == capacity - (uint32_t)n) sweepNs = t;
+            else claim.push_back(t);
+            mine.push_back(p);
+        }
+        LayoutStats after = LayoutGetStats(l);
+        uint32_t badMine = BadPlaces(mine, work, perLayer);
+        printf("after SIGKILL of %d: %zu of %u places taken again, %llu tiles reclaimed, claim with sweep %.1f us, "
+            "others p50 %llu ns, %u misplaced\n", n, mine.size(), capacity,
+            (unsigned long long)(after.reclaimed - before.reclaimed), sweepNs / 1e3,
+            (unsigned long long)BenchPercentile(claim, 0.5), badMine);
+        ok &= mine.size() == capacity && after.reclaimed - before.reclaimed == (uint64_t)n && badMine == 0;
+        for (const LayoutPlace& p : mine) LayoutRelease(l, &p);
+        ok &= LayoutGetStats(l).used == 0;
+
+        BenchSharedFree(placed, n);
+        BenchSharedFree(acks, 1);
+        BenchSharedFree(gate, 1);
+    }
+    if (!ok) fprintf(stderr, "a window was misplaced or a tile was lost\n");
+
+    LayoutClose(l);
+    shm_unlink(name);
+    return ok ? 0 : 1;
+}
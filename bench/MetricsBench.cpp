@@ -0,0 +1,239 @@
+﻿// Метрики (Metrics): цена записи, точность процентилей и цена чтения.
+//
+//   MetricsBench [-records 10000000] [-samples 1000000] [-writers 1,4,16,63] [-ms 500]
+//
+// Сегмент статистики свой, с именем от pid, и в конце удаляется.
+// 1. Запись: records вызовов MetricsRecord и MetricsCount подряд, нс на
+//    вызов. Рядом — тот же цикл без записи и MetricsRecord(nullptr), как
+//    в окне без сегмента.
+// 2. Точность: samples значений трёх распределений (равномерное,
+//    логнормальное, два горба) пишутся в гистограмму и читаются
+//    MetricsRead; p50..p99.9 сравниваются с точными по отсортированной
+//    выборке. Ошибка больше 1/16 значения (ширина корзины) — провал.
+// 3. Чтение: writers процессов со своими слотами пишут без остановки
+//    ms мс сами и ms мс под читателем, который зовёт MetricsRead в цикле.
+//    Печатаются задержка MetricsRead и записи в секунду у писателей в обоих
+//    окнах. Потом писатели встают, и количество в каждом прочитанном слоте
+//    должно сойтись с тем, что писатель насчитал сам.
+
+#include "Bench.h"
+
+#include <math.h>
+#include <signal.h>
+
+static volatile uint64_t sink;
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// Равномерное (0, 1]
+static double Uniform(uint64_t* s) {
+    return (double)((NextRandom(s) >> 11) + 1) / 9007199254740992.0;
+}
+
+// Задержка в нс: 0 — равномерно 1 мкс..1 мс, 1 — логнормальное с медианой
+// 50 мкс, 2 — 90% около 20 мкс и 10% около 5 мс
+static uint64_t Sample(int dist, uint64_t* s) {
+    switch (dist) {
+    case 0:
+        return 1000 + NextRandom(s) % 999000;
+    case 1: {
+        double z = sqrt(-2.0 * log(Uniform(s))) * cos(6.283185307179586 * Uniform(s));
+        return (uint64_t)(50000.0 * exp(z)) + 1;
+    }
+    default:
+        return NextRandom(s) % 10 ? 15000 + NextRandom(s) % 10000 : 4000000 + NextRandom(s) % 2000000;
+    }
+}
+
+static const char* distNames[] = { "uniform 1us..1ms", "lognormal, median 50us", "bimodal 20us / 5ms" };
+
+// Слот процесса pid в выборке; nullptr — нет
+static const MetricsInstance* Find(const MetricsSample* s, uint32_t pid) {
+    for (uint32_t i = 0; i < s->instances; i++)
+        if (s->inst[i].pid == pid) return &s->inst[i];
+    return nullptr;
+}
+
+struct Writer {
+    std::atomic<uint32_t> phase;       // 1 — пишут, 2 — встали, 3 — можно закрываться
+    std::atomic<uint32_t> stopped;
+    std::atomic<uint32_t> failed;
+    std::atomic<uint64_t> records[2];  // всего записей в окне без читателя и с ним
+};
+
+static int WriterBody(const char* name, int i, Writer* w, BenchGate* gate, uint64_t* own) {
+    Metrics* m = MetricsOpen(name, false, true);
+    if (!m) w->failed.fetch_add(1);
+    BenchGateWait(gate);
+    if (!m) return 2;
+    uint64_t rnd = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1), n = 0;
+    for (int window = 0; window < 2; window++) {
+        uint64_t k = 0;
+        while (w->phase.load(std::memory_order_relaxed) == (uint32_t)window) {
+            for (int j = 0; j < 256; j++) MetricsRecord(m, METRIC_PAINT, 1000 + (NextRandom(&rnd) & 0xFFFFF));
+            k += 256;
+        }
+        w->records[window].fetch_add(k);
+        n += k;
+    }
+    *own = n;
+    w->stopped.fetch_add(1, std::memory_order_release);
+    while (w->phase.load(std::memory_order_acquire) != 3) sched_yield();
+    MetricsClose(m);
+    return 0;
+}
+
+static bool Record(Metrics* m, uint64_t records) {
+    const size_t batch = 1 << 16;
+    std::vector<uint64_t> v(batch);
+    uint64_t rnd = 12345;
+    for (size_t i = 0; i < batch; i++) v[i] = Sample((int)(i % 3), &rnd);
+
+    uint64_t t0 = BenchNow(), sum = 0;
+    for (uint64_t i = 0; i < records; i++) sum += v[i & (batch - 1)];
+    uint64_t tLoop = BenchNow() - t0;
+    sink = sum;
+    t0 = BenchNow();
+    for (uint64_t i = 0; i < records; i++) MetricsRecord(nullptr, METRIC_PAINT, v[i & (batch - 1)]);
+    uint64_t tOff = BenchNow() - t0;
+    t0 = BenchNow();
+    for (uint64_t i = 0; i < records; i++) MetricsRecord(m, METRIC_PAINT, v[i & (batch - 1)]);
+    uint64_t tRec = BenchNow() - t0;
+    t0 = BenchNow();
+    for (uint64_t i = 0; i < records; i++) MetricsCount(m, METRIC_REPAINTS);
+    uint64_t tCount = BenchNow() - t0;
+
+    printf("record, %llu calls: loop %.2f ns, MetricsRecord(nullptr) %.2f ns, MetricsRecord %.2f ns, MetricsCount %.2f ns\n",
+        (unsigned long long)records, (double)tLoop / records, (double)tOff / records, (double)tRec / records,
+        (double)tCount / records);
+    return true;
+}
+
+static bool Accuracy(Metrics* m, int samples, MetricsSample* a, MetricsSample* b) {
+    static const double qs[] = { 0.5, 0.9, 0.99, 0.999 };
+    bool ok = true;
+    uint32_t self = (uint32_t)getpid();
+    printf("\npercentiles, %d samples: histogram vs exact, relative error\n", samples);
+    for (int d = 0; d < 3; d++) {
+        std::vector<uint64_t> v((size_t)samples);
+        uint64_t rnd = 777 + (uint64_t)d;
+        for (uint64_t& x : v) x = Sample(d, &rnd);
+        MetricsRead(m, a);
+        for (uint64_t x : v) MetricsRecord(m, METRIC_NOTIFY_TO_PAINT, x);
+        MetricsRead(m, b);
+        const MetricsInstance* before = Find(a, self);
+        const MetricsInstance* after = Find(b, self);
+        if (!before || !after) {
+            fprintf(stderr, "own slot missing from MetricsRead\n");
+            return false;
+        }
+        MetricsHistogram h;
+        MetricsHistogramDiff(&after->hist[METRIC_NOTIFY_TO_PAINT], &before->hist[METRIC_NOTIFY_TO_PAINT], &h);
+        std::sort(v.begin(), v.end());
+        printf("  %-24s", distNames[d]);
+        for (double q : qs) {
+            // тот же ранг, что у MetricsPercentile
+            size_t r = (size_t)(q * (double)v.size());
+            uint64_t exact = v[r < v.size() ? r : v.size() - 1], got = MetricsPercentile(&h, q);
+            double err = ((double)got - (double)exact) / (double)exact;
+            printf("  p%g %.1f/%.1f us %+.2f%%", q * 100, got / 1e3, exact / 1e3, err * 100);
+            if (fabs(err) > 1.0 / 16) ok = false;
+        }
+        printf("\n");
+        if (h.count != v.size()) ok = false;
+    }
+    return ok;
+}
+
+static bool Concurrent(const char* name, Metrics* m, const std::vector<int>& writers, int ms, MetricsSample* s) {
+    bool ok = true;
+    printf("\nreads under writers, %d ms without and %d ms with a reader\n", ms, ms);
+    for (int n : writers) {
+        if (n < 1 || n > METRICS_SLOTS - 1) {
+            fprintf(stderr, "writers must be 1..%d\n", METRICS_SLOTS - 1);
+            return false;
+        }
+        Writer* w = BenchShared<Writer>(1);
+        BenchGate* gate = BenchShared<BenchGate>(1);
+        uint64_t* own = BenchShared<uint64_t>(n);
+        std::vector<pid_t> pids;
+        ok &= BenchSpawn(n, [&](int i) { return WriterBody(name, i, w, gate, &own[i]); }, &pids);
+        BenchGateOpen(gate, n);
+        if (w->failed.load()) {
+            fprintf(stderr, "%u writer(s) found no free slot\n", w->failed.load());
+            ok = false;
+        }
+
+        usleep((useconds_t)ms * 1000);
+        w->phase.store(1);
+        std::vector<uint64_t> lat;
+        uint32_t seen = 0;
+        uint64_t end = BenchNow() + (uint64_t)ms * 1000000;
+        while (BenchNow() < end) {
+            uint64_t t0 = BenchNow();
+            MetricsRead(m, s);
+            lat.push_back(BenchNow() - t0);
+            seen = s->instances;
+        }
+        w->phase.store(2);
+        while (w->stopped.load(std::memory_order_acquire) < (uint32_t)(n - w->failed.load())) sched_yield();
+
+        // писатели стоят: прочитанное должно сойтись с их счётом
+        MetricsRead(m, s);
+        uint32_t mismatched = 0;
+        for (int i = 0; i < n; i++) {
+            const MetricsInstance* in = Find(s, (uint32_t)pids[i]);
+            if (!in || in->hist[METRIC_PAINT].count != own[i]) mismatched++;
+        }
+        w->phase.store(3);
+        ok &= BenchWait(&pids);
+
+        char label[96];
+        snprintf(label, sizeof(label), "%2d writers: MetricsRead of %u slots", n, seen);
+        BenchPrintLatency(label, lat);
+        printf("%2d writers: %.1f M records/s alone, %.1f M records/s under the reader, %zu reads, %u slot(s) off\n",
+            n, w->records[0].load() / (ms * 1e3), w->records[1].load() / (ms * 1e3), lat.size(), mismatched);
+        if (mismatched) ok = false;
+
+        BenchSharedFree(w, 1);
+        BenchSharedFree(gate, 1);
+        BenchSharedFree(own, n);
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    uint64_t records = (uint64_t)BenchArg(argc, argv, "-records", 10000000);
+    int samples = (int)BenchArg(argc, argv, "-samples", 1000000);
+    std::vector<int> writers = BenchList(argc, argv, "-writers", "1,4,16,63");
+    int ms = (int)BenchArg(argc, argv, "-ms", 500);
+
+    char name[64], stats[96];
+    BenchName(name, sizeof(name), "MetricsBench");
+    snprintf(stats, sizeof(stats), "%s.stats", name);
+    Metrics* m = MetricsOpen(name, true, true);
+    if (!m) {
+        fprintf(stderr, "cannot create %s\n", stats);
+        return 1;
+    }
+    MetricsSample* a = new MetricsSample;
+    MetricsSample* b = new MetricsSample;
+
+    bool ok = Record(m, records);
+    bool accOk = Accuracy(m, samples, a, b);
+    if (!accOk) fprintf(stderr, "a percentile is off by more than one bucket\n");
+    bool concOk = Concurrent(name, m, writers, ms, a);
+    if (!concOk) fprintf(stderr, "a slot read back a different count than its writer recorded\n");
+    ok &= accOk && concOk;
+
+    delete a;
+    delete b;
+    MetricsClose(m);
+    shm_unlink(stats);
+    return ok ? 0 : 1;
+}
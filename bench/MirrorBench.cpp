@@ -0,0 +1,273 @@
+﻿// Зеркало поля (Mirror): сколько обновлений в секунду уходит сотням
+// клиентов на сокете и сколько байт стоит одно обновление.
+//
+//   MirrorBench [-clients 1,100,300] [-grid 300] [-writes 4] [-ms 2000]
+//               [-frame 0] [-colors 500] [-slow 10]
+//
+// Писатель — как окно: ставит writes случайных клеток SharedWriteCell,
+// доводит снимок SharedRefreshSnapshot и отдаёт его MirrorPublish; раз в
+// colors обновлений меняет цвет фона (снимок целиком), между
+// обновлениями спит frame мс (0 — без пауз). Так ms мс.
+// Клиенты — отдельные процессы: подключаются к сокету, разбирают
+// сообщения, ведут свою копию поля и отмечают задержку от MirrorPublish
+// до прихода версии. slow% из них после каждого сообщения спят 5 мс —
+// им уходят склеенные дельты. Когда писатель закончил, каждый клиент
+// доводит копию до последней версии и сверяет её с полем.
+// Печатает обновления в секунду и время MirrorPublish у писателя,
+// сообщения и байты на сообщение и на обновление на клиента, долю
+// склеенных и полных сообщений, задержку быстрых и медленных клиентов.
+
+#include "Bench.h"
+#include "Mirror.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define VERSION_CAP  (1u << 22)        // версий, для которых помним время публикации
+#define SAMPLE_CAP   4096              // задержек на клиента
+
+struct Shared {
+    std::atomic<uint32_t> finalVersion;        // 0 — писатель ещё пишет
+    std::atomic<uint32_t> connected;
+    std::atomic<uint32_t> mismatched;
+    std::atomic<uint32_t> failed;
+    std::atomic<uint64_t> messages;
+    std::atomic<uint64_t> bytes;
+    uint32_t              firstVersion;
+    int                   gridSize;
+};
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static bool ReadVarint(const uint8_t** p, const uint8_t* end, uint64_t* x) {
+    *x = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t b = *(*p)++;
+        *x |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Применить сообщение к копии; false — протокол нарушен
+static bool Apply(const MirrorHeader& h, const uint8_t* body, std::vector<uint64_t>* image, uint32_t* version) {
+    if (h.magic != MIRROR_MAGIC || h.bytes < sizeof(MirrorState)) return false;
+    MirrorState st;
+    memcpy(&st, body, sizeof(st));
+    const uint8_t* p = body + sizeof(st);
+    const uint8_t* end = body + h.bytes;
+    if (h.type == MIRROR_FULL) {
+        size_t words = GridWordsFor(st.gridSize);
+        if ((size_t)(end - p) != words * sizeof(uint64_t)) return false;
+        image->resize(words);
+        memcpy(image->data(), p, words * sizeof(uint64_t));
+    }
+    else if (h.type == MIRROR_DELTA) {
+        uint32_t from, count;
+        if (end - p < 8) return false;
+        memcpy(&from, p, 4);
+        memcpy(&count, p + 4, 4);
+        p += 8;
+        if (from != *version || image->empty()) return false;
+        uint64_t cell = 0, x;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!ReadVarint(&p, end, &x)) return false;
+            cell += x >> 2;
+            if (cell >= (uint64_t)st.gridSize * st.gridSize) return false;
+            GridCellSet(image->data(), (int)cell, (int)(x & 3));
+        }
+        if (p != end) return false;
+    }
+    else {
+        return false;
+    }
+    *version = h.version;
+    return true;
+}
+
+static int Client(const char* endpoint, bool slow, Shared* sh, const uint64_t* pubNs,
+                  const uint64_t* expected, uint64_t* samples, uint32_t* count) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", endpoint);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        sh->failed.fetch_add(1);
+        sh->connected.fetch_add(1);
+        return 2;
+    }
+    sh->connected.fetch_add(1);
+
+    std::vector<uint8_t> buf;
+    std::vector<uint64_t> image;
+    uint32_t version = 0;
+    uint64_t messages = 0, bytes = 0;
+    bool ok = true;
+    for (;;) {
+        uint32_t fin = sh->finalVersion.load(std::memory_order_acquire);
+        if (fin && version == fin) break;
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        uint8_t chunk[1 << 16];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            ok = false;                // сервер закрыл раньше последней версии
+            break;
+        }
+        buf.insert(buf.end(), chunk, chunk + n);
+        size_t off = 0;
+        while (buf.size() - off >= sizeof(MirrorHeader)) {
+            MirrorHeader h;
+            memcpy(&h, buf.data() + off, sizeof(h));
+            if (buf.size() - off < sizeof(h) + h.bytes) break;
+            uint64_t now = BenchNow();
+            if (!Apply(h, buf.data() + off + sizeof(h), &image, &version)) {
+                ok = false;
+                break;
+            }
+            uint32_t k = version - sh->firstVersion;
+            if (k < VERSION_CAP && pubNs[k] && *count < SAMPLE_CAP)
+                samples[(*count)++] = now - pubNs[k];
+            messages++;
+            bytes += sizeof(h) + h.bytes;
+            off += sizeof(h) + h.bytes;
+            if (slow) usleep(5000);
+        }
+        if (!ok) break;
+        buf.erase(buf.begin(), buf.begin() + off);
+    }
+    if (!ok) sh->failed.fetch_add(1);
+    else if (image.size() != GridWordsFor(sh->gridSize) || memcmp(image.data(), expected, image.size() * 8) != 0)
+        sh->mismatched.fetch_add(1);
+    sh->messages.fetch_add(messages);
+    sh->bytes.fetch_add(bytes);
+    close(fd);
+    return ok ? 0 : 3;
+}
+
+static bool Run(SharedMapping* m, const char* endpoint, int clients, int writes, uint64_t ms, uint32_t frameMs,
+                int colors, int slowPct) {
+    int grid = SharedGridSize(m);
+    int slow = clients * slowPct / 100;
+    GridSnapshot snap = {};
+    GridDelta delta = {};
+    SharedReadSnapshot(m, &snap);
+    MirrorServer* server = MirrorStart(endpoint, &snap);
+    if (!server) {
+        fprintf(stderr, "cannot listen on %s\n", endpoint);
+        return false;
+    }
+
+    Shared* sh = BenchShared<Shared>(1);
+    uint64_t* pubNs = BenchShared<uint64_t>(VERSION_CAP);
+    uint64_t* expected = BenchShared<uint64_t>(GridWordsFor(grid));
+    uint64_t* samples = BenchShared<uint64_t>((size_t)clients * SAMPLE_CAP);
+    uint32_t* counts = BenchShared<uint32_t>(clients);
+    sh->firstVersion = snap.version;
+    sh->gridSize = grid;
+
+    std::vector<pid_t> pids;
+    bool ok = BenchSpawn(clients, [&](int i) {
+        return Client(endpoint, i < slow, sh, pubNs, expected, samples + (size_t)i * SAMPLE_CAP, &counts[i]);
+    }, &pids);
+    while (sh->connected.load() < (uint32_t)clients || MirrorGetStats(server).clients < (uint32_t)clients - sh->failed.load()) {
+        if (sh->failed.load() == (uint32_t)clients) break;
+        usleep(1000);
+    }
+    MirrorStats s0 = MirrorGetStats(server);
+
+    uint64_t rnd = 0x9E3779B97F4A7C15ull, updates = 0;
+    std::vector<uint64_t> publish;
+    uint64_t start = BenchNow(), stop = start + ms * 1000000;
+    while (BenchNow() < stop && snap.version - sh->firstVersion + writes + 2 < VERSION_CAP) {
+        for (int k = 0; k < writes; k++) {
+            uint64_t x = NextRandom(&rnd);
+            SharedWriteCell(m, (int)(x % ((uint64_t)grid * grid)), (int)((x >> 40) % 3));
+        }
+        if (colors > 0 && updates % colors == (uint64_t)colors - 1)
+            SharedWriteBackground(m, RGB(updates, updates >> 8, 200));
+        bool incremental = SharedRefreshSnapshot(m, &snap, &delta);
+        uint64_t t0 = BenchNow();
+        pubNs[snap.version - sh->firstVersion] = t0;
+        MirrorPublish(server, &snap, &delta, !incremental);
+        publish.push_back(BenchNow() - t0);
+        updates++;
+        if (frameMs) usleep(frameMs * 1000);
+    }
+    double sec = (BenchNow() - start) / 1e9;
+    memcpy(expected, snap.cells, GridWordsFor(grid) * sizeof(uint64_t));
+    sh->finalVersion.store(snap.version, std::memory_order_release);
+    ok &= BenchWait(&pids);
+    MirrorStats s1 = MirrorGetStats(server);
+    MirrorStop(server);
+
+    uint64_t msgs = s1.messages - s0.messages, bytes = s1.bytes - s0.bytes;
+    printf("%d clients (%d slow), grid %d, %d cells per update, %.1f s\n", clients, slow, grid, writes, sec);
+    printf("  writer: %.0f updates/s\n", updates / sec);
+    BenchPrintLatency("  MirrorPublish", publish);
+    printf("  server: %llu messages (%.0f/s), %.1f bytes per message, %.1f bytes per update per client, "
+        "%.1f%% coalesced, %llu full\n", (unsigned long long)msgs, msgs / sec, msgs ? (double)bytes / msgs : 0.0,
+        (double)bytes / ((double)updates * clients), msgs ? 100.0 * (s1.coalesced - s0.coalesced) / msgs : 0.0,
+        (unsigned long long)(s1.fullMessages - s0.fullMessages));
+    std::vector<uint64_t> fast, lazy;
+    for (int i = 0; i < clients; i++) {
+        std::vector<uint64_t>& to = i < slow ? lazy : fast;
+        to.insert(to.end(), samples + (size_t)i * SAMPLE_CAP, samples + (size_t)i * SAMPLE_CAP + counts[i]);
+    }
+    if (!fast.empty()) BenchPrintLatency("  publish -> fast client", fast);
+    if (!lazy.empty()) BenchPrintLatency("  publish -> slow client", lazy);
+    if (sh->failed.load() || sh->mismatched.load()) {
+        fprintf(stderr, "%u client(s) failed, %u ended with a different board\n", sh->failed.load(), sh->mismatched.load());
+        ok = false;
+    }
+
+    BenchSharedFree(sh, 1);
+    BenchSharedFree(pubNs, VERSION_CAP);
+    BenchSharedFree(expected, GridWordsFor(grid));
+    BenchSharedFree(samples, (size_t)clients * SAMPLE_CAP);
+    BenchSharedFree(counts, clients);
+    GridSnapshotFree(&snap);
+    GridDeltaFree(&delta);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> clients = BenchList(argc, argv, "-clients", "1,100,300");
+    int grid = (int)BenchArg(argc, argv, "-grid", 300);
+    int writes = (int)BenchArg(argc, argv, "-writes", 4);
+    uint64_t ms = (uint64_t)BenchArg(argc, argv, "-ms", 2000);
+    uint32_t frameMs = (uint32_t)BenchArg(argc, argv, "-frame", 0);
+    int colors = (int)BenchArg(argc, argv, "-colors", 500);
+    int slow = (int)BenchArg(argc, argv, "-slow", 10);
+
+    char name[64], endpoint[96];
+    BenchName(name, sizeof(name), "MirrorBench");
+    snprintf(endpoint, sizeof(endpoint), "/tmp%s.sock", name);
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created) || !created) {
+        fprintf(stderr, "cannot create %s\n", name);
+        return 1;
+    }
+    SharedReset(&m, RGB(0, 0, 255), RGB(255, 0, 0));
+    SharedSetWinLength(&m, grid + 1);
+
+    bool ok = writes >= 1;
+    for (int n : clients) {
+        if (n < 1 || n > 1000) {
+            fprintf(stderr, "clients must be 1..1000\n");
+            ok = false;
+            break;
+        }
+        ok &= Run(&m, endpoint, n, writes, ms, frameMs, colors, slow);
+    }
+    SharedClose(&m);
+    SharedUnlink(name);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+﻿// Подача ходов через очередь (MoveQueue) под соперничеством процессов.
+//
+//   MoveBench [-procs 1,4,16,64] [-ms 1000] [-grid 100] [-k 5]
+//
+// procs процессов подают ходы MoveSubmit в одно поле как можно чаще:
+// клетка и игрок случайные, так что часть ходов отказывает очередь
+// (клетка занята, не тот игрок). После победы
+// подавший зовёт SharedNewGame. Печатает принятые и отказанные ходы в
+// секунду по причинам, средний размер пачки у разборщика и задержку
+// MoveSubmit (p50/p99/p99.9).
+
+#include "Bench.h"
+#include "MoveQueue.h"
+
+#define SAMPLE_CAP 65536
+
+struct Counters {
+    std::atomic<uint64_t> results[MOVE_DROPPED + 1];
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> batchMoves;
+    std::atomic<uint64_t> abandoned;
+};
+
+static int Submitter(const char* name, int grid, int id, BenchGate* gate, uint64_t ms, Counters* c,
+                     uint64_t* samples, uint32_t* count) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created) || created) return 1;
+    uint64_t rnd = 0x9E3779B97F4A7C15ull * (uint64_t)(id + 1);
+    uint64_t cells = (uint64_t)grid * grid, n = 0;
+    uint64_t results[MOVE_DROPPED + 1] = {};
+    BenchGateWait(gate);
+    uint64_t stop = gate->startNs.load() + ms * 1000000;
+    for (;;) {
+        rnd ^= rnd >> 12; rnd ^= rnd << 25; rnd ^= rnd >> 27;
+        uint64_t x = rnd * 0x2545F4914F6CDD1Dull;
+        uint64_t t0 = BenchNow();
+        int r = MoveSubmit(&m, (int)(x % cells), CELL_O + (int)((x >> 40) & 1), nullptr);
+        uint64_t t1 = BenchNow();
+        if ((n & 7) == 0 && *count < SAMPLE_CAP) samples[(*count)++] = t1 - t0;
+        n++;
+        if (r >= 0 && r <= MOVE_DROPPED) results[r]++;
+        if (r == MOVE_GAME_OVER) SharedNewGame(&m);
+        if (t1 >= stop) break;
+    }
+    for (int r = 0; r <= MOVE_DROPPED; r++) c->results[r].fetch_add(results[r]);
+    MoveQueueStats st = MoveQueueGetStats();
+    c->batches.fetch_add(st.batches);
+    c->batchMoves.fetch_add(st.batchMoves);
+    c->abandoned.fetch_add(st.abandoned);
+    SharedClose(&m);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> procs = BenchList(argc, argv, "-procs", "1,4,16,64");
+    uint64_t ms = (uint64_t)BenchArg(argc, argv, "-ms", 1000);
+    int grid = (int)BenchArg(argc, argv, "-grid", 100);
+    int k = (int)BenchArg(argc, argv, "-k", 5);
+
+    char name[64];
+    BenchName(name, sizeof(name), "MoveBench");
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created) || !created) {
+        fprintf(stderr, "cannot create %s\n", name);
+        return 1;
+    }
+    SharedReset(&m, RGB(0, 0, 255), RGB(255, 0, 0));
+    SharedSetWinLength(&m, k);
+    printf("board %dx%d, K %d, %d ms per run\n", grid, grid, k, (int)ms);
+    printf("%5s %11s %11s | %9s %9s %9s %9s | %9s %9s\n", "procs", "accepted/s", "rejected/s",
+        "occupied", "not turn", "game over", "range", "avg batch", "abandoned");
+
+    int maxProcs = *std::max_element(procs.begin(), procs.end());
+    uint64_t* samples = BenchShared<uint64_t>((size_t)maxProcs * SAMPLE_CAP);
+    uint32_t* counts = BenchShared<uint32_t>(maxProcs);
+    bool ok = true;
+    for (int p : procs) {
+        SharedNewGame(&m);
+        BenchGate* gate = BenchShared<BenchGate>(1);
+        Counters* c = BenchShared<Counters>(1);
+        memset(counts, 0, sizeof(uint32_t) * maxProcs);
+        std::vector<pid_t> pids;
+        ok &= BenchSpawn(p, [&](int i) {
+            return Submitter(name, grid, i, gate, ms, c, samples + (size_t)i * SAMPLE_CAP, counts + i);
+        }, &pids);
+        BenchGateOpen(gate, p);
+        ok &= BenchWait(&pids);
+        double secs = (BenchNow() - gate->startNs.load()) / 1e9;
+
+        uint64_t acc = c->results[MOVE_ACCEPTED].load(), rej = 0;
+        for (int r = MOVE_OCCUPIED; r <= MOVE_DROPPED; r++) rej += c->results[r].load();
+        printf("%5d %11.0f %11.0f | %9.0f %9.0f %9.0f %9.0f | %9.1f %9llu\n", p, acc / secs, rej / secs,
+            c->results[MOVE_OCCUPIED].load() / secs, c->results[MOVE_NOT_YOUR_TURN].load() / secs,
+            c->results[MOVE_GAME_OVER].load() / secs, c->results[MOVE_OUT_OF_RANGE].load() / secs,
+            c->batches.load() ? (double)c->batchMoves.load() / c->batches.load() : 0,
+            (unsigned long long)c->abandoned.load());
+        std::vector<uint64_t> all;
+        BenchCollect(samples, SAMPLE_CAP, counts, p, &all);
+        char label[96];
+        snprintf(label, sizeof(label), "  MoveSubmit, %d process(es)", p);
+        BenchPrintLatency(label, all);
+        if (c->results[MOVE_PENDING].load() || c->results[MOVE_OUT_OF_RANGE].load() || c->results[MOVE_DROPPED].load()) {
+            fprintf(stderr, "%d processes: %llu pending / %llu out-of-range / %llu dropped results\n", p,
+                (unsigned long long)c->results[MOVE_PENDING].load(),
+                (unsigned long long)c->results[MOVE_OUT_OF_RANGE].load(),
+                (unsigned long long)c->results[MOVE_DROPPED].load());
+            ok = false;
+        }
+        BenchSharedFree(gate, 1);
+        BenchSharedFree(c, 1);
+    }
+
+    SharedClose(&m);
+    SharedUnlink(name);
+    BenchSharedFree(samples, (size_t)maxProcs * SAMPLE_CAP);
+    BenchSharedFree(counts, maxProcs);
+    return ok ? 0 : 1;
+}
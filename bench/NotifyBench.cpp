@@ -0,0 +1,131 @@
+﻿// Разветвление уведомлений (Notify): от записи до того, как проснулись
+// все подписчики.
+//
+//   NotifyBench [-instances 2,16,128] [-rounds 2000] [-grid 100]
+//
+// instances — процессов на одном поле, каждый со своим слотом, как окно:
+// один пишет, остальные ждут в NotifyWait. Раунд: писатель засекает
+// время, ставит клетку SharedWriteCell и зовёт NotifyAll; каждый
+// подписчик, проснувшись, отмечает свою задержку. Следующий раунд — когда
+// отметились все, чтобы пробуждения не сливались.
+// Печатает задержку одного подписчика, задержку последнего (все
+// уведомлены) и время самого NotifyAll у писателя.
+
+#include "Bench.h"
+#include "Notify.h"
+
+struct Round {
+    std::atomic<uint32_t> round;       // текущий раунд, с 1
+    std::atomic<uint32_t> stop;
+    std::atomic<uint32_t> acks;        // отметившихся в текущем раунде
+    std::atomic<uint32_t> failed;
+    std::atomic<uint64_t> t0;          // начало записи текущего раунда
+};
+
+static int Subscriber(const char* name, int grid, int id, int rounds, Round* r, BenchGate* gate, uint64_t* lat) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created)) return 2;
+    int slot = NotifySubscribe(&m);
+    if (slot < 0) {
+        r->failed.fetch_add(1);
+        BenchGateWait(gate);
+        return 3;
+    }
+    uint32_t seen = NotifySeen(&m, slot), last = 0;
+    BenchGateWait(gate);
+    while (!r->stop.load(std::memory_order_acquire)) {
+        if (!NotifyWait(&m, slot, &seen, 200)) continue;
+        uint64_t now = BenchNow();
+        uint32_t cur = r->round.load(std::memory_order_acquire);
+        if (cur == last || cur == 0 || cur > (uint32_t)rounds) continue;
+        lat[(size_t)(cur - 1) * 128 + id] = now - r->t0.load(std::memory_order_relaxed);
+        last = cur;
+        r->acks.fetch_add(1, std::memory_order_release);
+    }
+    NotifyUnsubscribe(&m, slot);
+    SharedClose(&m);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> instances = BenchList(argc, argv, "-instances", "2,16,128");
+    int rounds = (int)BenchArg(argc, argv, "-rounds", 2000);
+    int grid = (int)BenchArg(argc, argv, "-grid", 100);
+
+    char name[64];
+    BenchName(name, sizeof(name), "NotifyBench");
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created) || !created) {
+        fprintf(stderr, "cannot create %s\n", name);
+        return 1;
+    }
+    SharedReset(&m, RGB(0, 0, 255), RGB(255, 0, 0));
+    SharedSetWinLength(&m, grid);
+    int ownSlot = NotifySubscribe(&m);
+
+    uint64_t* lat = BenchShared<uint64_t>((size_t)rounds * 128);
+    bool ok = ownSlot >= 0;
+    for (int n : instances) {
+        int subs = n - 1;
+        if (subs < 1 || subs > GRID_MAX_SUBSCRIBERS - 1) {
+            fprintf(stderr, "instances must be 2..%d\n", GRID_MAX_SUBSCRIBERS);
+            return 1;
+        }
+        Round* r = BenchShared<Round>(1);
+        BenchGate* gate = BenchShared<BenchGate>(1);
+        std::vector<pid_t> pids;
+        ok &= BenchSpawn(subs, [&](int i) { return Subscriber(name, grid, i, rounds, r, gate, lat); }, &pids);
+        BenchGateOpen(gate, subs);
+        if (r->failed.load()) {
+            fprintf(stderr, "%u subscriber(s) found no free slot\n", r->failed.load());
+            ok = false;
+        }
+
+        std::vector<uint64_t> one, all, wake;
+        for (int k = 1; k <= rounds && ok; k++) {
+            r->acks.store(0);
+            uint64_t t0 = BenchNow();
+            r->t0.store(t0, std::memory_order_relaxed);
+            r->round.store((uint32_t)k, std::memory_order_release);
+            SharedWriteCell(&m, k % (grid * grid), CELL_O + (k & 1));
+            uint64_t t1 = BenchNow();
+            NotifyAll(&m, ownSlot);
+            wake.push_back(BenchNow() - t1);
+            uint64_t deadline = BenchNow() + 5000000000ull;
+            while (r->acks.load(std::memory_order_acquire) < (uint32_t)subs) {
+                if (BenchNow() > deadline) {
+                    fprintf(stderr, "round %d: only %u of %d woke up\n", k, r->acks.load(), subs);
+                    ok = false;
+                    break;
+                }
+                sched_yield();
+            }
+            uint64_t worst = 0;
+            for (int i = 0; i < subs; i++) {
+                uint64_t v = lat[(size_t)(k - 1) * 128 + i];
+                one.push_back(v);
+                if (v > worst) worst = v;
+            }
+            all.push_back(worst);
+            if (k % 256 == 0) SharedNewGame(&m);
+        }
+        r->stop.store(1, std::memory_order_release);
+        NotifyAll(&m, ownSlot);
+        ok &= BenchWait(&pids);
+
+        printf("%d instances (%d subscribers), %d rounds\n", n, subs, rounds);
+        BenchPrintLatency("  write -> one subscriber awake", one);
+        BenchPrintLatency("  write -> all subscribers awake", all);
+        BenchPrintLatency("  NotifyAll at the writer", wake);
+        BenchSharedFree(r, 1);
+        BenchSharedFree(gate, 1);
+    }
+
+    NotifyUnsubscribe(&m, ownSlot);
+    SharedClose(&m);
+    SharedUnlink(name);
+    BenchSharedFree(lat, (size_t)rounds * 128);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+﻿// Клетки по 2 бита (SharedCells) против прежнего int на клетку.
+//
+//   PackedBench [-sizes 10,100,1000,4000] [-writes 20000000] [-reps 5]
+//
+// Полный проход: сколько O и X на поле — по int, по GridCellGet на
+// каждую клетку и пословно (popcount по 32 клетки за раз, как CountAll).
+// Запись: случайные клетки по одной — int-присваивание против
+// GridCellSet (чтение-изменение-запись слова). Память — обе раскладки.
+
+#include "Bench.h"
+#include "SharedGrid.h"
+
+static volatile uint64_t sink;
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// Как в SharedGrid.cpp (CountWord)
+static inline int Popcount64(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((x * 0x0101010101010101ull) >> 56);
+}
+
+// Лучшее из reps прогонов f(), нс
+template <class F>
+static uint64_t Best(int reps, F f) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < reps; r++) {
+        uint64_t t0 = BenchNow();
+        f();
+        uint64_t t = BenchNow() - t0;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = BenchList(argc, argv, "-sizes", "10,100,1000,4000");
+    uint64_t writes = (uint64_t)BenchArg(argc, argv, "-writes", 20000000);
+    int reps = (int)BenchArg(argc, argv, "-reps", 5);
+
+    printf("%6s %10s %10s | %9s %9s %9s | %9s %9s  (scan: ns/cell, write: ns/op)\n",
+        "size", "int bytes", "2-bit", "scan int", "get", "words", "write int", "set");
+    for (int n : sizes) {
+        size_t cells = (size_t)n * n;
+        uint32_t words = GridWordsFor(n);
+        std::vector<int> flat(cells);
+        std::vector<uint64_t> packed(words);
+
+        // треть пустых, треть O, треть X
+        uint64_t rnd = 88172645463325252ull;
+        for (size_t i = 0; i < cells; i++) {
+            int v = (int)(NextRandom(&rnd) % 3);
+            flat[i] = v;
+            GridCellSet(packed.data(), (int)i, v);
+        }
+
+        uint64_t tInt = Best(reps, [&] {
+            uint64_t o = 0, x = 0;
+            for (size_t i = 0; i < cells; i++) {
+                o += flat[i] == CELL_O;
+                x += flat[i] == CELL_X;
+            }
+            sink = o * 3 + x;
+        });
+        uint64_t tGet = Best(reps, [&] {
+            uint64_t o = 0, x = 0;
+            for (size_t i = 0; i < cells; i++) {
+                int v = GridCellGet(packed.data(), (int)i);
+                o += v == CELL_O;
+                x += v == CELL_X;
+            }
+            sink = o * 3 + x;
+        });
+        uint64_t tWords = Best(reps, [&] {
+            uint64_t o = 0, x = 0;
+            for (uint32_t w = 0; w < words; w++) {
+                o += (uint64_t)Popcount64(packed[w] & 0x5555555555555555ull);
+                x += (uint64_t)Popcount64(packed[w] & 0xAAAAAAAAAAAAAAAAull);
+            }
+            sink = o * 3 + x;
+        });
+
+        // индексы заранее: генератор не должен входить в замер
+        size_t batch = writes < 1000000 ? (size_t)writes : 1000000;
+        std::vector<uint32_t> idx(batch);
+        for (size_t i = 0; i < batch; i++) idx[i] = (uint32_t)(NextRandom(&rnd) % cells);
+        uint64_t tWInt = Best(reps, [&] {
+            for (uint64_t i = 0; i < writes; i++) {
+                uint32_t c = idx[i % batch];
+                flat[c] = (int)(i & 1) + CELL_O;
+            }
+            sink = (uint64_t)flat[idx[0]];
+        });
+        uint64_t tWSet = Best(reps, [&] {
+            for (uint64_t i = 0; i < writes; i++) {
+                uint32_t c = idx[i % batch];
+                GridCellSet(packed.data(), (int)c, (int)(i & 1) + CELL_O);
+            }
+            sink = packed[0];
+        });
+
+        printf("%6d %10zu %10zu | %9.3f %9.3f %9.3f | %9.2f %9.2f\n",
+            n, cells * sizeof(int), (size_t)words * sizeof(uint64_t),
+            (double)tInt / cells, (double)tGet / cells, (double)tWords / cells,
+            (double)tWInt / writes, (double)tWSet / writes);
+    }
+    return 0;
+}
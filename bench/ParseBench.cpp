@@ -0,0 +1,128 @@
+﻿// Разбор текстового конфига: ConfigParse против прежних путей на sscanf.
+//
+//   ParseBench [-iters 1000000]
+//
+// Прежние загрузчики (до общего разбора) восстановлены здесь как были,
+// только над буфером в памяти вместо файла:
+//   mapping/winapi — копия в new char[] и один sscanf на 9 полей;
+//   filevars       — копия в new char[], strtok по строкам, atoi и sscanf;
+//   fstream        — getline по istringstream и до пяти sscanf на строку.
+// Два текста: как пишут сохранялки, и с ключами вразнобой, \r\n и
+// незнакомым ключом — на нём однопроходный sscanf просто не срабатывает.
+// Печатает нс на разбор и совпал ли результат с ConfigParse.
+
+#include "Bench.h"
+#include "Config.h"
+
+#include <sstream>
+#include <string>
+
+static Config OldMappingWinAPI(const char* text, size_t len) {
+    Config c = {};
+    char* buf = new char[len + 1];
+    memcpy(buf, text, len); buf[len] = 0;
+    int r1, g1, b1, r2, g2, b2;
+    if (sscanf(buf,
+        "GridSize=%d\nWindowWidth=%d\nWindowHeight=%d\n"
+        "BackgroundColor=%d;%d;%d\nGridColor=%d;%d;%d",
+        &c.gridSize, &c.clientWidth, &c.clientHeight,
+        &r1, &g1, &b1, &r2, &g2, &b2) == 9)
+    {
+        c.backgroundColor = RGB(r1, g1, b1);
+        c.gridColor = RGB(r2, g2, b2);
+    }
+    delete[] buf;
+    return c;
+}
+
+static Config OldFileVars(const char* text, size_t len) {
+    Config c = {};
+    char* buf = new char[len + 1];
+    memcpy(buf, text, len); buf[len] = 0;
+    char* line = strtok(buf, "\n");
+    while (line) {
+        if (!strncmp(line, "GridSize=", 9))
+            c.gridSize = atoi(line + 9);
+        else if (!strncmp(line, "WindowWidth=", 12))
+            c.clientWidth = atoi(line + 12);
+        else if (!strncmp(line, "WindowHeight=", 13))
+            c.clientHeight = atoi(line + 13);
+        else if (!strncmp(line, "BackgroundColor=", 16)) {
+            int r, g, b; sscanf(line + 16, "%d;%d;%d", &r, &g, &b);
+            c.backgroundColor = RGB(r, g, b);
+        }
+        else if (!strncmp(line, "GridColor=", 10)) {
+            int r, g, b; sscanf(line + 10, "%d;%d;%d", &r, &g, &b);
+            c.gridColor = RGB(r, g, b);
+        }
+        line = strtok(nullptr, "\n");
+    }
+    delete[] buf;
+    return c;
+}
+
+static Config OldFStream(const char* text, size_t len) {
+    Config c = {};
+    std::istringstream f(std::string(text, len));
+    std::string line; int r, g, b;
+    while (std::getline(f, line)) {
+        if (sscanf(line.c_str(), "GridSize=%d", &c.gridSize) == 1) continue;
+        if (sscanf(line.c_str(), "WindowWidth=%d", &c.clientWidth) == 1) continue;
+        if (sscanf(line.c_str(), "WindowHeight=%d", &c.clientHeight) == 1) continue;
+        if (sscanf(line.c_str(), "BackgroundColor=%d;%d;%d", &r, &g, &b) == 3)
+            c.backgroundColor = RGB(r, g, b);
+        if (sscanf(line.c_str(), "GridColor=%d;%d;%d", &r, &g, &b) == 3)
+            c.gridColor = RGB(r, g, b);
+    }
+    return c;
+}
+
+static Config NewParse(const char* text, size_t len) {
+    Config c = {};
+    ConfigParse(text, len, &c);
+    return c;
+}
+
+static bool SameConfig(const Config& a, const Config& b) {
+    return a.gridSize == b.gridSize && a.clientWidth == b.clientWidth && a.clientHeight == b.clientHeight
+        && a.backgroundColor == b.backgroundColor && a.gridColor == b.gridColor;
+}
+
+static volatile int sink;
+
+int main(int argc, char** argv) {
+    long long iters = BenchArg(argc, argv, "-iters", 1000000);
+
+    const char* texts[2] = {
+        "GridSize=17\nWindowWidth=640\nWindowHeight=480\nBackgroundColor=12;34;56\nGridColor=200;100;50\n",
+        "GridColor=200;100;50\r\nTheme=dark\r\nWindowHeight=480\r\nGridSize=17\r\n"
+        "BackgroundColor=12;34;56\r\nWindowWidth=640\r\n",
+    };
+    const char* textNames[2] = { "as saved", "reordered, CRLF, unknown key" };
+    struct Path { const char* name; Config (*fn)(const char*, size_t); };
+    const Path paths[] = {
+        { "ConfigParse", NewParse },
+        { "old mapping/winapi", OldMappingWinAPI },
+        { "old filevars", OldFileVars },
+        { "old fstream", OldFStream },
+    };
+
+    bool ok = true;
+    for (int t = 0; t < 2; t++) {
+        size_t len = strlen(texts[t]);
+        Config want = NewParse(texts[t], len);
+        ok &= want.gridSize == 17 && want.gridColor == RGB(200, 100, 50);
+        printf("%s (%zu bytes), %lld parses\n", textNames[t], len, iters);
+        double base = 0;
+        for (const Path& p : paths) {
+            Config got = p.fn(texts[t], len);
+            uint64_t t0 = BenchNow();
+            for (long long i = 0; i < iters; i++) sink = p.fn(texts[t], len).gridSize;
+            double ns = (double)(BenchNow() - t0) / iters;
+            if (!base) base = ns;
+            printf("  %-20s %8.1f ns  x%-6.1f %s\n", p.name, ns, ns / base,
+                SameConfig(got, want) ? "same result" : "DIFFERENT result");
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+﻿// Кадры в секунду программной отрисовки (Render) по ядрам заливки.
+//
+//   RenderBench [-heights 720,1080,2160] [-grids 10,100,1000] [-ms 1000]
+//
+// Окно 16:9 заданной высоты (2160 — 4K), поле gridSize x gridSize,
+// заполненное на две трети случайными O и X. Каждый кадр — полная
+// перерисовка RenderGrid, как WM_PAINT после изменения размера. Для каждого
+// сочетания — FPS и нс на пиксель со скалярным ядром, SSE2 и AVX2 (если
+// процессор умеет).
+
+#include "Bench.h"
+#include "Render.h"
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static void MakeBoard(GridSnapshot* s, std::vector<uint64_t>* words, int n) {
+    words->assign(GridWordsFor(n), 0);
+    uint64_t rnd = 0x9E3779B97F4A7C15ull ^ (uint64_t)n;
+    for (int i = 0; i < n * n; i++) GridCellSet(words->data(), i, (int)(NextRandom(&rnd) % 3));
+    *s = GridSnapshot();
+    s->gridSize = n;
+    s->backgroundColor = RGB(0, 0, 255);
+    s->gridColor = RGB(255, 0, 0);
+    s->cells = words->data();
+    s->capWords = (uint32_t)words->size();
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> heights = BenchList(argc, argv, "-heights", "720,1080,2160");
+    std::vector<int> grids = BenchList(argc, argv, "-grids", "10,100,1000");
+    uint64_t ms = (uint64_t)BenchArg(argc, argv, "-ms", 1000);
+
+    RenderKernel kernels[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+    printf("%11s %6s", "window", "grid");
+    for (RenderKernel k : kernels) printf(" | %6s fps  ns/px", RenderKernelName(k));
+    printf("\n");
+
+    Framebuffer fb = {};
+    for (int h : heights) {
+        int w = h * 16 / 9;
+        FramebufferResize(&fb, w, h);
+        RenderClip all = { 0, 0, w, h };
+        for (int n : grids) {
+            GridSnapshot snap;
+            std::vector<uint64_t> words;
+            MakeBoard(&snap, &words, n);
+            GridLayout lay = GridLayoutMake(n, w, h);
+            printf("%5dx%-5d %6d", w, h, n);
+            for (RenderKernel k : kernels) {
+                if (RenderSetKernel(k) != k) {
+                    printf(" | %17s", "-");
+                    continue;
+                }
+                RenderGrid(&fb, &snap, &lay, &all);          // прогрев
+                uint64_t frames = 0, t0 = BenchNow(), t = 0;
+                do {
+                    RenderGrid(&fb, &snap, &lay, &all);
+                    frames++;
+                    t = BenchNow() - t0;
+                } while (t < ms * 1000000);
+                printf(" | %10.1f %6.2f", frames * 1e9 / t, (double)t / frames / ((double)w * h));
+            }
+            printf("\n");
+        }
+    }
+    FramebufferFree(&fb);
+    return 0;
+}
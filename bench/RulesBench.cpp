@@ -0,0 +1,81 @@
+﻿// Ходы в секунду на случайных партиях: проверка после хода (RulesCheckMove,
+// O(K)) против полного перебора поля после каждого хода (RulesFindWin).
+//
+//   RulesBench [-sizes 3,5,10,15,100,1000] [-k 0] [-ms 500]
+//
+// Партия: ходы по очереди в случайные пустые клетки, GridCellSet и
+// проверка; выигрыш или полное поле — новая партия. Поле 1000x1000
+// не заполняется целиком — новая партия после 100000 ходов.
+
+#include "Bench.h"
+#include "Rules.h"
+#include "SharedGrid.h"
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+struct Game {
+    int                   n;
+    std::vector<uint64_t> cells;
+    std::vector<int>      empty;
+    int                   moves;
+};
+
+static void NewGame(Game* g) {
+    std::fill(g->cells.begin(), g->cells.end(), 0);
+    g->empty.resize((size_t)g->n * g->n);
+    for (size_t i = 0; i < g->empty.size(); i++) g->empty[i] = (int)i;
+    g->moves = 0;
+}
+
+// Играет ms миллисекунд; fullScan — RulesFindWin вместо RulesCheckMove
+static void Play(int n, int k, uint64_t ms, bool fullScan, double* movesPerSec, double* gamesPerSec) {
+    Game g;
+    g.n = n;
+    g.cells.assign(GridWordsFor(n), 0);
+    NewGame(&g);
+    uint64_t rnd = 0x853C49E6748FEA9Bull, moves = 0, games = 0;
+    int cap = n * n < 100000 ? n * n : 100000;
+    uint64_t t0 = BenchNow(), t = 0;
+    for (;;) {
+        for (int batch = 0; batch < 256; batch++) {
+            size_t slot = (size_t)(NextRandom(&rnd) % g.empty.size());
+            int index = g.empty[slot];
+            g.empty[slot] = g.empty.back();
+            g.empty.pop_back();
+            GridCellSet(g.cells.data(), index, CELL_O + (g.moves & 1));
+            g.moves++;
+            moves++;
+            bool won = fullScan ? RulesFindWin(g.cells.data(), n, k, nullptr)
+                                : RulesCheckMove(g.cells.data(), n, k, index, nullptr);
+            if (won || g.moves == cap) {
+                NewGame(&g);
+                games++;
+            }
+        }
+        t = BenchNow() - t0;
+        if (t >= ms * 1000000) break;
+    }
+    *movesPerSec = moves * 1e9 / t;
+    *gamesPerSec = games * 1e9 / t;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = BenchList(argc, argv, "-sizes", "3,5,10,15,100,1000");
+    int k0 = (int)BenchArg(argc, argv, "-k", 0);
+    uint64_t ms = (uint64_t)BenchArg(argc, argv, "-ms", 500);
+
+    printf("%6s %3s | %14s %12s | %14s %12s\n", "size", "K", "CheckMove/s", "games/s", "FindWin/s", "games/s");
+    for (int n : sizes) {
+        int k = RulesWinLength(n, k0);
+        double m1, g1, m2, g2;
+        Play(n, k, ms, false, &m1, &g1);
+        Play(n, k, n >= 1000 ? ms / 5 : ms, true, &m2, &g2);
+        printf("%6d %3d | %14.0f %12.1f | %14.0f %12.1f\n", n, k, m1, g1, m2, g2);
+    }
+    return 0;
+}
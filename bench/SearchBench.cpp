@@ -0,0 +1,118 @@
+﻿// Поиск хода (Search): узлы в секунду и ускорение по потокам.
+//
+//   SearchBench [-threads 1,2,4,8,16] [-depth 6] [-ms 2000] [-positions 4] [-tt 20]
+//
+// Позиции середины партии: 15x15 и 10x10 (K = 5) и 19x19 (K = 5), по
+// positions штук, набранные случайными ходами у центра без выигрыша на
+// доске. Два замера на каждое число потоков:
+//  - до фиксированной глубины depth — время до глубины и ускорение
+//    относительно одного потока (то, что чувствует игрок);
+//  - по бюджету ms — узлов в секунду и достигнутая глубина.
+// Таблица транспозиций пересоздаётся для каждого поиска, чтобы прогоны
+// не подсказывали друг другу.
+
+#include "Bench.h"
+#include "Rules.h"
+#include "Search.h"
+#include "SharedGrid.h"
+#include "ThreadPool.h"
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+struct Position {
+    int                   n, k;
+    std::vector<uint64_t> cells;
+};
+
+static Position MakePosition(int n, int k, int stones, uint64_t* rnd) {
+    Position p;
+    p.n = n;
+    p.k = k;
+    for (;;) {
+        p.cells.assign(GridWordsFor(n), 0);
+        int placed = 0, c0 = n / 2 - 3, span = 7;
+        while (placed < stones) {
+            int i = (c0 + (int)(NextRandom(rnd) % span)) * n + c0 + (int)(NextRandom(rnd) % span);
+            if (GridCellGet(p.cells.data(), i) != CELL_EMPTY) continue;
+            GridCellSet(p.cells.data(), i, CELL_O + (placed & 1));
+            placed++;
+        }
+        if (!RulesFindWin(p.cells.data(), n, k, nullptr)) return p;
+    }
+}
+
+struct Run {
+    uint64_t nodes;
+    uint64_t ns;
+    int      depth;
+};
+
+static Run Search(ThreadPool* pool, int ttBits, const Position& p, const SearchLimits& lim, int* move, int* score) {
+    SearchEngine* e = SearchCreate(pool, ttBits);
+    SearchStats st = {};
+    int player = SearchSideToMove(p.cells.data(), p.n);
+    uint64_t t0 = BenchNow();
+    *move = SearchBestMove(e, p.cells.data(), p.n, p.k, player, &lim, &st);
+    Run r = { st.nodes, BenchNow() - t0, st.depth };
+    *score = st.score;
+    SearchDestroy(e);
+    return r;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> threads = BenchList(argc, argv, "-threads", "1,2,4,8,16");
+    int depth = (int)BenchArg(argc, argv, "-depth", 6);
+    uint32_t ms = (uint32_t)BenchArg(argc, argv, "-ms", 2000);
+    int count = (int)BenchArg(argc, argv, "-positions", 4);
+    int ttBits = (int)BenchArg(argc, argv, "-tt", 20);
+
+    uint64_t rnd = 0xC0FFEE;
+    std::vector<Position> positions;
+    for (int i = 0; i < count; i++) {
+        positions.push_back(MakePosition(10, 5, 10, &rnd));
+        positions.push_back(MakePosition(15, 5, 12, &rnd));
+        positions.push_back(MakePosition(19, 5, 14, &rnd));
+    }
+    printf("%zu positions (10x10, 15x15, 19x19, K=5), %ld cores\n", positions.size(),
+        sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%7s | %12s %8s %12s | %12s %6s\n", "threads", "to depth ms", "speedup", "nodes/s", "budget n/s", "depth");
+
+    double base = 0;
+    std::vector<int> firstMoves, firstScores;
+    int disagree = 0;
+    for (int t : threads) {
+        ThreadPool* pool = t > 1 ? ThreadPoolCreate(t) : nullptr;
+        uint64_t fixedNs = 0, fixedNodes = 0, budgetNs = 0, budgetNodes = 0;
+        int depthSum = 0;
+        for (size_t i = 0; i < positions.size(); i++) {
+            int move, score;
+            SearchLimits fixed = { 600000, depth };
+            Run r = Search(pool, ttBits, positions[i], fixed, &move, &score);
+            fixedNs += r.ns;
+            fixedNodes += r.nodes;
+            if (firstScores.size() < positions.size()) {
+                firstMoves.push_back(move);
+                firstScores.push_back(score);
+            }
+            else if (score != firstScores[i]) disagree++;
+
+            SearchLimits budget = { ms / (uint32_t)positions.size(), 0 };
+            r = Search(pool, ttBits, positions[i], budget, &move, &score);
+            budgetNs += r.ns;
+            budgetNodes += r.nodes;
+            depthSum += r.depth;
+        }
+        double msToDepth = fixedNs / 1e6 / positions.size();
+        if (!base) base = msToDepth;
+        printf("%7d | %12.2f %8.2f %12.0f | %12.0f %6.1f\n", t, msToDepth, base / msToDepth,
+            fixedNodes * 1e9 / fixedNs, budgetNodes * 1e9 / budgetNs, (double)depthSum / positions.size());
+        if (pool) ThreadPoolDestroy(pool);
+    }
+    if (disagree) printf("%d searches to depth %d scored differently from 1 thread\n", disagree, depth);
+    return 0;
+}
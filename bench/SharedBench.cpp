@@ -0,0 +1,159 @@
+﻿// Межпроцессная запись в поле (SharedGrid): писатели и читатели — отдельные
+// процессы, каждый со своим SharedOpen, как экземпляры окна.
+//
+//   SharedBench [-grid 1000] [-writers 1,2,4,8] [-readers 2] [-ms 1000]
+//               [-attachers 4] [-attach 200] [-k 5]
+//
+// Подключение: attachers процессов одновременно по attach раз делают
+// SharedOpen + SharedClose уже существующего поля.
+// Запись: writers процессов ставят случайные клетки SharedWriteCell (с
+// проверкой правил, как клик; после победы — SharedNewGame), readers
+// процессов доводят свой снимок SharedRefreshSnapshot, как окно в
+// UpdateFromShared. Печатает записи и чтения в секунду и задержку записи.
+
+#include "Bench.h"
+#include "SharedGrid.h"
+
+#define SAMPLE_CAP 65536
+
+struct Counters {
+    std::atomic<uint64_t> writes;
+    std::atomic<uint64_t> reads;
+    std::atomic<uint64_t> cellsSeen;
+};
+
+static int Attacher(const char* name, int grid, int n, uint64_t* samples, uint32_t* count) {
+    for (int i = 0; i < n; i++) {
+        SharedMapping m;
+        bool created = false;
+        uint64_t t0 = BenchNow();
+        if (!SharedOpen(&m, name, grid, &created) || created) return 1;
+        samples[(*count)++] = BenchNow() - t0;
+        SharedClose(&m);
+    }
+    return 0;
+}
+
+static int Writer(const char* name, int grid, int id, BenchGate* gate, uint64_t ms, Counters* c,
+                  uint64_t* samples, uint32_t* count) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created)) return 1;
+    uint64_t rnd = 0x9E3779B97F4A7C15ull * (uint64_t)(id + 1);
+    uint64_t cells = (uint64_t)grid * grid, n = 0;
+    BenchGateWait(gate);
+    uint64_t stop = gate->startNs.load() + ms * 1000000;
+    for (;;) {
+        rnd ^= rnd >> 12; rnd ^= rnd << 25; rnd ^= rnd >> 27;
+        uint64_t x = rnd * 0x2545F4914F6CDD1Dull;
+        uint64_t t0 = BenchNow();
+        if (!SharedWriteCell(&m, (int)(x % cells), (int)((x >> 40) & 1) + CELL_O))
+            SharedNewGame(&m);
+        uint64_t t1 = BenchNow();
+        if ((n & 15) == 0 && *count < SAMPLE_CAP) samples[(*count)++] = t1 - t0;
+        n++;
+        if (t1 >= stop) break;
+    }
+    c->writes.fetch_add(n);
+    SharedClose(&m);
+    return 0;
+}
+
+static int Reader(const char* name, int grid, BenchGate* gate, uint64_t ms, Counters* c) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created)) return 1;
+    GridSnapshot snap = {};
+    GridDelta delta = {};
+    SharedReadSnapshot(&m, &snap);
+    uint64_t reads = 0, seen = 0;
+    BenchGateWait(gate);
+    uint64_t stop = gate->startNs.load() + ms * 1000000;
+    while (BenchNow() < stop) {
+        uint32_t v = snap.version;
+        if (SharedVersion(&m) == v) {
+            sched_yield();
+            continue;
+        }
+        SharedRefreshSnapshot(&m, &snap, &delta);
+        reads++;
+        seen += delta.count;
+    }
+    c->reads.fetch_add(reads);
+    c->cellsSeen.fetch_add(seen);
+    GridDeltaFree(&delta);
+    GridSnapshotFree(&snap);
+    SharedClose(&m);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int grid = (int)BenchArg(argc, argv, "-grid", 1000);
+    std::vector<int> writers = BenchList(argc, argv, "-writers", "1,2,4,8");
+    int readers = (int)BenchArg(argc, argv, "-readers", 2);
+    uint64_t ms = (uint64_t)BenchArg(argc, argv, "-ms", 1000);
+    int attachers = (int)BenchArg(argc, argv, "-attachers", 4);
+    int attach = (int)BenchArg(argc, argv, "-attach", 200);
+    int k = (int)BenchArg(argc, argv, "-k", 5);
+
+    char name[64];
+    BenchName(name, sizeof(name), "SharedBench");
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created) || !created) {
+        fprintf(stderr, "cannot create %s\n", name);
+        return 1;
+    }
+    SharedReset(&m, RGB(0, 0, 255), RGB(255, 0, 0));
+    SharedSetWinLength(&m, k);
+    printf("board %dx%d, K %d, %zu bytes of cells\n", grid, grid, k, m.cellsBytes);
+
+    int maxWriters = *std::max_element(writers.begin(), writers.end());
+    int maxProcs = std::max(attachers, maxWriters + readers);
+    uint64_t* samples = BenchShared<uint64_t>((size_t)maxProcs * SAMPLE_CAP);
+    uint32_t* counts = BenchShared<uint32_t>(maxProcs);
+    std::vector<uint64_t> all;
+    bool ok = true;
+
+    // Подключение к готовому полю
+    ok &= BenchFork(attachers, [&](int i) {
+        return Attacher(name, grid, attach, samples + (size_t)i * SAMPLE_CAP, counts + i);
+    });
+    BenchCollect(samples, SAMPLE_CAP, counts, attachers, &all);
+    char label[96];
+    snprintf(label, sizeof(label), "attach (%d processes at once)", attachers);
+    BenchPrintLatency(label, all);
+
+    // Запись и чтение
+    for (int w : writers) {
+        BenchGate* gate = BenchShared<BenchGate>(1);
+        Counters* c = BenchShared<Counters>(1);
+        memset(counts, 0, sizeof(uint32_t) * maxProcs);
+        std::vector<pid_t> pids;
+        ok &= BenchSpawn(w, [&](int i) {
+            return Writer(name, grid, i, gate, ms, c, samples + (size_t)i * SAMPLE_CAP, counts + i);
+        }, &pids);
+        ok &= BenchSpawn(readers, [&](int) { return Reader(name, grid, gate, ms, c); }, &pids);
+        BenchGateOpen(gate, w + readers);
+        ok &= BenchWait(&pids);
+        uint64_t elapsed = BenchNow() - gate->startNs.load();
+
+        double secs = elapsed / 1e9;
+        printf("writers %d, readers %d: %.0f writes/s (%.0f per writer), %.0f refreshes/s per reader, %.1f cells per refresh\n",
+            w, readers, c->writes.load() / secs, c->writes.load() / secs / w,
+            readers ? c->reads.load() / secs / readers : 0.0,
+            c->reads.load() ? (double)c->cellsSeen.load() / c->reads.load() : 0.0);
+        BenchCollect(samples, SAMPLE_CAP, counts, w, &all);
+        snprintf(label, sizeof(label), "  SharedWriteCell (every 16th)");
+        BenchPrintLatency(label, all);
+        BenchSharedFree(gate, 1);
+        BenchSharedFree(c, 1);
+    }
+
+    SharedClose(&m);
+    SharedUnlink(name);
+    BenchSharedFree(samples, (size_t)maxProcs * SAMPLE_CAP);
+    BenchSharedFree(counts, maxProcs);
+    if (!ok) fprintf(stderr, "a participant failed\n");
+    return ok ? 0 : 1;
+}
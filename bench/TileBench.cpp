@@ -0,0 +1,74 @@
+﻿// Масштабирование тайловой отрисовки (RenderGridTiled) по потокам.
+//
+//   TileBench [-threads 1,2,4,8,16] [-height 2160] [-grid 1000] [-tile 128] [-frames 20]
+//
+// Полный кадр поля gridSize на окне 16:9 (по умолчанию 4K, 1000x1000 —
+// стенной экран) на пуле из N участников. Печатает FPS, ускорение
+// относительно однопоточного RenderGrid и сверяет каждый кадр с ним:
+// тайлы не пересекаются, так что расхождение хоть в одном пикселе —
+// ошибка, а не шум (код выхода 1).
+
+#include "Bench.h"
+#include "Render.h"
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> threads = BenchList(argc, argv, "-threads", "1,2,4,8,16");
+    int h = (int)BenchArg(argc, argv, "-height", 2160);
+    int n = (int)BenchArg(argc, argv, "-grid", 1000);
+    int tile = (int)BenchArg(argc, argv, "-tile", RENDER_TILE_SIZE);
+    int frames = (int)BenchArg(argc, argv, "-frames", 20);
+    int w = h * 16 / 9;
+
+    std::vector<uint64_t> words(GridWordsFor(n));
+    uint64_t rnd = 12345;
+    for (int i = 0; i < n * n; i++) GridCellSet(words.data(), i, (int)(NextRandom(&rnd) % 3));
+    GridSnapshot snap = {};
+    snap.gridSize = n;
+    snap.backgroundColor = RGB(0, 0, 255);
+    snap.gridColor = RGB(255, 0, 0);
+    snap.cells = words.data();
+    snap.capWords = (uint32_t)words.size();
+    GridLayout lay = GridLayoutMake(n, w, h);
+    RenderClip all = { 0, 0, w, h };
+
+    Framebuffer fb = {};
+    FramebufferResize(&fb, w, h);
+    RenderKernel k = RenderSetKernel(KERNEL_AUTO);
+    RenderGrid(&fb, &snap, &lay, &all);
+    std::vector<uint32_t> ref(fb.pixels, fb.pixels + (size_t)w * h);
+    uint64_t t0 = BenchNow();
+    for (int f = 0; f < frames; f++) RenderGrid(&fb, &snap, &lay, &all);
+    double single = (double)(BenchNow() - t0) / frames;
+
+    printf("%dx%d, grid %d, tile %d, %s kernel, %ld cores\n", w, h, n, tile, RenderKernelName(k),
+        sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %10s %8s\n", "threads", "fps", "speedup");
+    printf("%8s %10.1f %8.2f\n", "RenderGrid", 1e9 / single, 1.0);
+    bool ok = true;
+    for (int t : threads) {
+        ThreadPool* pool = ThreadPoolCreate(t);
+        RenderGridTiled(pool, &fb, &snap, &lay, &all, tile);
+        uint64_t best = UINT64_MAX;
+        size_t mismatches = 0;
+        for (int f = 0; f < frames; f++) {
+            memset(fb.pixels, 0, (size_t)w * h * sizeof(uint32_t));
+            uint64_t s = BenchNow();
+            RenderGridTiled(pool, &fb, &snap, &lay, &all, tile);
+            uint64_t d = BenchNow() - s;
+            if (d < best) best = d;
+            if (memcmp(fb.pixels, ref.data(), ref.size() * sizeof(uint32_t)) != 0) mismatches++;
+        }
+        printf("%8d %10.1f %8.2f%s\n", t, 1e9 / best, single / best, mismatches ? "  FRAMES DIFFER" : "");
+        ok &= mismatches == 0;
+        ThreadPoolDestroy(pool);
+    }
+    FramebufferFree(&fb);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+﻿// Арена досок (Arena): память возвращается, умершие процессы не держат
+// доски.
+//
+//   ArenaTest [-procs 6] [-kills 10]
+//
+// 1. Куски между размерами: арена забивается мелкими досками, они
+//    удаляются, и крупных досок помещается столько же, сколько в пустую,
+//    за вычетом кусков, оставшихся под таблицами подключений.
+// 2. Создатель умер до ArenaPublish — тот же номер заводится заново.
+// 3. Подключённый процесс умер — ArenaDestroy освобождает доску сразу.
+// 4. Подключённый жив — доска живёт до его ArenaDetach, новые
+//    подключения к ней не проходят.
+// 5. procs процессов заводят, подключают и удаляют доски и получают
+//    SIGKILL в случайный момент, kills раз. После каждого раза все номера
+//    заводятся и удаляются без зависаний, и досок в арене не остаётся.
+// 6. Номеров за жизнь сегмента больше, чем записей каталога: записи
+//    удалённых досок занимают новые номера, и проба каталога остаётся
+//    короткой. procs процессов одновременно
+//    заводят одни и те же номера — каждый заводится ровно один раз.
+
+#include "Bench.h"
+#include "Test.h"
+#include "Arena.h"
+
+#include <signal.h>
+
+static const size_t SMALL = 4096, LARGE = 1u << 20;
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static bool Create(Arena* a, uint32_t id, size_t bytes) {
+    bool created = false;
+    int b = ArenaAttach(a, id, SMALL, bytes, true, &created);
+    if (b < 0) return false;
+    if (created) ArenaPublish(a, b);
+    ArenaDetach(a, b);
+    return created;
+}
+
+// Сколько досок bytes влезает в арену, начиная с номера first
+static uint32_t Fill(Arena* a, uint32_t first, size_t bytes) {
+    uint32_t n = 0;
+    while (Create(a, first + n, bytes)) n++;
+    return n;
+}
+
+static void DestroyRange(Arena* a, uint32_t first, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) ArenaDestroy(a, first + i);
+}
+
+static void CheckEmpty(Arena* a, const char* what) {
+    ArenaStats s = ArenaGetStats(a);
+    TEST_CHECK(s.boards == 0 && s.bytesInUse == 0, "%s: %u boards, %llu bytes in use left", what, s.boards,
+        (unsigned long long)s.bytesInUse);
+    TEST_CHECK(s.bytesFreeChunks + s.bytesTables == s.bytesCarved, "%s: %llu of %llu carved bytes not returned", what,
+        (unsigned long long)(s.bytesCarved - s.bytesFreeChunks - s.bytesTables), (unsigned long long)s.bytesCarved);
+}
+
+int main(int argc, char** argv) {
+    int procs = (int)BenchArg(argc, argv, "-procs", 6);
+    int kills = (int)BenchArg(argc, argv, "-kills", 10);
+    alarm(240);                        // зависание — тоже провал
+
+    char name[64];
+    BenchName(name, sizeof(name), "ArenaTest");
+    Arena* a = ArenaOpen(name);
+    TEST_CHECK(a, "cannot create %s", name);
+    if (!a) return TestResult("ArenaTest");
+
+    // 1. Куски между размерами
+    uint32_t large = Fill(a, 1, LARGE);
+    DestroyRange(a, 1, large);
+    CheckEmpty(a, "large boards destroyed");
+    uint32_t small = Fill(a, 100000, SMALL);
+    DestroyRange(a, 100000, small);
+    CheckEmpty(a, "small boards destroyed");
+    uint32_t tables = (uint32_t)(ArenaGetStats(a).bytesTables / ARENA_CHUNK_BYTES);
+    uint32_t again = Fill(a, 200000, LARGE);
+    DestroyRange(a, 200000, again);
+    printf("arena fits %u large boards, %u small; %u large after the small ones were destroyed"
+        " (%u chunks kept for attach tables)\n", large, small, again, tables);
+    // крупная доска — полкуска клеток
+    TEST_CHECK(large > 0 && small > large && again + 2 * (tables - 1) >= large && again <= large,
+        "large boards: %u fresh, %u after small ones", large, again);
+
+    // 2. Создатель умер до публикации
+    BenchFork(1, [&](int) -> int {
+        Arena* own = ArenaOpen(name);
+        bool created = false;
+        ArenaAttach(own, 7, SMALL, LARGE, true, &created);
+        _exit(created ? 0 : 1);
+    });
+    uint64_t t0 = BenchNow();
+    TEST_CHECK(Create(a, 7, SMALL), "board left in INIT by a dead creator was not taken over");
+    printf("board of a dead creator taken over in %.2f ms\n", (BenchNow() - t0) / 1e6);
+    TEST_CHECK(ArenaDestroy(a, 7), "board 7 is gone");
+    CheckEmpty(a, "after a dead creator");
+
+    // 3. Подключённый умер
+    TEST_CHECK(Create(a, 8, SMALL), "cannot create board 8");
+    BenchFork(3, [&](int) -> int {
+        Arena* own = ArenaOpen(name);
+        bool created = false;
+        _exit(ArenaAttach(own, 8, 0, 0, false, &created) >= 0 ? 0 : 1);
+    });
+    TEST_CHECK(ArenaDestroy(a, 8), "board 8 is gone");
+    CheckEmpty(a, "after dead attachers");
+
+    // 4. Подключённый жив
+    TEST_CHECK(Create(a, 9, SMALL), "cannot create board 9");
+    std::atomic<uint32_t>* step = BenchShared<std::atomic<uint32_t>>(1);
+    std::vector<pid_t> pids;
+    BenchSpawn(1, [&](int) {
+        Arena* own = ArenaOpen(name);
+        bool created = false;
+        int b = ArenaAttach(own, 9, 0, 0, false, &created);
+        step->store(1);
+        while (step->load() != 2) sched_yield();
+        if (b >= 0) ArenaDetach(own, b);
+        return b >= 0 ? 0 : 1;
+    }, &pids);
+    while (step->load() != 1) sched_yield();
+    bool created = false;
+    TEST_CHECK(ArenaDestroy(a, 9), "board 9 is gone");
+    TEST_CHECK(ArenaGetStats(a).boards == 1, "board 9 freed under a live attacher");
+    TEST_CHECK(ArenaAttach(a, 9, SMALL, SMALL, true, &created) < 0, "attached to a destroyed board");
+    step->store(2);
+    TEST_CHECK(BenchWait(&pids), "attacher failed");
+    CheckEmpty(a, "after the last detach");
+    BenchSharedFree(step, 1);
+
+    // 5. Оборот под SIGKILL
+    const uint32_t ids = 64, first = 300000;
+    uint64_t rnd = 0x9E3779B97F4A7C15ull;
+    uint64_t leaked = 0;
+    for (int k = 1; k <= kills; k++) {
+        BenchSpawn(procs, [&](int i) {
+            Arena* own = ArenaOpen(name);
+            uint64_t r = NextRandom(&rnd) ^ (uint64_t)(i + 1) << 32;
+            const size_t sizes[3] = { SMALL, 64 << 10, LARGE };
+            for (;;) {
+                uint32_t id = first + (uint32_t)(NextRandom(&r) % ids);
+                bool cr = false;
+                switch (NextRandom(&r) % 3) {
+                case 0: {
+                    int b = ArenaAttach(own, id, SMALL, sizes[NextRandom(&r) % 3], true, &cr);
+                    if (b >= 0 && cr) ArenaPublish(own, b);
+                    if (b >= 0 && NextRandom(&r) % 4) ArenaDetach(own, b);   // иногда не отключается
+                    break;
+                }
+                case 1: {
+                    int b = ArenaAttach(own, id, 0, 0, false, &cr);
+                    if (b >= 0) ArenaDetach(own, b);
+                    break;
+                }
+                default:
+                    ArenaDestroy(own, id);
+                }
+            }
+            return 0;
+        }, &pids);
+        usleep((useconds_t)(20000 + NextRandom(&rnd) % 80000));
+        for (pid_t p : pids) kill(p, SIGKILL);
+        for (pid_t p : pids) waitpid(p, nullptr, 0);
+        pids.clear();
+
+        t0 = BenchNow();
+        for (uint32_t i = 0; i < ids; i++) {
+            Create(a, first + i, SMALL);
+            TEST_CHECK(ArenaDestroy(a, first + i), "kill %d: board %u cannot be destroyed", k, first + i);
+        }
+        ArenaStats s = ArenaGetStats(a);
+        TEST_CHECK(s.boards == 0, "kill %d: %u boards left", k, s.boards);
+        leaked = s.bytesInUse;
+        if (k % 5 == 0 || k == kills)
+            printf("kill %d: all %u boards recovered in %.1f ms, %llu bytes lost with killed processes\n",
+                k, ids, (BenchNow() - t0) / 1e6, (unsigned long long)leaked);
+    }
+    TEST_CHECK(Create(a, 1, LARGE) && ArenaDestroy(a, 1), "arena unusable after kills");
+
+    // 6. Записи каталога переходят к новым номерам
+    t0 = BenchNow();
+    uint32_t churned = 0;
+    for (uint32_t i = 0; i < ARENA_DIR_SLOTS + ARENA_DIR_SLOTS / 4; i++) {
+        uint32_t id = 1000000 + i;
+        if (Create(a, id, SMALL) && ArenaDestroy(a, id)) churned++;
+    }
+    ArenaStats s = ArenaGetStats(a);
+    printf("%u distinct boards created and destroyed in %.1f ms, %u directory records used, longest probe %u\n",
+        churned, (BenchNow() - t0) / 1e6, s.directory, s.probe);
+    TEST_CHECK(churned == ARENA_DIR_SLOTS + ARENA_DIR_SLOTS / 4, "only %u distinct boards fit the directory", churned);
+    TEST_CHECK(s.probe < 64, "probe of %u records for boards that lived one at a time", s.probe);
+
+    // номера через ARENA_DIR_SLOTS начинают пробу с одной записи: заводящие
+    // разные номера тоже сталкиваются
+    const uint32_t racing = 1000;
+    std::atomic<uint32_t>* made = BenchShared<std::atomic<uint32_t>>(racing);
+    BenchGate* gate = BenchShared<BenchGate>(1);
+    BenchSpawn(procs, [&](int) {
+        Arena* own = ArenaOpen(name);
+        BenchGateWait(gate);
+        for (uint32_t i = 0; i < racing; i++) {
+            bool cr = false;
+            int b = ArenaAttach(own, 1 + i * ARENA_DIR_SLOTS, SMALL, SMALL, true, &cr);
+            if (b < 0) return 1;
+            if (cr) {
+                made[i].fetch_add(1);
+                ArenaPublish(own, b);
+            }
+            ArenaDetach(own, b);
+        }
+        return 0;
+    }, &pids);
+    BenchGateOpen(gate, procs);
+    TEST_CHECK(BenchWait(&pids), "racing creator failed to attach");
+    uint32_t twice = 0, never = 0;
+    for (uint32_t i = 0; i < racing; i++) {
+        uint32_t n = made[i].load();
+        twice += n > 1;
+        never += n == 0;
+        ArenaDestroy(a, 1 + i * ARENA_DIR_SLOTS);
+    }
+    TEST_CHECK(twice == 0 && never == 0, "racing creators: %u boards created twice, %u never", twice, never);
+    CheckEmpty(a, "after racing creators");
+    BenchSharedFree(made, racing);
+    BenchSharedFree(gate, 1);
+
+    ArenaClose(a);
+    shm_unlink(name);
+    return TestResult("ArenaTest");
+}
@@ -0,0 +1,153 @@
+﻿// Склейка обновлений (UpdateScheduler) под штормом ввода.
+//
+// Время виртуальное: шторм — это список моментов ввода, таймер
+// срабатывает в назначенный момент (или позже на jitter мс, как
+// WM_TIMER под нагрузкой). Для каждого шторма проверяется:
+//  - публикаций не больше duration / interval + 1 и между соседними
+//    не меньше interval — как бы часто ни шёл ввод;
+//  - ни одно событие не потеряно: после последнего ввода публикация
+//    есть, и каждое событие опубликовано не позже чем через
+//    interval + jitter;
+//  - редкий ввод не задерживается и не склеивается;
+//  - счётчики: input = published + coalesced.
+// Второй каскад — перерисовка окна, которое будят несколько писателей
+// (repaintSched): перерисовок тоже не больше одной за интервал.
+
+#include "Test.h"
+#include "UpdateScheduler.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+struct Sim {
+    UpdateScheduler       s;
+    uint32_t              jitterMs;
+    uint64_t              timerDue;
+    std::vector<uint64_t> pubs;
+};
+
+static void SimInit(Sim* sim, uint32_t intervalMs, uint32_t jitterMs) {
+    SchedulerInit(&sim->s, intervalMs);
+    sim->jitterMs = jitterMs;
+    sim->timerDue = UINT64_MAX;
+    sim->pubs.clear();
+}
+
+// Таймеры, которые должны были сработать до now
+static void SimAdvance(Sim* sim, uint64_t now) {
+    if (sim->timerDue > now) return;
+    uint64_t t = sim->timerDue;
+    sim->timerDue = UINT64_MAX;
+    if (SchedulerOnTimer(&sim->s, t)) sim->pubs.push_back(t);
+}
+
+static void SimInput(Sim* sim, uint64_t now) {
+    SimAdvance(sim, now);
+    uint32_t delay = 0;
+    switch (SchedulerOnInput(&sim->s, now, &delay)) {
+    case SCHED_NOW:    sim->pubs.push_back(now); break;
+    case SCHED_DEFER:  sim->timerDue = now + delay + sim->jitterMs; break;
+    case SCHED_MERGED: break;
+    }
+}
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// Прогоняет ввод inputs (моменты по возрастанию) и проверяет границы
+static void Storm(const char* name, const std::vector<uint64_t>& inputs, uint32_t intervalMs, uint32_t jitterMs,
+                  bool expectNoCoalescing = false) {
+    Sim sim;
+    SimInit(&sim, intervalMs, jitterMs);
+    for (uint64_t t : inputs) SimInput(&sim, t);
+    SimAdvance(&sim, UINT64_MAX - 1);
+
+    const std::vector<uint64_t>& p = sim.pubs;
+    uint64_t first = inputs.front(), last = inputs.back();
+    uint64_t span = p.empty() ? 0 : p.back() - first;
+    uint64_t bound = span / intervalMs + 1;
+    printf("%-28s interval %2u ms, jitter %u: %7zu inputs -> %5zu publications (bound %llu)\n",
+        name, intervalMs, jitterMs, inputs.size(), p.size(), (unsigned long long)bound);
+
+    TEST_CHECK(!p.empty() && p.size() <= bound, "%s: %zu publications over %llu ms", name, p.size(),
+        (unsigned long long)span);
+    for (size_t i = 1; i < p.size(); i++)
+        TEST_CHECK(p[i] - p[i - 1] >= intervalMs, "%s: publications %llu and %llu ms are too close", name,
+            (unsigned long long)p[i - 1], (unsigned long long)p[i]);
+    TEST_CHECK(!p.empty() && p.back() >= last, "%s: last input at %llu ms never published", name,
+        (unsigned long long)last);
+
+    // каждое событие уходит с первой публикацией не раньше него
+    size_t j = 0;
+    uint64_t worst = 0;
+    for (uint64_t t : inputs) {
+        while (j < p.size() && p[j] < t) j++;
+        if (j == p.size()) break;
+        if (p[j] - t > worst) worst = p[j] - t;
+    }
+    TEST_CHECK(worst <= (uint64_t)intervalMs + jitterMs, "%s: an input waited %llu ms", name,
+        (unsigned long long)worst);
+
+    const UpdateScheduler& s = sim.s;
+    TEST_CHECK(s.inputEvents == inputs.size() && s.published == p.size() && !s.pending
+        && s.inputEvents == s.published + s.coalesced, "%s: counters input %llu, published %llu, coalesced %llu",
+        name, (unsigned long long)s.inputEvents, (unsigned long long)s.published, (unsigned long long)s.coalesced);
+    if (expectNoCoalescing)
+        TEST_CHECK(s.coalesced == 0 && p == inputs, "%s: slow input was delayed or merged", name);
+}
+
+int main() {
+    const uint32_t intervals[] = { 1, DEFAULT_FRAME_INTERVAL, 33 };
+    const uint32_t jitters[] = { 0, 5 };
+    for (uint32_t iv : intervals) {
+        for (uint32_t jit : jitters) {
+            std::vector<uint64_t> in;
+
+            // колесо без остановки: 50 событий в каждую миллисекунду, 10 с
+            for (uint64_t t = 1000; t < 11000; t++)
+                for (int k = 0; k < 50; k++) in.push_back(t);
+            Storm("steady 50 per ms", in, iv, jit);
+
+            // пачки по 1000 событий в одну миллисекунду каждые 37 мс
+            in.clear();
+            for (uint64_t t = 5; t < 20000; t += 37)
+                for (int k = 0; k < 1000; k++) in.push_back(t);
+            Storm("bursts of 1000 every 37 ms", in, iv, jit);
+
+            // случайные промежутки 0..2*interval
+            in.clear();
+            uint64_t rnd = 42, t = 1;
+            for (int k = 0; k < 200000; k++) {
+                t += NextRandom(&rnd) % (2 * iv + 1);
+                in.push_back(t);
+            }
+            Storm("random gaps", in, iv, jit);
+
+            // редкий ввод: каждое событие публикуется сразу
+            in.clear();
+            for (uint64_t t2 = 100; t2 < 100 + 1000 * (uint64_t)(iv + 7); t2 += iv + 7) in.push_back(t2);
+            Storm("slow input", in, iv, jit, true);
+        }
+    }
+
+    // Перерисовка окна: 8 писателей публикуют каждый не чаще кадра,
+    // окно склеивает их уведомления вторым планировщиком
+    Sim writers[8];
+    std::vector<uint64_t> notifies;
+    uint64_t rnd = 7;
+    for (int w = 0; w < 8; w++) {
+        SimInit(&writers[w], DEFAULT_FRAME_INTERVAL, 0);
+        for (uint64_t t = 0; t < 10000; t += NextRandom(&rnd) % 3) SimInput(&writers[w], t);
+        SimAdvance(&writers[w], UINT64_MAX - 1);
+        notifies.insert(notifies.end(), writers[w].pubs.begin(), writers[w].pubs.end());
+    }
+    std::sort(notifies.begin(), notifies.end());
+    Storm("repaints from 8 writers", notifies, DEFAULT_FRAME_INTERVAL, 0);
+
+    return TestResult("CoalesceTest");
+}
@@ -0,0 +1,93 @@
+﻿// Наблюдатель конфига (ConfigWatch) срабатывает только на настоящие правки.
+//
+// Окно стартует с конфигом, который отличается от файла (-grid из
+// командной строки). Не должны вызывать перезагрузку:
+//  - пересохранение файла с тем же содержимым;
+//  - запись соседних файлов каталога (data.bin, журнал, снимки поля —
+//    их пишут каждый кадр);
+//  - для -m5 — запись config.txt.
+// Правка самого конфига — ровно одно срабатывание с новым содержимым.
+
+#include "Bench.h"
+#include "Test.h"
+#include "Config.h"
+
+#include <fcntl.h>
+
+static std::atomic<int> fired(0);
+
+static void OnChanged(void*) { fired.fetch_add(1); }
+
+static void Touch(const char* name) {
+    int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (write(fd, "x", 1) < 0) {}
+        close(fd);
+    }
+}
+
+// Ждёт срабатывания до ms миллисекунд
+static bool WaitFired(int want, int ms) {
+    for (int i = 0; i < ms && fired.load() < want; i++) usleep(1000);
+    return fired.load() >= want;
+}
+
+static bool SameConfig(const Config& a, const Config& b) {
+    return a.gridSize == b.gridSize && a.clientWidth == b.clientWidth && a.clientHeight == b.clientHeight
+        && a.backgroundColor == b.backgroundColor && a.gridColor == b.gridColor;
+}
+
+static void Check(ConfigMethod method, const char* name) {
+    Config onDisk = { 5, 640, 480, RGB(1, 2, 3), RGB(4, 5, 6) };
+    configMethod = method;
+    currentConfig = onDisk;
+    SaveConfig();
+    if (method == METHOD_BINARY) SaveConfigMapping();
+
+    Config started = onDisk;
+    started.gridSize = 40;                 // -grid 40
+    fired.store(0);
+    ConfigWatcher* w = ConfigWatchStart(method, &started, OnChanged, nullptr);
+    TEST_CHECK(w != nullptr, "%s: watcher did not start", name);
+    if (!w) return;
+
+    SaveConfig();                          // то же содержимое
+    for (int i = 0; i < 20; i++) {
+        Touch("data.bin");
+        Touch("data.1.bin");
+        Touch("board.snap.1");
+        if (method == METHOD_BINARY) SaveConfigMapping();
+    }
+    bool spurious = WaitFired(1, 300);
+    Config c;
+    TEST_CHECK(!spurious && !ConfigWatchTake(w, &c), "%s: reloaded without a config change (%d times)", name,
+        fired.load());
+
+    Config edited = onDisk;
+    edited.gridSize = 9;
+    edited.gridColor = RGB(7, 8, 9);
+    currentConfig = edited;
+    SaveConfig();
+    TEST_CHECK(WaitFired(1, 2000), "%s: config edit was not noticed", name);
+    usleep(100000);
+    bool took = ConfigWatchTake(w, &c);
+    TEST_CHECK(took && SameConfig(c, edited), "%s: reloaded config is not the edited one", name);
+    TEST_CHECK(fired.load() == 1, "%s: one edit fired %d times", name, fired.load());
+    ConfigWatchStop(w);
+    printf("%s: watcher ignored rewrites and neighbours, edit fired once\n", name);
+}
+
+int main() {
+    char work[] = "/tmp/ConfigWatchTest.XXXXXX";
+    if (!mkdtemp(work) || chdir(work) != 0) {
+        perror(work);
+        return 1;
+    }
+    Check(METHOD_MAPPING, "-m1 config.txt");
+    Check(METHOD_BINARY, "-m5 config.bin");
+
+    const char* files[] = { "config.txt", "config.bin", "data.bin", "data.1.bin", "board.snap.1" };
+    for (const char* f : files) unlink(f);
+    if (chdir("/") == 0) rmdir(work);
+    return TestResult("ConfigWatchTest");
+}
@@ -0,0 +1,210 @@
+﻿// Журнал (Journal) переживает SIGKILL в любой момент.
+//
+//   JournalTest [-grid 256] [-writers 3] [-kills 20] [-commit 4] [-checkpoint 16]
+//
+// Раунд: писатели ставят ходы каждый в свою полосу клеток, раз в commit
+// ходов сбрасывают журнал (как окно раз в кадр) и отмечают ходы
+// сохранёнными, раз в checkpoint ходов — контрольную точку. Чётные
+// писатели зовут JournalCommit сами, нечётные будят JournalFlusher и
+// отмечают ходы, когда его поток доложит о сбросе. Через случайное
+// время все они получают SIGKILL — посреди хода, сброса или контрольной
+// точки; поле в общей памяти удаляется, как после выхода всех экземпляров.
+// Пока они пишут, журнал всё время открывается заново (как новым окном) —
+// заголовок должен быть цел в любой момент. Дальше — как у первого окна: журнал открывается без права создать
+// (заголовок должен остаться целым), поле поднимается JournalReplay и
+// проверяется: каждый сохранённый ход на месте, посторонних значений нет.
+// Следующий раунд пишет в восстановленное поле.
+
+#include "Bench.h"
+#include "Test.h"
+#include "Journal.h"
+#include "SharedGrid.h"
+
+#include <signal.h>
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// Значение, которое писатели ставят в клетку: своё у каждой
+static int CellValue(int cell) {
+    return CELL_O + (int)(((uint32_t)cell * 2654435761u) >> 31);
+}
+
+// committed[cell] — ход сохранён (JournalCommit вернулся после него)
+static int Writer(const char* name, const char* path, int grid, int id, int writers, int commitEvery,
+                  int checkpointEvery, uint8_t* committed, std::atomic<uint32_t>* started) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created) || created) return 2;
+    Journal* j = JournalOpen(path, false);
+    if (!j) return 3;
+    SharedAttachJournal(&m, j, false);
+    GridSnapshot snap = {};
+    SharedReadSnapshot(&m, &snap);
+
+    JournalFlusher* f = id % 2 ? JournalFlusherStart(j) : nullptr;
+
+    // ходы и номер Kick, после которого они сброшены
+    std::vector<std::pair<int, uint64_t>> pending;
+    started->fetch_add(1);
+    int moves = 0;
+    for (int cell = id; cell < grid * grid; cell += writers) {
+        if (GridCellGet(snap.cells, cell) != CELL_EMPTY) continue;
+        SharedWriteCell(&m, cell, CellValue(cell));
+        pending.push_back({ cell, 0 });
+        if (++moves % commitEvery == 0) {
+            if (f) {
+                uint64_t ticket = JournalFlusherKick(f);
+                for (auto& p : pending) if (!p.second) p.second = ticket;
+            }
+            else {
+                JournalCommit(j);
+                for (auto& p : pending) p.second = 1;
+            }
+        }
+        uint64_t done = f ? JournalFlusherDone(f) : 1;
+        size_t keep = 0;
+        for (auto& p : pending) {
+            if (p.second && p.second <= done) committed[p.first] = 1;
+            else pending[keep++] = p;
+        }
+        pending.resize(keep);
+        if (moves % checkpointEvery == 0) SharedAttachJournal(&m, j, true);
+    }
+    // поле кончилось: ждём SIGKILL, досчитывая то, что сбросил поток
+    for (;;) {
+        uint64_t done = JournalFlusherDone(f);
+        for (auto& p : pending) if (p.second && p.second <= done) committed[p.first] = 1;
+        usleep(1000);
+    }
+}
+
+// Первое окно после сбоя: поле из журнала. false — журнал не открылся
+// или восстанавливать нечего.
+static bool Recover(SharedMapping* m, const char* name, const char* path, int grid, bool create, Journal** out) {
+    bool created = false;
+    TEST_CHECK(SharedOpen(m, name, grid, &created) && created, "cannot create %s", name);
+    Journal* j = JournalOpen(path, create);
+    *out = j;
+    if (!j) return false;
+    SharedReset(m, RGB(0, 0, 255), RGB(255, 0, 0));
+    bool replayed = JournalReplay(j, m);
+    SharedAttachJournal(m, j, true);
+    return replayed || create;
+}
+
+int main(int argc, char** argv) {
+    int grid = (int)BenchArg(argc, argv, "-grid", 256);
+    int writers = (int)BenchArg(argc, argv, "-writers", 3);
+    int kills = (int)BenchArg(argc, argv, "-kills", 20);
+    int commitEvery = (int)BenchArg(argc, argv, "-commit", 4);
+    int checkpointEvery = (int)BenchArg(argc, argv, "-checkpoint", 16);
+    alarm(240);                        // зависание — тоже провал
+
+    char work[] = "/tmp/JournalTest.XXXXXX";
+    if (!mkdtemp(work)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char path[128];
+    snprintf(path, sizeof(path), "%s/data.bin", work);
+    char base[64], name[80];
+    BenchName(base, sizeof(base), "JournalTest");
+
+    int cells = grid * grid;
+    uint8_t* committed = BenchShared<uint8_t>((size_t)cells);
+    std::atomic<uint32_t>* started = BenchShared<std::atomic<uint32_t>>(1);
+    uint64_t rnd = 20240917;
+    uint64_t lost = 0, stray = 0, totalCommitted = 0, opens = 0, badOpens = 0;
+
+    SharedMapping m;
+    Journal* j = nullptr;
+    snprintf(name, sizeof(name), "%s.0", base);
+    TEST_CHECK(Recover(&m, name, path, grid, true, &j), "cannot create journal %s", path);
+    SharedSetWinLength(&m, grid);      // линии в grid одинаковых значений не будет
+    JournalCommit(j);
+
+    for (int k = 1; k <= kills && j; k++) {
+        started->store(0);
+        std::vector<pid_t> pids;
+        BenchSpawn(writers, [&](int i) {
+            return Writer(name, path, grid, i, writers, commitEvery, checkpointEvery, committed, started);
+        }, &pids);
+        while (started->load() < (uint32_t)writers) {
+            bool gone = false;
+            for (pid_t p : pids) gone |= waitpid(p, nullptr, WNOHANG) == p;
+            TEST_CHECK(!gone, "round %d: writer exited before starting", k);
+            if (gone) break;
+            sched_yield();
+        }
+        // каждого — в своё случайное время; пока они пишут, журнал то и
+        // дело открывается заново, как новым экземпляром: заголовок должен
+        // быть цел в любой момент, а не только после сбоя
+        for (pid_t p : pids) {
+            uint64_t until = BenchNow() + NextRandom(&rnd) % 8000 * 1000;
+            while (BenchNow() < until) {
+                Journal* probe = JournalOpen(path, false);
+                if (!probe) badOpens++;
+                JournalClose(probe);
+                opens++;
+            }
+            kill(p, SIGKILL);
+        }
+        for (pid_t p : pids) waitpid(p, nullptr, 0);
+
+        // все экземпляры ушли: в памяти не остаётся ничего, кроме файла
+        m.journal = nullptr;
+        JournalClose(j);
+        SharedClose(&m);
+        SharedUnlink(name);
+
+        snprintf(name, sizeof(name), "%s.%d", base, k);
+        bool ok = Recover(&m, name, path, grid, false, &j);
+        TEST_CHECK(j, "round %d: journal header no longer valid", k);
+        TEST_CHECK(ok, "round %d: nothing to replay", k);
+        if (!ok) break;
+
+        GridSnapshot snap = {};
+        SharedReadSnapshot(&m, &snap);
+        uint64_t roundLost = 0, present = 0, saved = 0;
+        for (int c = 0; c < cells; c++) {
+            int v = GridCellGet(snap.cells, c);
+            if (v != CELL_EMPTY) present++;
+            if (v != CELL_EMPTY && v != CellValue(c)) stray++;
+            if (committed[c]) {
+                saved++;
+                if (v != CellValue(c)) roundLost++;
+            }
+        }
+        lost += roundLost;
+        totalCommitted = saved;
+        TEST_CHECK(snap.gridSize == grid && snap.winner == CELL_EMPTY, "round %d: board %d, winner %d", k,
+            snap.gridSize, snap.winner);
+        TEST_CHECK(!roundLost, "round %d: %llu committed moves lost", k, (unsigned long long)roundLost);
+        GridSnapshotFree(&snap);
+        if (k % 5 == 0 || k == kills)
+            printf("round %2d: %llu committed, %llu on the board after replay\n", k, (unsigned long long)saved,
+                (unsigned long long)present);
+    }
+    printf("%d kills: %llu committed moves, %llu lost, %llu stray cells\n", kills,
+        (unsigned long long)totalCommitted, (unsigned long long)lost, (unsigned long long)stray);
+    printf("header checked %llu times while writing: %llu invalid\n", (unsigned long long)opens,
+        (unsigned long long)badOpens);
+    TEST_CHECK(!badOpens, "journal header invalid %llu times while writing", (unsigned long long)badOpens);
+    TEST_CHECK(totalCommitted > 0, "nothing was committed");
+    TEST_CHECK(!stray, "%llu cells hold values nobody wrote", (unsigned long long)stray);
+
+    m.journal = nullptr;
+    JournalClose(j);
+    SharedClose(&m);
+    SharedUnlink(name);
+    unlink(path);
+    rmdir(work);
+    BenchSharedFree(committed, (size_t)cells);
+    BenchSharedFree(started, 1);
+    return TestResult("JournalTest");
+}
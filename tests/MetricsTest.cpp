@@ -0,0 +1,163 @@
+﻿// Метрики (Metrics): корзины, счёт под конкурентной записью и слоты
+// умерших процессов.
+//
+//   MetricsTest [-procs 8] [-records 200000]
+//
+// 1. Одно значение за раз: квантиль гистограммы из одной записи отстоит
+//    от значения не больше чем на 1/16, до 16 нс — совпадает точно.
+// 2. procs процессов пишут records значений и счётчик каждый; пока они
+//    стоят, MetricsRead видит ровно столько в каждом слоте.
+// 3. Все слоты заняты живыми — MetricsOpen с join отказывает. Владельцы
+//    получают SIGKILL; читатель их больше не показывает, а их слоты
+//    достаются новым подключениям.
+
+#include "Bench.h"
+#include "Test.h"
+
+#include <signal.h>
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static const MetricsInstance* Find(const MetricsSample* s, uint32_t pid) {
+    for (uint32_t i = 0; i < s->instances; i++)
+        if (s->inst[i].pid == pid) return &s->inst[i];
+    return nullptr;
+}
+
+// Гистограмма одной записи v: квантиль из разницы двух чтений
+static uint64_t RoundTrip(Metrics* m, uint64_t v, MetricsSample* a, MetricsSample* b) {
+    uint32_t self = (uint32_t)getpid();
+    MetricsRead(m, a);
+    MetricsRecord(m, METRIC_PAINT, v);
+    MetricsRead(m, b);
+    const MetricsInstance* x = Find(a, self);
+    const MetricsInstance* y = Find(b, self);
+    if (!x || !y) return UINT64_MAX;
+    MetricsHistogram h;
+    MetricsHistogramDiff(&y->hist[METRIC_PAINT], &x->hist[METRIC_PAINT], &h);
+    if (h.count != 1) return UINT64_MAX;
+    return MetricsPercentile(&h, 0.5);
+}
+
+struct Phase {
+    std::atomic<uint32_t> stopped;
+    std::atomic<uint32_t> release;
+};
+
+int main(int argc, char** argv) {
+    int procs = (int)BenchArg(argc, argv, "-procs", 8);
+    int records = (int)BenchArg(argc, argv, "-records", 200000);
+    alarm(240);                        // зависание — тоже провал
+
+    char name[64], stats[96];
+    BenchName(name, sizeof(name), "MetricsTest");
+    snprintf(stats, sizeof(stats), "%s.stats", name);
+    Metrics* m = MetricsOpen(name, true, true);
+    TEST_CHECK(m, "cannot create %s", stats);
+    if (!m) return TestResult("MetricsTest");
+    MetricsSample* a = new MetricsSample;
+    MetricsSample* b = new MetricsSample;
+
+    // 1. Корзины: все значения до 4096 и случайные до 2^40 по возрастанию,
+    //    чтобы общий максимум не подрезал квантиль
+    std::vector<uint64_t> values;
+    for (uint64_t v = 0; v < 4096; v++) values.push_back(v);
+    uint64_t rnd = 99;
+    for (int i = 0; i < 20000; i++) values.push_back(4096 + NextRandom(&rnd) % ((1ull << METRICS_MAX_BITS) - 4096));
+    std::sort(values.begin(), values.end());
+    uint32_t off = 0;
+    for (uint64_t v : values) {
+        uint64_t got = RoundTrip(m, v, a, b);
+        uint64_t diff = got > v ? got - v : v - got;
+        bool fine = v < (1u << METRICS_SUB_BITS) ? got == v : got != UINT64_MAX && diff * 16 <= v;
+        if (!fine && off++ < 5)
+            fprintf(stderr, "value %llu read back as %llu\n", (unsigned long long)v, (unsigned long long)got);
+    }
+    TEST_CHECK(off == 0, "%u of %zu values outside their bucket", off, values.size());
+
+    // 2. Конкурентная запись: каждый в свой слот, без потерь
+    Phase* ph = BenchShared<Phase>(1);
+    std::vector<pid_t> pids;
+    TEST_CHECK(BenchSpawn(procs, [&](int i) {
+        Metrics* own = MetricsOpen(name, false, true);
+        if (!own) return 2;
+        uint64_t r = 1 + (uint64_t)i;
+        for (int k = 0; k < records; k++) {
+            MetricsRecord(own, METRIC_WRITE_TO_NOTIFY, NextRandom(&r) & 0xFFFFFF);
+            MetricsCount(own, METRIC_BROADCASTS, (uint64_t)i + 1);
+        }
+        ph->stopped.fetch_add(1);
+        while (!ph->release.load()) sched_yield();
+        MetricsClose(own);
+        return 0;
+    }, &pids), "fork failed");
+    uint64_t deadline = BenchNow() + 60000000000ull;
+    while (ph->stopped.load() < (uint32_t)procs && BenchNow() < deadline) sched_yield();
+    MetricsRead(m, a);
+    for (int i = 0; i < procs && i < (int)pids.size(); i++) {
+        const MetricsInstance* in = Find(a, (uint32_t)pids[i]);
+        TEST_CHECK(in, "writer %d missing from MetricsRead", i);
+        if (!in) continue;
+        const MetricsHistogram& h = in->hist[METRIC_WRITE_TO_NOTIFY];
+        uint64_t inBuckets = 0;
+        for (int k = 0; k < METRICS_BUCKETS; k++) inBuckets += h.buckets[k];
+        TEST_CHECK(h.count == (uint64_t)records && inBuckets == (uint64_t)records,
+            "writer %d: count %llu, buckets %llu, expected %d", i, (unsigned long long)h.count,
+            (unsigned long long)inBuckets, records);
+        TEST_CHECK(in->counters[METRIC_BROADCASTS] == (uint64_t)records * (i + 1), "writer %d: counter %llu", i,
+            (unsigned long long)in->counters[METRIC_BROADCASTS]);
+    }
+    ph->release.store(1);
+    TEST_CHECK(BenchWait(&pids), "a writer failed");
+    MetricsRead(m, a);
+    TEST_CHECK(a->instances == 1, "%u instances after writers closed", a->instances);
+    BenchSharedFree(ph, 1);
+
+    // 3. Слоты умерших: остальные METRICS_SLOTS - 1 заняты и владельцы убиты
+    const int others = METRICS_SLOTS - 1;
+    std::atomic<uint32_t>* joined = BenchShared<std::atomic<uint32_t>>(1);
+    BenchSpawn(others, [&](int) -> int {
+        Metrics* own = MetricsOpen(name, false, true);
+        if (own) MetricsCount(own, METRIC_REPAINTS);
+        joined->fetch_add(own ? 1 : 0x10000);
+        for (;;) pause();
+    }, &pids);
+    while (joined->load() < (uint32_t)others && BenchNow() < deadline) sched_yield();
+    TEST_CHECK(joined->load() == (uint32_t)others, "%u of %d joined, %u refused", joined->load() & 0xFFFF, others,
+        joined->load() >> 16);
+    Metrics* extra = MetricsOpen(name, false, true);
+    TEST_CHECK(!extra, "joined with every slot held by a live process");
+    MetricsClose(extra);
+    MetricsRead(m, a);
+    TEST_CHECK(a->instances == METRICS_SLOTS, "%u instances with every slot taken", a->instances);
+
+    for (pid_t p : pids) kill(p, SIGKILL);
+    for (pid_t p : pids) waitpid(p, nullptr, 0);
+    pids.clear();
+    MetricsRead(m, a);
+    TEST_CHECK(a->instances == 1, "%u instances after the owners were killed", a->instances);
+    std::vector<Metrics*> again;
+    for (int i = 0; i < others; i++) {
+        Metrics* own = MetricsOpen(name, false, true);
+        TEST_CHECK(own, "slot %d of a killed process not reclaimed", i);
+        if (!own) break;
+        again.push_back(own);
+    }
+    MetricsRead(m, a);
+    uint64_t stale = 0;
+    for (uint32_t i = 0; i < a->instances; i++) stale += a->inst[i].counters[METRIC_REPAINTS];
+    TEST_CHECK(stale == 0, "reclaimed slots kept %llu repaints of the dead", (unsigned long long)stale);
+    for (Metrics* own : again) MetricsClose(own);
+    BenchSharedFree(joined, 1);
+
+    delete a;
+    delete b;
+    MetricsClose(m);
+    shm_unlink(stats);
+    return TestResult("MetricsTest");
+}
@@ -0,0 +1,147 @@
+﻿// Очередь ходов (MoveQueue): умершие участники не останавливают её.
+//
+//   MoveQueueTest [-procs 8] [-moves 20000]
+//
+// 1. Счёт: procs процессов подают ходы в поле без побед; принятых ровно
+//    столько, сколько фишек на поле, и ни одной заявки без итога.
+// 2. Автор взял номер и умер до публикации (claim записан) — следующие
+//    ходы проходят, заявка пропущена как брошенная.
+// 3. То же, но умер раньше, чем записал claim, — пропуск по таймауту.
+// 4. Автор опубликовал заявку и умер, не забрав итог, — слот на
+//    следующем круге освобождается.
+// 5. Разборщик умер, держа consumer, — разбирать начинает другой.
+// 6. Разборщик умер посреди пропуска брошенной заявки (слот в +3) —
+//    следующий доводит пропуск.
+
+#include "Bench.h"
+#include "Test.h"
+#include "MoveQueue.h"
+
+static uint32_t LapTag(uint32_t t) {
+    return t / MOVE_QUEUE_SLOTS * 4;
+}
+
+static uint32_t CountPieces(SharedMapping* m) {
+    GridSnapshot snap = {};
+    SharedReadSnapshot(m, &snap);
+    uint32_t n = 0;
+    for (uint32_t w = 0; w < GridWordsFor(snap.gridSize); w++)
+        n += (uint32_t)__builtin_popcountll((snap.cells[w] | snap.cells[w] >> 1) & 0x5555555555555555ull);
+    GridSnapshotFree(&snap);
+    return n;
+}
+
+// Ходы после сбоя проходят; ms — сколько ушло на первый
+static double SubmitAfter(SharedMapping* m, const char* what, int moves) {
+    uint64_t t0 = BenchNow();
+    double first = 0;
+    for (int i = 0; i < moves; i++) {
+        int cell = SharedGridSize(m) * SharedGridSize(m) - 1 - i;
+        int player = m->data->countO <= m->data->countX ? CELL_O : CELL_X;
+        int r = MoveSubmit(m, cell, player, nullptr);
+        if (i == 0) first = (BenchNow() - t0) / 1e6;
+        TEST_CHECK(r == MOVE_ACCEPTED || r == MOVE_OCCUPIED, "%s: move %d got %d", what, i, r);
+    }
+    printf("%s: next move went through in %.2f ms\n", what, first);
+    return first;
+}
+
+int main(int argc, char** argv) {
+    int procs = (int)BenchArg(argc, argv, "-procs", 8);
+    int moves = (int)BenchArg(argc, argv, "-moves", 20000);
+    alarm(120);                        // зависание — тоже провал
+
+    char name[64];
+    BenchName(name, sizeof(name), "MoveQueueTest");
+    const int grid = 300;
+    SharedMapping m;
+    bool created = false;
+    TEST_CHECK(SharedOpen(&m, name, grid, &created) && created, "cannot create %s", name);
+    SharedReset(&m, RGB(0, 0, 0), RGB(255, 255, 255));
+    SharedSetWinLength(&m, grid + 1);
+    SharedMoveQueue& q = m.data->moves;
+
+    // 1. Счёт
+    std::atomic<uint64_t>* tally = BenchShared<std::atomic<uint64_t>>(MOVE_DROPPED + 1);
+    bool ok = BenchFork(procs, [&](int i) {
+        SharedMapping c;
+        bool cr = false;
+        if (!SharedOpen(&c, name, grid, &cr)) return 2;
+        uint64_t rnd = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+        for (int k = 0; k < moves; k++) {
+            rnd ^= rnd >> 12; rnd ^= rnd << 25; rnd ^= rnd >> 27;
+            int r = MoveSubmit(&c, (int)(rnd % (grid * grid / 2)), CELL_O + (int)(rnd >> 63), nullptr);
+            tally[r >= 0 && r <= MOVE_DROPPED ? r : MOVE_PENDING].fetch_add(1);
+        }
+        SharedClose(&c);
+        return 0;
+    });
+    uint32_t pieces = CountPieces(&m);
+    printf("%d processes x %d moves: accepted %llu, occupied %llu, not your turn %llu; %u pieces on the board\n",
+        procs, moves, (unsigned long long)tally[MOVE_ACCEPTED].load(), (unsigned long long)tally[MOVE_OCCUPIED].load(),
+        (unsigned long long)tally[MOVE_NOT_YOUR_TURN].load(), pieces);
+    TEST_CHECK(ok, "a submitter failed");
+    TEST_CHECK(tally[MOVE_ACCEPTED].load() == pieces, "accepted %llu, pieces %u",
+        (unsigned long long)tally[MOVE_ACCEPTED].load(), pieces);
+    TEST_CHECK(!tally[MOVE_PENDING].load() && !tally[MOVE_GAME_OVER].load() && !tally[MOVE_OUT_OF_RANGE].load()
+        && !tally[MOVE_DROPPED].load(), "unexpected results: pending %llu, game over %llu, out of range %llu, dropped %llu",
+        (unsigned long long)tally[MOVE_PENDING].load(), (unsigned long long)tally[MOVE_GAME_OVER].load(),
+        (unsigned long long)tally[MOVE_OUT_OF_RANGE].load(), (unsigned long long)tally[MOVE_DROPPED].load());
+    BenchSharedFree(tally, MOVE_DROPPED + 1);
+
+    // 2. Умер с номером, claim записан
+    uint64_t abandoned = MoveQueueGetStats().abandoned;
+    BenchFork(1, [&](int) -> int {
+        uint32_t t = q.tail.fetch_add(1);
+        q.slots[t % MOVE_QUEUE_SLOTS].claim.store((uint64_t)t << 32 | (uint32_t)getpid());
+        _exit(0);
+    });
+    SubmitAfter(&m, "producer died after claiming a ticket", 4);
+    TEST_CHECK(MoveQueueGetStats().abandoned == abandoned + 1, "claimed ticket of a dead producer was not skipped");
+
+    // 3. Умер раньше, чем записал claim
+    BenchFork(1, [&](int) -> int {
+        q.tail.fetch_add(1);
+        _exit(0);
+    });
+    double orphanMs = SubmitAfter(&m, "producer died before claiming", 4);
+    TEST_CHECK(MoveQueueGetStats().abandoned == abandoned + 2, "unclaimed ticket was not skipped");
+    TEST_CHECK(orphanMs < 10000, "unclaimed ticket held the queue %.0f ms", orphanMs);
+
+    // 4. Опубликовал и умер, не забрав итог: слот нужен через круг
+    BenchFork(1, [&](int) -> int {
+        uint32_t t = q.tail.fetch_add(1);
+        SharedMoveSlot& s = q.slots[t % MOVE_QUEUE_SLOTS];
+        s.claim.store((uint64_t)t << 32 | (uint32_t)getpid());
+        s.pid.store((uint32_t)getpid());
+        s.cell = 0;
+        s.player = CELL_O;
+        s.state.store(LapTag(t) + 1);
+        _exit(0);
+    });
+    SubmitAfter(&m, "author died before taking its result", MOVE_QUEUE_SLOTS + 8);
+
+    // 5. Разборщик умер посреди разбора
+    BenchFork(1, [&](int) -> int {
+        q.consumer.store((uint32_t)getpid());
+        _exit(0);
+    });
+    SubmitAfter(&m, "consumer died", 4);
+    TEST_CHECK(q.consumer.load() == 0, "consumer still held by %u", q.consumer.load());
+
+    // 6. Разборщик умер, забрав слот под пропуск
+    abandoned = MoveQueueGetStats().abandoned;
+    BenchFork(1, [&](int) -> int {
+        uint32_t t = q.tail.fetch_add(1);
+        q.consumer.store((uint32_t)getpid());
+        q.slots[t % MOVE_QUEUE_SLOTS].state.store(LapTag(t) + 3);
+        _exit(0);
+    });
+    SubmitAfter(&m, "consumer died while skipping", 4);
+    TEST_CHECK(MoveQueueGetStats().abandoned == abandoned + 1, "half-skipped ticket was not finished");
+    TEST_CHECK(q.head.load() == q.tail.load(), "queue not drained: head %u, tail %u", q.head.load(), q.tail.load());
+
+    SharedClose(&m);
+    SharedUnlink(name);
+    return TestResult("MoveQueueTest");
+}
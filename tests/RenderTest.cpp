@@ -0,0 +1,107 @@
+﻿// Ядра заливки Render дают одну и ту же картинку.
+//
+// Случайные поля и размеры окна (нечётные ширины — хвосты SIMD-циклов),
+// полный кадр и случайные прямоугольники отсечения, с фоном и со слоем
+// цветов на клетку. Кадр скалярного ядра — эталон; SSE2 и AVX2 (если есть)
+// должны совпасть с ним пиксель в пиксель. Отсечение не должно задевать
+// пиксели за своими границами. Тайловая отрисовка (RenderGridTiled) на
+// пулах разного размера и с разными тайлами тоже совпадает с эталоном.
+
+#include "Test.h"
+#include "Render.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+#define CANARY 0xDEADBEEFu
+
+// Кадр ядром k поверх буфера, залитого CANARY
+static std::vector<uint32_t> Draw(RenderKernel k, Framebuffer* fb, const GridSnapshot* snap, const GridLayout* lay,
+                                  const RenderClip* clip, const uint32_t* cellPixels) {
+    RenderSetKernel(k);
+    for (size_t i = 0; i < (size_t)fb->width * fb->height; i++) fb->pixels[i] = CANARY;
+    RenderGrid(fb, snap, lay, clip, cellPixels);
+    return std::vector<uint32_t>(fb->pixels, fb->pixels + (size_t)fb->width * fb->height);
+}
+
+static std::vector<uint32_t> DrawTiled(ThreadPool* pool, int tile, Framebuffer* fb, const GridSnapshot* snap,
+                                       const GridLayout* lay, const RenderClip* clip, const uint32_t* cellPixels) {
+    for (size_t i = 0; i < (size_t)fb->width * fb->height; i++) fb->pixels[i] = CANARY;
+    RenderGridTiled(pool, fb, snap, lay, clip, tile, cellPixels);
+    return std::vector<uint32_t>(fb->pixels, fb->pixels + (size_t)fb->width * fb->height);
+}
+
+int main() {
+    std::vector<RenderKernel> kernels = { KERNEL_SSE2 };
+    if (RenderSetKernel(KERNEL_AVX2) == KERNEL_AVX2) kernels.push_back(KERNEL_AVX2);
+
+    ThreadPool* pools[] = { ThreadPoolCreate(1), ThreadPoolCreate(3), ThreadPoolCreate(8) };
+    uint64_t rnd = 2024;
+    Framebuffer fb = {};
+    int frames = 0;
+    for (int iter = 0; iter < 300; iter++) {
+        int n = 1 + (int)(NextRandom(&rnd) % 60);
+        int w = 1 + (int)(NextRandom(&rnd) % 700), h = 1 + (int)(NextRandom(&rnd) % 500);
+        if (iter == 0) { n = 1000; w = 3840; h = 2160; }
+
+        std::vector<uint64_t> words(GridWordsFor(n));
+        for (int i = 0; i < n * n; i++) GridCellSet(words.data(), i, (int)(NextRandom(&rnd) % 3));
+        GridSnapshot snap = {};
+        snap.gridSize = n;
+        snap.backgroundColor = (COLORREF)(NextRandom(&rnd) & 0xFFFFFF);
+        snap.gridColor = (COLORREF)(NextRandom(&rnd) & 0xFFFFFF);
+        snap.cells = words.data();
+        snap.capWords = (uint32_t)words.size();
+        std::vector<uint32_t> layer((size_t)n * n);
+        for (uint32_t& p : layer) p = (uint32_t)(NextRandom(&rnd) & 0xFFFFFF);
+
+        FramebufferResize(&fb, w, h);
+        GridLayout lay = GridLayoutMake(n, w, h);
+        RenderClip clip = { 0, 0, w, h };
+        if (iter % 2) {
+            clip.left = (int)(NextRandom(&rnd) % w);
+            clip.top = (int)(NextRandom(&rnd) % h);
+            clip.right = clip.left + 1 + (int)(NextRandom(&rnd) % (w - clip.left));
+            clip.bottom = clip.top + 1 + (int)(NextRandom(&rnd) % (h - clip.top));
+        }
+        const uint32_t* cellPixels = iter % 3 == 0 ? layer.data() : nullptr;
+
+        std::vector<uint32_t> ref = Draw(KERNEL_SCALAR, &fb, &snap, &lay, &clip, cellPixels);
+        bool outside = false;
+        for (int y = 0; y < h && !outside; y++)
+            for (int x = 0; x < w; x++) {
+                bool in = x >= clip.left && x < clip.right && y >= clip.top && y < clip.bottom;
+                if (!in && ref[(size_t)y * w + x] != CANARY) { outside = true; break; }
+            }
+        TEST_CHECK(!outside, "grid %d, %dx%d: scalar kernel drew outside the clip", n, w, h);
+
+        for (RenderKernel k : kernels) {
+            std::vector<uint32_t> got = Draw(k, &fb, &snap, &lay, &clip, cellPixels);
+            size_t diff = 0;
+            while (diff < got.size() && got[diff] == ref[diff]) diff++;
+            TEST_CHECK(diff == got.size(), "grid %d, %dx%d, %s: pixel (%zu, %zu) is %06x, scalar drew %06x", n, w, h,
+                RenderKernelName(k), diff % w, diff / w, diff < got.size() ? got[diff] : 0,
+                diff < got.size() ? ref[diff] : 0);
+            frames++;
+        }
+
+        ThreadPool* pool = pools[iter % 3];
+        int tile = 16 + (int)(NextRandom(&rnd) % 200);
+        std::vector<uint32_t> got = DrawTiled(pool, tile, &fb, &snap, &lay, &clip, cellPixels);
+        TEST_CHECK(got == ref, "grid %d, %dx%d: %d threads with %d px tiles differ from RenderGrid", n, w, h,
+            ThreadPoolSize(pool), tile);
+        frames++;
+    }
+    for (ThreadPool* pool : pools) ThreadPoolDestroy(pool);
+    printf("%d frames compared against the scalar RenderGrid\n", frames);
+    FramebufferFree(&fb);
+    return TestResult("RenderTest");
+}
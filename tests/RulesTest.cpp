@@ -0,0 +1,144 @@
+﻿// Правила (Rules) против наивного эталона на обычном массиве int.
+//
+// Случайные партии на полях 3..12, 15, 50 и 1000 с разными K. Ходы
+// наполовину рядом с предыдущим, чтобы линии и выигрыши встречались и
+// на больших полях. После каждого хода:
+//  - RulesCheckMove выигрывает ровно тогда, когда эталон находит через
+//    эту клетку серию игрока не короче K, и возвращает настоящую линию:
+//    все её клетки — игрока, клетка хода на ней, длина не меньше K;
+//  - RulesFindWin (на малых полях — битборды) находит ту же линию, что и
+//    эталонный перебор: первую клетку в порядке строк, первое направление.
+// Малые поля проходятся дважды: ядрами по размеру и общим путём.
+
+#include "Test.h"
+#include "Rules.h"
+#include "SharedGrid.h"
+
+#include <vector>
+
+static const int dr[4] = { 0, 1, 1, 1 };
+static const int dc[4] = { 1, 0, 1, -1 };
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static int At(const std::vector<int>& g, int n, int r, int c) {
+    return r < 0 || r >= n || c < 0 || c >= n ? CELL_EMPTY : g[(size_t)r * n + c];
+}
+
+// Самая длинная серия игрока через (r, c)
+static int NaiveRunThrough(const std::vector<int>& g, int n, int r, int c) {
+    int p = At(g, n, r, c), best = 0;
+    if (p == CELL_EMPTY) return 0;
+    for (int d = 0; d < 4; d++) {
+        int len = 1;
+        for (int i = 1; At(g, n, r + i * dr[d], c + i * dc[d]) == p; i++) len++;
+        for (int i = 1; At(g, n, r - i * dr[d], c - i * dc[d]) == p; i++) len++;
+        if (len > best) best = len;
+    }
+    return best;
+}
+
+static bool NaiveFindWin(const std::vector<int>& g, int n, int k, WinLine* out) {
+    for (int r = 0; r < n; r++)
+        for (int c = 0; c < n; c++) {
+            int p = At(g, n, r, c);
+            if (p == CELL_EMPTY) continue;
+            for (int d = 0; d < 4; d++) {
+                int i = 1;
+                while (i < k && At(g, n, r + i * dr[d], c + i * dc[d]) == p) i++;
+                if (i < k) continue;
+                *out = { p, r * n + c, d, k };
+                return true;
+            }
+        }
+    return false;
+}
+
+static bool LineValid(const std::vector<int>& g, int n, int k, int index, const WinLine& w) {
+    if (w.length < k || w.dir < 0 || w.dir > 3) return false;
+    int r = w.start / n, c = w.start % n;
+    bool hit = false;
+    for (int i = 0; i < w.length; i++) {
+        int rr = r + i * dr[w.dir], cc = c + i * dc[w.dir];
+        if (At(g, n, rr, cc) != w.player) return false;
+        hit |= rr * n + cc == index;
+    }
+    return hit;
+}
+
+static uint64_t games, moves, wins;
+
+static void Game(int n, int k, int maxMoves, bool fullScan, uint64_t* rnd) {
+    std::vector<int> g((size_t)n * n, CELL_EMPTY);
+    std::vector<uint64_t> cells(GridWordsFor(n), 0);
+    std::vector<int> empty((size_t)n * n), pos((size_t)n * n);    // pos — место клетки в empty
+    for (size_t i = 0; i < empty.size(); i++) empty[i] = pos[i] = (int)i;
+    int last = -1;
+    games++;
+    for (int m = 0; m < maxMoves && !empty.empty(); m++) {
+        int index = -1;
+        if (last >= 0 && NextRandom(rnd) % 2) {
+            int r = last / n + (int)(NextRandom(rnd) % 3) - 1, c = last % n + (int)(NextRandom(rnd) % 3) - 1;
+            if (At(g, n, r, c) == CELL_EMPTY && r >= 0 && r < n && c >= 0 && c < n) index = r * n + c;
+        }
+        if (index < 0) index = empty[(size_t)(NextRandom(rnd) % empty.size())];
+        int slot = pos[index];
+        empty[slot] = empty.back();
+        pos[empty[slot]] = slot;
+        empty.pop_back();
+        int p = CELL_O + (m & 1);
+        g[index] = p;
+        GridCellSet(cells.data(), index, p);
+        last = index;
+        moves++;
+
+        WinLine w = {};
+        bool won = RulesCheckMove(cells.data(), n, k, index, &w);
+        bool want = NaiveRunThrough(g, n, index / n, index % n) >= k;
+        wins += want;
+        TEST_CHECK(won == want, "%dx%d K=%d: move %d at %d: CheckMove says %d, reference %d", n, n, k, m, index,
+            won, want);
+        if (won)
+            TEST_CHECK(LineValid(g, n, k, index, w) && w.player == p, "%dx%d K=%d: move %d at %d: bad line "
+                "start %d dir %d length %d", n, n, k, m, index, w.start, w.dir, w.length);
+
+        if (fullScan) {
+            WinLine a = {}, b = {};
+            bool fa = RulesFindWin(cells.data(), n, k, &a), fb = NaiveFindWin(g, n, k, &b);
+            TEST_CHECK(fa == fb && (!fa || (a.player == b.player && a.start == b.start && a.dir == b.dir
+                && a.length == b.length)), "%dx%d K=%d: move %d: FindWin %d (%d/%d) vs reference %d (%d/%d)",
+                n, n, k, m, fa, a.start, a.dir, fb, b.start, b.dir);
+        }
+    }
+}
+
+int main() {
+    uint64_t rnd = 20240611;
+    // ядра по размеру и общий путь (RulesUseSizeKernels) — против одного эталона
+    for (bool sized : { true, false }) {
+        RulesUseSizeKernels(sized);
+        for (int n = 3; n <= 12; n++) {
+            int ks[] = { 3, 4, 0, n };
+            for (int k0 : ks) {
+                int k = RulesWinLength(n, k0);
+                for (int i = 0; i < 200; i++) Game(n, k, n * n, true, &rnd);
+            }
+        }
+    }
+    RulesUseSizeKernels(true);
+    for (int n : { 15, 50 })
+        for (int k0 : { 3, 0 })
+            for (int i = 0; i < 10; i++) Game(n, RulesWinLength(n, k0), n * n, n <= 15, &rnd);
+    for (int k0 : { 3, 0, 8 })
+        Game(1000, RulesWinLength(1000, k0), 200000, false, &rnd);
+
+    printf("%llu games, %llu moves, %llu winning moves checked against the reference\n",
+        (unsigned long long)games, (unsigned long long)moves, (unsigned long long)wins);
+    TEST_CHECK(wins > 1000, "too few wins to mean anything: %llu", (unsigned long long)wins);
+    return TestResult("RulesTest");
+}
@@ -0,0 +1,239 @@
+﻿// Seqlock поля (SharedGrid) под несколькими процессами.
+//
+//   SeqlockTest [-grid 256] [-writers 3] [-ms 2000] [-kills 20]
+//
+// 1. Рваные снимки. Писатели публикуют только внутренне согласованные
+//    версии: цвета парой с grid == bg ^ 0xFFFFFF (SharedWriteColors) и
+//    поле, целиком залитое одним значением (SharedLoadCells). Читатели —
+//    полным снимком и инкрементальным, как окно, — не должны увидеть
+//    смеси двух версий ни разу.
+// 2. Писатель умирает посреди записи (или сразу после неё, не отпустив
+//    writer): следующий читатель и следующий писатель не зависают, поле
+//    снова пишется, счётчики фишек сходятся с клетками. Читатель,
+//    закрывший оборванную запись, контрольную точку журнала не делает —
+//    её делает следующий писатель.
+// 3. То же со случайными SIGKILL писателя, заливающего большое поле.
+
+#include "Bench.h"
+#include "Test.h"
+#include "Journal.h"
+#include "SharedGrid.h"
+
+#include <signal.h>
+
+static const uint64_t fills[3] = { 0, 0x5555555555555555ull, 0xAAAAAAAAAAAAAAAAull };
+
+static uint64_t NextRandom(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// Версия цела: пара цветов и одно значение во всех словах
+static bool SnapshotWhole(const GridSnapshot* s) {
+    if ((s->backgroundColor ^ s->gridColor) != 0xFFFFFF) return false;
+    uint64_t w0 = s->cells[0];
+    if (w0 != fills[0] && w0 != fills[1] && w0 != fills[2]) return false;
+    uint32_t words = GridWordsFor(s->gridSize);
+    for (uint32_t w = 1; w < words; w++)
+        if (s->cells[w] != w0) return false;
+    return true;
+}
+
+static int Writer(const char* name, int grid, int id, BenchGate* gate, uint64_t ms) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created)) return 2;
+    std::vector<uint64_t> words(GridWordsFor(grid));
+    uint64_t rnd = 0x9E3779B97F4A7C15ull * (uint64_t)(id + 1);
+    BenchGateWait(gate);
+    uint64_t stop = gate->startNs.load() + ms * 1000000;
+    while (BenchNow() < stop) {
+        uint64_t x = NextRandom(&rnd);
+        if (x & 1) {
+            COLORREF c = (COLORREF)(x >> 8) & 0xFFFFFF;
+            SharedWriteColors(&m, c, c ^ 0xFFFFFF);
+        }
+        else {
+            std::fill(words.begin(), words.end(), fills[(x >> 8) % 3]);
+            SharedLoadCells(&m, grid, words.data());
+        }
+    }
+    SharedClose(&m);
+    return 0;
+}
+
+// full — SharedReadSnapshot каждый раз, иначе SharedRefreshSnapshot
+static int Reader(const char* name, int grid, bool full, BenchGate* gate, uint64_t ms, std::atomic<uint64_t>* seen) {
+    SharedMapping m;
+    bool created = false;
+    if (!SharedOpen(&m, name, grid, &created)) return 2;
+    GridSnapshot snap = {};
+    GridDelta delta = {};
+    uint64_t reads = 0, torn = 0;
+    BenchGateWait(gate);
+    uint64_t stop = gate->startNs.load() + ms * 1000000;
+    while (BenchNow() < stop) {
+        if (full) SharedReadSnapshot(&m, &snap);
+        else SharedRefreshSnapshot(&m, &snap, &delta);
+        reads++;
+        if (!SnapshotWhole(&snap)) {
+            if (!torn) fprintf(stderr, "%s reader: torn snapshot at version %u\n", full ? "full" : "incremental", snap.version);
+            torn++;
+        }
+    }
+    seen->fetch_add(reads);
+    GridDeltaFree(&delta);
+    GridSnapshotFree(&snap);
+    SharedClose(&m);
+    return torn ? 1 : 0;
+}
+
+static void TornSnapshots(const char* name, int grid, int writers, uint64_t ms) {
+    BenchGate* gate = BenchShared<BenchGate>(1);
+    std::atomic<uint64_t>* seen = BenchShared<std::atomic<uint64_t>>(1);
+    SharedMapping m;
+    bool created = false;
+    TEST_CHECK(SharedOpen(&m, name, grid, &created) && created, "cannot create %s", name);
+    SharedReset(&m, RGB(0, 0, 0), RGB(255, 255, 255));
+    uint32_t v0 = SharedVersion(&m);
+
+    std::vector<pid_t> pids;
+    bool ok = BenchSpawn(writers, [&](int i) { return Writer(name, grid, i, gate, ms); }, &pids);
+    ok &= BenchSpawn(2, [&](int i) { return Reader(name, grid, i == 0, gate, ms, seen); }, &pids);
+    BenchGateOpen(gate, writers + 2);
+    ok &= BenchWait(&pids);
+    TEST_CHECK(ok, "torn snapshot seen or participant failed");
+    uint32_t versions = SharedVersion(&m) - v0;
+    printf("torn snapshots: %d writers published %u versions, readers took %llu snapshots\n",
+        writers, versions, (unsigned long long)seen->load());
+    TEST_CHECK(versions > 0 && seen->load() > 0, "nothing happened");
+
+    SharedClose(&m);
+    SharedUnlink(name);
+    BenchSharedFree(gate, 1);
+    BenchSharedFree(seen, 1);
+}
+
+static uint32_t CountPieces(const GridSnapshot* s) {
+    uint32_t n = 0;
+    for (uint32_t w = 0; w < GridWordsFor(s->gridSize); w++)
+        n += (uint32_t)__builtin_popcountll((s->cells[w] | s->cells[w] >> 1) & 0x5555555555555555ull);
+    return n;
+}
+
+// Поле снова живое: запись проходит, seq чётный, writer свободен,
+// счётчики фишек сходятся с клетками
+static void CheckAlive(SharedMapping* m, const char* what) {
+    GridSnapshot snap = {};
+    SharedReadSnapshot(m, &snap);
+    uint32_t v = SharedWriteColors(m, RGB(1, 2, 3), RGB(1, 2, 3) ^ 0xFFFFFF);
+    TEST_CHECK(v > snap.version, "%s: write after recovery did not publish", what);
+    TEST_CHECK(!(m->data->seq.load() & 1) && m->data->writer.load() == 0, "%s: write section still held", what);
+    SharedReadSnapshot(m, &snap);
+    TEST_CHECK(CountPieces(&snap) == m->data->countO + m->data->countX, "%s: piece counts %u+%u, board has %u",
+        what, m->data->countO, m->data->countX, CountPieces(&snap));
+    GridSnapshotFree(&snap);
+}
+
+static void DeadWriters(const char* name, int grid, int kills) {
+    SharedMapping m;
+    bool created = false;
+    TEST_CHECK(SharedOpen(&m, name, grid, &created) && created, "cannot create %s", name);
+    SharedReset(&m, RGB(0, 0, 0), RGB(255, 255, 255));
+    char work[] = "/tmp/SeqlockTest.XXXXXX", path[128];
+    TEST_CHECK(mkdtemp(work), "cannot create a directory for the journal");
+    snprintf(path, sizeof(path), "%s/data.bin", work);
+    Journal* j = JournalOpen(path, true);
+    TEST_CHECK(j, "cannot create journal %s", path);
+    SharedAttachJournal(&m, j, true);
+    uint64_t checkpoints = JournalGetStats(j)->checkpoints;
+
+    // Умер посреди записи: seq нечётный, в клетках половина хода
+    BenchFork(1, [&](int) {
+        SharedMapping c;
+        bool cr = false;
+        if (!SharedOpen(&c, name, grid, &cr)) return 2;
+        c.data->writer.store((uint32_t)getpid());
+        c.data->seq.fetch_add(1);
+        SharedCellWords(c.cells)[0] = fills[1];
+        _exit(0);
+    });
+    uint64_t t0 = BenchNow();
+    GridSnapshot snap = {};
+    SharedReadSnapshot(&m, &snap);
+    printf("dead writer mid-write: reader recovered in %.2f ms\n", (BenchNow() - t0) / 1e6);
+    TEST_CHECK(snap.cells[0] == fills[1], "abandoned cells were not published");
+    TEST_CHECK(JournalGetStats(j)->checkpoints == checkpoints, "reader checkpointed the journal");
+    GridSnapshotFree(&snap);
+    CheckAlive(&m, "mid-write");
+    TEST_CHECK(JournalGetStats(j)->checkpoints == checkpoints + 1,
+        "next writer made %llu journal checkpoints after the repair, not 1",
+        (unsigned long long)(JournalGetStats(j)->checkpoints - checkpoints));
+
+    // Умер, не отпустив writer: seq чётный, ждут только писатели
+    BenchFork(1, [&](int) {
+        SharedMapping c;
+        bool cr = false;
+        if (!SharedOpen(&c, name, grid, &cr)) return 2;
+        c.data->writer.store((uint32_t)getpid());
+        _exit(0);
+    });
+    t0 = BenchNow();
+    SharedWriteCell(&m, 1, CELL_X);
+    printf("dead writer holding the lock: writer recovered in %.2f ms\n", (BenchNow() - t0) / 1e6);
+    CheckAlive(&m, "lock held");
+
+    // Случайные SIGKILL посреди заливки большого поля
+    std::atomic<uint64_t>* loads = BenchShared<std::atomic<uint64_t>>(1);
+    uint64_t rnd = 12345;
+    double worst = 0;
+    for (int k = 0; k < kills; k++) {
+        std::vector<pid_t> pids;
+        BenchSpawn(1, [&](int) {
+            SharedMapping c;
+            bool cr = false;
+            if (!SharedOpen(&c, name, grid, &cr)) return 2;
+            std::vector<uint64_t> words(GridWordsFor(grid));
+            for (uint64_t i = 0; ; i++) {
+                std::fill(words.begin(), words.end(), fills[1 + (i & 1)]);
+                SharedLoadCells(&c, grid, words.data());
+                loads->fetch_add(1);
+            }
+            return 0;
+        }, &pids);
+        while (loads->load() == 0) sched_yield();
+        usleep((useconds_t)(1000 + NextRandom(&rnd) % 20000));
+        kill(pids[0], SIGKILL);
+        waitpid(pids[0], nullptr, 0);
+        loads->store(0);
+        t0 = BenchNow();
+        CheckAlive(&m, "SIGKILL");
+        double msTaken = (BenchNow() - t0) / 1e6;
+        if (msTaken > worst) worst = msTaken;
+    }
+    printf("%d SIGKILLed writers: worst recovery %.2f ms\n", kills, worst);
+
+    BenchSharedFree(loads, 1);
+    m.journal = nullptr;
+    JournalClose(j);
+    unlink(path);
+    rmdir(work);
+    SharedClose(&m);
+    SharedUnlink(name);
+}
+
+int main(int argc, char** argv) {
+    int grid = (int)BenchArg(argc, argv, "-grid", 256);
+    int writers = (int)BenchArg(argc, argv, "-writers", 3);
+    uint64_t ms = (uint64_t)BenchArg(argc, argv, "-ms", 2000);
+    int kills = (int)BenchArg(argc, argv, "-kills", 20);
+    alarm(120);                        // зависание — тоже провал
+
+    char name[64];
+    BenchName(name, sizeof(name), "SeqlockTest");
+    TornSnapshots(name, grid, writers, ms);
+    DeadWriters(name, 1024, kills);
+    return TestResult("SeqlockTest");
+}
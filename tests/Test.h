@@ -0,0 +1,25 @@
+﻿#pragma once
+
+// Проверки для тестов — без фреймворка. Провал печатается с местом и
+// считается; main возвращает TestResult(). Процессы-участники (Bench.h)
+// сообщают о провалах кодом выхода.
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define TEST_CHECK(cond, ...)                                               \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            testFailures++;                                                 \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);      \
+            fprintf(stderr, __VA_ARGS__);                                   \
+            fputc('\n', stderr);                                            \
+        }                                                                   \
+    } while (0)
+
+inline int TestResult(const char* name) {
+    if (testFailures) fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures);
+    else printf("%s: ok\n", name);
+    return testFailures ? 1 : 0;
+}